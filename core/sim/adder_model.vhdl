@@ -0,0 +1,62 @@
+-- Copyright (c) 2014, Juha Turunen
+-- All rights reserved.
+--
+-- Redistribution and use in source and binary forms, with or without
+-- modification, are permitted provided that the following conditions are met: 
+--
+-- 1. Redistributions of source code must retain the above copyright notice, this
+--    list of conditions and the following disclaimer. 
+-- 2. Redistributions in binary form must reproduce the above copyright notice,
+--    this list of conditions and the following disclaimer in the documentation
+--    and/or other materials provided with the distribution. 
+--
+-- THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+-- ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+-- WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+-- DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+-- ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+-- (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+-- LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+-- ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+-- (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+-- SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+-- Behavioral replacement for the lpm_add_sub based adder in core/vhdl/adder.vhd
+-- so that the core can be simulated without the Altera libraries.
+-- add_sub = '1' : result = dataa + datab + cin
+-- add_sub = '0' : result = dataa - datab - not cin
+
+library IEEE;
+use IEEE.STD_LOGIC_1164.ALL;
+use IEEE.NUMERIC_STD.ALL;
+
+entity adder is port (
+	add_sub : in std_logic;
+	cin : in std_logic;
+	dataa : in std_logic_vector(15 downto 0);
+	datab : in std_logic_vector(15 downto 0);
+	cout : out std_logic;
+	overflow : out std_logic;
+	result : out std_logic_vector(15 downto 0)
+);
+end adder;
+
+architecture Behavioral of adder is
+
+signal operand : std_logic_vector(15 downto 0);
+signal sum : unsigned(16 downto 0);
+signal carry : unsigned(0 downto 0);
+
+begin
+	-- subtraction is addition of the one's complement
+	operand <= datab when add_sub = '1' else not datab;
+	carry(0) <= cin;
+	sum <= unsigned('0' & dataa) + unsigned('0' & operand) + carry;
+
+	result <= std_logic_vector(sum(15 downto 0));
+	cout <= sum(16);
+	overflow <= (dataa(15) xnor operand(15)) and (dataa(15) xor sum(15));
+
+end Behavioral;
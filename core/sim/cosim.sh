@@ -0,0 +1,70 @@
+#!/bin/sh
+#
+# Runs a program on the shitty_risc RTL under GHDL and checks the state trace
+# against srsim. Exits with 1 and prints the first divergence when they differ.
+#
+# usage: cosim.sh [-p] [-s sample_interval] [-c max_cycles] [-d clock_divider] [-m mapfile] program.bin
+#
+# -p runs the pipelined core, at every clock unless -d says otherwise.
+#
+# SRSIM and GHDL can be set in the environment if the tools aren't in PATH.
+
+set -e
+
+sim_dir=$(cd "$(dirname "$0")" && pwd)
+vhdl_dir="$sim_dir/../vhdl"
+work_dir="$sim_dir/work"
+ghdl=${GHDL:-ghdl}
+srsim=${SRSIM:-srsim}
+ghdl_flags="--std=93c --ieee=synopsys -fexplicit --workdir=$work_dir"
+
+sample=1
+cycles=100000
+divider=""
+map=""
+pipelined=false
+
+while getopts "ps:c:d:m:" opt; do
+    case $opt in
+        p) pipelined=true ;;
+        s) sample=$OPTARG ;;
+        c) cycles=$OPTARG ;;
+        d) divider=$OPTARG ;;
+        m) map="-m $OPTARG" ;;
+        *) echo "usage: $0 [-p] [-s sample_interval] [-c max_cycles] [-d clock_divider] [-m mapfile] program.bin"; exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -ne 1 ]; then
+    echo "usage: $0 [-p] [-s sample_interval] [-c max_cycles] [-d clock_divider] [-m mapfile] program.bin"
+    exit 2
+fi
+if [ -z "$divider" ]; then
+    if [ $pipelined = true ]; then divider=1; else divider=8; fi
+fi
+program=$(cd "$(dirname "$1")" && pwd)/$(basename "$1")
+trace="$work_dir/$(basename "$1" .bin).trace"
+
+mkdir -p "$work_dir"
+
+# adder.vhd and the RAMs are Altera megafunctions, the models in this directory replace them
+$ghdl -a $ghdl_flags \
+    "$sim_dir/adder_model.vhdl" \
+    "$vhdl_dir/alu.vhdl" \
+    "$vhdl_dir/register_file.vhdl" \
+    "$vhdl_dir/shitty_risc.vhdl" \
+    "$vhdl_dir/shitty_risc_pipelined.vhdl" \
+    "$vhdl_dir/hd44780_lcd_controller.vhdl" \
+    "$vhdl_dir/interrupt_controller.vhdl" \
+    "$vhdl_dir/perf_counters.vhdl" \
+    "$sim_dir/ram_model.vhdl" \
+    "$sim_dir/shitty_risc_tb.vhdl"
+$ghdl -e $ghdl_flags shitty_risc_tb
+
+# The core has don't care inputs to the adder, silence the metavalue warnings
+(cd "$work_dir" && $ghdl -r $ghdl_flags shitty_risc_tb --ieee-asserts=disable \
+    -gprogram_file="$program" -gtrace_file="$trace" \
+    -gsample_interval="$sample" -gmax_cycles="$cycles" -gclk_ena_period="$divider" -gpipelined="$pipelined")
+
+$srsim $map --compare "$trace" -c "$cycles" --clock-divider "$divider" "$program"
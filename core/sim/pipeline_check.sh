@@ -0,0 +1,71 @@
+#!/bin/sh
+#
+# Checks the pipelined core against srsim on assembly programs. Every
+# program runs on pipeline_model.cpp, the C++ transliteration of
+# shitty_risc_pipelined.vhdl, and when GHDL is installed also on the RTL
+# itself with cosim.sh -p. Exits with 1 if any of them differ.
+#
+# usage: pipeline_check.sh [-c max_instructions] program.asm...
+#
+# SRASM, SRSIM, GHDL and CXX can be set in the environment if the tools
+# aren't in PATH, QT_CFLAGS and QT_LIBS if Qt 5 isn't known to pkg-config.
+
+set -e
+
+sim_dir=$(cd "$(dirname "$0")" && pwd)
+tools_dir="$sim_dir/../../tools"
+work_dir="$sim_dir/work"
+srasm=${SRASM:-srasm}
+ghdl=${GHDL:-ghdl}
+cxx=${CXX:-g++}
+qt_cflags=${QT_CFLAGS:-$(pkg-config --cflags Qt5Core) -fPIC}
+qt_libs=${QT_LIBS:-$(pkg-config --libs Qt5Core)}
+
+cycles=100000
+
+while getopts "c:" opt; do
+    case $opt in
+        c) cycles=$OPTARG ;;
+        *) echo "usage: $0 [-c max_instructions] program.asm..."; exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -eq 0 ]; then
+    echo "usage: $0 [-c max_instructions] program.asm..."
+    exit 2
+fi
+
+mkdir -p "$work_dir"
+
+# The model runs srsim next to it, so it's linked with everything in srsim but its main()
+sources=""
+for f in "$tools_dir"/srsim/*.cpp; do
+    [ "$(basename "$f")" = main.cpp ] || sources="$sources $f"
+done
+$cxx -O2 $qt_cflags -I"$tools_dir/srsim" -I"$tools_dir/srasm" -o "$work_dir/pipeline_model" \
+    "$sim_dir/pipeline_model.cpp" $sources "$tools_dir/srasm/srimage.cpp" $qt_libs
+
+if command -v "$ghdl" > /dev/null; then
+    rtl=true
+else
+    echo "$ghdl not found, only running the model"
+    rtl=false
+fi
+
+failed=0
+for program in "$@"; do
+    name=$(basename "$program" .asm)
+    echo "$name:"
+    if ! "$srasm" "$program" "$work_dir/$name.bin" > /dev/null 2>&1; then
+        echo "doesn't assemble"
+        failed=1
+        continue
+    fi
+    "$work_dir/pipeline_model" "$work_dir/$name.bin" "$cycles" || failed=1
+    if [ $rtl = true ]; then
+        "$sim_dir/cosim.sh" -p -c "$cycles" "$work_dir/$name.bin" || failed=1
+    fi
+done
+
+exit $failed
@@ -0,0 +1,508 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Clock by clock C++ transliteration of core/vhdl/shitty_risc_pipelined.vhdl,
+// run next to srsim for checking the pipeline control where GHDL isn't
+// available. The variables are named after the VHDL signals. Every clock on
+// which E completes an instruction or an interrupt entry srsim is stepped once
+// and the scan view, the registers, the flags and the data memory have to
+// match, and so do the I/O writes with their cycles at the end. The interrupt
+// controller is srsim's model ticked by completed instructions like cosim.sh
+// -p counts them, the performance counters and the mailboxes aren't modelled.
+
+#include "srsimulator.h"
+#include "interruptcontroller.h"
+
+#include <QByteArray>
+#include <QFile>
+#include <QVector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct IoWrite
+{
+    quint64 cycle;
+    int address;
+    int value;
+
+    bool operator==(const IoWrite& other) const
+    {
+        return cycle == other.cycle && address == other.address && value == other.value;
+    }
+};
+
+class ReferenceSimulator : public SRSimulator
+{
+public:
+    QVector<IoWrite> m_writes;
+
+protected:
+    void ioWrite(int address, unsigned char value)
+    {
+        IoWrite w = { cycles(), address, value };
+        m_writes.append(w);
+        SRSimulator::ioWrite(address, value);
+    }
+};
+
+class PipelineModel
+{
+public:
+    PipelineModel(const ReferenceSimulator& reference);
+
+    // One clock with clk_ena high, returns false when the model and srsim differ
+    bool clock(ReferenceSimulator& reference);
+    bool stopped() const { return (m_srReg & (SR_HALTED | SR_INTERRUPT_ENABLE)) == SR_HALTED; }
+
+    quint64 m_cycles;
+    quint64 m_clocks;
+    QVector<IoWrite> m_writes;
+
+private:
+    unsigned alu(int op, unsigned src1, unsigned src2, int carryIn, int& carryOut, int& negative, int& zero) const;
+    unsigned forward(int sel) const;
+    unsigned char ioRead(int address, quint64 cycle);
+    void ioWrite(int address, unsigned char value, quint64 cycle);
+
+    QVector<unsigned short> m_program;
+    InterruptController m_interrupts;
+    unsigned char m_ram[256];
+    int m_ramAddr;
+
+    unsigned m_registers[4];
+    int m_dPc;
+    int m_spReg;
+    bool m_eValid;
+    bool m_eIrq;
+    int m_ePc;
+    int m_eInstruction;
+    int m_eSrc1Select;
+    unsigned m_eSrc1;
+    unsigned m_eSrc2;
+    unsigned m_eDst;
+    int m_eIoData;
+    int m_eVector;
+    int m_srReg;
+    int m_savedFlagsReg;
+    int m_bankReg;
+    int m_bankSpReg;
+    int m_bankStack[8];
+
+    // E's register writes of the current clock, forwarded to D
+    bool m_regWrEna;
+    int m_regDstSelect;
+    unsigned m_regDstIn;
+    bool m_regSrc1WrEna;
+    unsigned m_aluResult;
+};
+
+PipelineModel::PipelineModel(const ReferenceSimulator& reference) :
+    m_cycles(0),
+    m_clocks(0),
+    m_program(PROGRAM_SIZE),
+    m_ramAddr(0),
+    m_dPc(0),
+    m_spReg(0xff),
+    m_eValid(false),
+    m_eIrq(false),
+    m_ePc(0),
+    m_eInstruction(0),
+    m_eSrc1Select(0),
+    m_eSrc1(0),
+    m_eSrc2(0),
+    m_eDst(0),
+    m_eIoData(0),
+    m_eVector(0),
+    m_srReg(0),
+    m_savedFlagsReg(0),
+    m_bankReg(0),
+    m_bankSpReg(0)
+{
+    for (int i = 0; i < PROGRAM_SIZE; i++)
+        m_program[i] = reference.programWord(i);
+    for (int a = 0; a < 256; a++)
+        m_ram[a] = reference.dataByte(a);
+    memset(m_registers, 0, sizeof(m_registers));
+    memset(m_bankStack, 0, sizeof(m_bankStack));
+}
+
+// core/vhdl/alu.vhdl
+unsigned PipelineModel::alu(int op, unsigned src1, unsigned src2, int carryIn, int& carryOut, int& negative, int& zero) const
+{
+    unsigned result;
+    switch (op) {
+        case ALU_OP_ADD: result = src1 + src2; break;
+        case ALU_OP_SUB: result = src1 + (src2 ^ 0xffff) + 1; break;
+        case ALU_OP_ADC: result = src1 + src2 + carryIn; break;
+        case ALU_OP_SBC: result = src1 + (src2 ^ 0xffff) + carryIn; break;
+        case ALU_OP_SHR: result = (src1 & 0x8000) | src1 >> 1; break;
+        case ALU_OP_SHL: result = src1 << 1; break;
+        case ALU_OP_SWAP: result = src1 << 8 | src1 >> 8; break;
+        case ALU_OP_NOT: result = ~src1; break;
+        case ALU_OP_OR: result = src1 | src2; break;
+        case ALU_OP_AND: result = src1 & src2; break;
+        case ALU_OP_XOR: result = src1 ^ src2; break;
+        case ALU_OP_NOP: result = src1; break;
+        case ALU_OP_DEC: result = src1 + 0xffff; break;
+        case ALU_OP_INC: result = src1 + 1; break;
+        default: result = 0; break;
+    }
+    carryOut = ALU_OP_SETS_CARRY(op) ? (result >> 16) & 1 : carryIn;
+    result &= 0xffff;
+    zero = result == 0;
+    negative = result >> 15;
+    return result;
+}
+
+// forward() of the VHDL, the destination wins when both ports write the register
+unsigned PipelineModel::forward(int sel) const
+{
+    if (m_regWrEna && m_regDstSelect == sel)
+        return m_regDstIn;
+    if (m_regSrc1WrEna && m_eSrc1Select == sel)
+        return m_aluResult;
+    return m_registers[sel];
+}
+
+// The cycle is srsim's cycle count before D's instruction
+unsigned char PipelineModel::ioRead(int address, quint64 cycle)
+{
+    m_interrupts.tick(cycle);
+    if ((address & 0xf0) == InterruptController::BaseAddress)
+        return m_interrupts.read(address & 0xf);
+    return 0;
+}
+
+void PipelineModel::ioWrite(int address, unsigned char value, quint64 cycle)
+{
+    IoWrite w = { cycle, address, value };
+    m_writes.append(w);
+    m_interrupts.tick(cycle);
+    if ((address & 0xf0) == InterruptController::BaseAddress)
+        m_interrupts.write(address & 0xf, value, cycle + 1);
+    else if (address == InterruptController::LcdCommandAddress || address == InterruptController::LcdDataAddress)
+        m_interrupts.lcdWritten(address, value, cycle + 1);
+}
+
+bool PipelineModel::clock(ReferenceSimulator& reference)
+{
+    m_clocks++;
+    int dataMemDataIn = m_ram[m_ramAddr];
+    int dInstruction = m_program[m_dPc];
+
+    // E stage
+    int op = m_eInstruction >> 12;
+    int interruptsEnabled = (m_srReg & SR_INTERRUPT_ENABLE) != 0;
+    int halted = (m_srReg & SR_HALTED) != 0;
+    int carry = (m_srReg & SR_CARRY) != 0;
+    int negative = (m_srReg & SR_NEGATIVE) != 0;
+    int zero = (m_srReg & SR_ZERO) != 0;
+    int interruptsEnabledNext = interruptsEnabled;
+    int haltedNext = halted;
+    int carryNext = carry;
+    int negativeNext = negative;
+    int zeroNext = zero;
+    int savedFlagsNext = m_savedFlagsReg;
+    int bankNext = m_bankReg;
+    int bankSpNext = m_bankSpReg;
+    bool bankPush = false;
+    bool redirect = false;
+    int redirectPc = (m_eInstruction & 0x800) ? m_eSrc1 & 0xff : m_eInstruction & 0xff;
+    int aluOp = m_eInstruction & 0xf;
+    m_regWrEna = false;
+    m_regSrc1WrEna = false;
+    m_regDstSelect = (m_eInstruction >> 8) & 3;
+    m_regDstIn = 0;
+    bool eReadsMem = m_eValid && !m_eIrq && (op == 0x2 || op == 0x8 || (op == 0x9 && (m_eInstruction & 0x800)));
+
+    if (!m_eValid) {
+        // bubble
+    } else if (m_eIrq) {
+        redirect = true;
+        redirectPc = m_eVector;
+        bankPush = true;
+        bankSpNext = (m_bankSpReg + 1) & 7;
+        bankNext = 0;
+        haltedNext = 0;
+        interruptsEnabledNext = 0;
+        savedFlagsNext = carry << 2 | negative << 1 | zero;
+    } else {
+        if (((op >> 1) & 3) == 1 && (m_eInstruction & 0x800)) {
+            if ((m_eInstruction & 3) == 1) {
+                aluOp = ALU_OP_INC;
+                m_regSrc1WrEna = true;
+            } else if ((m_eInstruction & 3) == 2) {
+                aluOp = ALU_OP_DEC;
+                m_regSrc1WrEna = true;
+            }
+        }
+        if (op == 0x6)
+            aluOp = ALU_OP_INC;
+    }
+    int aluCarryOut, aluNegative, aluZero;
+    m_aluResult = alu(aluOp, m_eSrc1, m_eSrc2, carry, aluCarryOut, aluNegative, aluZero);
+
+    if (m_eValid && !m_eIrq) {
+        bool extend = m_eInstruction & 0x400;
+        switch (op) {
+            case 0x1:   // MOVI
+                m_regWrEna = true;
+                m_regDstIn = extend ? (unsigned) (signed char) m_eInstruction & 0xffff : (m_eDst & 0xff00) | (m_eInstruction & 0xff);
+                break;
+            case 0x4:   // alu op, CMP and TST only update the flags
+                m_regWrEna = !(m_eInstruction & 0x800);
+                m_regDstIn = m_aluResult;
+                zeroNext = aluZero;
+                negativeNext = aluNegative;
+                carryNext = aluCarryOut;
+                break;
+            case 0x2:   // LD/LDI
+                m_regWrEna = true;
+                m_regDstIn = extend ? (unsigned) (signed char) dataMemDataIn & 0xffff : (m_eDst & 0xff00) | dataMemDataIn;
+                break;
+            case 0xa:   // IN, read at the end of D
+                m_regWrEna = true;
+                m_regDstIn = extend ? (unsigned) (signed char) m_eIoData & 0xffff : (m_eDst & 0xff00) | m_eIoData;
+                break;
+            case 0x5:
+            case 0x7: { // branches and branches to subroutine
+                int condition = (m_eInstruction >> 8) & 3;
+                redirect = condition == 0 ? zero : condition == 1 ? !zero : condition == 2;
+                break;
+            }
+            case 0x8:   // RET, RETI & FRET
+                redirect = true;
+                redirectPc = dataMemDataIn;
+                if (m_eInstruction & 0xc00) {
+                    bankSpNext = (m_bankSpReg - 1) & 7;
+                    bankNext = m_bankStack[(m_bankSpReg - 1) & 7];
+                }
+                if (m_eInstruction & 0x800) {
+                    interruptsEnabledNext = 1;
+                    carryNext = (m_savedFlagsReg >> 2) & 1;
+                    negativeNext = (m_savedFlagsReg >> 1) & 1;
+                    zeroNext = m_savedFlagsReg & 1;
+                }
+                break;
+            case 0x9:   // POP, PUSH was done in D
+                if (m_eInstruction & 0x800) {
+                    m_regWrEna = true;
+                    m_regDstIn = (m_eDst & 0xff00) | dataMemDataIn;
+                }
+                break;
+            case 0x6:   // CPYDATA, the write was done in D
+                m_regWrEna = true;
+                m_regDstIn = m_aluResult;
+                break;
+            case 0xc:   // EI & DI
+                interruptsEnabledNext = m_eInstruction & 1;
+                break;
+            case 0xd:   // FBSR
+                redirect = true;
+                redirectPc = m_eInstruction & 0xff;
+                bankPush = true;
+                bankSpNext = (m_bankSpReg + 1) & 7;
+                bankNext = (m_eInstruction >> 8) & 7;
+                break;
+            case 0xf:   // HALT, fetched again until an interrupt
+                redirect = true;
+                redirectPc = m_ePc & 0xff;
+                haltedNext = 1;
+                break;
+        }
+    }
+    int srNext = interruptsEnabledNext << 4 | haltedNext << 3 | carryNext << 2 | negativeNext << 1 | zeroNext;
+
+    // D stage
+    int dOp = dInstruction >> 12;
+    int dDstSelect = (dInstruction >> 8) & 3;
+    int dSrc2Select = (dInstruction >> 4) & 3;
+    int dSrc1Select = dOp == 0x6 ? dDstSelect : (dInstruction >> 6) & 3;
+    int dAddrSelect = dSrc1Select;
+    bool dIo = ((dOp >> 1) & 3) == 1 && (dOp & 8);
+    bool dUsesAddrReg = (((dOp >> 1) & 3) == 1 && (dInstruction & 0x800)) || dOp == 0x6;
+    bool eWritesAddrReg = (m_regWrEna && m_regDstSelect == dAddrSelect) || (m_regSrc1WrEna && m_eSrc1Select == dAddrSelect);
+
+    // The interrupt controller as srsim sees it before D's instruction
+    quint64 dCycle = m_cycles + m_eValid;
+    m_interrupts.tick(dCycle);
+    bool irqTaken = m_interrupts.irq() && interruptsEnabledNext && !redirect;
+    bool dStall = ((dUsesAddrReg && eWritesAddrReg) || (dIo && eReadsMem)) && !irqTaken;
+    bool dAdvance = !(redirect || dStall);
+
+    int spNext = m_spReg;
+    bool dMemWrite = false;
+    int dWriteData = forward(dDstSelect) & 0xff;
+    int dAddr = (dInstruction & 0x800) ? m_registers[dAddrSelect] & 0xff : dInstruction & 0xff;
+    bool ioSelect = true;
+    if (irqTaken) {
+        dAddr = m_spReg;
+        dMemWrite = true;
+        spNext = (m_spReg - 1) & 0xff;
+        dWriteData = haltedNext ? (m_dPc + 1) & 0xff : m_dPc & 0xff;
+    } else if (dAdvance) {
+        ioSelect = !dIo;
+        switch (dOp) {
+            case 0x3:
+            case 0xb:   // ST/STI/OUT
+                dMemWrite = true;
+                break;
+            case 0x7:
+            case 0xd:   // BSR & FBSR push whether the branch is taken or not
+                dAddr = m_spReg;
+                dMemWrite = true;
+                spNext = (m_spReg - 1) & 0xff;
+                dWriteData = (m_dPc + 1) & 0xff;
+                break;
+            case 0x8:   // RET, RETI & FRET
+                dAddr = (m_spReg + 1) & 0xff;
+                spNext = dAddr;
+                break;
+            case 0x9:   // PUSH & POP
+                if (!(dInstruction & 0x800)) {
+                    dAddr = m_spReg;
+                    dMemWrite = true;
+                    spNext = (m_spReg - 1) & 0xff;
+                } else {
+                    dAddr = (m_spReg + 1) & 0xff;
+                    spNext = dAddr;
+                }
+                break;
+            case 0x6:   // CPYDATA
+                dAddr = m_registers[dAddrSelect] & 0xff;
+                dMemWrite = true;
+                dWriteData = dInstruction & 0xff;
+                break;
+        }
+    }
+
+    int fetchAddr = redirect ? bankNext << 8 | redirectPc :
+                    dStall ? m_dPc : (m_dPc & 0x700) | ((m_dPc + 1) & 0xff);
+    unsigned dSrc1 = forward(dSrc1Select);
+    unsigned dSrc2 = forward(dSrc2Select);
+    unsigned dDst = forward(dDstSelect);
+    int ioData = dAdvance && dOp == 0xa ? ioRead(dAddr, dCycle) : 0;
+    int vector = m_interrupts.vector();
+
+    // Clock edge, E first
+    if (m_regSrc1WrEna)
+        m_registers[m_eSrc1Select] = m_aluResult;
+    if (m_regWrEna)
+        m_registers[m_regDstSelect] = m_regDstIn;
+    m_srReg = srNext;
+    m_savedFlagsReg = savedFlagsNext;
+    if (bankPush)
+        m_bankStack[m_bankSpReg] = m_bankReg;
+    m_bankReg = bankNext;
+    m_bankSpReg = bankSpNext;
+
+    if (m_eValid) {
+        m_cycles++;
+        reference.step();
+        // The scan chain after the edge, before D's data memory write lands
+        int scanPc = dAdvance ? m_dPc : fetchAddr;
+        int scanSp = dAdvance ? m_spReg : spNext;
+        bool match = scanPc == reference.pc() && scanSp == reference.sp() && m_srReg == reference.sr();
+        for (int r = 0; r < 4; r++)
+            match &= m_registers[r] == reference.reg(r);
+        for (int a = 0; a < 256; a++)
+            match &= m_ram[a] == reference.dataByte(a);
+        if (!match) {
+            printf("MISMATCH after %llu instructions: model pc %03x, sp %02x, sr %02x, r0-r3 %04x %04x %04x %04x\n",
+                   (unsigned long long) m_cycles, scanPc, scanSp, m_srReg, m_registers[0], m_registers[1], m_registers[2], m_registers[3]);
+            printf("srsim pc %03x, sp %02x, sr %02x, r0-r3 %04x %04x %04x %04x\n", reference.pc(), reference.sp(), reference.sr(),
+                   reference.reg(0), reference.reg(1), reference.reg(2), reference.reg(3));
+            for (int a = 0; a < 256; a++) {
+                if (m_ram[a] != reference.dataByte(a))
+                    printf("data $%02x: model %02x, srsim %02x\n", a, m_ram[a], reference.dataByte(a));
+            }
+            return false;
+        }
+    }
+
+    // D
+    if (dMemWrite && ioSelect)
+        m_ram[dAddr] = dWriteData;
+    else if (dMemWrite)
+        ioWrite(dAddr, dWriteData, dCycle);
+    m_ramAddr = dAddr;
+    m_eValid = dAdvance;
+    m_eIrq = dAdvance && irqTaken;
+    m_ePc = m_dPc;
+    m_eInstruction = dInstruction;
+    m_eSrc1Select = dSrc1Select;
+    m_eSrc1 = dSrc1;
+    m_eSrc2 = dSrc2;
+    m_eDst = dDst;
+    m_eIoData = ioData;
+    m_eVector = vector;
+    m_dPc = fetchAddr;
+    m_spReg = spNext;
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        printf("usage: %s program.bin [max_instructions]\n", argv[0]);
+        return 2;
+    }
+
+    QFile file(argv[1]);
+    if (!file.open(QIODevice::ReadOnly)) {
+        printf("Can't open %s\n", argv[1]);
+        return 2;
+    }
+    quint64 maxCycles = argc > 2 ? strtoull(argv[2], 0, 0) : 100000;
+
+    ReferenceSimulator reference;
+    reference.loadProgram(file.readAll());
+    PipelineModel model(reference);
+    while (model.m_cycles < maxCycles && !model.stopped()) {
+        if (!model.clock(reference))
+            return 1;
+    }
+
+    // D may have written for an instruction that hasn't completed yet
+    while (!model.m_writes.isEmpty() && model.m_writes.last().cycle >= model.m_cycles)
+        model.m_writes.removeLast();
+    bool match = model.m_writes == reference.m_writes;
+    printf("%s: %llu instructions in %llu clocks, %d I/O writes\n", match ? "match" : "MISMATCH",
+           (unsigned long long) model.m_cycles, (unsigned long long) model.m_clocks, model.m_writes.size());
+    if (!match)
+        printf("srsim: %d I/O writes\n", reference.m_writes.size());
+    for (int i = 0; !match && i < model.m_writes.size() && i < reference.m_writes.size(); i++) {
+        const IoWrite& a = model.m_writes.at(i);
+        const IoWrite& b = reference.m_writes.at(i);
+        if (!(a == b)) {
+            printf("I/O write %d: srsim $%02x = %02x at %llu, model $%02x = %02x at %llu\n", i,
+                   b.address, b.value, (unsigned long long) b.cycle, a.address, a.value, (unsigned long long) a.cycle);
+            break;
+        }
+    }
+    return match ? 0 : 1;
+}
@@ -0,0 +1,97 @@
+-- Copyright (c) 2014, Juha Turunen
+-- All rights reserved.
+--
+-- Redistribution and use in source and binary forms, with or without
+-- modification, are permitted provided that the following conditions are met: 
+--
+-- 1. Redistributions of source code must retain the above copyright notice, this
+--    list of conditions and the following disclaimer. 
+-- 2. Redistributions in binary form must reproduce the above copyright notice,
+--    this list of conditions and the following disclaimer in the documentation
+--    and/or other materials provided with the distribution. 
+--
+-- THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+-- ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+-- WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+-- DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+-- ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+-- (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+-- LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+-- ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+-- (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+-- SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+-- Behavioral model of the single port altsyncram configuration used by
+-- ep1_pgmram and ep1_dataram: registered address, unregistered output.
+-- The contents can be initialized from a binary file of big endian words,
+-- the format srasm writes.
+
+library IEEE;
+use IEEE.STD_LOGIC_1164.ALL;
+use IEEE.NUMERIC_STD.ALL;
+
+entity ram_model is generic (
+	data_width : positive := 8;
+	address_width : positive := 8;
+	init_file : string := ""
+);
+port (
+	clock : in std_logic;
+	address : in std_logic_vector(address_width - 1 downto 0);
+	data : in std_logic_vector(data_width - 1 downto 0);
+	wren : in std_logic;
+	q : out std_logic_vector(data_width - 1 downto 0)
+);
+end ram_model;
+
+architecture Behavioral of ram_model is
+
+type ram_array is array (0 to 2 ** address_width - 1) of std_logic_vector(data_width - 1 downto 0);
+
+impure function load(filename : string) return ram_array is
+	type char_file is file of character;
+	file f : char_file;
+	variable status : file_open_status;
+	variable c : character;
+	variable word : natural;
+	variable contents : ram_array := (others => (others => '0'));
+begin
+	if (filename'length = 0) then
+		return contents;
+	end if;
+
+	file_open(status, f, filename, read_mode);
+	assert status = open_ok report "Can't open " & filename severity failure;
+	for i in ram_array'range loop
+		exit when endfile(f);
+		word := 0;
+		for b in 1 to data_width / 8 loop
+			exit when endfile(f);
+			read(f, c);
+			word := word * 256 + character'pos(c);
+		end loop;
+		contents(i) := std_logic_vector(to_unsigned(word, data_width));
+	end loop;
+	file_close(f);
+	return contents;
+end function;
+
+signal ram : ram_array := load(init_file);
+signal address_reg : std_logic_vector(address_width - 1 downto 0) := (others => '0');
+
+begin
+	process (clock)
+	begin
+		if (clock'event and clock = '1') then
+			if (wren = '1') then
+				ram(to_integer(unsigned(address))) <= data;
+			end if;
+			address_reg <= address;
+		end if;
+	end process;
+
+	q <= ram(to_integer(unsigned(address_reg)));
+
+end Behavioral;
@@ -0,0 +1,349 @@
+-- Copyright (c) 2014, Juha Turunen
+-- All rights reserved.
+--
+-- Redistribution and use in source and binary forms, with or without
+-- modification, are permitted provided that the following conditions are met: 
+--
+-- 1. Redistributions of source code must retain the above copyright notice, this
+--    list of conditions and the following disclaimer. 
+-- 2. Redistributions in binary form must reproduce the above copyright notice,
+--    this list of conditions and the following disclaimer in the documentation
+--    and/or other materials provided with the distribution. 
+--
+-- THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+-- ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+-- WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+-- DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+-- ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+-- (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+-- LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+-- ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+-- (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+-- SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+-- Co-simulation testbench for shitty_risc. Runs a program binary written by
+-- srasm and writes a state trace that tools/srsim --compare checks against
+-- the instruction set simulator, one event per line:
+--   S <cycle> <pc> <sp> <sr> <ir> <r0> <r1> <r2> <r3>  state after <cycle> instructions
+--   W <cycle> <address> <value>                         data memory write
+--   O <cycle> <address> <value>                         I/O write
+-- The cycle is decimal, the rest is hex. The pc includes the program memory
+-- bank, i.e. it's bank * 256 + PC. The state is read through the debug
+-- scan chain the same way debug_scan_controller does it, every
+-- sample_interval cycles and when the run ends. Writes are always traced.
+--
+-- With pipelined set the testbench runs shitty_risc_pipelined instead. A
+-- cycle is then an instruction or interrupt entry leaving the pipeline, the
+-- bubbles aren't counted. The pipelined core writes the data memory a clock
+-- before the instruction completes, the writes are traced with the cycle of
+-- the instruction they belong to. Interrupt controller timing is counted in
+-- clocks, so timer interrupts land on different instructions than in srsim.
+
+library IEEE;
+use IEEE.STD_LOGIC_1164.ALL;
+use IEEE.NUMERIC_STD.ALL;
+use STD.TEXTIO.ALL;
+
+entity shitty_risc_tb is generic (
+	program_file : string := "program.bin";
+	trace_file : string := "rtl_trace.txt";
+	sample_interval : positive := 1;
+	max_cycles : natural := 100000;
+	-- clocks per instruction, the debugger runs the CPU at every 8th clock.
+	-- Has to be at least 2 because the data memory has a registered address,
+	-- unless the core is pipelined.
+	clk_ena_period : positive := 8;
+	pipelined : boolean := false
+);
+end shitty_risc_tb;
+
+architecture Behavioral of shitty_risc_tb is
+
+-- SP(1) + PC(1) + SR(1) + IR(2) + bank(1) + 4 * regs(2)
+constant scan_length : integer := 8 * (1 + 1 + 1 + 2 + 1 + 8);
+
+signal clk : std_logic := '0';
+signal reset, clk_ena, halt : std_logic := '0';
+signal scan_reset, scan_enable, scan_output : std_logic := '0';
+
+signal pgm_mem_addr : std_logic_vector(10 downto 0);
+signal pgm_mem_data : std_logic_vector(15 downto 0);
+
+signal data_mem_addr : std_logic_vector(7 downto 0);
+signal data_mem_data_in, data_mem_data_out : std_logic_vector(7 downto 0);
+signal data_mem_wr_ena, data_ram_wren, mem_io_select : std_logic;
+
+signal data_ram_q : std_logic_vector(7 downto 0);
+
+signal io_write, lcd_strobe, lcd_ready, lcd_en, lcd_rs : std_logic;
+signal lcd_data : std_logic_vector(7 downto 0);
+signal irqctl_select, irqctl_wr_ena, irq : std_logic;
+signal irqctl_data_out, irq_vector : std_logic_vector(7 downto 0);
+signal perf_select, perf_wr_ena, perf_retired, perf_branch_taken, perf_mem_read, perf_mem_write, perf_halted : std_logic;
+signal perf_data_out : std_logic_vector(7 downto 0);
+signal trace_valid : std_logic;
+constant no_host_data : std_logic_vector(7 downto 0) := (others => '0');
+
+constant low : std_logic := '0';
+constant no_data : std_logic_vector(15 downto 0) := (others => '0');
+
+signal done : boolean := false;
+
+function hex(v : std_logic_vector) return string is
+	constant digits : string(1 to 16) := "0123456789abcdef";
+	constant padded_length : integer := ((v'length + 3) / 4) * 4;
+	variable padded : std_logic_vector(padded_length - 1 downto 0) := (others => '0');
+	variable nibble : std_logic_vector(3 downto 0);
+	variable s : string(1 to padded_length / 4);
+begin
+	padded(v'length - 1 downto 0) := v;
+	for i in s'range loop
+		nibble := padded(padded_length - (i - 1) * 4 - 1 downto padded_length - i * 4);
+		if (is_x(nibble)) then
+			s(i) := 'x';
+		else
+			s(i) := digits(to_integer(unsigned(nibble)) + 1);
+		end if;
+	end loop;
+	return s;
+end function;
+
+begin
+	assert clk_ena_period >= 2 or pipelined report "clk_ena_period has to be at least 2" severity failure;
+
+	-- 50 MHz like on the EP1 board
+	clk <= not clk after 10 ns when not done else '0';
+
+	single_cycle_core : if not pipelined generate
+		cpu : entity work.shitty_risc port map (
+			clk => clk,
+			reset => reset,
+			clk_ena => clk_ena,
+			halt => halt,
+			scan_reset => scan_reset,
+			scan_input => low,
+			scan_output => scan_output,
+			scan_enable => scan_enable,
+			pgm_mem_addr => pgm_mem_addr,
+			pgm_mem_data_in => pgm_mem_data,
+			data_mem_addr => data_mem_addr,
+			data_mem_data_in => data_mem_data_in,
+			data_mem_data_out => data_mem_data_out,
+			data_mem_wr_ena => data_mem_wr_ena,
+			mem_io_select => mem_io_select,
+			irq => irq,
+			irq_vector => irq_vector,
+			trace_valid => trace_valid,
+			perf_retired => perf_retired,
+			perf_branch_taken => perf_branch_taken,
+			perf_mem_read => perf_mem_read,
+			perf_mem_write => perf_mem_write,
+			perf_halted => perf_halted
+		);
+	end generate;
+
+	pipelined_core : if pipelined generate
+		cpu : entity work.shitty_risc_pipelined port map (
+			clk => clk,
+			reset => reset,
+			clk_ena => clk_ena,
+			halt => halt,
+			scan_reset => scan_reset,
+			scan_input => low,
+			scan_output => scan_output,
+			scan_enable => scan_enable,
+			pgm_mem_addr => pgm_mem_addr,
+			pgm_mem_data_in => pgm_mem_data,
+			data_mem_addr => data_mem_addr,
+			data_mem_data_in => data_mem_data_in,
+			data_mem_data_out => data_mem_data_out,
+			data_mem_wr_ena => data_mem_wr_ena,
+			mem_io_select => mem_io_select,
+			irq => irq,
+			irq_vector => irq_vector,
+			trace_valid => trace_valid,
+			perf_retired => perf_retired,
+			perf_branch_taken => perf_branch_taken,
+			perf_mem_read => perf_mem_read,
+			perf_mem_write => perf_mem_write,
+			perf_halted => perf_halted
+		);
+	end generate;
+
+	pgm_mem : entity work.ram_model generic map (
+		data_width => 16,
+		address_width => 11,
+		init_file => program_file
+	) port map (
+		clock => clk,
+		address => pgm_mem_addr,
+		data => no_data,
+		wren => low,
+		q => pgm_mem_data
+	);
+
+	data_mem : entity work.ram_model generic map (
+		data_width => 8
+	) port map (
+		clock => clk,
+		address => data_mem_addr,
+		data => data_mem_data_out,
+		wren => data_ram_wren,
+		q => data_ram_q
+	);
+
+	-- Same muxing as the EP1 top level, I/O reads other than the interrupt
+	-- controller and the performance counters return zero. The LCD controller is only there for its ready
+	-- signal and the host byte source is unused.
+	data_ram_wren <= data_mem_wr_ena and mem_io_select;
+	io_write <= data_mem_wr_ena and clk_ena and not mem_io_select;
+	irqctl_select <= '1' when data_mem_addr(7 downto 4) = "0011" else '0';
+	irqctl_wr_ena <= irqctl_select and io_write;
+	perf_select <= '1' when data_mem_addr(7 downto 5) = "010" else '0';
+	perf_wr_ena <= perf_select and io_write;
+	lcd_strobe <= io_write when data_mem_addr(7 downto 4) = "0010" else '0';
+	data_mem_data_in <= data_ram_q when mem_io_select = '1' else
+		irqctl_data_out when irqctl_select = '1' else
+		perf_data_out when perf_select = '1' else (others => '0');
+
+	lcd : entity work.lcd_controller port map (
+		clk_50 => clk,
+		reset => reset,
+		di => data_mem_data_out,
+		strobe => lcd_strobe,
+		register_select => data_mem_addr(0),
+		lcd_en => lcd_en,
+		lcd_rs => lcd_rs,
+		lcd_do => lcd_data,
+		ready => lcd_ready
+	);
+
+	interrupt_controller : entity work.interrupt_controller port map (
+		clk => clk,
+		reset => reset,
+		clk_ena => clk_ena,
+		address => data_mem_addr(3 downto 0),
+		data_in => data_mem_data_out,
+		data_out => irqctl_data_out,
+		wr_ena => irqctl_wr_ena,
+		lcd_ready => lcd_ready,
+		host_data => no_host_data,
+		host_data_strobe => low,
+		irq => irq,
+		vector => irq_vector
+	);
+
+	-- Not in the scan chain, the trace only has the core state
+	perf_counters : entity work.perf_counters port map (
+		clk => clk,
+		reset => reset,
+		clk_ena => clk_ena,
+		address => data_mem_addr(4 downto 0),
+		data_in => data_mem_data_out,
+		data_out => perf_data_out,
+		wr_ena => perf_wr_ena,
+		retired => perf_retired,
+		branch_taken => perf_branch_taken,
+		mem_read => perf_mem_read,
+		mem_write => perf_mem_write,
+		halted => perf_halted,
+		scan_reset => low,
+		scan_input => low,
+		scan_enable => low
+	);
+
+	process
+		file trace : text open write_mode is trace_file;
+		variable l, w : line;
+		variable cycle : natural := 0;
+		variable completed : boolean;
+		variable chain : std_logic_vector(scan_length - 1 downto 0);
+
+		-- Captures the state and shifts it out LSB first
+		procedure scan_state is
+		begin
+			scan_reset <= '1';
+			wait until clk'event and clk = '1';
+			scan_reset <= '0';
+			for i in 0 to scan_length - 1 loop
+				wait until clk'event and clk = '0';
+				chain(i) := scan_output;
+				scan_enable <= '1';
+				wait until clk'event and clk = '1';
+				scan_enable <= '0';
+			end loop;
+
+			write(l, string'("S "));
+			write(l, cycle);
+			write(l, ' ' & hex(chain(42 downto 40) & chain(15 downto 8)));		-- bank & PC
+			write(l, ' ' & hex(chain(7 downto 0)));		-- SP
+			write(l, ' ' & hex(chain(23 downto 16)));		-- SR
+			write(l, ' ' & hex(chain(39 downto 24)));		-- IR
+			for r in 0 to 3 loop
+				write(l, ' ' & hex(chain(48 + r * 16 + 15 downto 48 + r * 16)));
+			end loop;
+			writeline(trace, l);
+		end procedure;
+
+	begin
+		write(l, string'("# sample "));
+		write(l, sample_interval);
+		writeline(trace, l);
+
+		reset <= '1';
+		for i in 1 to 4 loop
+			wait until clk'event and clk = '1';
+		end loop;
+		reset <= '0';
+		-- let the program memory output the first instruction
+		wait until clk'event and clk = '1';
+		scan_state;
+
+		while (halt = '0' and cycle < max_cycles) loop
+			for i in 1 to clk_ena_period - 1 loop
+				wait until clk'event and clk = '1';
+			end loop;
+			clk_ena <= '1';
+			wait until clk'event and clk = '1';
+			clk_ena <= '0';
+
+			-- The signals still have the values the memories saw at the edge
+			completed := trace_valid = '1';
+			if (completed) then
+				cycle := cycle + 1;
+			end if;
+			if (data_mem_wr_ena = '1') then
+				if (mem_io_select = '1') then
+					write(w, string'("W "));
+				else
+					write(w, string'("O "));
+				end if;
+				if (pipelined) then
+					write(w, cycle + 1);
+				else
+					write(w, cycle);
+				end if;
+				write(w, ' ' & hex(data_mem_addr) & ' ' & hex(data_mem_data_out));
+				if (not pipelined) then
+					writeline(trace, w);
+				end if;
+			end if;
+
+			wait until clk'event and clk = '0';
+			if (completed and (cycle mod sample_interval = 0 or halt = '1' or cycle = max_cycles)) then
+				scan_state;
+			end if;
+			-- the pipelined core's write comes after the state before its instruction
+			if (w /= null) then
+				writeline(trace, w);
+			end if;
+		end loop;
+
+		report "Stopped after " & integer'image(cycle) & " cycles";
+		done <= true;
+		wait;
+	end process;
+
+end Behavioral;
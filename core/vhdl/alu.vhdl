@@ -60,7 +60,7 @@ begin
 	);
 	
 	
-	process (op, src1, src2, adder_result)		
+	process (op, src1, src2, adder_result, carry_in)		
 	begin
 		adder_addsub <= '-';
 		adder_carry_in <= '-';
@@ -70,11 +70,11 @@ begin
 		case op is
 			when "0000" =>		-- add
 				adder_addsub <= '1';
-				adder_carry_in <= carry_in;
+				adder_carry_in <= '0';
 				op_result <= adder_result;
 			when "0001" =>		-- sub
 				adder_addsub <= '0';
-				adder_carry_in <= not carry_in;
+				adder_carry_in <= '1';
 				op_result <= adder_result;
 			when "0010" =>		-- shift right
 				op_result <= src1(15) & src1(15 downto 1);
@@ -104,6 +104,14 @@ begin
 				adder_addsub <= '1';
 				adder_src2 <= x"0001";
 				adder_carry_in <= '0';
+			when "1101" =>		-- add with carry
+				adder_addsub <= '1';
+				adder_carry_in <= carry_in;
+				op_result <= adder_result;
+			when "1110" =>		-- sub with carry, carry clear means borrow
+				adder_addsub <= '0';
+				adder_carry_in <= carry_in;
+				op_result <= adder_result;
 			when others =>
 				op_result <= (others => '0');
 				
@@ -112,7 +120,8 @@ begin
 	
 	zero <= '1' when op_result = "0000000000000000" else '0';
 	negative <= '1' when op_result(15) = '1' else '0';
-	carry_out <= adder_carry_out when op(3 downto 1) = "000" else '0';		-- use carry_out when op is add or sub
+	-- adder carry for add, sub, adc and sbc, the other ops leave the carry alone
+	carry_out <= adder_carry_out when op = "0000" or op = "0001" or op = "1101" or op = "1110" else carry_in;
 	result <= op_result;
 	
 end Behavioral;
\ No newline at end of file
@@ -37,9 +37,10 @@ entity debug_mem_op_controller is port (
 	pgm_data_mem_select : in std_logic;
 	
 	mem_addr : in std_logic_vector(7 downto 0);			-- read/write starting from address
+	pgm_mem_bank : in std_logic_vector(2 downto 0);		-- program memory bank, addresses wrap within it
 	run_length : in std_logic_vector(7 downto 0);		-- how many bytes/instructions to read/write
 	
-	pgm_mem_addr : out std_logic_vector(7 downto 0);
+	pgm_mem_addr : out std_logic_vector(10 downto 0);
 	pgm_mem_data_out : out std_logic_vector(15 downto 0);
 	pgm_mem_wren : out std_logic;
    data_mem_addr : out std_logic_vector(7 downto 0);
@@ -68,6 +69,7 @@ type controller_state is (idle,
 
 signal bytes_left_reg, bytes_left_next : std_logic_vector(7 downto 0);
 signal mem_addr_reg, mem_addr_next : std_logic_vector(7 downto 0);
+signal bank_reg, bank_next : std_logic_vector(2 downto 0);
 signal state_reg, state_next : controller_state;
 signal rx_byte_reg, rx_byte_next : std_logic_vector(7 downto 0);
 signal pgm_mem_byte_reg, pgm_mem_byte_next : std_logic_vector(15 downto 0);
@@ -80,6 +82,7 @@ begin
 		if (reset = '1') then
 			bytes_left_reg <= (others => '0');
 			mem_addr_reg <= (others => '0');
+			bank_reg <= (others => '0');
 			state_reg <= idle;
 			rx_byte_reg <= (others => '0');
 			debug_data_reg <= "0000";
@@ -87,18 +90,20 @@ begin
 			state_reg <= state_next;
 			bytes_left_reg <= bytes_left_next;
 			mem_addr_reg <= mem_addr_next;
+			bank_reg <= bank_next;
 			rx_byte_reg <= rx_byte_next;
 			debug_data_reg <= debug_data_next;
 			pgm_mem_byte_reg <= pgm_mem_byte_next;
 		end if;
 	end process;
 	
-	process (state_reg, rw, mem_addr, pgm_data_mem_select, strobe, rx_ready, rx_data, run_length, data_mem_data_in,
+	process (state_reg, rw, mem_addr, pgm_mem_bank, bank_reg, pgm_data_mem_select, strobe, rx_ready, rx_data, run_length, data_mem_data_in,
 				rx_byte_reg, mem_addr_reg, bytes_left_reg, tx_idle, bytes_left_next, debug_data_reg, pgm_mem_byte_reg)
 	begin
 		state_next <= state_reg;
 		bytes_left_next <= bytes_left_reg;
 		mem_addr_next <= mem_addr_reg;
+		bank_next <= bank_reg;
 		data_mem_wren <= '0';
 		pgm_mem_wren <= '0';
 		tx_strobe <= '0';
@@ -111,6 +116,7 @@ begin
 				if (strobe = '1') then
 					bytes_left_next <= run_length;		-- run length of 0 is 256
 					mem_addr_next <= mem_addr;
+					bank_next <= pgm_mem_bank;
 					
 					if (pgm_data_mem_select = '1') then
 						state_next <= rx_pgm_byte1;
@@ -198,7 +204,7 @@ begin
 	
 	data_mem_addr <= mem_addr_reg;
 	data_mem_data_out <= rx_byte_reg;
-	pgm_mem_addr <= mem_addr_reg;
+	pgm_mem_addr <= bank_reg & mem_addr_reg;
 	pgm_mem_data_out <= pgm_mem_byte_reg;
 	tx_data <= data_mem_data_in;
 	
@@ -92,11 +92,11 @@ begin
 					state_next <= apply_reset;
 				end if;
 				
-			-- PC(1) + SR(1) + IR(2) + 4 * regs(2)	
+			-- SP(1) + PC(1) + SR(1) + IR(2) + bank(1) + 4 * regs(2) + 6 * perf counters(4)
 			when apply_reset =>
 				scan_reset <= '1';
 				state_next <= prepare_collect_byte;
-				expected_scan_byte_count_next <= conv_std_logic_vector(1 + 1 + 1 + 2 + 8, 6);
+				expected_scan_byte_count_next <= conv_std_logic_vector(1 + 1 + 1 + 2 + 1 + 8 + 24, 6);
 				
 			when prepare_collect_byte =>
 				collect_debug_byte_counter_next <= (others => '0');
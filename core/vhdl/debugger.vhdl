@@ -28,13 +28,19 @@ use IEEE.STD_LOGIC_ARITH.ALL;
 use IEEE.STD_LOGIC_UNSIGNED.ALL;
 
 
-entity debugger is port (
+-- min_clock_divider is the fastest the CPU can be run at, 2 for shitty_risc
+-- and 1 for shitty_risc_pipelined. cores is the number of CPUs command 09
+-- can select between.
+entity debugger is generic (
+	min_clock_divider : positive := 2;
+	cores : positive range 1 to 4 := 1
+); port (
 	clk_50 : in std_logic;
 	reset : in std_logic;
 	serial_rx : in std_logic;
 	serial_tx : out std_logic;
 	mem_access : out std_logic;
-	pgm_mem_addr : out std_logic_vector(7 downto 0);
+	pgm_mem_addr : out std_logic_vector(10 downto 0);
 	pgm_mem_data_out : out std_logic_vector(15 downto 0);
 	pgm_mem_wren : out std_logic;
 	data_mem_addr : out std_logic_vector(7 downto 0);
@@ -44,17 +50,36 @@ entity debugger is port (
 	command_buffer : out std_logic_vector(31 downto 0);
 	cpu_reset : out std_logic;
 	cpu_clk_ena : out std_logic;
+	
+	-- core the memory ops, scans, traces and steps go to, core_step is high
+	-- while a single step is clocking only it
+	core_select : out std_logic_vector(1 downto 0);
+	core_step : out std_logic;
 		
 	debug_scan_reset : out std_logic;
 	debug_scan_input : in std_logic;
-	debug_scan_enable : out std_logic
+	debug_scan_enable : out std_logic;
+	
+	-- byte for the CPU sent with command 06, raises the host interrupt
+	host_data : out std_logic_vector(7 downto 0);
+	host_data_strobe : out std_logic;
+	
+	-- what the CPU executes on the enabled clock, for the trace buffer
+	trace_pc : in std_logic_vector(10 downto 0);
+	trace_halted : in std_logic;
+	trace_ir : in std_logic_vector(15 downto 0);
+	trace_irq_taken : in std_logic;
+	trace_mem_write : in std_logic;
+	trace_io_write : in std_logic;
+	trace_write_addr : in std_logic_vector(7 downto 0);
+	trace_write_data : in std_logic_vector(7 downto 0)
 );
 end debugger;
 
 architecture Behavioral of debugger is
 
 type debugger_state is (idle, running, stepping, start_debug_scan, wait_debug_scan, start_mem_op,
-								wait_mem_op, toggle_reset);
+								wait_mem_op, toggle_reset, start_trace_dump, wait_trace_dump);
 
 signal rx_data : std_logic_vector(7 downto 0);
 signal rx_tick : std_logic;
@@ -66,8 +91,16 @@ signal cpu_clk_ena_reg, cpu_clk_ena_next : std_logic;
 
 signal expected_rx_bytes_reg, expected_rx_bytes_next : std_logic_vector(1 downto 0);
 
--- cpu clock divider
+-- cpu clock divider, the CPU runs at every (period + 1)th clock. Set with command 07,
+-- 2 is the fastest the single cycle core works at because the data memory has a
+-- registered address.
 signal cpu_clock_divider_reg : std_logic_vector(2 downto 0);
+signal cpu_clock_period_reg, cpu_clock_period_next : std_logic_vector(2 downto 0);
+
+signal requested_clock_period : std_logic_vector(2 downto 0);
+signal cpu_clk_ena_internal : std_logic;
+
+signal core_select_reg, core_select_next : std_logic_vector(1 downto 0);
 
 signal debugger_state_reg, debugger_state_next : debugger_state;
 
@@ -79,13 +112,19 @@ signal scan_controller_scan_reset, scan_controller_scan_enable : std_logic;
 
 -- mem op controller
 signal memctl_busy, memctl_rw, memctl_pgm_data_mem_select, memctl_data_mem_wren, memctl_pgm_mem_wren : std_logic;
-signal memctl_start_addr, memctl_run_length, memctl_pgm_mem_addr, 
+signal memctl_pgm_mem_addr : std_logic_vector(10 downto 0);
+signal memctl_pgm_mem_bank : std_logic_vector(2 downto 0);
+signal memctl_start_addr, memctl_run_length, 
 		 memctl_data_mem_addr, memctl_data_mem_data_out, memctl_data_mem_data_in, 
 		 memctl_tx_data : std_logic_vector(7 downto 0);
 signal memctl_pgm_mem_data_out : std_logic_vector(15 downto 0);
 signal memctl_strobe, memctl_tx_strobe : std_logic;
 signal memctl_debug_data : std_logic_vector(3 downto 0);
 
+-- trace buffer, controlled with command 08
+signal trace_control_strobe, trace_dump_strobe, trace_busy, trace_tx_strobe : std_logic;
+signal trace_tx_data : std_logic_vector(7 downto 0);
+
 begin
 
 	process(clk_50, reset)
@@ -93,30 +132,43 @@ begin
 		if (reset = '1') then
 			debugger_state_reg <= idle;
 			cpu_clock_divider_reg <= (others => '0');
+			cpu_clock_period_reg <= "111";
 			expected_rx_bytes_reg <= "11";
 			cmd_buffer_reg <= (others => '0');
 			cmd_ready_reg <= '0';
 			cpu_clk_ena_reg <= '0';
+			core_select_reg <= (others => '0');
 		else
 			if (clk_50'event and clk_50 = '1') then
 				debugger_state_reg <= debugger_state_next;
-				cpu_clock_divider_reg <= cpu_clock_divider_reg + 1;
+				if (cpu_clock_divider_reg >= cpu_clock_period_reg) then
+					cpu_clock_divider_reg <= (others => '0');
+				else
+					cpu_clock_divider_reg <= cpu_clock_divider_reg + 1;
+				end if;
+				cpu_clock_period_reg <= cpu_clock_period_next;
 				expected_rx_bytes_reg <= expected_rx_bytes_next;
 				cmd_ready_reg <= cmd_ready_next;
 				cmd_buffer_reg <= cmd_buffer_next;
 				cpu_clk_ena_reg <= cpu_clk_ena_next;
+				core_select_reg <= core_select_next;
 			end if;
 		end if;
 	end process;	
 	
 	-- FSM logic
 	process(cmd_ready_reg, cmd_buffer_reg, debugger_state_reg, scan_controller_done, cpu_clock_divider_reg, 
-			  memctl_busy)
+			  memctl_busy, cpu_clock_period_reg, requested_clock_period, trace_busy, core_select_reg)
 	begin
 		debugger_state_next <= debugger_state_reg;
+		cpu_clock_period_next <= cpu_clock_period_reg;
+		core_select_next <= core_select_reg;
 		scan_controller_strobe <= '0';
 		memctl_strobe <= '0';
+		trace_control_strobe <= '0';
+		trace_dump_strobe <= '0';
 		cpu_reset <= '0';
+		host_data_strobe <= '0';
 		case debugger_state_reg is
 			when idle =>
 				if (cmd_ready_reg = '1') then
@@ -130,12 +182,33 @@ begin
 						debugger_state_next <= start_mem_op;
 					elsif (cmd_buffer_reg(31 downto 24) = "00000101") then
 						debugger_state_next <= toggle_reset;
+					elsif (cmd_buffer_reg(31 downto 24) = "00000110") then
+						host_data_strobe <= '1';
+					elsif (cmd_buffer_reg(31 downto 24) = "00000111") then
+						cpu_clock_period_next <= requested_clock_period;
+					elsif (cmd_buffer_reg(31 downto 24) = "00001000") then
+						if (cmd_buffer_reg(23) = '1') then
+							debugger_state_next <= start_trace_dump;
+						else
+							trace_control_strobe <= '1';
+						end if;
+					elsif (cmd_buffer_reg(31 downto 24) = "00001001") then
+						-- select a core, a number past the last core is ignored
+						if (cmd_buffer_reg(7 downto 0) < cores) then
+							core_select_next <= cmd_buffer_reg(1 downto 0);
+						end if;
 					end if;			
 				end if;
 			
 			when running =>
 				if (cmd_ready_reg = '1' and cmd_buffer_reg(31 downto 24) = "00000000") then
 					debugger_state_next <= idle;
+				elsif (cmd_ready_reg = '1' and cmd_buffer_reg(31 downto 24) = "00000110") then
+					host_data_strobe <= '1';
+				elsif (cmd_ready_reg = '1' and cmd_buffer_reg(31 downto 24) = "00000111") then
+					cpu_clock_period_next <= requested_clock_period;
+				elsif (cmd_ready_reg = '1' and cmd_buffer_reg(31 downto 24) = "00001000" and cmd_buffer_reg(23) = '0') then
+					trace_control_strobe <= '1';	-- dumping needs the CPU stopped
 				end if;
 				
 			when stepping =>
@@ -165,6 +238,15 @@ begin
 				cpu_reset <= '1';
 				debugger_state_next <= idle;
 				
+			when start_trace_dump =>
+				debugger_state_next <= wait_trace_dump;
+				trace_dump_strobe <= '1';
+				
+			when wait_trace_dump =>
+				if (trace_busy = '0') then
+					debugger_state_next <= idle;
+				end if;
+				
 		end case;
 	end process;
 	
@@ -211,6 +293,7 @@ begin
 		rw => memctl_rw,
 		pgm_data_mem_select => memctl_pgm_data_mem_select,
 		mem_addr => memctl_start_addr,
+		pgm_mem_bank => memctl_pgm_mem_bank,
 		run_length => memctl_run_length,
 		pgm_mem_addr => memctl_pgm_mem_addr,
 		pgm_mem_data_out => memctl_pgm_mem_data_out,
@@ -232,6 +315,7 @@ begin
 	memctl_run_length <= cmd_buffer_reg(7 downto 0);
 	memctl_pgm_data_mem_select <= cmd_buffer_reg(16);
 	memctl_rw <= cmd_buffer_reg(17);
+	memctl_pgm_mem_bank <= cmd_buffer_reg(20 downto 18);
 	memctl_data_mem_data_in <= data_mem_data_in;
 	data_mem_data_out <= memctl_data_mem_data_out;
 	data_mem_addr <= memctl_data_mem_addr;
@@ -240,9 +324,38 @@ begin
 	pgm_mem_data_out <= memctl_pgm_mem_data_out;
 	pgm_mem_wren <= memctl_pgm_mem_wren;
 	
+	-- Command 08 controls the trace buffer. Bit 23 dumps it, otherwise bit 16 starts
+	-- recording (0 stops it), bit 17 records data writes instead of the IR and bit 18
+	-- stops recording after the instruction at bank & PC in bits 10..0.
+	trace : entity work.trace_buffer port map (
+		clk => clk_50,
+		reset => reset,
+		control_strobe => trace_control_strobe,
+		start => cmd_buffer_reg(16),
+		record_writes => cmd_buffer_reg(17),
+		trigger_enable => cmd_buffer_reg(18),
+		trigger_addr => cmd_buffer_reg(10 downto 0),
+		dump_strobe => trace_dump_strobe,
+		busy => trace_busy,
+		cpu_clk_ena => cpu_clk_ena_internal,
+		cpu_pc => trace_pc,
+		cpu_halted => trace_halted,
+		cpu_ir => trace_ir,
+		cpu_irq_taken => trace_irq_taken,
+		cpu_mem_write => trace_mem_write,
+		cpu_io_write => trace_io_write,
+		cpu_write_addr => trace_write_addr,
+		cpu_write_data => trace_write_data,
+		tx_data => trace_tx_data,
+		tx_strobe => trace_tx_strobe,
+		tx_idle => tx_idle
+	);
+	
 	-- mux debug_scan_controller tx stuff 
-	tx_data_strobe <= memctl_tx_strobe when debugger_state_reg = wait_mem_op else scan_controller_tx_strobe;
-	tx_data <= memctl_tx_data when debugger_state_reg = wait_mem_op else scan_controller_tx_data;
+	tx_data_strobe <= memctl_tx_strobe when debugger_state_reg = wait_mem_op else
+							trace_tx_strobe when debugger_state_reg = wait_trace_dump else scan_controller_tx_strobe;
+	tx_data <= memctl_tx_data when debugger_state_reg = wait_mem_op else
+				  trace_tx_data when debugger_state_reg = wait_trace_dump else scan_controller_tx_data;
 	
 	
 	tx : entity work.serial_tx port map (
@@ -262,8 +375,17 @@ begin
 		dout_tick => rx_tick		
 	);
 	
-	cpu_clk_ena <= '1' when cpu_clock_divider_reg = "000" and (debugger_state_reg = running or debugger_state_reg = stepping) else '0';
+	-- command 07 takes the divider (min_clock_divider-8) in the last byte, out of range values are clamped
+	requested_clock_period <= conv_std_logic_vector(min_clock_divider - 1, 3) when cmd_buffer_reg(7 downto 0) < min_clock_divider else
+									  "111" when cmd_buffer_reg(7 downto 0) > 8 else
+									  cmd_buffer_reg(2 downto 0) - 1;
+	
+	cpu_clk_ena_internal <= '1' when cpu_clock_divider_reg = "000" and (debugger_state_reg = running or debugger_state_reg = stepping) else '0';
+	cpu_clk_ena <= cpu_clk_ena_internal;
+	core_select <= core_select_reg;
+	core_step <= '1' when debugger_state_reg = stepping else '0';
 	command_buffer <= cmd_buffer_reg;
+	host_data <= cmd_buffer_reg(7 downto 0);
 	
 	
 end Behavioral;
\ No newline at end of file
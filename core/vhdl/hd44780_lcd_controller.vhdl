@@ -35,7 +35,8 @@ Port (
     register_select : in std_logic;
     lcd_en : out std_logic;
     lcd_rs : out std_logic;
-    lcd_do : out std_logic_vector(7 downto 0)
+    lcd_do : out std_logic_vector(7 downto 0);
+    ready : out std_logic
 );
 end lcd_controller;
 
@@ -46,6 +47,14 @@ signal state_reg, state_reg_next : std_logic_vector(4 downto 0);
 signal lcd_en_reg, lcd_en_reg_next : std_logic;
 signal lcd_rs_reg, lcd_rs_reg_next : std_logic;
 
+-- The LCD can't be read so ready comes from the worst case execution times of
+-- the HD44780, 37us for most instructions and 1.52ms for clear and home. The
+-- counts are 256 and 10240 CPU cycles at clk_50 / 8 minus two clocks for the
+-- interrupt controller, which makes the ready interrupt cycle exact.
+constant short_delay : integer := 8 * 256 - 2;
+constant long_delay : integer := 8 * 10240 - 2;
+signal busy_counter_reg, busy_counter_next : std_logic_vector(16 downto 0);
+
 begin
     process(clk_50, reset)
     begin
@@ -54,12 +63,14 @@ begin
             state_reg <= (others => '0');
             lcd_en_reg <= '0';
             lcd_rs_reg <= '0';
+            busy_counter_reg <= (others => '0');
         else
             if clk_50'event and clk_50 = '1' then
                 data_in_reg <= data_in_reg_next;
                 state_reg <= state_reg_next;
                 lcd_en_reg <= lcd_en_reg_next;
                 lcd_rs_reg <= lcd_rs_reg_next;
+                busy_counter_reg <= busy_counter_next;
             end if;
         end if;
     end process;
@@ -68,8 +79,15 @@ begin
 	 lcd_rs <= lcd_rs_reg;
 	 lcd_en <= lcd_en_reg;
 
-    process(state_reg, data_in_reg, lcd_en_reg, lcd_rs_reg, register_select, strobe, di)
+    ready <= '1' when state_reg = "00000" and busy_counter_reg = 0 else '0';
+
+    process(state_reg, data_in_reg, lcd_en_reg, lcd_rs_reg, register_select, strobe, di, busy_counter_reg)
     begin
+        busy_counter_next <= busy_counter_reg;
+        if busy_counter_reg /= 0 then
+            busy_counter_next <= busy_counter_reg - 1;
+        end if;
+
         state_reg_next <= state_reg;
         data_in_reg_next <= data_in_reg;
         lcd_en_reg_next <= lcd_en_reg;
@@ -82,6 +100,12 @@ begin
                     lcd_rs_reg_next <= register_select;
                     data_in_reg_next <= di;
                     state_reg_next <= "00001";
+                    -- clear display and return home are the slow ones
+                    if register_select = '0' and di(7 downto 2) = "000000" and di(1 downto 0) /= "00" then
+                        busy_counter_next <= conv_std_logic_vector(long_delay, 17);
+                    else
+                        busy_counter_next <= conv_std_logic_vector(short_delay, 17);
+                    end if;
                 end if;
                 
 				-- The intermediate states exist because RW and RS need to settle for at least 60ns before EN goes up
@@ -0,0 +1,167 @@
+-- Copyright (c) 2014, Juha Turunen
+-- All rights reserved.
+--
+-- Redistribution and use in source and binary forms, with or without
+-- modification, are permitted provided that the following conditions are met: 
+--
+-- 1. Redistributions of source code must retain the above copyright notice, this
+--    list of conditions and the following disclaimer. 
+-- 2. Redistributions in binary form must reproduce the above copyright notice,
+--    this list of conditions and the following disclaimer in the documentation
+--    and/or other materials provided with the distribution. 
+--
+-- THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+-- ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+-- WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+-- DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+-- ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+-- (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+-- LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+-- ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+-- (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+-- SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+library IEEE;
+use IEEE.STD_LOGIC_1164.ALL;
+use IEEE.STD_LOGIC_ARITH.ALL;
+use IEEE.STD_LOGIC_UNSIGNED.ALL;
+
+-- Interrupt controller with a timer, LCD ready and host byte sources.
+--
+-- $0 enable   R/W  XXXXXSLT  T = timer, L = LCD ready, S = byte from the host
+-- $1 pending  R/W  XXXXXSLT  reads the pending sources, writing 1 clears the bit
+-- $2 vector   R/W  program address of the interrupt handler
+-- $3 timer reload low byte  R/W
+-- $4 timer reload high byte R/W, writing it (re)starts the timer
+-- $5 host byte R   last byte sent by the debugger
+--
+-- The timer counts CPU cycles and raises its interrupt every reload cycles,
+-- reload 0 stops it. irq stays up as long as an enabled source is pending.
+
+entity interrupt_controller is port (
+	clk : in std_logic;
+	reset : in std_logic;
+	clk_ena : in std_logic;
+	address : in std_logic_vector(3 downto 0);
+	data_in : in std_logic_vector(7 downto 0);
+	data_out : out std_logic_vector(7 downto 0);
+	wr_ena : in std_logic;
+
+	lcd_ready : in std_logic;
+	host_data : in std_logic_vector(7 downto 0);
+	host_data_strobe : in std_logic;
+
+	irq : out std_logic;
+	vector : out std_logic_vector(7 downto 0)
+);
+end interrupt_controller;
+
+architecture Behavioral of interrupt_controller is
+
+signal enable_reg, enable_next : std_logic_vector(2 downto 0);
+signal pending_reg, pending_next : std_logic_vector(2 downto 0);
+signal vector_reg, vector_next : std_logic_vector(7 downto 0);
+signal reload_reg, reload_next : std_logic_vector(15 downto 0);
+signal counter_reg, counter_next : std_logic_vector(15 downto 0);
+signal host_data_reg, host_data_next : std_logic_vector(7 downto 0);
+signal lcd_ready_reg : std_logic;
+
+begin
+
+	process (clk, reset)
+	begin
+		if (reset = '1') then
+			enable_reg <= (others => '0');
+			pending_reg <= (others => '0');
+			vector_reg <= (others => '0');
+			reload_reg <= (others => '0');
+			counter_reg <= (others => '0');
+			host_data_reg <= (others => '0');
+			lcd_ready_reg <= '1';
+		elsif (clk'event and clk = '1') then
+			enable_reg <= enable_next;
+			pending_reg <= pending_next;
+			vector_reg <= vector_next;
+			reload_reg <= reload_next;
+			counter_reg <= counter_next;
+			host_data_reg <= host_data_next;
+			lcd_ready_reg <= lcd_ready;
+		end if;
+	end process;
+
+	process (wr_ena, address, data_in, clk_ena, enable_reg, pending_reg, vector_reg, reload_reg, counter_reg,
+				host_data_reg, host_data, host_data_strobe, lcd_ready, lcd_ready_reg)
+	begin
+		enable_next <= enable_reg;
+		pending_next <= pending_reg;
+		vector_next <= vector_reg;
+		reload_next <= reload_reg;
+		counter_next <= counter_reg;
+		host_data_next <= host_data_reg;
+
+		-- register writes
+		if (wr_ena = '1') then
+			case address is
+				when "0000" =>
+					enable_next <= data_in(2 downto 0);
+				when "0001" =>
+					pending_next <= pending_reg and not data_in(2 downto 0);
+				when "0010" =>
+					vector_next <= data_in;
+				when "0011" =>
+					reload_next(7 downto 0) <= data_in;
+				when "0100" =>
+					reload_next(15 downto 8) <= data_in;
+					counter_next <= data_in & reload_reg(7 downto 0);
+				when others =>
+			end case;
+		end if;
+
+		-- timer, a write to the reload register restarts it instead of counting
+		if (clk_ena = '1' and not (wr_ena = '1' and address = "0100") and counter_reg /= 0) then
+			if (counter_reg = 1) then
+				counter_next <= reload_reg;
+				pending_next(0) <= '1';
+			else
+				counter_next <= counter_reg - 1;
+			end if;
+		end if;
+
+		-- sources set their bit even if it's cleared in the same cycle
+		if (lcd_ready = '1' and lcd_ready_reg = '0') then
+			pending_next(1) <= '1';
+		end if;
+
+		if (host_data_strobe = '1') then
+			host_data_next <= host_data;
+			pending_next(2) <= '1';
+		end if;
+	end process;
+
+	-- register reads
+	process (address, enable_reg, pending_reg, vector_reg, reload_reg, host_data_reg)
+	begin
+		case address is
+			when "0000" =>
+				data_out <= "00000" & enable_reg;
+			when "0001" =>
+				data_out <= "00000" & pending_reg;
+			when "0010" =>
+				data_out <= vector_reg;
+			when "0011" =>
+				data_out <= reload_reg(7 downto 0);
+			when "0100" =>
+				data_out <= reload_reg(15 downto 8);
+			when "0101" =>
+				data_out <= host_data_reg;
+			when others =>
+				data_out <= (others => '0');
+		end case;
+	end process;
+
+	irq <= '1' when (pending_reg and enable_reg) /= "000" else '0';
+	vector <= vector_reg;
+
+end Behavioral;
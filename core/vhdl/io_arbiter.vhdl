@@ -0,0 +1,86 @@
+-- Copyright (c) 2014, Juha Turunen
+-- All rights reserved.
+--
+-- Redistribution and use in source and binary forms, with or without
+-- modification, are permitted provided that the following conditions are met: 
+--
+-- 1. Redistributions of source code must retain the above copyright notice, this
+--    list of conditions and the following disclaimer. 
+-- 2. Redistributions in binary form must reproduce the above copyright notice,
+--    this list of conditions and the following disclaimer in the documentation
+--    and/or other materials provided with the distribution. 
+--
+-- THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+-- ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+-- WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+-- DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+-- ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+-- (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+-- LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+-- ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+-- (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+-- SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+library IEEE;
+use IEEE.STD_LOGIC_1164.ALL;
+use IEEE.STD_LOGIC_ARITH.ALL;
+use IEEE.STD_LOGIC_UNSIGNED.ALL;
+
+-- Round robin arbiter for the I/O bus the cores share. A core requests the
+-- bus while its instruction does IN or OUT and only gets its clock enable when
+-- it's granted, the others wait. The search for the next grant starts after
+-- the core that got the bus last.
+
+entity io_arbiter is generic (
+	cores : positive := 1
+); port (
+	clk : in std_logic;
+	reset : in std_logic;
+	clk_ena : in std_logic;
+	request : in std_logic_vector(cores - 1 downto 0);
+	grant : out std_logic_vector(cores - 1 downto 0);
+	grant_index : out std_logic_vector(1 downto 0);
+	granted : out std_logic
+);
+end io_arbiter;
+
+architecture Behavioral of io_arbiter is
+
+signal last_reg, last_next : integer range 0 to cores - 1;
+
+begin
+
+	process (clk, reset)
+	begin
+		if (reset = '1') then
+			last_reg <= cores - 1;
+		elsif (clk'event and clk = '1') then
+			if (clk_ena = '1') then
+				last_reg <= last_next;
+			end if;
+		end if;
+	end process;
+
+	process (request, last_reg)
+		variable candidate : integer range 0 to cores - 1;
+		variable found : boolean;
+	begin
+		grant <= (others => '0');
+		grant_index <= (others => '0');
+		granted <= '0';
+		last_next <= last_reg;
+		found := false;
+		for i in 1 to cores loop
+			candidate := (last_reg + i) mod cores;
+			if (not found and request(candidate) = '1') then
+				found := true;
+				grant(candidate) <= '1';
+				grant_index <= conv_std_logic_vector(candidate, 2);
+				granted <= '1';
+				last_next <= candidate;
+			end if;
+		end loop;
+	end process;
+
+end Behavioral;
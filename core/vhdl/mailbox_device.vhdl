@@ -0,0 +1,117 @@
+-- Copyright (c) 2014, Juha Turunen
+-- All rights reserved.
+--
+-- Redistribution and use in source and binary forms, with or without
+-- modification, are permitted provided that the following conditions are met: 
+--
+-- 1. Redistributions of source code must retain the above copyright notice, this
+--    list of conditions and the following disclaimer. 
+-- 2. Redistributions in binary form must reproduce the above copyright notice,
+--    this list of conditions and the following disclaimer in the documentation
+--    and/or other materials provided with the distribution. 
+--
+-- THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+-- ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+-- WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+-- DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+-- ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+-- (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+-- LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+-- ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+-- (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+-- SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+library IEEE;
+use IEEE.STD_LOGIC_1164.ALL;
+use IEEE.STD_LOGIC_ARITH.ALL;
+use IEEE.STD_LOGIC_UNSIGNED.ALL;
+
+-- Mailboxes and semaphores for the cores sharing the I/O bus.
+--
+-- $0-$3  R/W  mailbox of core 0-3. A write posts a byte, a read takes it and
+--             clears the full flag.
+-- $4     R    XXXXFFFF  F = mailbox 0-3 full
+-- $5     R    number of the core doing the read
+-- $6     R    number of cores
+-- $8-$f  R/W  semaphores 0-7. A read returns 0 and takes the semaphore when
+--             it was free, 1 when another core has it. A write frees it.
+--
+-- The arbiter lets one core at a time on the bus, so a read takes effect on
+-- the enabled clock that completes it and can't race another core.
+
+entity mailbox_device is generic (
+	cores : positive := 1
+); port (
+	clk : in std_logic;
+	reset : in std_logic;
+	address : in std_logic_vector(3 downto 0);
+	data_in : in std_logic_vector(7 downto 0);
+	data_out : out std_logic_vector(7 downto 0);
+	wr_ena : in std_logic;
+	rd_ena : in std_logic;
+	-- the core that has the bus
+	core : in std_logic_vector(1 downto 0)
+);
+end mailbox_device;
+
+architecture Behavioral of mailbox_device is
+
+type mailbox_array is array (0 to 3) of std_logic_vector(7 downto 0);
+signal mailbox_reg, mailbox_next : mailbox_array;
+signal full_reg, full_next : std_logic_vector(3 downto 0);
+signal semaphore_reg, semaphore_next : std_logic_vector(7 downto 0);
+
+begin
+
+	process (clk, reset)
+	begin
+		if (reset = '1') then
+			full_reg <= (others => '0');
+			semaphore_reg <= (others => '0');
+		elsif (clk'event and clk = '1') then
+			mailbox_reg <= mailbox_next;
+			full_reg <= full_next;
+			semaphore_reg <= semaphore_next;
+		end if;
+	end process;
+
+	process (address, data_in, wr_ena, rd_ena, mailbox_reg, full_reg, semaphore_reg)
+	begin
+		mailbox_next <= mailbox_reg;
+		full_next <= full_reg;
+		semaphore_next <= semaphore_reg;
+
+		if (address(3) = '1') then
+			if (wr_ena = '1') then
+				semaphore_next(conv_integer(address(2 downto 0))) <= '0';
+			elsif (rd_ena = '1') then
+				semaphore_next(conv_integer(address(2 downto 0))) <= '1';
+			end if;
+		elsif (address(2) = '0') then
+			if (wr_ena = '1') then
+				mailbox_next(conv_integer(address(1 downto 0))) <= data_in;
+				full_next(conv_integer(address(1 downto 0))) <= '1';
+			elsif (rd_ena = '1') then
+				full_next(conv_integer(address(1 downto 0))) <= '0';
+			end if;
+		end if;
+	end process;
+
+	process (address, core, mailbox_reg, full_reg, semaphore_reg)
+	begin
+		data_out <= (others => '0');
+		if (address(3) = '1') then
+			data_out(0) <= semaphore_reg(conv_integer(address(2 downto 0)));
+		else
+			case address(2 downto 0) is
+				when "100" => data_out <= "0000" & full_reg;
+				when "101" => data_out <= "000000" & core;
+				when "110" => data_out <= conv_std_logic_vector(cores, 8);
+				when "111" => null;		-- reserved, reads 0
+				when others => data_out <= mailbox_reg(conv_integer(address(1 downto 0)));
+			end case;
+		end if;
+	end process;
+
+end Behavioral;
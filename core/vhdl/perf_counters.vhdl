@@ -0,0 +1,155 @@
+-- Copyright (c) 2014, Juha Turunen
+-- All rights reserved.
+--
+-- Redistribution and use in source and binary forms, with or without
+-- modification, are permitted provided that the following conditions are met: 
+--
+-- 1. Redistributions of source code must retain the above copyright notice, this
+--    list of conditions and the following disclaimer. 
+-- 2. Redistributions in binary form must reproduce the above copyright notice,
+--    this list of conditions and the following disclaimer in the documentation
+--    and/or other materials provided with the distribution. 
+--
+-- THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+-- ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+-- WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+-- DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+-- ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+-- (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+-- LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+-- ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+-- (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+-- SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+library IEEE;
+use IEEE.STD_LOGIC_1164.ALL;
+use IEEE.STD_LOGIC_ARITH.ALL;
+use IEEE.STD_LOGIC_UNSIGNED.ALL;
+
+-- Free running 32-bit performance counters.
+--
+-- $00-$17 R  snapshot of the counters, four bytes each with the LSB first
+--            $00 CPU cycles
+--            $04 retired instructions
+--            $08 taken branches, calls and returns
+--            $0c data memory reads (LD, POP, RET)
+--            $10 data memory writes, including the interrupt entry push
+--            $14 cycles a HALT waited for an interrupt, and the bubbles of
+--                the pipelined core
+-- $00-$1f W  XXXXXXCS  S = take a snapshot, C = clear the counters
+--
+-- Every CPU cycle is either a retired instruction, an interrupt entry or a
+-- halted one, a pipeline bubble counts as halted. A clear zeroes the counters before the events of the OUT doing
+-- it are counted. The debug scan chain captures the counters, not the snapshot.
+
+entity perf_counters is port (
+	clk : in std_logic;
+	reset : in std_logic;
+	clk_ena : in std_logic;
+	address : in std_logic_vector(4 downto 0);
+	data_in : in std_logic_vector(7 downto 0);
+	data_out : out std_logic_vector(7 downto 0);
+	wr_ena : in std_logic;
+
+	-- events of the cycle ending on the next enabled clock
+	retired : in std_logic;
+	branch_taken : in std_logic;
+	mem_read : in std_logic;
+	mem_write : in std_logic;
+	halted : in std_logic;
+
+	scan_reset : in std_logic;
+	scan_input : in std_logic;
+	scan_output : out std_logic;
+	scan_enable : in std_logic
+);
+end perf_counters;
+
+architecture Behavioral of perf_counters is
+
+constant counter_count : integer := 6;
+type counter_array is array (0 to counter_count - 1) of std_logic_vector(31 downto 0);
+signal counters_reg, counters_next : counter_array;
+signal snapshot_reg, snapshot_next : counter_array;
+signal events : std_logic_vector(counter_count - 1 downto 0);
+
+constant scan_length : integer := 32 * counter_count;
+signal scan_reg, scan_reg_next : std_logic_vector(scan_length - 1 downto 0);
+
+begin
+
+	process (clk, reset)
+	begin
+		if (reset = '1') then
+			counters_reg <= (others => (others => '0'));
+			snapshot_reg <= (others => (others => '0'));
+		elsif (clk'event and clk = '1') then
+			counters_reg <= counters_next;
+			snapshot_reg <= snapshot_next;
+		end if;
+	end process;
+
+	-- the scan register isn't reset like the rest of the scan chain
+	process (clk)
+	begin
+		if (clk'event and clk = '1') then
+			scan_reg <= scan_reg_next;
+		end if;
+	end process;
+
+	events <= halted & mem_write & mem_read & branch_taken & retired & '1';
+
+	process (clk_ena, wr_ena, data_in, counters_reg, snapshot_reg, events)
+	begin
+		counters_next <= counters_reg;
+		snapshot_next <= snapshot_reg;
+
+		if (wr_ena = '1' and data_in(0) = '1') then
+			snapshot_next <= counters_reg;
+		end if;
+
+		if (clk_ena = '1') then
+			for i in 0 to counter_count - 1 loop
+				if (wr_ena = '1' and data_in(1) = '1') then
+					counters_next(i) <= x"0000000" & "000" & events(i);
+				else
+					counters_next(i) <= counters_reg(i) + events(i);
+				end if;
+			end loop;
+		end if;
+	end process;
+
+	-- snapshot reads
+	process (address, snapshot_reg)
+		variable counter : integer;
+	begin
+		counter := conv_integer(address(4 downto 2));
+		data_out <= (others => '0');
+		if (counter < counter_count) then
+			case address(1 downto 0) is
+				when "00" => data_out <= snapshot_reg(counter)(7 downto 0);
+				when "01" => data_out <= snapshot_reg(counter)(15 downto 8);
+				when "10" => data_out <= snapshot_reg(counter)(23 downto 16);
+				when others => data_out <= snapshot_reg(counter)(31 downto 24);
+			end case;
+		end if;
+	end process;
+
+	-- scan logic
+	process (scan_reg, scan_enable, scan_input, scan_reset, counters_reg)
+	begin
+		if (scan_reset = '1') then
+			for i in 0 to counter_count - 1 loop
+				scan_reg_next(i * 32 + 31 downto i * 32) <= counters_reg(i);
+			end loop;
+		elsif (scan_enable = '1') then
+			scan_reg_next <= scan_input & scan_reg(scan_length - 1 downto 1);
+		else
+			scan_reg_next <= scan_reg;
+		end if;
+	end process;
+
+	scan_output <= scan_reg(0);
+
+end Behavioral;
@@ -40,6 +40,9 @@ entity register_file is port (
 	src2_select : in std_logic_vector(1 downto 0);
 	dst_select : in std_logic_vector(1 downto 0);
 	dst_wr_ena : in std_logic;
+	-- second write port for the address register of post-incrementing loads and stores
+	src1_wr_ena : in std_logic;
+	src1_in : in std_logic_vector(15 downto 0);
 	
 	src1_out : out std_logic_vector(15 downto 0);
 	src2_out : out std_logic_vector(15 downto 0);
@@ -75,9 +78,13 @@ begin
 
 	end process;
 	
-	process (registers, registers_next, dst_select, dst_in, dst_wr_ena)
+	process (registers, registers_next, dst_select, dst_in, dst_wr_ena, src1_select, src1_in, src1_wr_ena)
 	begin
 		registers_next <= registers;
+		if (src1_wr_ena = '1') then
+			registers_next(to_integer(unsigned(src1_select))) <= src1_in;
+		end if;
+		-- the destination wins when both ports write the same register
 		if (dst_wr_ena = '1') then
 			registers_next(to_integer(unsigned(dst_select))) <= dst_in;
 		end if;	
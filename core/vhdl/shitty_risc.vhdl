@@ -34,19 +34,39 @@ entity shitty_risc is port (
 	clk_ena : in std_logic;
 	halt : out std_logic;
 	
+	irq : in std_logic;
+	irq_vector : in std_logic_vector(7 downto 0);
+	
 	scan_reset : in std_logic;
 	scan_input : in std_logic;
 	scan_output : out std_logic;
 	scan_enable : in std_logic;
 	
-	pgm_mem_addr : out std_logic_vector(7 downto 0);
+	pgm_mem_addr : out std_logic_vector(10 downto 0);
 	pgm_mem_data_in : in std_logic_vector(15 downto 0);
 	
 	data_mem_addr : out std_logic_vector(7 downto 0);
 	data_mem_data_in : in std_logic_vector(7 downto 0);
 	data_mem_data_out : out std_logic_vector(7 downto 0);
 	data_mem_wr_ena : out std_logic;
-	mem_io_select : out std_logic
+	mem_io_select : out std_logic;
+	
+	-- bank & PC of the instruction executed on the next enabled clock, whether
+	-- it's a HALT that already stopped the core and whether an interrupt entry
+	-- replaces it, for the debugger's trace buffer. trace_valid is always high,
+	-- it's there for the same ports as shitty_risc_pipelined.
+	trace_valid : out std_logic;
+	trace_pc : out std_logic_vector(10 downto 0);
+	trace_ir : out std_logic_vector(15 downto 0);
+	trace_halted : out std_logic;
+	trace_irq_taken : out std_logic;
+
+	-- events of the same instruction for the performance counters
+	perf_retired : out std_logic;
+	perf_branch_taken : out std_logic;
+	perf_mem_read : out std_logic;
+	perf_mem_write : out std_logic;
+	perf_halted : out std_logic
 );
 end shitty_risc;
 
@@ -76,6 +96,12 @@ signal op : operation;
 signal op_alu_op : std_logic_vector(3 downto 0);
 signal op_sign_extend, op_indirect_addr, op_register_jump_target : std_logic;
 signal op_pop_push : std_logic;
+signal op_no_writeback : std_logic;
+signal op_reti : std_logic;
+signal op_far_return : std_logic;
+signal op_post_modify : std_logic_vector(1 downto 0);
+signal reg_src1_wr_ena : std_logic;
+signal far_target_bank : std_logic_vector(2 downto 0);
 signal reg_src1_select, reg_src2_select, reg_dst_select : register_address;
 signal branch_cond : std_logic_vector(1 downto 0);
 signal instruction : std_logic_vector(15 downto 0);
@@ -84,9 +110,23 @@ signal jump_target : std_logic_vector(7 downto 0);
 
 -- status flags
 signal carry, carry_next, negative, negative_next, zero, zero_next, halted, halted_next : std_logic;
+signal interrupts_enabled, interrupts_enabled_next : std_logic;
+
+-- C, N and Z saved on interrupt entry and restored by RETI, interrupts don't nest
+signal saved_flags_reg, saved_flags_next : std_logic_vector(2 downto 0);
+signal irq_taken : std_logic;
 
--- Instruction | SR | PC
-constant scan_length : integer := 16 + 8 + 8 + 8; 
+-- Program memory bank, the PC addresses 256 words within it. FBSR pushes the
+-- old bank to a hardware stack, FRET, RETI and interrupt entry use it too.
+-- Far calls nest 8 deep, deeper ones wrap around.
+type bank_stack_type is array (0 to 7) of std_logic_vector(2 downto 0);
+signal bank_stack : bank_stack_type;
+signal bank_reg, bank_next : std_logic_vector(2 downto 0);
+signal bank_sp_reg, bank_sp_next : std_logic_vector(2 downto 0);
+signal bank_push : std_logic;
+
+-- Bank | Instruction | SR | PC | SP
+constant scan_length : integer := 8 + 16 + 8 + 8 + 8; 
 signal scan_reg, scan_reg_next : std_logic_vector(scan_length - 1 downto 0);
 
 signal movi_high_byte, ld_high_byte : std_logic_vector(7 downto 0);
@@ -95,6 +135,8 @@ signal mem_write: std_logic;
 
 signal stack_read_access, stack_write_access : std_logic;
 
+signal branch_taken, mem_read : std_logic;
+
 
 begin
 
@@ -103,6 +145,9 @@ begin
 		if (reset = '1') then
 			pc_reg <= (others => '0');
 			sr_reg <= (others => '0');
+			saved_flags_reg <= (others => '0');
+			bank_reg <= (others => '0');
+			bank_sp_reg <= (others => '0');
 			scan_reg <= (others => '0');
 			sp_reg <= "11111111";
 		elsif (clk'event and clk = '1') then			
@@ -110,12 +155,25 @@ begin
 				pc_reg <= pc_next;
 				sr_reg <= sr_next;
 				sp_reg <= sp_next;
+				saved_flags_reg <= saved_flags_next;
+				bank_reg <= bank_next;
+				bank_sp_reg <= bank_sp_next;
 			end if;
 			-- not related to actual CPU functionality so no need to depend on clk_ena
 			scan_reg <= scan_reg_next;
 		end if;
 	end process;
 
+	-- Not reset, it's only read back after something has been pushed
+	process (clk)
+	begin
+		if (clk'event and clk = '1') then
+			if (clk_ena = '1' and bank_push = '1') then
+				bank_stack(conv_integer(bank_sp_reg)) <= bank_reg;
+			end if;
+		end if;
+	end process;
+
 	-- General purpose registers
 	registers : entity work.register_file port map (
 		clk => clk,
@@ -132,7 +190,9 @@ begin
 		src2_out => reg_src2_out,
 		dst_select => reg_dst_select,
 		dst_in => reg_dst_in,
-		dst_out => reg_dst_out
+		dst_out => reg_dst_out,
+		src1_wr_ena => reg_src1_wr_ena,
+		src1_in => alu_result
 	);
 			
 	alu : entity work.alu port map (
@@ -141,6 +201,7 @@ begin
 		src2 => alu_src2,
 		result => alu_result,
 		carry_in => alu_carry_in,
+		carry_out => alu_carry_out,
 		zero => alu_zero,
 		negative => alu_negative
 	);
@@ -149,7 +210,8 @@ begin
 	alu_src2 <= reg_src2_out;
 	alu_carry_in <= carry;
 
-	halt <= halted;
+	-- HALT with interrupts enabled waits for an interrupt, so it only stops the core for good with them disabled
+	halt <= halted and not interrupts_enabled;
 	
 	-- X = don't care
 	-- r = source reg1
@@ -173,15 +235,16 @@ begin
 	-- t = (imm)
 	
 	-- LDI
-	--	0010nettrrXXXXXX
+	--	0010nettrrXXXXmm
 	-- t = (r)
+	-- m = 01: r = r + 1 after the access, m = 10: r = r - 1. Same for STI, IN and OUT.
 	
 	-- ST 
 	-- 00110ottaaaaaaaa
 	-- (imm) = t
 	
 	-- STI
-	-- 0011nXttrrXXXXXX
+	-- 0011nXttrrXXXXmm
 	-- (r) = t
 	
 	-- ADD
@@ -196,6 +259,22 @@ begin
 	-- 0100XXttrrss0001
 	-- t = r - s
 	
+	-- ADC
+	-- 0100XXttrrss1101
+	-- t = r + s + C
+	
+	-- SBC
+	-- 0100XXttrrss1110
+	-- t = r - s - not C
+	
+	-- CMP
+	-- 01001XXXrrss0001
+	-- flags of r - s
+	
+	-- TST
+	-- 01001XXXrrss1000
+	-- flags of r & s
+	
 	-- CLR
 	-- 0100XXttXXXX0100
 	-- t = 0
@@ -246,7 +325,23 @@ begin
 	--	0111XX01aaaaaaaa
 	
 	-- RET
-	--	1000XXXXXXXXXXXX
+	--	10000XXXXXXXXXXX
+	
+	-- RETI
+	--	10001XXXXXXXXXXX
+	-- RET that enables interrupts and restores the flags and the bank saved on interrupt entry
+	
+	-- FRET
+	--	100001XXXXXXXXXX
+	-- RET that also pops the program memory bank
+	
+	-- FBSR
+	--	1101Xbbbaaaaaaaa
+	-- (sp--) = pc + 1, push bank, bank = b, pc = a
+	
+	-- EI / DI
+	-- 1100XXXXXXXXXXXe
+	-- interrupts enabled = e
 	
 	-- PUSH
 	-- 10010XttXXXXXXXX
@@ -275,24 +370,40 @@ begin
 	op_indirect_addr <= instruction(11);
 	op_register_jump_target <= instruction(11);
 	op_pop_push <= instruction(11);
+	op_no_writeback <= instruction(11);
+	op_reti <= instruction(11);
+	op_far_return <= instruction(11) or instruction(10);
+	far_target_bank <= instruction(10 downto 8);
+	op_post_modify <= instruction(1 downto 0);
 	
 	-- Separate status flags
+	interrupts_enabled <= sr_reg(4);
 	halted <= sr_reg(3);
 	carry <= sr_reg(2);
 	negative <= sr_reg(1);
 	zero <= sr_reg(0);
 
+	-- Interrupts are taken between instructions and also wake up a halted core
+	irq_taken <= irq and interrupts_enabled;
 	
 	-- Control path logic
 	process (pc_reg, carry, negative, zero, sr_reg, sp_reg, imm_value, op_sign_extend, data_mem_data_in,
 				op, movi_high_byte, alu_result, ld_high_byte, branch_cond, imm_address,
-				alu_zero, alu_negative, reg_dst_out, zero_next)
+				alu_zero, alu_negative, alu_carry_out, op_no_writeback, reg_dst_out, zero_next,
+				irq_taken, irq_vector, halted, interrupts_enabled, saved_flags_reg, op_reti, instruction,
+				bank_reg, bank_sp_reg, bank_stack, op_far_return, far_target_bank, op_indirect_addr, op_post_modify)
 	begin
+		bank_next <= bank_reg;
+		bank_sp_next <= bank_sp_reg;
+		bank_push <= '0';
+		interrupts_enabled_next <= interrupts_enabled;
+		saved_flags_next <= saved_flags_reg;
 		halted_next <= halted;
 		carry_next <= carry;
 		negative_next <= negative;
 		zero_next <= zero;
 		reg_wr_ena <= '0';
+		reg_src1_wr_ena <= '0';
 		mem_write <= '0';
 		reg_dst_in <= (others => 'X');
 		alu_op <= op_alu_op;
@@ -300,10 +411,12 @@ begin
 		mem_io_select <= '1';
 		stack_read_access <= '0';
 		stack_write_access <= '0';
+		branch_taken <= '0';
+		mem_read <= '0';
 		sp_next <= sp_reg;
 		
 
-		sr_next <= "0000" & halted_next & carry_next & negative_next & zero_next;
+		sr_next <= "000" & interrupts_enabled_next & halted_next & carry_next & negative_next & zero_next;
 		pc_next <= pc_reg + 1;
 
 		-- to simplify encoding we're using the usual dest reg as output for st instruction
@@ -315,6 +428,40 @@ begin
 			ld_high_byte(i) <= data_mem_data_in(7);
 		end loop;
 		
+		if (irq_taken = '1') then
+			-- Interrupt entry replaces the instruction. The address of the instruction is
+			-- pushed like BSR does it, or the one after it when a HALT was waiting.
+			mem_write <= '1';
+			stack_write_access <= '1';
+			sp_next <= sp_reg - 1;
+			if (halted = '1') then
+				data_mem_data_out <= pc_reg + 1;
+			else
+				data_mem_data_out <= pc_reg;
+			end if;
+			pc_next <= irq_vector;
+			-- handlers live in bank 0
+			bank_push <= '1';
+			bank_sp_next <= bank_sp_reg + 1;
+			bank_next <= "000";
+			halted_next <= '0';
+			interrupts_enabled_next <= '0';
+			saved_flags_next <= carry & negative & zero;
+		else
+		-- Post-increment and decrement of LDI/STI/IN/OUT, the address register is
+		-- written back through the second register file port using the idle ALU
+		if (op(2 downto 1) = "01" and op_indirect_addr = '1') then
+			case op_post_modify is
+				when "01" =>
+					alu_op <= "1100";
+					reg_src1_wr_ena <= '1';
+				when "10" =>
+					alu_op <= "1011";
+					reg_src1_wr_ena <= '1';
+				when others =>
+			end case;
+		end if;
+		
 		case op is
 			when "0000" =>		-- NOP
 				
@@ -326,15 +473,17 @@ begin
 					reg_dst_in <= reg_dst_out(15 downto 8) & imm_value;
 				end if;
 			
-			when "0100" =>		-- alu op
-				reg_wr_ena <= '1';
+			when "0100" =>		-- alu op, CMP and TST only update the flags
+				reg_wr_ena <= not op_no_writeback;
 				reg_dst_in <= alu_result;
 				zero_next <= alu_zero;
 				negative_next <= alu_negative;
+				carry_next <= alu_carry_out;
 				
 			-- LD/LDI/IN
 			when "0010" =>
 				reg_wr_ena <= '1';
+				mem_read <= '1';
 				if (op_sign_extend = '1') then
 					reg_dst_in <= ld_high_byte & data_mem_data_in;
 				else
@@ -366,15 +515,18 @@ begin
 					when "00" =>	-- BREQ
 						if (zero = '1') then
 							pc_next <= jump_target;
+							branch_taken <= '1';
 						end if;
 					
 					when "01" =>	-- BRNE
 						if (zero = '0') then
 							pc_next <= jump_target;
+							branch_taken <= '1';
 						end if;
 						
 					when "10" =>	-- BRA
 						pc_next <= jump_target;
+						branch_taken <= '1';
 						
 					when others =>
 						pc_next <= pc_reg + 1;
@@ -391,25 +543,40 @@ begin
 					when "00" =>	-- BREQ
 						if (zero = '1') then
 							pc_next <= jump_target;
+							branch_taken <= '1';
 						end if;
 					
 					when "01" =>	-- BRNE
 						if (zero = '0') then
 							pc_next <= jump_target;
+							branch_taken <= '1';
 						end if;
 						
 					when "10" =>	-- BRA
 						pc_next <= jump_target;
+						branch_taken <= '1';
 						
 					when others =>
 						pc_next <= pc_reg + 1;
 						
 				end case;
 				
-			when "1000"	=>		-- RET
+			when "1000"	=>		-- RET, RETI & FRET
 				stack_read_access <= '1';
+				mem_read <= '1';
+				branch_taken <= '1';
 				sp_next <= sp_reg + 1;
 				pc_next <= data_mem_data_in;
+				if (op_far_return = '1') then
+					bank_sp_next <= bank_sp_reg - 1;
+					bank_next <= bank_stack(conv_integer(bank_sp_reg - 1));
+				end if;
+				if (op_reti = '1') then
+					interrupts_enabled_next <= '1';
+					carry_next <= saved_flags_reg(2);
+					negative_next <= saved_flags_reg(1);
+					zero_next <= saved_flags_reg(0);
+				end if;
 
 			when "1001" =>		-- PUSH & POP
 				if (op_pop_push = '0') then
@@ -419,6 +586,7 @@ begin
 					data_mem_data_out <= reg_dst_out(7 downto 0);		-- can push only lower byte
 				else
 					stack_read_access <= '1';
+					mem_read <= '1';
 					sp_next <= sp_reg + 1;
 					reg_wr_ena <= '1';
 					reg_dst_in <= reg_dst_out(15 downto 8) & data_mem_data_in;  -- can pop only lower byte
@@ -434,26 +602,55 @@ begin
 				data_mem_data_out <= imm_value;
 				reg_src1_select <= reg_dst_select;
 			
+			when "1100" =>		-- EI & DI
+				interrupts_enabled_next <= instruction(0);
+			
+			when "1101" =>		-- FBSR
+				mem_write <= '1';
+				stack_write_access <= '1';
+				sp_next <= sp_reg - 1;
+				data_mem_data_out <= pc_reg + 1;
+				pc_next <= imm_value;
+				branch_taken <= '1';
+				bank_push <= '1';
+				bank_sp_next <= bank_sp_reg + 1;
+				bank_next <= far_target_bank;
+			
 			when "1111" =>
 				pc_next <= pc_reg;
 				halted_next <= '1';
 			when others =>
 			
 		end case;
+		end if;
 	end process;
 	
-	pgm_mem_addr <= pc_reg;
+	-- The program memory has a registered address, feeding it the next PC on the
+	-- enabled clock has the instruction ready right after the edge. That leaves
+	-- the rest of the CPU cycle to the registered data memory address, so the
+	-- debugger can run the core at every second clock.
+	pgm_mem_addr <= bank_next & pc_next when clk_ena = '1' else bank_reg & pc_reg;
 	data_mem_addr <= sp_reg when stack_write_access = '1' else
 						  sp_next when stack_read_access = '1' else
 						  reg_src1_out(7 downto 0) when op_indirect_addr = '1' else imm_address;
 	data_mem_wr_ena <= clk_ena and mem_write;
+	trace_valid <= '1';
+	trace_pc <= bank_reg & pc_reg;
+	trace_ir <= instruction;
+	trace_halted <= halted;
+	trace_irq_taken <= irq_taken;
+	perf_retired <= not (irq_taken or halted);
+	perf_halted <= halted and not irq_taken;
+	perf_branch_taken <= branch_taken;
+	perf_mem_read <= mem_read;
+	perf_mem_write <= mem_write and mem_io_select;
 	jump_target <= reg_src1_out(7 downto 0) when op_register_jump_target = '1' else imm_value;
 	
 	-- scan logic
-	process (scan_reg, scan_enable, scan_input, scan_reset, pc_reg, sr_reg, instruction, reg_file_scan_output)
+	process (scan_reg, scan_enable, scan_input, scan_reset, pc_reg, sr_reg, sp_reg, bank_reg, instruction, reg_file_scan_output)
 	begin
 		if (scan_reset = '1') then
-			scan_reg_next <= instruction & sr_reg & pc_reg & sp_reg;
+			scan_reg_next <= "00000" & bank_reg & instruction & sr_reg & pc_reg & sp_reg;
 		elsif (scan_enable = '1') then
 			scan_reg_next <= reg_file_scan_output & scan_reg(scan_length - 1 downto 1); 
 		else
@@ -0,0 +1,535 @@
+-- Copyright (c) 2014, Juha Turunen
+-- All rights reserved.
+--
+-- Redistribution and use in source and binary forms, with or without
+-- modification, are permitted provided that the following conditions are met: 
+--
+-- 1. Redistributions of source code must retain the above copyright notice, this
+--    list of conditions and the following disclaimer. 
+-- 2. Redistributions in binary form must reproduce the above copyright notice,
+--    this list of conditions and the following disclaimer in the documentation
+--    and/or other materials provided with the distribution. 
+--
+-- THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+-- ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+-- WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+-- DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+-- ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+-- (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+-- LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+-- ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+-- (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+-- SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+library IEEE;
+use IEEE.STD_LOGIC_1164.ALL;
+use IEEE.STD_LOGIC_ARITH.ALL;
+use IEEE.STD_LOGIC_UNSIGNED.ALL;
+
+-- Two stage pipelined variant of shitty_risc with the same ports and
+-- instruction set. It runs at every clock where the single cycle core needs
+-- at least two.
+--
+-- D  decodes the instruction from the program memory, reads the registers
+--    and does the data memory and I/O access: the address goes to the data
+--    memory's address register and stores, pushes and CPYDATA write at the
+--    end of D. D owns the SP and takes the interrupts.
+-- E  does the ALU operation and writes the registers and the flags. Loads,
+--    POP and RET take the data memory output that D addressed. Branches,
+--    calls, returns, HALT and interrupt entries are resolved in E and replace
+--    the instruction in D, so taken ones cost a cycle.
+--
+-- E's register writes are forwarded to D. D waits a cycle when its address
+-- register is written by E, or when it does I/O while E reads the data
+-- memory since the data input is shared. The debug scan chain has the same
+-- layout as the single cycle core's and shows the oldest instruction in the
+-- pipeline, the one executed on the next clock that isn't a bubble.
+
+entity shitty_risc_pipelined is port (
+	clk : in std_logic;
+	reset : in std_logic;
+	clk_ena : in std_logic;
+	halt : out std_logic;
+	
+	irq : in std_logic;
+	irq_vector : in std_logic_vector(7 downto 0);
+	
+	scan_reset : in std_logic;
+	scan_input : in std_logic;
+	scan_output : out std_logic;
+	scan_enable : in std_logic;
+	
+	pgm_mem_addr : out std_logic_vector(10 downto 0);
+	pgm_mem_data_in : in std_logic_vector(15 downto 0);
+	
+	data_mem_addr : out std_logic_vector(7 downto 0);
+	data_mem_data_in : in std_logic_vector(7 downto 0);
+	data_mem_data_out : out std_logic_vector(7 downto 0);
+	data_mem_wr_ena : out std_logic;
+	mem_io_select : out std_logic;
+	
+	-- the instruction or interrupt entry E completes on the next enabled clock,
+	-- trace_valid is low for a bubble. The data memory writes belong to the
+	-- instruction one clock later.
+	trace_valid : out std_logic;
+	trace_pc : out std_logic_vector(10 downto 0);
+	trace_ir : out std_logic_vector(15 downto 0);
+	trace_halted : out std_logic;
+	trace_irq_taken : out std_logic;
+
+	-- perf_halted also counts the bubbles
+	perf_retired : out std_logic;
+	perf_branch_taken : out std_logic;
+	perf_mem_read : out std_logic;
+	perf_mem_write : out std_logic;
+	perf_halted : out std_logic
+);
+end shitty_risc_pipelined;
+
+architecture Behavioral of shitty_risc_pipelined is
+
+subtype register_address is std_logic_vector(1 downto 0);
+type regarray is array (0 to 3) of std_logic_vector(15 downto 0);
+
+-- Register read with E's writes of the same clock forwarded, the destination
+-- wins when both ports write the register like in register_file
+function forward(sel : register_address; registers : regarray;
+				dst_wr_ena : std_logic; dst_select : register_address; dst_in : std_logic_vector;
+				src1_wr_ena : std_logic; src1_select : register_address; src1_in : std_logic_vector)
+				return std_logic_vector is
+begin
+	if (dst_wr_ena = '1' and dst_select = sel) then
+		return dst_in;
+	elsif (src1_wr_ena = '1' and src1_select = sel) then
+		return src1_in;
+	else
+		return registers(conv_integer(sel));
+	end if;
+end function;
+
+signal registers : regarray;
+
+signal alu_op : std_logic_vector(3 downto 0);
+signal alu_result : std_logic_vector(15 downto 0);
+signal alu_carry_out, alu_zero, alu_negative : std_logic;
+
+-- D stage
+signal d_pc, fetch_addr : std_logic_vector(10 downto 0);
+signal d_instruction : std_logic_vector(15 downto 0);
+signal d_op : std_logic_vector(3 downto 0);
+signal d_src1_select, d_src2_select, d_dst_select, d_addr_select : register_address;
+signal d_src1, d_src2, d_dst : std_logic_vector(15 downto 0);
+signal d_addr, d_write_data : std_logic_vector(7 downto 0);
+signal d_uses_addr_reg, d_io, d_mem_write, io_select : std_logic;
+signal d_stall, d_advance, irq_taken : std_logic;
+signal sp_reg, sp_next : std_logic_vector(7 downto 0) := "11111111";
+
+-- E stage, the operands are read in D
+signal e_valid, e_irq : std_logic;
+signal e_pc : std_logic_vector(10 downto 0);
+signal e_instruction : std_logic_vector(15 downto 0);
+signal e_src1, e_src2, e_dst : std_logic_vector(15 downto 0);
+signal e_sp, e_addr, e_io_data, e_vector : std_logic_vector(7 downto 0);
+signal e_src1_select : register_address;
+
+signal op : std_logic_vector(3 downto 0);
+signal reg_dst_select : register_address;
+signal reg_wr_ena, reg_src1_wr_ena : std_logic;
+signal reg_dst_in : std_logic_vector(15 downto 0);
+signal e_reads_mem, e_writes_addr_reg : std_logic;
+signal redirect, branch_taken : std_logic;
+signal redirect_pc, jump_target : std_logic_vector(7 downto 0);
+signal movi_high_byte, ld_high_byte, in_high_byte : std_logic_vector(7 downto 0);
+
+-- status flags
+signal sr_reg, sr_next : std_logic_vector(7 downto 0);
+signal carry, carry_next, negative, negative_next, zero, zero_next, halted, halted_next : std_logic;
+signal interrupts_enabled, interrupts_enabled_next : std_logic;
+signal saved_flags_reg, saved_flags_next : std_logic_vector(2 downto 0);
+
+-- program memory bank and the bank stack of FBSR, FRET and interrupts, see shitty_risc
+type bank_stack_type is array (0 to 7) of std_logic_vector(2 downto 0);
+signal bank_stack : bank_stack_type;
+signal bank_reg, bank_next : std_logic_vector(2 downto 0);
+signal bank_sp_reg, bank_sp_next : std_logic_vector(2 downto 0);
+signal bank_push : std_logic;
+
+-- R3 | R2 | R1 | R0 | Bank | Instruction | SR | PC | SP, the register file
+-- and the control path of shitty_risc in one chain
+constant scan_length : integer := 16 * 4 + 8 + 16 + 8 + 8 + 8;
+signal scan_reg, scan_reg_next : std_logic_vector(scan_length - 1 downto 0);
+signal scan_pc : std_logic_vector(10 downto 0);
+signal scan_instruction : std_logic_vector(15 downto 0);
+signal scan_sp : std_logic_vector(7 downto 0);
+
+begin
+
+	process (reset, clk, clk_ena)
+	begin
+		if (reset = '1') then
+			registers <= (others => (others => '0'));
+			d_pc <= (others => '0');
+			sp_reg <= "11111111";
+			e_valid <= '0';
+			e_irq <= '0';
+			e_pc <= (others => '0');
+			e_instruction <= (others => '0');
+			e_sp <= "11111111";
+			sr_reg <= (others => '0');
+			saved_flags_reg <= (others => '0');
+			bank_reg <= (others => '0');
+			bank_sp_reg <= (others => '0');
+			scan_reg <= (others => '0');
+		elsif (clk'event and clk = '1') then
+			if (clk_ena = '1') then
+				-- E
+				if (reg_src1_wr_ena = '1') then
+					registers(conv_integer(e_src1_select)) <= alu_result;
+				end if;
+				if (reg_wr_ena = '1') then
+					registers(conv_integer(reg_dst_select)) <= reg_dst_in;
+				end if;
+				sr_reg <= sr_next;
+				saved_flags_reg <= saved_flags_next;
+				bank_reg <= bank_next;
+				bank_sp_reg <= bank_sp_next;
+
+				-- D
+				d_pc <= fetch_addr;
+				sp_reg <= sp_next;
+				e_valid <= d_advance;
+				e_irq <= d_advance and irq_taken;
+				e_pc <= d_pc;
+				e_instruction <= d_instruction;
+				e_src1_select <= d_src1_select;
+				e_src1 <= d_src1;
+				e_src2 <= d_src2;
+				e_dst <= d_dst;
+				e_sp <= sp_reg;
+				e_addr <= d_addr;
+				e_io_data <= data_mem_data_in;
+				e_vector <= irq_vector;
+			end if;
+			-- not related to actual CPU functionality so no need to depend on clk_ena
+			scan_reg <= scan_reg_next;
+		end if;
+	end process;
+
+	-- Not reset, it's only read back after something has been pushed
+	process (clk)
+	begin
+		if (clk'event and clk = '1') then
+			if (clk_ena = '1' and bank_push = '1') then
+				bank_stack(conv_integer(bank_sp_reg)) <= bank_reg;
+			end if;
+		end if;
+	end process;
+
+	alu : entity work.alu port map (
+		op => alu_op,
+		src1 => e_src1,
+		src2 => e_src2,
+		result => alu_result,
+		carry_in => carry,
+		carry_out => alu_carry_out,
+		zero => alu_zero,
+		negative => alu_negative
+	);
+
+	interrupts_enabled <= sr_reg(4);
+	halted <= sr_reg(3);
+	carry <= sr_reg(2);
+	negative <= sr_reg(1);
+	zero <= sr_reg(0);
+
+	halt <= halted and not interrupts_enabled;
+
+	-- D stage decoding, see shitty_risc for the encodings
+	d_instruction <= pgm_mem_data_in;
+	d_op <= d_instruction(15 downto 12);
+	d_dst_select <= d_instruction(9 downto 8);
+	d_src2_select <= d_instruction(5 downto 4);
+	-- CPYDATA increments its target through the ALU's first operand
+	d_src1_select <= d_dst_select when d_op = "0110" else d_instruction(7 downto 6);
+	-- IN and OUT
+	d_io <= '1' when d_op(2 downto 1) = "01" and d_op(3) = '1' else '0';
+	-- LDI/STI/IN/OUT through a register and CPYDATA
+	d_uses_addr_reg <= '1' when (d_op(2 downto 1) = "01" and d_instruction(11) = '1') or d_op = "0110" else '0';
+	d_addr_select <= d_dst_select when d_op = "0110" else d_instruction(7 downto 6);
+
+	d_src1 <= forward(d_src1_select, registers, reg_wr_ena, reg_dst_select, reg_dst_in, reg_src1_wr_ena, e_src1_select, alu_result);
+	d_src2 <= forward(d_src2_select, registers, reg_wr_ena, reg_dst_select, reg_dst_in, reg_src1_wr_ena, e_src1_select, alu_result);
+	d_dst <= forward(d_dst_select, registers, reg_wr_ena, reg_dst_select, reg_dst_in, reg_src1_wr_ena, e_src1_select, alu_result);
+
+	-- The address goes straight from the register file to the data memory, so
+	-- there's no forwarding for it. IN and OUT would take the data input away
+	-- from a load in E.
+	e_writes_addr_reg <= '1' when (reg_wr_ena = '1' and reg_dst_select = d_addr_select) or
+										 (reg_src1_wr_ena = '1' and e_src1_select = d_addr_select) else '0';
+	d_stall <= ((d_uses_addr_reg and e_writes_addr_reg) or (d_io and e_reads_mem)) and not irq_taken;
+
+	-- Interrupts are taken between instructions with the flags E leaves. An
+	-- interrupt entry replaces the instruction in D, it's executed again after RETI.
+	irq_taken <= irq and interrupts_enabled_next and not redirect;
+	d_advance <= not (redirect or d_stall);
+
+	process (d_op, d_instruction, d_pc, d_dst, sp_reg, registers, d_addr_select,
+				irq_taken, halted_next, d_advance, d_io)
+	begin
+		sp_next <= sp_reg;
+		d_mem_write <= '0';
+		d_write_data <= d_dst(7 downto 0);		-- ST, OUT and PUSH
+		if (d_instruction(11) = '1') then
+			d_addr <= registers(conv_integer(d_addr_select))(7 downto 0);
+		else
+			d_addr <= d_instruction(7 downto 0);
+		end if;
+		io_select <= '1';
+
+		if (irq_taken = '1') then
+			-- same push as BSR, or the address after the HALT that was waiting
+			d_addr <= sp_reg;
+			d_mem_write <= '1';
+			sp_next <= sp_reg - 1;
+			if (halted_next = '1') then
+				d_write_data <= d_pc(7 downto 0) + 1;
+			else
+				d_write_data <= d_pc(7 downto 0);
+			end if;
+		elsif (d_advance = '1') then
+			io_select <= not d_io;
+			case d_op is
+				when "0011" | "1011" =>		-- ST/STI/OUT
+					d_mem_write <= '1';
+
+				when "0111" | "1101" =>		-- BSR & FBSR push whether the branch is taken or not
+					d_addr <= sp_reg;
+					d_mem_write <= '1';
+					sp_next <= sp_reg - 1;
+					d_write_data <= d_pc(7 downto 0) + 1;
+
+				when "1000" =>		-- RET, RETI & FRET
+					d_addr <= sp_reg + 1;
+					sp_next <= sp_reg + 1;
+
+				when "1001" =>		-- PUSH & POP
+					if (d_instruction(11) = '0') then
+						d_addr <= sp_reg;
+						d_mem_write <= '1';
+						sp_next <= sp_reg - 1;
+					else
+						d_addr <= sp_reg + 1;
+						sp_next <= sp_reg + 1;
+					end if;
+
+				when "0110" =>		-- CPYDATA
+					d_addr <= registers(conv_integer(d_addr_select))(7 downto 0);
+					d_mem_write <= '1';
+					d_write_data <= d_instruction(7 downto 0);
+
+				when others =>
+			end case;
+		end if;
+	end process;
+
+	-- The next instruction, a stalled one again or the target E branches to
+	fetch_addr <= bank_next & redirect_pc when redirect = '1' else
+					  d_pc when d_stall = '1' else
+					  d_pc(10 downto 8) & (d_pc(7 downto 0) + 1);
+
+	-- The program memory has a registered address, the instruction for D is
+	-- ready right after the edge. Between enabled clocks the data memory keeps
+	-- the address of the access E is using.
+	pgm_mem_addr <= fetch_addr when clk_ena = '1' else d_pc;
+	data_mem_addr <= d_addr when clk_ena = '1' else e_addr;
+	data_mem_data_out <= d_write_data;
+	data_mem_wr_ena <= clk_ena and d_mem_write;
+	mem_io_select <= io_select;
+
+	-- E stage
+	op <= e_instruction(15 downto 12);
+	reg_dst_select <= e_instruction(9 downto 8);
+	jump_target <= e_src1(7 downto 0) when e_instruction(11) = '1' else e_instruction(7 downto 0);
+	e_reads_mem <= '1' when e_valid = '1' and e_irq = '0' and
+							(op = "0010" or op = "1000" or (op = "1001" and e_instruction(11) = '1')) else '0';
+
+	process (e_valid, e_irq, e_instruction, op, e_pc, e_src1, e_dst, e_io_data, e_vector, jump_target,
+				alu_result, alu_zero, alu_negative, alu_carry_out, data_mem_data_in,
+				movi_high_byte, ld_high_byte, in_high_byte, carry, negative, zero, halted, interrupts_enabled,
+				saved_flags_reg, bank_reg, bank_sp_reg, bank_stack)
+		variable taken : std_logic;
+	begin
+		bank_next <= bank_reg;
+		bank_sp_next <= bank_sp_reg;
+		bank_push <= '0';
+		interrupts_enabled_next <= interrupts_enabled;
+		saved_flags_next <= saved_flags_reg;
+		halted_next <= halted;
+		carry_next <= carry;
+		negative_next <= negative;
+		zero_next <= zero;
+		reg_wr_ena <= '0';
+		reg_src1_wr_ena <= '0';
+		reg_dst_in <= (others => 'X');
+		alu_op <= e_instruction(3 downto 0);
+		redirect <= '0';
+		branch_taken <= '0';
+		redirect_pc <= jump_target;
+
+		for i in 0 to 7 loop
+			movi_high_byte(i) <= e_instruction(7);
+			ld_high_byte(i) <= data_mem_data_in(7);
+			in_high_byte(i) <= e_io_data(7);
+		end loop;
+
+		if (e_valid = '0') then
+			-- bubble
+		elsif (e_irq = '1') then
+			redirect <= '1';
+			redirect_pc <= e_vector;
+			bank_push <= '1';
+			bank_sp_next <= bank_sp_reg + 1;
+			bank_next <= "000";
+			halted_next <= '0';
+			interrupts_enabled_next <= '0';
+			saved_flags_next <= carry & negative & zero;
+		else
+		if (op(2 downto 1) = "01" and e_instruction(11) = '1') then
+			case e_instruction(1 downto 0) is
+				when "01" =>
+					alu_op <= "1100";
+					reg_src1_wr_ena <= '1';
+				when "10" =>
+					alu_op <= "1011";
+					reg_src1_wr_ena <= '1';
+				when others =>
+			end case;
+		end if;
+
+		case op is
+			when "0001" =>		-- MOVI
+				reg_wr_ena <= '1';
+				if (e_instruction(10) = '1') then
+					reg_dst_in <= movi_high_byte & e_instruction(7 downto 0);
+				else
+					reg_dst_in <= e_dst(15 downto 8) & e_instruction(7 downto 0);
+				end if;
+
+			when "0100" =>		-- alu op, CMP and TST only update the flags
+				reg_wr_ena <= not e_instruction(11);
+				reg_dst_in <= alu_result;
+				zero_next <= alu_zero;
+				negative_next <= alu_negative;
+				carry_next <= alu_carry_out;
+
+			when "0010" =>		-- LD/LDI
+				reg_wr_ena <= '1';
+				if (e_instruction(10) = '1') then
+					reg_dst_in <= ld_high_byte & data_mem_data_in;
+				else
+					reg_dst_in <= e_dst(15 downto 8) & data_mem_data_in;
+				end if;
+
+			when "1010" =>		-- IN, read at the end of D
+				reg_wr_ena <= '1';
+				if (e_instruction(10) = '1') then
+					reg_dst_in <= in_high_byte & e_io_data;
+				else
+					reg_dst_in <= e_dst(15 downto 8) & e_io_data;
+				end if;
+
+			when "0101" | "0111" =>		-- branches and branches to subroutine
+				case e_instruction(9 downto 8) is
+					when "00" =>
+						taken := zero;
+					when "01" =>
+						taken := not zero;
+					when "10" =>
+						taken := '1';
+					when others =>
+						taken := '0';
+				end case;
+				redirect <= taken;
+				branch_taken <= taken;
+
+			when "1000" =>		-- RET, RETI & FRET
+				redirect <= '1';
+				branch_taken <= '1';
+				redirect_pc <= data_mem_data_in;
+				if (e_instruction(11) = '1' or e_instruction(10) = '1') then
+					bank_sp_next <= bank_sp_reg - 1;
+					bank_next <= bank_stack(conv_integer(bank_sp_reg - 1));
+				end if;
+				if (e_instruction(11) = '1') then
+					interrupts_enabled_next <= '1';
+					carry_next <= saved_flags_reg(2);
+					negative_next <= saved_flags_reg(1);
+					zero_next <= saved_flags_reg(0);
+				end if;
+
+			when "1001" =>		-- POP, PUSH was done in D
+				if (e_instruction(11) = '1') then
+					reg_wr_ena <= '1';
+					reg_dst_in <= e_dst(15 downto 8) & data_mem_data_in;
+				end if;
+
+			when "0110" =>		-- CPYDATA, the write was done in D
+				alu_op <= "1100";
+				reg_wr_ena <= '1';
+				reg_dst_in <= alu_result;
+
+			when "1100" =>		-- EI & DI
+				interrupts_enabled_next <= e_instruction(0);
+
+			when "1101" =>		-- FBSR
+				redirect <= '1';
+				branch_taken <= '1';
+				redirect_pc <= e_instruction(7 downto 0);
+				bank_push <= '1';
+				bank_sp_next <= bank_sp_reg + 1;
+				bank_next <= e_instruction(10 downto 8);
+
+			when "1111" =>		-- HALT, fetched again until an interrupt
+				redirect <= '1';
+				redirect_pc <= e_pc(7 downto 0);
+				halted_next <= '1';
+
+			when others =>
+		end case;
+		end if;
+	end process;
+
+	sr_next <= "000" & interrupts_enabled_next & halted_next & carry_next & negative_next & zero_next;
+
+	trace_valid <= e_valid;
+	trace_pc <= e_pc;
+	trace_ir <= e_instruction;
+	trace_halted <= halted or not e_valid;
+	trace_irq_taken <= e_valid and e_irq;
+	perf_retired <= e_valid and not (e_irq or halted);
+	perf_halted <= not e_valid or (halted and not e_irq);
+	perf_branch_taken <= branch_taken;
+	perf_mem_read <= e_reads_mem;
+	perf_mem_write <= d_mem_write and io_select;
+
+	-- scan logic
+	scan_pc <= e_pc when e_valid = '1' else d_pc;
+	scan_instruction <= e_instruction when e_valid = '1' else d_instruction;
+	scan_sp <= e_sp when e_valid = '1' else sp_reg;
+
+	process (scan_reg, scan_enable, scan_input, scan_reset, registers, scan_pc, scan_instruction, scan_sp, sr_reg)
+	begin
+		if (scan_reset = '1') then
+			scan_reg_next <= registers(3) & registers(2) & registers(1) & registers(0) &
+								  "00000" & scan_pc(10 downto 8) & scan_instruction & sr_reg & scan_pc(7 downto 0) & scan_sp;
+		elsif (scan_enable = '1') then
+			scan_reg_next <= scan_input & scan_reg(scan_length - 1 downto 1);
+		else
+			scan_reg_next <= scan_reg;
+		end if;
+	end process;
+
+	scan_output <= scan_reg(0);
+
+end Behavioral;
@@ -28,7 +28,19 @@ use IEEE.STD_LOGIC_ARITH.ALL;
 use IEEE.STD_LOGIC_UNSIGNED.ALL;
 
 
-entity shitty_risc_top_ep1 is Port (
+-- pipelined selects shitty_risc_pipelined, which runs at every clock, over
+-- the single cycle core that needs a clock divider of at least 2.
+--
+-- cores (1-4) instantiates that many CPUs, each with its own program and data
+-- RAM booting the same image. They share the I/O bus through a round robin
+-- arbiter, a core doing IN or OUT waits until it gets the bus. Only core 0
+-- gets interrupts and the performance counters count its events. The
+-- debugger's command 09 selects the core that is stepped, scanned, loaded and
+-- traced, running and stopping applies to all of them.
+entity shitty_risc_top_ep1 is generic (
+	pipelined : boolean := false;
+	cores : positive range 1 to 4 := 1
+); Port (
 	clk_50 : in std_logic;
 	uart_rxd : in std_logic;
 	uart_txd : out std_logic;
@@ -47,38 +59,45 @@ end shitty_risc_top_ep1;
 
 architecture Behavioral of shitty_risc_top_ep1 is
 
-signal pgm_ram_data_in : std_logic_vector(15 downto 0);
-signal pgm_ram_data_out : std_logic_vector(15 downto 0);
-signal pgm_ram_addr : std_logic_vector(7 downto 0);
-signal pgm_ram_wren : std_logic;
+type word_array is array (0 to cores - 1) of std_logic_vector(15 downto 0);
+type pgm_addr_array is array (0 to cores - 1) of std_logic_vector(10 downto 0);
+type byte_array is array (0 to cores - 1) of std_logic_vector(7 downto 0);
+
+-- per core memories and CPU ports
+signal pgm_ram_data_out : word_array;
+signal pgm_ram_addr : pgm_addr_array;
+signal pgm_ram_wren : std_logic_vector(cores - 1 downto 0);
 
-signal data_ram_addr : std_logic_vector(7 downto 0);
-signal data_ram_data_in : std_logic_vector(7 downto 0);
-signal data_ram_data_out : std_logic_vector(7 downto 0);
-signal data_ram_wren : std_logic;
+signal data_ram_addr, data_ram_data_in, data_ram_data_out : byte_array;
+signal data_ram_wren : std_logic_vector(cores - 1 downto 0);
+
+signal cpu_pgm_ram_addr : pgm_addr_array;
+signal cpu_data_ram_data_in, cpu_data_ram_data_out, cpu_data_ram_addr : byte_array;
+signal cpu_data_ram_wren, cpu_mem_io_select, cpu_clk_ena, cpu_irq, cpu_debug_output : std_logic_vector(cores - 1 downto 0);
 
 signal debugger_pgm_ram_data_out : std_logic_vector(15 downto 0);
-signal debugger_pgm_ram_addr : std_logic_vector(7 downto 0);
+signal debugger_pgm_ram_addr : std_logic_vector(10 downto 0);
 signal debugger_pgm_ram_wren : std_logic;
 signal debugger_data_ram_addr : std_logic_vector(7 downto 0);
 signal debugger_data_ram_data_in : std_logic_vector(7 downto 0);
 signal debugger_data_ram_data_out : std_logic_vector(7 downto 0);
 signal debugger_data_ram_wren : std_logic;
 
-signal cpu_pgm_ram_data_in : std_logic_vector(15 downto 0);
-signal cpu_pgm_ram_addr : std_logic_vector(7 downto 0);
-signal cpu_data_ram_data_in : std_logic_vector(7 downto 0);
-signal cpu_data_ram_data_out : std_logic_vector(7 downto 0);
-signal cpu_data_ram_addr : std_logic_vector(7 downto 0);
-signal cpu_data_ram_wren : std_logic;
-signal cpu_mem_io_select : std_logic;
-
 signal debugger_mem_access : std_logic;
 signal debugger_cpu_clk_ena : std_logic;
 signal debugger_cpu_reset : std_logic;
 signal debugger_scan_reset : std_logic;
 signal debugger_scan_enable : std_logic;
 signal debugger_leds, debugger_7seg : std_logic_vector(3 downto 0);
+signal debugger_core_select : std_logic_vector(1 downto 0);
+signal debugger_core_step : std_logic;
+signal selected_core : integer range 0 to cores - 1;
+
+-- the shared I/O bus, driven by the core the arbiter granted it to
+signal core_enabled, io_request, io_grant : std_logic_vector(cores - 1 downto 0);
+signal io_grant_index : std_logic_vector(1 downto 0);
+signal io_granted : std_logic;
+signal io_addr, io_data_out, io_data_in : std_logic_vector(7 downto 0);
 
 signal display_device_address : std_logic_vector(2 downto 0);
 signal display_device_data : std_logic_vector(7 downto 0);
@@ -88,8 +107,7 @@ signal display_device_select : std_logic;
 signal beeper_data : std_logic_vector(7 downto 0);
 signal beeper_wr_ena, beeper_output, beeper_select : std_logic;
 
-signal cpu_debug_output : std_logic;
-signal io_write : std_logic;
+signal io_write, io_read : std_logic;
 
 signal reset : std_logic;
 
@@ -98,9 +116,39 @@ signal terminal_scan_input : std_logic;
 signal lcdctrl_data_in, lcdctrl_data_out : std_logic_vector(7 downto 0);
 signal lcdctrl_write_strobe, lcdctrl_rs, lcdctrl_ready_read : std_logic;
 signal lcdctrl_select : std_logic;	-- chip select
+signal lcdctrl_ready : std_logic;
+
+signal irqctl_select, irqctl_wr_ena, irqctl_irq : std_logic;
+signal irqctl_data_out, cpu_irq_vector : std_logic_vector(7 downto 0);
+signal debugger_host_data : std_logic_vector(7 downto 0);
+signal debugger_host_data_strobe : std_logic;
+
+signal mailbox_select, mailbox_wr_ena, mailbox_rd_ena : std_logic;
+signal mailbox_data_out : std_logic_vector(7 downto 0);
+
+signal cpu_trace_pc : pgm_addr_array;
+signal cpu_trace_ir : word_array;
+signal cpu_trace_halted, cpu_trace_irq_taken, trace_mem_write, trace_io_write : std_logic_vector(cores - 1 downto 0);
+signal trace_write_addr, trace_write_data : byte_array;
+
+signal perf_select, perf_wr_ena, perf_scan_output : std_logic;
+signal perf_data_out : std_logic_vector(7 downto 0);
+signal cpu_perf_retired, cpu_perf_branch_taken, cpu_perf_mem_read, cpu_perf_mem_write, cpu_perf_halted : std_logic_vector(cores - 1 downto 0);
+signal perf_clk_ena, perf_waiting : std_logic;
+
+function clock_divider_limit(pipelined : boolean) return positive is
+begin
+	if (pipelined) then
+		return 1;
+	end if;
+	return 2;
+end function;
 
 begin
-	debugger : entity work.debugger port map (
+	debugger : entity work.debugger generic map (
+		min_clock_divider => clock_divider_limit(pipelined),
+		cores => cores
+	) port map (
 		clk_50 => clk_50,
 		reset => reset,
 		serial_rx => uart_rxd,
@@ -115,81 +163,197 @@ begin
 		data_mem_wren => debugger_data_ram_wren,
 		cpu_reset => debugger_cpu_reset,
 		cpu_clk_ena => debugger_cpu_clk_ena,
+		core_select => debugger_core_select,
+		core_step => debugger_core_step,
 		debug_scan_reset => debugger_scan_reset,
-		debug_scan_input => cpu_debug_output,
-		debug_scan_enable => debugger_scan_enable
+		debug_scan_input => cpu_debug_output(selected_core),
+		debug_scan_enable => debugger_scan_enable,
+		host_data => debugger_host_data,
+		host_data_strobe => debugger_host_data_strobe,
+		trace_pc => cpu_trace_pc(selected_core),
+		trace_halted => cpu_trace_halted(selected_core),
+		trace_ir => cpu_trace_ir(selected_core),
+		trace_irq_taken => cpu_trace_irq_taken(selected_core),
+		trace_mem_write => trace_mem_write(selected_core),
+		trace_io_write => trace_io_write(selected_core),
+		trace_write_addr => trace_write_addr(selected_core),
+		trace_write_data => trace_write_data(selected_core)
 	);
 
 	terminal_scan_input <= '0';
-	
-	cpu : entity work.shitty_risc port map (
+	selected_core <= conv_integer(debugger_core_select);
+	debugger_data_ram_data_in <= data_ram_data_out(selected_core);
+
+	cpus : for i in 0 to cores - 1 generate
+		-- every core gets the perf counters at the start of its scan chain
+		single_cycle_core : if not pipelined generate
+			cpu : entity work.shitty_risc port map (
+				clk => clk_50,
+				clk_ena => cpu_clk_ena(i),
+				reset => reset,
+				scan_input => perf_scan_output,
+				scan_output => cpu_debug_output(i),
+				scan_reset => debugger_scan_reset,
+				scan_enable => debugger_scan_enable,
+				pgm_mem_addr => cpu_pgm_ram_addr(i),
+				pgm_mem_data_in => pgm_ram_data_out(i),
+				data_mem_addr => cpu_data_ram_addr(i),
+				data_mem_data_out => cpu_data_ram_data_out(i),
+				data_mem_data_in => cpu_data_ram_data_in(i),
+				data_mem_wr_ena => cpu_data_ram_wren(i),
+				mem_io_select => cpu_mem_io_select(i),
+				irq => cpu_irq(i),
+				irq_vector => cpu_irq_vector,
+				trace_valid => open,
+				trace_pc => cpu_trace_pc(i),
+				trace_ir => cpu_trace_ir(i),
+				trace_halted => cpu_trace_halted(i),
+				trace_irq_taken => cpu_trace_irq_taken(i),
+				perf_retired => cpu_perf_retired(i),
+				perf_branch_taken => cpu_perf_branch_taken(i),
+				perf_mem_read => cpu_perf_mem_read(i),
+				perf_mem_write => cpu_perf_mem_write(i),
+				perf_halted => cpu_perf_halted(i)
+			);
+
+			trace_mem_write(i) <= cpu_data_ram_wren(i) and cpu_mem_io_select(i);
+			trace_io_write(i) <= cpu_data_ram_wren(i) and not cpu_mem_io_select(i);
+			trace_write_addr(i) <= cpu_data_ram_addr(i);
+			trace_write_data(i) <= cpu_data_ram_data_out(i);
+		end generate;
+
+		pipelined_core : if pipelined generate
+			cpu : entity work.shitty_risc_pipelined port map (
+				clk => clk_50,
+				clk_ena => cpu_clk_ena(i),
+				reset => reset,
+				scan_input => perf_scan_output,
+				scan_output => cpu_debug_output(i),
+				scan_reset => debugger_scan_reset,
+				scan_enable => debugger_scan_enable,
+				pgm_mem_addr => cpu_pgm_ram_addr(i),
+				pgm_mem_data_in => pgm_ram_data_out(i),
+				data_mem_addr => cpu_data_ram_addr(i),
+				data_mem_data_out => cpu_data_ram_data_out(i),
+				data_mem_data_in => cpu_data_ram_data_in(i),
+				data_mem_wr_ena => cpu_data_ram_wren(i),
+				mem_io_select => cpu_mem_io_select(i),
+				irq => cpu_irq(i),
+				irq_vector => cpu_irq_vector,
+				trace_valid => open,
+				trace_pc => cpu_trace_pc(i),
+				trace_ir => cpu_trace_ir(i),
+				trace_halted => cpu_trace_halted(i),
+				trace_irq_taken => cpu_trace_irq_taken(i),
+				perf_retired => cpu_perf_retired(i),
+				perf_branch_taken => cpu_perf_branch_taken(i),
+				perf_mem_read => cpu_perf_mem_read(i),
+				perf_mem_write => cpu_perf_mem_write(i),
+				perf_halted => cpu_perf_halted(i)
+			);
+
+			-- The pipelined core writes a clock before the instruction completes,
+			-- delay the writes so the trace buffer records them with it
+			process (clk_50)
+			begin
+				if (clk_50'event and clk_50 = '1') then
+					if (cpu_clk_ena(i) = '1') then
+						trace_mem_write(i) <= cpu_data_ram_wren(i) and cpu_mem_io_select(i);
+						trace_io_write(i) <= cpu_data_ram_wren(i) and not cpu_mem_io_select(i);
+						trace_write_addr(i) <= cpu_data_ram_addr(i);
+						trace_write_data(i) <= cpu_data_ram_data_out(i);
+					end if;
+				end if;
+			end process;
+		end generate;
+
+		pgm_mem : entity work.ep1_pgmram port map (
+			address => pgm_ram_addr(i),
+			clock => clk_50,
+			wren => pgm_ram_wren(i),
+			data => debugger_pgm_ram_data_out,
+			q => pgm_ram_data_out(i)
+		);
+
+		data_mem : entity work.ep1_dataram port map (
+			address => data_ram_addr(i),
+			clock => clk_50,
+			wren => data_ram_wren(i),
+			q => data_ram_data_out(i),
+			data => data_ram_data_in(i)
+		);
+
+		-- The debugger accesses the memories of the selected core, CPU can't write program mem
+		pgm_ram_addr(i) <= debugger_pgm_ram_addr when debugger_mem_access = '1' and selected_core = i else cpu_pgm_ram_addr(i);
+		pgm_ram_wren(i) <= debugger_pgm_ram_wren when debugger_mem_access = '1' and selected_core = i else '0';
+		data_ram_addr(i) <= debugger_data_ram_addr when debugger_mem_access = '1' and selected_core = i else cpu_data_ram_addr(i);
+		data_ram_wren(i) <= debugger_data_ram_wren when debugger_mem_access = '1' and selected_core = i else
+								  (cpu_data_ram_wren(i) and cpu_mem_io_select(i));
+		data_ram_data_in(i) <= debugger_data_ram_data_out when debugger_mem_access = '1' and selected_core = i else cpu_data_ram_data_out(i);
+
+		-- A debugger step only clocks the selected core. One waiting for the I/O
+		-- bus doesn't get the clock enable until it's granted.
+		core_enabled(i) <= '1' when debugger_core_step = '0' or selected_core = i else '0';
+		io_request(i) <= core_enabled(i) and not cpu_mem_io_select(i);
+		cpu_clk_ena(i) <= debugger_cpu_clk_ena and core_enabled(i) and (io_grant(i) or not io_request(i));
+
+		cpu_data_ram_data_in(i) <= data_ram_data_out(i) when cpu_mem_io_select(i) = '1' else io_data_in;
+
+		-- only core 0 takes interrupts
+		cpu_irq(i) <= irqctl_irq when i = 0 else '0';
+	end generate;
+
+	io_arbiter : entity work.io_arbiter generic map (
+		cores => cores
+	) port map (
 		clk => clk_50,
-		clk_ena => debugger_cpu_clk_ena,
 		reset => reset,
-		scan_input => terminal_scan_input,
-		scan_output => cpu_debug_output,
-		scan_reset => debugger_scan_reset,
-		scan_enable => debugger_scan_enable,
-		pgm_mem_addr => cpu_pgm_ram_addr,
-		pgm_mem_data_in => cpu_pgm_ram_data_in,
-		data_mem_addr => cpu_data_ram_addr,
-		data_mem_data_out => cpu_data_ram_data_out,
-		data_mem_data_in => cpu_data_ram_data_in,
-		data_mem_wr_ena => cpu_data_ram_wren,
-		mem_io_select => cpu_mem_io_select
+		clk_ena => debugger_cpu_clk_ena,
+		request => io_request,
+		grant => io_grant,
+		grant_index => io_grant_index,
+		granted => io_granted
 	);
-		
-	pgm_ram_addr <= debugger_pgm_ram_addr when debugger_mem_access = '1' else cpu_pgm_ram_addr;
-	pgm_ram_data_in <= debugger_pgm_ram_data_out;
-	cpu_pgm_ram_data_in <= pgm_ram_data_out;
-	pgm_ram_wren <= debugger_pgm_ram_wren when debugger_mem_access = '1' else '0';		-- CPU can't write program mem
-	
-	data_ram_addr <= debugger_data_ram_addr when debugger_mem_access = '1' else cpu_data_ram_addr;
-	data_ram_wren <= debugger_data_ram_wren when debugger_mem_access = '1' else (cpu_data_ram_wren and cpu_mem_io_select);
-	debugger_data_ram_data_in <= data_ram_data_out;
-	data_ram_data_in <= debugger_data_ram_data_out when debugger_mem_access = '1' else cpu_data_ram_data_out;
+
+	io_addr <= cpu_data_ram_addr(conv_integer(io_grant_index));
+	io_data_out <= cpu_data_ram_data_out(conv_integer(io_grant_index));
 
 	-- Allocating each 'device' 4 bits of address space, should be enough...
 	-- Anding with cpu_clk_ena because the cpu outputs glitch 
-	io_write <= '1' when (cpu_mem_io_select = '0' and cpu_data_ram_wren = '1' and debugger_cpu_clk_ena = '1') else '0';
+	io_write <= io_granted and cpu_data_ram_wren(conv_integer(io_grant_index)) and debugger_cpu_clk_ena;
+	io_read <= io_granted and not cpu_data_ram_wren(conv_integer(io_grant_index)) and debugger_cpu_clk_ena;
 	
-	display_device_select <= '1' when cpu_data_ram_addr(7 downto 4) = "0000" else '0';
-	beeper_select <= '1' when cpu_data_ram_addr(7 downto 4) = "0001" else '0';
-	lcdctrl_select <= '1' when cpu_data_ram_addr(7 downto 4) = "0010" else '0';
+	display_device_select <= '1' when io_addr(7 downto 4) = "0000" else '0';
+	beeper_select <= '1' when io_addr(7 downto 4) = "0001" else '0';
+	lcdctrl_select <= '1' when io_addr(7 downto 4) = "0010" else '0';
+	irqctl_select <= '1' when io_addr(7 downto 4) = "0011" else '0';
+	perf_select <= '1' when io_addr(7 downto 5) = "010" else '0';		-- $40-$5f
+	mailbox_select <= '1' when io_addr(7 downto 4) = "0110" else '0';
 	
 	display_device_wr_ena <= display_device_select and io_write;	
 	beeper_wr_ena <= beeper_select and io_write;
 	lcdctrl_write_strobe <= lcdctrl_select and io_write;
-	lcdctrl_rs <= cpu_data_ram_addr(0);		-- 0x20 register write, 0x21 lcd ram write
-	lcdctrl_data_in <= cpu_data_ram_data_out;
+	irqctl_wr_ena <= irqctl_select and io_write;
+	perf_wr_ena <= perf_select and io_write;
+	mailbox_wr_ena <= mailbox_select and io_write;
+	mailbox_rd_ena <= mailbox_select and io_read;
+	lcdctrl_rs <= io_addr(0);		-- 0x20 register write, 0x21 lcd ram write
+	lcdctrl_data_in <= io_data_out;
 	
-	-- Muxing ram, device and device outputs to cpu data input
-	process (cpu_mem_io_select, cpu_data_ram_addr, display_device_select, beeper_select,
-				data_ram_data_out)
+	-- Muxing device outputs to the cpu data input
+	process (io_addr, irqctl_select, irqctl_data_out, perf_select, perf_data_out, mailbox_select, mailbox_data_out)
 	begin
-		cpu_data_ram_data_in <= data_ram_data_out;
-
-		if (cpu_mem_io_select = '0') then
-			cpu_data_ram_data_in <= (others => '0');	
+		io_data_in <= (others => '0');	
+		if (irqctl_select = '1') then
+			io_data_in <= irqctl_data_out;
+		end if;
+		if (perf_select = '1') then
+			io_data_in <= perf_data_out;
+		end if;
+		if (mailbox_select = '1') then
+			io_data_in <= mailbox_data_out;
 		end if;
-
 	end process;
-	
-	pgm_mem : entity work.ep1_pgmram port map (
-		address => pgm_ram_addr,
-		clock => clk_50,
-		wren => pgm_ram_wren,
-		data => pgm_ram_data_in,
-		q => pgm_ram_data_out
-	);
-
-	data_mem : entity work.ep1_dataram port map (
-		address => data_ram_addr,
-		clock => clk_50,
-		wren => data_ram_wren,
-		q => data_ram_data_out,
-		data => data_ram_data_in
-	);
 
 	beeper_device : entity work.beeper_device port map (
 		clk => clk_50,
@@ -200,7 +364,7 @@ begin
 	);
 	
 	buzz <= beeper_output;
-	beeper_data <= cpu_data_ram_data_out;
+	beeper_data <= io_data_out;
 	
 	display_device : entity work.display_device port map (
 		clk => clk_50,
@@ -223,12 +387,64 @@ begin
 		register_select => lcdctrl_rs,
 		lcd_en => hd44780_en,
 		lcd_rs => hd44780_rs,
-		lcd_do => lcdctrl_data_out
+		lcd_do => lcdctrl_data_out,
+		ready => lcdctrl_ready
+	);
+
+	interrupt_controller : entity work.interrupt_controller port map (
+		clk => clk_50,
+		reset => reset,
+		clk_ena => debugger_cpu_clk_ena,
+		address => io_addr(3 downto 0),
+		data_in => io_data_out,
+		data_out => irqctl_data_out,
+		wr_ena => irqctl_wr_ena,
+		lcd_ready => lcdctrl_ready,
+		host_data => debugger_host_data,
+		host_data_strobe => debugger_host_data_strobe,
+		irq => irqctl_irq,
+		vector => cpu_irq_vector
+	);
+
+	mailbox_device : entity work.mailbox_device generic map (
+		cores => cores
+	) port map (
+		clk => clk_50,
+		reset => reset,
+		address => io_addr(3 downto 0),
+		data_in => io_data_out,
+		data_out => mailbox_data_out,
+		wr_ena => mailbox_wr_ena,
+		rd_ena => mailbox_rd_ena,
+		core => io_grant_index
 	);
 	
-	display_device_address <= cpu_data_ram_addr(2 downto 0);
-	display_device_data <= cpu_data_ram_data_out;
+	-- Core 0's events, the cycles it waits for the I/O bus count as halted
+	perf_clk_ena <= debugger_cpu_clk_ena and core_enabled(0);
+	perf_waiting <= io_request(0) and not io_grant(0);
+
+	-- first in the scan chain, so the counters come out after the registers
+	perf_counters : entity work.perf_counters port map (
+		clk => clk_50,
+		reset => reset,
+		clk_ena => perf_clk_ena,
+		address => io_addr(4 downto 0),
+		data_in => io_data_out,
+		data_out => perf_data_out,
+		wr_ena => perf_wr_ena,
+		retired => cpu_perf_retired(0) and not perf_waiting,
+		branch_taken => cpu_perf_branch_taken(0) and not perf_waiting,
+		mem_read => cpu_perf_mem_read(0) and not perf_waiting,
+		mem_write => cpu_perf_mem_write(0) and not perf_waiting,
+		halted => cpu_perf_halted(0) or perf_waiting,
+		scan_reset => debugger_scan_reset,
+		scan_input => terminal_scan_input,
+		scan_output => perf_scan_output,
+		scan_enable => debugger_scan_enable
+	);
+
+	display_device_address <= io_addr(2 downto 0);
+	display_device_data <= io_data_out;
 	reset <= not btn(3) or debugger_cpu_reset;
     
 end Behavioral;
-
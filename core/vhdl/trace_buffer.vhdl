@@ -0,0 +1,258 @@
+-- Copyright (c) 2014, Juha Turunen
+-- All rights reserved.
+--
+-- Redistribution and use in source and binary forms, with or without
+-- modification, are permitted provided that the following conditions are met: 
+--
+-- 1. Redistributions of source code must retain the above copyright notice, this
+--    list of conditions and the following disclaimer. 
+-- 2. Redistributions in binary form must reproduce the above copyright notice,
+--    this list of conditions and the following disclaimer in the documentation
+--    and/or other materials provided with the distribution. 
+--
+-- THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+-- ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+-- WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+-- DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+-- ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+-- (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+-- LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+-- ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+-- (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+-- SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+
+
+
+-- Execution trace for the debugger. Records an entry for every instruction the
+-- CPU executes into a block RAM ring buffer, so the last 2^depth_bits
+-- instructions before a failure can be looked at without stepping. Entries:
+--   31     interrupt entry, it replaced the recorded instruction
+--   30     data memory write
+--   29     I/O write
+--   26..16 bank & PC
+--   15..0  IR, or the write address & value when record_writes is set
+-- The dump is a header word followed by the entries oldest first, every word
+-- little endian. The header has the entry count in bits 15..0, the flags in
+-- 23..16 (0 = writes recorded, 1 = triggered, 2 = wrapped) and depth_bits in 31..24.
+-- A HALT is recorded once, the core executing it again while halted isn't, so
+-- the history before it doesn't get flushed out.
+
+library IEEE;
+use IEEE.STD_LOGIC_1164.ALL;
+use IEEE.STD_LOGIC_ARITH.ALL;
+use IEEE.STD_LOGIC_UNSIGNED.ALL;
+
+
+entity trace_buffer is generic (
+	depth_bits : positive := 9
+); port (
+	clk : in std_logic;
+	reset : in std_logic;
+	
+	-- start clears the buffer and starts recording, stop keeps the contents
+	control_strobe : in std_logic;
+	start : in std_logic;
+	record_writes : in std_logic;
+	trigger_enable : in std_logic;		-- stop recording after the instruction at trigger_addr
+	trigger_addr : in std_logic_vector(10 downto 0);
+	
+	dump_strobe : in std_logic;
+	busy : out std_logic;
+	
+	-- sampled on the enabled CPU clock
+	cpu_clk_ena : in std_logic;
+	cpu_pc : in std_logic_vector(10 downto 0);
+	cpu_halted : in std_logic;
+	cpu_ir : in std_logic_vector(15 downto 0);
+	cpu_irq_taken : in std_logic;
+	cpu_mem_write : in std_logic;
+	cpu_io_write : in std_logic;
+	cpu_write_addr : in std_logic_vector(7 downto 0);
+	cpu_write_data : in std_logic_vector(7 downto 0);
+	
+	tx_data : out std_logic_vector(7 downto 0);
+	tx_strobe : out std_logic;
+	tx_idle : in std_logic
+);
+end trace_buffer;
+
+architecture Behavioral of trace_buffer is
+
+type trace_ram_type is array (0 to 2 ** depth_bits - 1) of std_logic_vector(31 downto 0);
+signal trace_ram : trace_ram_type;
+signal ram_q, entry : std_logic_vector(31 downto 0);
+signal ram_wren : std_logic;
+
+type dump_state is (idle, send_byte, wait_tx, read_entry, load_entry);
+
+signal state_reg, state_next : dump_state;
+signal recording_reg, recording_next : std_logic;
+signal record_writes_reg, record_writes_next : std_logic;
+signal trigger_enable_reg, trigger_enable_next : std_logic;
+signal trigger_addr_reg, trigger_addr_next : std_logic_vector(10 downto 0);
+signal triggered_reg, triggered_next : std_logic;
+signal wrapped_reg, wrapped_next : std_logic;
+signal write_ptr_reg, write_ptr_next : std_logic_vector(depth_bits - 1 downto 0);
+signal read_ptr_reg, read_ptr_next : std_logic_vector(depth_bits - 1 downto 0);
+signal entries_left_reg, entries_left_next : std_logic_vector(depth_bits downto 0);
+signal byte_count_reg, byte_count_next : std_logic_vector(1 downto 0);
+signal tx_word_reg, tx_word_next : std_logic_vector(31 downto 0);
+
+signal entry_count : std_logic_vector(depth_bits downto 0);
+signal header : std_logic_vector(31 downto 0);
+
+begin
+
+	process (reset, clk)
+	begin
+		if (reset = '1') then
+			state_reg <= idle;
+			recording_reg <= '0';
+			record_writes_reg <= '0';
+			trigger_enable_reg <= '0';
+			trigger_addr_reg <= (others => '0');
+			triggered_reg <= '0';
+			wrapped_reg <= '0';
+			write_ptr_reg <= (others => '0');
+			read_ptr_reg <= (others => '0');
+			entries_left_reg <= (others => '0');
+			byte_count_reg <= (others => '0');
+			tx_word_reg <= (others => '0');
+		elsif (clk'event and clk = '1') then
+			state_reg <= state_next;
+			recording_reg <= recording_next;
+			record_writes_reg <= record_writes_next;
+			trigger_enable_reg <= trigger_enable_next;
+			trigger_addr_reg <= trigger_addr_next;
+			triggered_reg <= triggered_next;
+			wrapped_reg <= wrapped_next;
+			write_ptr_reg <= write_ptr_next;
+			read_ptr_reg <= read_ptr_next;
+			entries_left_reg <= entries_left_next;
+			byte_count_reg <= byte_count_next;
+			tx_word_reg <= tx_word_next;
+		end if;
+	end process;
+	
+	-- Simple dual port RAM with a registered read, infers a block RAM
+	process (clk)
+	begin
+		if (clk'event and clk = '1') then
+			if (ram_wren = '1') then
+				trace_ram(conv_integer(write_ptr_reg)) <= entry;
+			end if;
+			ram_q <= trace_ram(conv_integer(read_ptr_reg));
+		end if;
+	end process;
+	
+	entry(31) <= cpu_irq_taken;
+	entry(30) <= cpu_mem_write;
+	entry(29) <= cpu_io_write;
+	entry(28 downto 27) <= "00";
+	entry(26 downto 16) <= cpu_pc;
+	entry(15 downto 0) <= cpu_write_addr & cpu_write_data when record_writes_reg = '1' else cpu_ir;
+	
+	ram_wren <= recording_reg and cpu_clk_ena and (cpu_irq_taken or not cpu_halted);
+	
+	-- Recording
+	process (recording_reg, record_writes_reg, trigger_enable_reg, trigger_addr_reg, triggered_reg, wrapped_reg,
+				write_ptr_reg, control_strobe, start, record_writes, trigger_enable, trigger_addr, dump_strobe,
+				ram_wren, cpu_pc)
+	begin
+		recording_next <= recording_reg;
+		record_writes_next <= record_writes_reg;
+		trigger_enable_next <= trigger_enable_reg;
+		trigger_addr_next <= trigger_addr_reg;
+		triggered_next <= triggered_reg;
+		wrapped_next <= wrapped_reg;
+		write_ptr_next <= write_ptr_reg;
+		
+		if (ram_wren = '1') then
+			write_ptr_next <= write_ptr_reg + 1;
+			if (write_ptr_reg = 2 ** depth_bits - 1) then
+				wrapped_next <= '1';
+			end if;
+			if (trigger_enable_reg = '1' and cpu_pc = trigger_addr_reg) then
+				recording_next <= '0';
+				triggered_next <= '1';
+			end if;
+		end if;
+		
+		if (control_strobe = '1') then
+			recording_next <= start;
+			if (start = '1') then
+				record_writes_next <= record_writes;
+				trigger_enable_next <= trigger_enable;
+				trigger_addr_next <= trigger_addr;
+				triggered_next <= '0';
+				wrapped_next <= '0';
+				write_ptr_next <= (others => '0');
+			end if;
+		elsif (dump_strobe = '1') then
+			recording_next <= '0';
+		end if;
+	end process;
+	
+	-- Dumping, the header goes out first and then the entries starting from the oldest one
+	entry_count <= conv_std_logic_vector(2 ** depth_bits, depth_bits + 1) when wrapped_reg = '1' else '0' & write_ptr_reg;
+	header <= conv_std_logic_vector(depth_bits, 8) & "00000" & wrapped_reg & triggered_reg & record_writes_reg &
+				 conv_std_logic_vector(0, 15 - depth_bits) & entry_count;
+	
+	process (state_reg, dump_strobe, read_ptr_reg, entries_left_reg, byte_count_reg, tx_word_reg, tx_idle,
+				wrapped_reg, write_ptr_reg, entry_count, header, ram_q)
+	begin
+		state_next <= state_reg;
+		read_ptr_next <= read_ptr_reg;
+		entries_left_next <= entries_left_reg;
+		byte_count_next <= byte_count_reg;
+		tx_word_next <= tx_word_reg;
+		tx_strobe <= '0';
+		
+		case state_reg is
+			when idle =>
+				if (dump_strobe = '1') then
+					tx_word_next <= header;
+					entries_left_next <= entry_count;
+					if (wrapped_reg = '1') then
+						read_ptr_next <= write_ptr_reg;
+					else
+						read_ptr_next <= (others => '0');
+					end if;
+					state_next <= send_byte;
+				end if;
+				
+			when send_byte =>
+				tx_strobe <= '1';
+				state_next <= wait_tx;
+				
+			when wait_tx =>
+				if (tx_idle = '1') then
+					byte_count_next <= byte_count_reg + 1;
+					tx_word_next <= "00000000" & tx_word_reg(31 downto 8);
+					if (byte_count_reg /= "11") then
+						state_next <= send_byte;
+					elsif (entries_left_reg = 0) then
+						state_next <= idle;
+					else
+						entries_left_next <= entries_left_reg - 1;
+						state_next <= read_entry;
+					end if;
+				end if;
+			
+			-- read_ptr_reg has been stable for a cycle when load_entry is reached
+			when read_entry =>
+				state_next <= load_entry;
+				
+			when load_entry =>
+				tx_word_next <= ram_q;
+				read_ptr_next <= read_ptr_reg + 1;
+				state_next <= send_byte;
+				
+		end case;
+	end process;
+	
+	tx_data <= tx_word_reg(7 downto 0);
+	busy <= '0' when state_reg = idle else '1';
+	
+end Behavioral;
@@ -8,13 +8,23 @@ CONFIG   -= app_bundle
 TEMPLATE = app
 
 
+INCLUDEPATH += ../srasm ../srsim
+
 SOURCES += main.cpp \
     consolereader.cpp \
-    risccomm.cpp
+    risccomm.cpp \
+    ../srsim/tracebuffer.cpp \
+    ../srsim/disassembler.cpp \
+    ../srsim/perfcounters.cpp \
+    ../srasm/srimage.cpp
 
 HEADERS += \
     consolereader.h \
-    risccomm.h
+    risccomm.h \
+    ../srsim/tracebuffer.h \
+    ../srsim/disassembler.h \
+    ../srsim/perfcounters.h \
+    ../srasm/srimage.h
 
 OTHER_FILES += \
     asd.txt
@@ -24,6 +24,10 @@
 */
 
 #include "risccomm.h"
+#include "srimage.h"
+#include "tracebuffer.h"
+#include "disassembler.h"
+#include "perfcounters.h"
 #include <QDebug>
 #include <QElapsedTimer>
 #include <QCoreApplication>
@@ -38,6 +42,11 @@ unsigned char takeByte(const QByteArray& d, int& offset) {
     return (unsigned char) d.at(offset++);
 }
 
+quint32 takeLong(const QByteArray& d, int& offset) {
+    quint32 low = takeShort(d, offset);
+    return low | (quint32) takeShort(d, offset) << 16;
+}
+
 RiscComm::RiscComm(QObject *parent) :
     QObject(parent)
 {
@@ -86,6 +95,66 @@ void RiscComm::onConsoleInput(QString input)
         writeMem(zeros, 0, true);
     } else if (input.compare("dm") == 0) {
         dumpMem();
+    } else if (input.startsWith("send")) {
+        // byte for the host interrupt source, e.g. "send $41" or "send 65"
+        QStringList args = input.split(" ");
+        bool ok = false;
+        int byte = 0;
+        if (args.length() == 2)
+            byte = args.at(1).startsWith("$") ? args.at(1).mid(1).toInt(&ok, 16) : args.at(1).toInt(&ok, 0);
+        if (ok && byte >= 0 && byte <= 255)
+            sendHostByte(byte);
+        else
+            qDebug() << "Usage: send <byte>";
+    } else if (input.startsWith("speed")) {
+        // CPU clock divider, "speed 2" runs the CPU at every second clk_50 cycle.
+        // 1 only works with the pipelined core, the debugger clamps it to 2 otherwise.
+        QStringList args = input.split(" ");
+        bool ok = false;
+        int divider = 0;
+        if (args.length() == 2)
+            divider = args.at(1).toInt(&ok);
+        if (ok && divider >= 1 && divider <= 8)
+            sendClockDivider(divider);
+        else
+            qDebug() << "Usage: speed <1-8>";
+    } else if (input.startsWith("core")) {
+        // selects the core of a multi-core top level that s, sc, wp, dm and the trace go to
+        QStringList args = input.split(" ");
+        bool ok = false;
+        int core = 0;
+        if (args.length() == 2)
+            core = args.at(1).toInt(&ok);
+        if (ok && core >= 0 && core <= 3)
+            sendCoreSelect(core);
+        else
+            qDebug() << "Usage: core <0-3>";
+    } else if (input.startsWith("trace")) {
+        // "trace [writes] [stop <bank * 256 + PC>]" starts recording, "trace off" stops it
+        QStringList args = input.split(" ");
+        bool ok = true;
+        bool writes = false;
+        int trigger = -1;
+        for (int i = 1; i < args.length() && ok; i++) {
+            if (args.at(i) == "writes")
+                writes = true;
+            else if (args.at(i) == "stop" && i + 1 < args.length()) {
+                QString a = args.at(++i);
+                trigger = a.startsWith("$") ? a.mid(1).toInt(&ok, 16) : a.toInt(&ok, 0);
+                ok = ok && trigger >= 0 && trigger < 2048;
+            } else
+                ok = false;
+        }
+        if (args.length() == 2 && args.at(1) == "off")
+            sendTraceControl(false);
+        else if (ok)
+            sendTraceControl(true, writes, trigger);
+        else
+            qDebug() << "Usage: trace [writes] [stop <address>] | trace off";
+    } else if (input.startsWith("td")) {
+        // dump the trace buffer, optionally saving the raw dump to a file
+        QStringList args = input.split(" ");
+        dumpTrace(args.length() == 2 ? args.at(1) : QString());
     }
     else
         qDebug() << "Unknown command:" << input;
@@ -128,11 +197,35 @@ void RiscComm::sendProgram(QString filename)
     }
 
     QByteArray data = program.readAll();
-    writeMem(data, 0, false);
+    if (SRImage::isImage(data)) {
+        SRImage image;
+        if (!image.parse(data))
+            return;
+        if (image.entry() != 0)
+            qDebug() << "Warning: the CPU starts from bank 0 address 0, not from the image entry point" << image.entry();
+        // Only the used program words, the data segments go straight to the data RAM
+        m_program = image.program();
+        foreach (const SRImage::Section& s, image.sections()) {
+            if (s.type == SRImage::ProgramSection)
+                writeMem(s.bytes, s.address & 0xff, false, s.address >> 8);
+            else
+                writeMem(s.bytes, s.address, true);
+        }
+        return;
+    }
+
+    // The flat binary has the program memory banks back to back, 256 words each
+    m_program.clear();
+    for (int i = 0; i + 1 < data.length(); i += 2)
+        m_program.append((unsigned char) data.at(i) << 8 | (unsigned char) data.at(i + 1));
+    for (int bank = 0; bank * 512 < data.length(); bank++)
+        writeMem(data.mid(bank * 512, 512), 0, false, bank);
 }
 
-void RiscComm::writeMem(QByteArray data, int addr, bool datamem) {
-    char writedatacmd[4] = {04, datamem ? 0 : 1, (unsigned char) addr, (unsigned char) data.length() / 2};
+void RiscComm::writeMem(QByteArray data, int addr, bool datamem, int bank) {
+    // the length is in bytes for the data memory and in words for the program memory, 0 is 256
+    char writedatacmd[4] = {04, (char) (datamem ? 0 : 1 | bank << 2), (unsigned char) addr,
+                            (unsigned char) (datamem ? data.length() : data.length() / 2)};
     m_sp->write(writedatacmd, 4);
     m_sp->flush();
     m_sp->write(data);
@@ -166,6 +259,74 @@ void RiscComm::sendReset()
     m_sp->write(cmd, 4);
 }
 
+void RiscComm::sendHostByte(unsigned char byte)
+{
+    qDebug() << "Sending byte" << byte << "to the interrupt controller";
+    char cmd[4] = {06, 00, 00, (char) byte};
+    m_sp->write(cmd, 4);
+}
+
+void RiscComm::sendClockDivider(int divider)
+{
+    qDebug() << "Running the CPU at clk_50 /" << divider;
+    char cmd[4] = {07, 00, 00, (char) divider};
+    m_sp->write(cmd, 4);
+}
+
+void RiscComm::sendCoreSelect(int core)
+{
+    // The debugger ignores a core the top level doesn't have
+    qDebug() << "Selecting core" << core;
+    char cmd[4] = {9, 00, 00, (char) core};
+    m_sp->write(cmd, 4);
+}
+
+void RiscComm::sendTraceControl(bool start, bool recordWrites, int trigger)
+{
+    qDebug() << (start ? "Starting" : "Stopping") << "the trace";
+    char control = start ? 1 : 0;
+    if (recordWrites)
+        control |= 2;
+    if (trigger >= 0)
+        control |= 4;
+    char cmd[4] = {8, control, (char) (trigger >> 8 & 7), (char) trigger};
+    m_sp->write(cmd, 4);
+}
+
+void RiscComm::dumpTrace(QString filename)
+{
+    qDebug() << "Dumping the trace buffer";
+    char cmd[4] = {8, (char) 0x80, 0, 0};
+    m_sp->write(cmd, 4);
+    m_sp->flush();
+
+    // Header word with the entry count first, the rest follows in one burst
+    QByteArray d;
+    int length = 4;
+    while (d.length() < length) {
+        m_sp->waitForReadyRead(1000);
+        QByteArray data = m_sp->readAll();
+        if (data.length() == 0) {
+            qDebug() << "Trace dump timed out.";
+            return;
+        }
+        d.append(data);
+        if (length == 4 && d.length() >= 4)
+            length += ((unsigned char) d.at(0) | (unsigned char) d.at(1) << 8) * 4;
+    }
+
+    if (!filename.isEmpty()) {
+        QFile file(filename);
+        if (file.open(QFile::WriteOnly))
+            file.write(d);
+        else
+            qDebug() << "Can't open" << filename;
+    }
+
+    QTextStream out(stdout);
+    TraceBuffer::decode(d, out, Disassembler(), m_program);
+}
+
 void RiscComm::doScan()
 {
     qDebug() << "Sending scan command";
@@ -173,9 +334,10 @@ void RiscComm::doScan()
     m_sp->write(cmd, 4);
 
     //
-    // Control path 3 (IR + PC + SR + SP)
+    // Control path 6 (bank + IR + SR + PC + SP)
     // Regfile 8 (r0 - r3)
-    int scanLength = 8 + 2 + 1 + 1 + 1;
+    // Performance counters 24
+    int scanLength = 8 + 1 + 2 + 1 + 1 + 1 + 4 * PerfCounters::CounterCount;
     QElapsedTimer e;
     e.start();
 
@@ -196,25 +358,32 @@ void RiscComm::doScan()
     unsigned char pc;
     unsigned char sr;
     unsigned char sp;
+    unsigned char bank;
 
     int o = 0;
     sp = takeByte(d, o);
     pc = takeByte(d, o);
     sr = takeByte(d, o);
     ir = takeShort(d, o);
+    bank = takeByte(d, o);
     regs[0] = takeShort(d, o);
     regs[1] = takeShort(d, o);
     regs[2] = takeShort(d, o);
     regs[3] = takeShort(d, o);
+    quint32 counters[PerfCounters::CounterCount];
+    for (int i = 0; i < PerfCounters::CounterCount; i++)
+        counters[i] = takeLong(d, o);
 
-    char srString[5];
-    srString[0] = sr & 0x8 ? 'H' : '-';
-    srString[1] = sr & 0x4 ? 'C' : '-';
-    srString[2] = sr & 0x2 ? 'N' : '-';
-    srString[3] = sr & 0x1 ? 'Z' : '-';
-    srString[4] = 0;
+    char srString[6];
+    srString[0] = sr & 0x10 ? 'I' : '-';
+    srString[1] = sr & 0x8 ? 'H' : '-';
+    srString[2] = sr & 0x4 ? 'C' : '-';
+    srString[3] = sr & 0x2 ? 'N' : '-';
+    srString[4] = sr & 0x1 ? 'Z' : '-';
+    srString[5] = 0;
     printf("----------------------------------------------\n");
     printf("R0: 0x%04X  R1: 0x%04X  R2: 0x%04X  R3: 0x%04X\n", regs[0], regs[1], regs[2], regs[3]);
-    printf("PC: 0x%02X    SR: --%s  IR: 0x%04X  SP: 0x%02X\n", pc, srString, ir, sp);
+    printf("PC: 0x%02X    SR: -%s  IR: 0x%04X  SP: 0x%02X  BANK: %d\n", pc, srString, ir, sp, bank);
+    printf("%s\n", qPrintable(PerfCounters::format(counters)));
     printf("----------------------------------------------\n");
 }
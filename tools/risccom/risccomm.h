@@ -28,6 +28,7 @@
 
 #include <QObject>
 #include <QSerialPort>
+#include <QVector>
 #include "consolereader.h"
 
 class RiscComm : public QObject
@@ -47,14 +48,20 @@ private:
     void sendRun();
     void sendStop();
     void sendReset();
+    void sendHostByte(unsigned char byte);
+    void sendClockDivider(int divider);
+    void sendCoreSelect(int core);
+    void sendTraceControl(bool start, bool recordWrites = false, int trigger = -1);
+    void dumpTrace(QString filename);
     void doScan();
     void dumpMem();
     void sendProgram(QString filename);
-    void writeMem(QByteArray data, int addr, bool datamem = true);
+    void writeMem(QByteArray data, int addr, bool datamem = true, int bank = 0);
 
 private:
     ConsoleReader m_console;
     QSerialPort* m_sp;
+    QVector<unsigned short> m_program;      // last uploaded image, for decoding write traces
 };
 
 #endif // RISCCOMM_H
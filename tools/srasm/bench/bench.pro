@@ -0,0 +1,68 @@
+QT       += core
+QT       -= gui
+
+TARGET = srasm-bench
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+QMAKE_CXXFLAGS = -std=c++0x
+
+INCLUDEPATH += ..
+
+HEADERS += ../nodes.h \
+    ../srprogram.h \
+    ../isa.h \
+    ../srobject.h \
+    ../srlinker.h \
+    ../srimage.h \
+    sourcegenerator.h
+SOURCES += main.cpp \
+    sourcegenerator.cpp \
+    ../nodes.cpp \
+    ../srprogram.cpp \
+    ../srobject.cpp \
+    ../srlinker.cpp \
+    ../srimage.cpp
+
+# Same flex and bison setup as srasm.pro
+LIBS += -lfl -ly
+FLEXSOURCES = ../lexer.l
+BISONSOURCES = ../parser.y
+
+flexsource.input = FLEXSOURCES
+flexsource.output = ${QMAKE_FILE_BASE}.cpp
+flexsource.commands = flex --header-file=${QMAKE_FILE_BASE}.h -o ${QMAKE_FILE_BASE}.cpp ${QMAKE_FILE_IN}
+flexsource.variable_out = SOURCES
+flexsource.name = Flex Sources ${QMAKE_FILE_IN}
+flexsource.CONFIG += target_predeps
+
+QMAKE_EXTRA_COMPILERS += flexsource
+
+flexheader.input = FLEXSOURCES
+flexheader.output = ${QMAKE_FILE_BASE}.h
+flexheader.commands = @true
+flexheader.variable_out = HEADERS
+flexheader.name = Flex Headers ${QMAKE_FILE_IN}
+flexheader.CONFIG += target_predeps no_link
+
+QMAKE_EXTRA_COMPILERS += flexheader
+
+bisonsource.input = BISONSOURCES
+bisonsource.output = ${QMAKE_FILE_BASE}.cpp
+bisonsource.commands = bison -d --verbose --defines=${QMAKE_FILE_BASE}.h -o ${QMAKE_FILE_BASE}.cpp ${QMAKE_FILE_IN}
+bisonsource.variable_out = SOURCES
+bisonsource.name = Bison Sources ${QMAKE_FILE_IN}
+bisonsource.CONFIG += target_predeps
+
+QMAKE_EXTRA_COMPILERS += bisonsource
+
+bisonheader.input = BISONSOURCES
+bisonheader.output = ${QMAKE_FILE_BASE}.h
+bisonheader.commands = @true
+bisonheader.variable_out = HEADERS
+bisonheader.name = Bison Headers ${QMAKE_FILE_IN}
+bisonheader.CONFIG += target_predeps no_link
+
+QMAKE_EXTRA_COMPILERS += bisonheader
@@ -0,0 +1,252 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QStringList>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <sys/resource.h>
+
+#include "lexer.h"
+#include "nodes.h"
+#include "parser.h"
+#include "srprogram.h"
+#include "srlinker.h"
+#include "sourcegenerator.h"
+
+int yyparse(Section*, Section*);
+extern int lineNumber;
+
+static bool verbose = false;
+
+static void messageHandler(QtMsgType type, const QMessageLogContext&, const QString& msg)
+{
+    // The assembler chats a lot through qDebug, keep the JSON output clean
+    if (type == QtDebugMsg && !verbose)
+        return;
+    QTextStream(stderr) << msg << "\n";
+    if (type == QtFatalMsg)
+        abort();
+}
+
+static qint64 peakRss()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;     // kilobytes on Linux
+}
+
+static double median(QList<qint64> samples)
+{
+    qSort(samples);
+    int n = samples.length();
+    return n % 2 ? samples.at(n / 2) : (samples.at(n / 2 - 1) + samples.at(n / 2)) / 2.0;
+}
+
+static int lexOnly(const QByteArray& source)
+{
+    lineNumber = 1;
+    YY_BUFFER_STATE bufferState = yy_scan_string(source.constData());
+    int tokens = 0;
+    int token;
+    while ((token = yylex()) != 0) {
+        if (token == TOK_LABEL || token == TOK_LABEL_REF)
+            delete yylval.str;
+        else if (token == TOK_STRING)
+            delete yylval.data;
+        tokens++;
+    }
+    yy_delete_buffer(bufferState);
+    return tokens;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Benchmarks srasm on generated sources and writes the results as JSON");
+    parser.addHelpOption();
+    QCommandLineOption sizesOption("sizes", "Comma separated list of program sizes in instructions", "n,n,...", "256,2048,16384");
+    QCommandLineOption iterationsOption("iterations", "Runs per size, the median is reported", "n", "5");
+    QCommandLineOption seedOption("seed", "Random seed for the generator", "n", "1");
+    QCommandLineOption labelOption("label-every", "Place a code label every n instructions", "n", "8");
+    QCommandLineOption branchOption("branch-percent", "Share of branch instructions", "percent", "20");
+    QCommandLineOption dataOption("data-bytes", "Size of the data section, at most 255", "n", "240");
+    QCommandLineOption dbOption("db-length", "Bytes per db line", "n", "16");
+    QCommandLineOption rbOption("rb-percent", "Share of the data section reserved with rb", "percent", "25");
+    QCommandLineOption outputOption(QStringList() << "o" << "output", "Write the JSON results to <file> instead of stdout", "file");
+    QCommandLineOption sourcesOption("save-sources", "Save the generated sources to <dir>", "dir");
+    QCommandLineOption revisionOption("revision", "Revision tag stored in the results, e.g. the output of git describe", "rev");
+    QCommandLineOption verboseOption("verbose", "Don't silence the assembler debug output");
+    parser.addOption(sizesOption);
+    parser.addOption(iterationsOption);
+    parser.addOption(seedOption);
+    parser.addOption(labelOption);
+    parser.addOption(branchOption);
+    parser.addOption(dataOption);
+    parser.addOption(dbOption);
+    parser.addOption(rbOption);
+    parser.addOption(outputOption);
+    parser.addOption(sourcesOption);
+    parser.addOption(revisionOption);
+    parser.addOption(verboseOption);
+    parser.process(a);
+
+    verbose = parser.isSet(verboseOption);
+    qInstallMessageHandler(messageHandler);
+
+    SourceGenerator::Mix mix;
+    mix.labelEvery = parser.value(labelOption).toInt();
+    mix.branchPercent = parser.value(branchOption).toInt();
+    mix.dataBytes = parser.value(dataOption).toInt();
+    mix.dbLength = parser.value(dbOption).toInt();
+    mix.rbPercent = parser.value(rbOption).toInt();
+    int iterations = qMax(1, parser.value(iterationsOption).toInt());
+    unsigned int seed = parser.value(seedOption).toUInt();
+
+    QTemporaryDir outputDir;
+    if (!outputDir.isValid())
+        qFatal("Can't create a temporary directory for the output files");
+
+    QJsonArray results;
+    foreach (QString size, parser.value(sizesOption).split(",")) {
+        mix.instructions = size.toInt();
+        SourceGenerator generator(seed);
+        QByteArray source = generator.generate(mix);
+
+        if (parser.isSet(sourcesOption)) {
+            QFile file(QDir(parser.value(sourcesOption)).filePath(QString("bench_%1.asm").arg(mix.instructions)));
+            if (file.open(QFile::WriteOnly))
+                file.write(source);
+        }
+
+        QList<qint64> lexTimes, parseTimes, compileTimes, linkTimes, writeTimes;
+        int tokens = 0;
+        int programSize = 0;
+        for (int i = 0; i < iterations; i++) {
+            QElapsedTimer timer;
+
+            timer.start();
+            tokens = lexOnly(source);
+            lexTimes.append(timer.nsecsElapsed());
+
+            Section codeSection;
+            Section dataSection;
+            lineNumber = 1;
+            timer.start();
+            YY_BUFFER_STATE bufferState = yy_scan_string(source.constData());
+            yyparse(&codeSection, &dataSection);
+            yy_delete_buffer(bufferState);
+            parseTimes.append(timer.nsecsElapsed());
+
+            SRProgram prg;
+            timer.start();
+            SRObject object = prg.compile(&codeSection, &dataSection, "bench");
+            compileTimes.append(timer.nsecsElapsed());
+
+            SRLinker linker;
+            linker.setMaxProgramSize(0x10000);
+            linker.addObject(object);
+            timer.start();
+            QByteArray bin = linker.link();
+            linkTimes.append(timer.nsecsElapsed());
+            programSize = linker.program().size();
+
+            timer.start();
+            QFile output(outputDir.path() + "/bench.bin");
+            if (output.open(QFile::WriteOnly))
+                output.write(bin);
+            output.close();
+            object.save(outputDir.path() + "/bench.o");
+            writeTimes.append(timer.nsecsElapsed());
+
+            qDeleteAll(codeSection.m_nodes);
+            qDeleteAll(dataSection.m_nodes);
+        }
+
+        // yyparse() runs the lexer too, report the parser on its own
+        double lex = median(lexTimes) / 1e6;
+        double parse = qMax(0.0, median(parseTimes) / 1e6 - lex);
+        double compile = median(compileTimes) / 1e6;
+        double link = median(linkTimes) / 1e6;
+        double write = median(writeTimes) / 1e6;
+        double total = lex + parse + compile + link + write;
+
+        QJsonObject result;
+        result["instructions"] = mix.instructions;
+        result["program_words"] = programSize;
+        result["source_bytes"] = source.size();
+        result["source_lines"] = source.count('\n');
+        result["tokens"] = tokens;
+        result["lex_ms"] = lex;
+        result["parse_ms"] = parse;
+        result["compile_ms"] = compile;
+        result["link_ms"] = link;
+        result["write_ms"] = write;
+        result["total_ms"] = total;
+        result["lines_per_second"] = total > 0 ? source.count('\n') / (total / 1e3) : 0.0;
+        result["megabytes_per_second"] = total > 0 ? source.size() / (total / 1e3) / 1e6 : 0.0;
+        result["peak_rss_kb"] = peakRss();
+        results.append(result);
+    }
+
+    QJsonObject generator;
+    generator["seed"] = (qint64) seed;
+    generator["label_every"] = mix.labelEvery;
+    generator["branch_percent"] = mix.branchPercent;
+    generator["data_bytes"] = mix.dataBytes;
+    generator["db_length"] = mix.dbLength;
+    generator["rb_percent"] = mix.rbPercent;
+
+    QJsonObject root;
+    root["revision"] = parser.value(revisionOption);
+    root["timestamp"] = QDateTime::currentDateTimeUtc().toString(Qt::ISODate);
+    root["iterations"] = iterations;
+    root["generator"] = generator;
+    root["results"] = results;
+
+    QByteArray json = QJsonDocument(root).toJson();
+    if (parser.isSet(outputOption)) {
+        QFile file(parser.value(outputOption));
+        if (!file.open(QFile::WriteOnly)) {
+            qWarning() << "Can't open" << parser.value(outputOption);
+            return 1;
+        }
+        file.write(json);
+    } else {
+        QTextStream(stdout) << json;
+    }
+    return 0;
+}
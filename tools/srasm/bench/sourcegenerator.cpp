@@ -0,0 +1,138 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "sourcegenerator.h"
+#include <QStringList>
+
+SourceGenerator::Mix::Mix() :
+    instructions(1000),
+    labelEvery(8),
+    branchPercent(20),
+    dataBytes(240),
+    dbLength(16),
+    rbPercent(25)
+{
+}
+
+SourceGenerator::SourceGenerator(unsigned int seed) :
+    m_state(seed ? seed : 1)
+{
+}
+
+unsigned int SourceGenerator::random(unsigned int range)
+{
+    // xorshift32, qrand() isn't guaranteed to produce the same sequence everywhere
+    m_state ^= m_state << 13;
+    m_state ^= m_state >> 17;
+    m_state ^= m_state << 5;
+    return m_state % range;
+}
+
+QByteArray SourceGenerator::reg()
+{
+    return "r" + QByteArray::number(random(4));
+}
+
+QByteArray SourceGenerator::generate(const Mix &mix)
+{
+    QByteArray src;
+    int codeLabels = qMax(1, mix.instructions / qMax(1, mix.labelEvery) + 1);
+
+    // Lay out the data first so that the code can reference the data labels
+    QByteArray data;
+    int dataLabels = 0;
+    int dataBytes = qMin(mix.dataBytes, 255);
+    for (int allocated = 0; allocated < dataBytes; dataLabels++) {
+        data += "d" + QByteArray::number(dataLabels) + ":\n";
+        int length = qMin(qMax(1, mix.dbLength), dataBytes - allocated);
+        if ((int) random(100) < mix.rbPercent) {
+            data += "    rb " + QByteArray::number(length) + "\n";
+        } else {
+            QList<QByteArray> fragments;
+            for (int i = 0; i < length; ) {
+                if (length - i >= 4 && random(4) == 0) {
+                    fragments.append("\"text\"");
+                    i += 4;
+                } else {
+                    fragments.append(random(2) ? QByteArray::number(random(256)) : "$" + QByteArray::number(random(256), 16));
+                    i++;
+                }
+            }
+            data += "    db ";
+            for (int i = 0; i < fragments.length(); i++)
+                data += (i ? ", " : "") + fragments.at(i);
+            data += "\n";
+        }
+        allocated += length;
+    }
+
+    src += "SECTION CODE\n";
+    int label = 0;
+    for (int i = 0; i < mix.instructions; i++) {
+        if (i % qMax(1, mix.labelEvery) == 0)
+            src += "l" + QByteArray::number(label++) + ":\n";
+
+        QByteArray target = "l" + QByteArray::number(random(codeLabels));
+        QByteArray dataLabel = dataLabels ? "d" + QByteArray::number(random(dataLabels)) : QByteArray("0");
+        if ((int) random(100) < mix.branchPercent) {
+            static const char* branches[] = { "breq", "brne", "bra", "bsr" };
+            if (random(8) == 0)
+                src += "    bra     " + reg() + "\n";
+            else
+                src += QByteArray("    ") + branches[random(4)] + "    " + target + "\n";
+            continue;
+        }
+
+        switch (random(12)) {
+            case 0: src += "    mov     " + QByteArray::number(random(256)) + ", " + reg() + "\n"; break;
+            case 1: src += "    mov     $" + QByteArray::number(random(256), 16) + ", " + reg() + "e\n"; break;
+            case 2: src += "    mov     " + (random(2) ? dataLabel : target) + ", " + reg() + "\n"; break;
+            case 3: src += "    ld      " + dataLabel + ", " + reg() + "\n"; break;
+            case 4: src += "    ld      (" + reg() + "), " + reg() + "\n"; break;
+            case 5: src += "    st      " + reg() + ", " + dataLabel + "\n"; break;
+            case 6: src += "    st      " + reg() + ", (" + reg() + ")\n"; break;
+            case 7: {
+                static const char* ops[] = { "add", "sub", "and", "or", "xor" };
+                src += QByteArray("    ") + ops[random(5)] + "     " + reg() + ", " + reg() + ", " + reg() + "\n";
+                break;
+            }
+            case 8: src += random(2) ? "    inc     " + reg() + "\n" : "    dec     " + reg() + "\n"; break;
+            case 9: src += "    out     " + reg() + ", $" + QByteArray::number(random(0x30), 16) + "     // comment\n"; break;
+            case 10: src += "    in      $" + QByteArray::number(random(0x30), 16) + ", " + reg() + "\n"; break;
+            case 11: src += random(2) ? "    push    " + reg() + "\n" : "    pop     " + reg() + "\n"; break;
+        }
+    }
+    // Labels can be referenced before the last one gets placed
+    while (label < codeLabels)
+        src += "l" + QByteArray::number(label++) + ":\n";
+    src += "    halt\n";
+
+    if (!data.isEmpty())
+        src += "SECTION DATA\n" + data;
+    else
+        src.prepend("\n");     // the grammar wants a leading empty line in code only sources
+    src += "END\n";
+    return src;
+}
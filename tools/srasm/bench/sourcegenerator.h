@@ -0,0 +1,59 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef SOURCEGENERATOR_H
+#define SOURCEGENERATOR_H
+
+#include <QByteArray>
+
+// Generates syntactically valid srasm sources of arbitrary size for benchmarking.
+// The programs aren't meant to be run and don't fit in the program memory once they
+// grow past 256 instructions, but every label reference resolves.
+class SourceGenerator
+{
+public:
+    struct Mix {
+        Mix();
+        int instructions;
+        int labelEvery;         // a code label is placed every n instructions
+        int branchPercent;      // share of branch instructions in the code
+        int dataBytes;          // capped by the 256 byte data memory
+        int dbLength;           // bytes per db line
+        int rbPercent;          // share of the data section reserved with rb instead of db
+    };
+
+    explicit SourceGenerator(unsigned int seed = 1);
+
+    QByteArray generate(const Mix& mix);
+
+private:
+    unsigned int random(unsigned int range);
+    QByteArray reg();
+
+private:
+    unsigned int m_state;
+};
+
+#endif // SOURCEGENERATOR_H
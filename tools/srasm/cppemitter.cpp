@@ -0,0 +1,511 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "cppemitter.h"
+#include "isa.h"
+
+CppEmitter::CppEmitter(const QVector<unsigned short>& program, const QMap<QString, int>& codeLabels) :
+    m_program(program),
+    m_banks(PROGRAM_BANKS, false),
+    m_interrupts(false),
+    m_dispatch(false)
+{
+    for (QMap<QString, int>::const_iterator i = codeLabels.constBegin(); i != codeLabels.constEnd(); ++i) {
+        if (!m_labels.contains(i.value()))
+            m_labels.insert(i.value(), i.key());
+    }
+
+    // Banks the program runs in are padded with NOPs so that falling off the end wraps like the PC does
+    for (int i = 0; i < m_program.size() && i < PROGRAM_SIZE; i += PROGRAM_BANK_SIZE)
+        m_banks[i / PROGRAM_BANK_SIZE] = true;
+    m_program.resize(PROGRAM_SIZE);
+    for (int i = 0; i < PROGRAM_SIZE; i++) {
+        unsigned short w = m_program.at(i);
+        if ((w & OPCODE_MASK) == OPCODE_FAR_BRANCH_TO_SUBROUTINE && m_banks.at(i / PROGRAM_BANK_SIZE))
+            m_banks[FAR_BANK(w)] = true;
+        if (((w & OPCODE_MASK) == OPCODE_INTERRUPT_ENABLE && (w & FLAG_INTERRUPT_ENABLE)) ||
+                ((w & OPCODE_MASK) == OPCODE_RETURN_FROM_SUBROUTINE && (w & FLAG_RETI)))
+            m_interrupts = true;
+    }
+
+    // Interrupts, returns and register branches jump through the dispatch switch
+    m_dispatch = m_interrupts;
+    for (int i = 0; i < PROGRAM_SIZE; i++) {
+        unsigned short w = m_program.at(i);
+        if (!m_banks.at(i / PROGRAM_BANK_SIZE))
+            continue;
+        if ((w & OPCODE_MASK) == OPCODE_RETURN_FROM_SUBROUTINE)
+            m_dispatch = true;
+        if (((w & OPCODE_MASK) == OPCODE_BRANCH || (w & OPCODE_MASK) == OPCODE_BRANCH_TO_SUBROUTINE) &&
+                (w & FLAG_REGISTER_JUMP_TARGET) && BRANCH_CONDITION(w) <= BRANCH_ALWAYS)
+            m_dispatch = true;
+    }
+
+    findLeaders();
+    findDeadFlags();
+}
+
+bool CppEmitter::endsBlock(unsigned short instruction) const
+{
+    switch (instruction & OPCODE_MASK) {
+        case OPCODE_BRANCH:
+        case OPCODE_BRANCH_TO_SUBROUTINE:
+        case OPCODE_FAR_BRANCH_TO_SUBROUTINE:
+        case OPCODE_RETURN_FROM_SUBROUTINE:
+        case OPCODE_HALT:
+            return true;
+        default:
+            return false;
+    }
+}
+
+void CppEmitter::findLeaders()
+{
+    m_leader.fill(m_interrupts, PROGRAM_SIZE);
+    for (int bank = 0; bank < PROGRAM_BANKS; bank++) {
+        if (!m_banks.at(bank))
+            continue;
+        int base = bank * PROGRAM_BANK_SIZE;
+        m_leader[base] = true;
+        for (int i = base; i < base + PROGRAM_BANK_SIZE; i++) {
+            unsigned short w = m_program.at(i);
+            int next = base | ((i + 1) & 0xff);
+            if (m_labels.contains(i))
+                m_leader[i] = true;     // might be the target of a register branch
+            switch (w & OPCODE_MASK) {
+                case OPCODE_BRANCH:
+                case OPCODE_BRANCH_TO_SUBROUTINE:
+                    if (!(w & FLAG_REGISTER_JUMP_TARGET))
+                        m_leader[base | (w & 0xff)] = true;
+                    break;
+                case OPCODE_FAR_BRANCH_TO_SUBROUTINE:
+                    m_leader[FAR_BANK(w) * PROGRAM_BANK_SIZE + (w & 0xff)] = true;
+                    break;
+                case OPCODE_HALT:
+                    m_leader[i] = true;     // waits by branching to itself
+                    break;
+            }
+            if (endsBlock(w))
+                m_leader[next] = true;
+        }
+    }
+}
+
+// Walks forward to the end of the block looking for an ALU op that overwrites the
+// result or the carry before anything reads it. Branches only ever end a block so
+// the flags are live at the leader that follows.
+void CppEmitter::findDeadFlags()
+{
+    m_resultDead.fill(false, PROGRAM_SIZE);
+    m_carryDead.fill(false, PROGRAM_SIZE);
+    for (int i = 0; i < PROGRAM_SIZE; i++) {
+        if ((m_program.at(i) & OPCODE_MASK) != OPCODE_ALUOP)
+            continue;
+        bool resultDone = false;
+        bool carryDone = false;
+        for (int j = i + 1; j % PROGRAM_BANK_SIZE && !m_leader.at(j) && !(resultDone && carryDone); j++) {
+            unsigned short w = m_program.at(j);
+            if ((w & OPCODE_MASK) != OPCODE_ALUOP)
+                continue;
+            if (!resultDone)
+                m_resultDead[i] = true;
+            resultDone = true;
+            if (!carryDone) {
+                if (ALU_OP(w) == ALU_OP_ADC || ALU_OP(w) == ALU_OP_SBC) {
+                    carryDone = true;
+                } else if (ALU_OP_SETS_CARRY(ALU_OP(w))) {
+                    m_carryDead[i] = true;
+                    carryDone = true;
+                }
+            }
+        }
+    }
+}
+
+QString CppEmitter::label(int address)
+{
+    return QString("L%1").arg(address, 3, 16, QChar('0'));
+}
+
+QString CppEmitter::hex(int value, int digits)
+{
+    return QString("0x%1").arg(value, digits, 16, QChar('0'));
+}
+
+QString CppEmitter::reg(int r)
+{
+    return QString("r%1").arg(r);
+}
+
+void CppEmitter::writeRuntime(QTextStream& out) const
+{
+    out << "#ifndef SRAOT_RUNTIME\n"
+           "#define SRAOT_RUNTIME\n"
+           "\n"
+           "// Machine state like srsim keeps it, pc is bank * 256 + PC\n"
+           "struct SRAotState\n"
+           "{\n"
+           "    uint16_t regs[4];\n"
+           "    uint8_t data[256];\n"
+           "    int pc;\n"
+           "    int sp;\n"
+           "    int sr;\n"
+           "    int savedFlags;     // C, N and Z saved on interrupt entry\n"
+           "    int bankStack[8];\n"
+           "    int bankSp;\n"
+           "    uint64_t cycles;\n"
+           "};\n"
+           "\n"
+           "enum\n"
+           "{\n"
+           "    SRAotZero = " << SR_ZERO << ",\n"
+           "    SRAotNegative = " << SR_NEGATIVE << ",\n"
+           "    SRAotCarry = " << SR_CARRY << ",\n"
+           "    SRAotHalted = " << SR_HALTED << ",\n"
+           "    SRAotInterruptEnable = " << SR_INTERRUPT_ENABLE << "\n"
+           "};\n"
+           "\n"
+           "// The I/O devices. The cycle is the number of instructions executed before the\n"
+           "// accessing one, what srsim's cycles() returns at that point.\n"
+           "class SRAotIo\n"
+           "{\n"
+           "public:\n"
+           "    virtual ~SRAotIo() {}\n"
+           "    virtual uint8_t read(int address, uint64_t cycle) = 0;\n"
+           "    virtual void write(int address, uint8_t value, uint64_t cycle) = 0;\n"
+           "    // Vector of the interrupt taken instead of the instruction at the cycle or -1,\n"
+           "    // only asked while interrupts are enabled. With -1, next is set to the first\n"
+           "    // cycle the answer can change at if there is no I/O access before it.\n"
+           "    virtual int interrupt(uint64_t cycle, uint64_t* next) = 0;\n"
+           "};\n"
+           "\n"
+           "enum SRAotStatus\n"
+           "{\n"
+           "    SRAotStopped,           // HALT with interrupts disabled\n"
+           "    SRAotCycleLimit,\n"
+           "    SRAotUnknownTarget      // returned or branched to an address that wasn't translated as an entry\n"
+           "};\n"
+           "\n"
+           "// Z and N are derived from the last ALU result\n"
+           "static inline int srAotFlags(uint16_t result, unsigned carry)\n"
+           "{\n"
+           "    return (result == 0 ? SRAotZero : 0) | (result & 0x8000 ? SRAotNegative : 0) | (carry ? SRAotCarry : 0);\n"
+           "}\n"
+           "\n"
+           "static inline uint16_t srAotResult(int flags)\n"
+           "{\n"
+           "    return (flags & SRAotZero) ? 0 : (flags & SRAotNegative) ? 0x8000 : 1;\n"
+           "}\n"
+           "\n"
+           "#endif\n\n";
+}
+
+void CppEmitter::write(QTextStream& out, const QString& functionName) const
+{
+    out << "// Generated by srasm --emit-cpp, don't edit\n"
+           "//\n"
+           "// " << functionName << "() runs the program from the state until it stops on HALT, has run\n"
+           "// at least maxCycles instructions or can't find the target of a jump. The cycle limit is\n"
+           "// only checked at the start of basic blocks.\n\n"
+           "#include <stdint.h>\n\n";
+    writeRuntime(out);
+
+    out << "SRAotStatus " << functionName << "(SRAotState* s, SRAotIo* io, uint64_t maxCycles)\n"
+           "{\n"
+           "    uint16_t r0 = s->regs[0];\n"
+           "    uint16_t r1 = s->regs[1];\n"
+           "    uint16_t r2 = s->regs[2];\n"
+           "    uint16_t r3 = s->regs[3];\n"
+           "    uint8_t* const data = s->data;\n"
+           "    uint8_t sp = s->sp;\n"
+           "    uint16_t zn = srAotResult(s->sr);\n"
+           "    unsigned carry = (s->sr & SRAotCarry) ? 1 : 0;\n"
+           "    bool ie = s->sr & SRAotInterruptEnable;\n"
+           "    bool halted = s->sr & SRAotHalted;\n"
+           "    int savedFlags = s->savedFlags;\n"
+           "    int bankSp = s->bankSp;\n"
+           "    uint64_t c = s->cycles;\n"
+           "    const uint64_t limit = c + maxCycles;\n"
+           "    int pc = s->pc;\n"
+           "    SRAotStatus status;\n"
+           "    (void) io;\n"
+           "    (void) data;\n";
+    if (m_interrupts)
+        out << "    int vector;\n"
+               "    int ret;\n"
+               "    uint64_t check = c;    // next cycle to ask for an interrupt or check the limit at\n";
+    out << "\n";
+    if (m_dispatch)
+        out << "dispatch:\n";
+    out << "    switch (pc) {\n";
+    for (int i = 0; i < PROGRAM_SIZE; i++) {
+        if (m_banks.at(i / PROGRAM_BANK_SIZE) && m_leader.at(i))
+            out << "        case " << hex(i, 3) << ": goto " << label(i) << ";\n";
+    }
+    out << "        default: status = SRAotUnknownTarget; goto out;\n"
+           "    }\n";
+
+    if (m_interrupts) {
+        // Same as SRSimulator::interrupt()
+        out << "\n"
+               "irq:\n"
+               "    data[sp--] = ret;\n"
+               "    savedFlags = srAotFlags(zn, carry);\n"
+               "    ie = false;\n"
+               "    halted = false;\n"
+               "    s->bankStack[bankSp] = ret >> 8;\n"
+               "    bankSp = (bankSp + 1) & 7;\n"
+               "    pc = vector;\n"
+               "    c++;\n"
+               "    goto dispatch;\n";
+    }
+
+    for (int bank = 0; bank < PROGRAM_BANKS; bank++) {
+        if (!m_banks.at(bank))
+            continue;
+        int base = bank * PROGRAM_BANK_SIZE;
+        out << "\n    // bank " << bank << "\n";
+        for (int i = base; i < base + PROGRAM_BANK_SIZE; i++)
+            writeInstruction(out, i);
+        out << "    goto " << label(base) << ";\n";
+    }
+
+    out << "\n"
+           "out:\n"
+           "    s->regs[0] = r0;\n"
+           "    s->regs[1] = r1;\n"
+           "    s->regs[2] = r2;\n"
+           "    s->regs[3] = r3;\n"
+           "    s->sp = sp;\n"
+           "    s->sr = srAotFlags(zn, carry) | (halted ? SRAotHalted : 0) | (ie ? SRAotInterruptEnable : 0);\n"
+           "    s->savedFlags = savedFlags;\n"
+           "    s->bankSp = bankSp;\n"
+           "    s->cycles = c;\n"
+           "    s->pc = pc;\n"
+           "    return status;\n"
+           "}\n";
+}
+
+void CppEmitter::writeInstruction(QTextStream& out, int address) const
+{
+    unsigned short i = m_program.at(address);
+    int base = address & ~(PROGRAM_BANK_SIZE - 1);
+    int next = base | ((address + 1) & 0xff);
+    QString t = reg((i >> TARGET_REG) & REG_MASK);
+    QString r = reg((i >> SRC1_REG) & REG_MASK);
+    QString s = reg((i >> SRC2_REG) & REG_MASK);
+    int imm = i & 0xff;
+    QString dataAddress = (i & FLAG_INDIRECT) ? QString("(uint8_t) %1").arg(r) : hex(imm, 2);
+    QString postModify;
+    if (i & FLAG_INDIRECT) {
+        if ((i & POST_MODIFY_MASK) == FLAG_POST_INCREMENT)
+            postModify = QString("    %1++;\n").arg(r);
+        else if ((i & POST_MODIFY_MASK) == FLAG_POST_DECREMENT)
+            postModify = QString("    %1--;\n").arg(r);
+    }
+    QString condition;
+    switch (BRANCH_CONDITION(i)) {
+        case BRANCH_EQUAL: condition = "zn == 0"; break;
+        case BRANCH_NOT_EQUAL: condition = "zn != 0"; break;
+        case BRANCH_ALWAYS: condition = "true"; break;
+        default: condition = "false"; break;
+    }
+
+    if (m_labels.contains(address))
+        out << "    // " << m_labels.value(address) << "\n";
+    if (m_leader.at(address)) {
+        out << label(address) << ":\n";
+        if (m_interrupts) {
+            // A waiting HALT returns to the instruction after it
+            QString ret = (i & OPCODE_MASK) == OPCODE_HALT ? QString("halted ? %1 : %2").arg(hex(next, 3), hex(address, 3)) : hex(address, 3);
+            out << "    if (c >= check) {\n";
+            out << "        if (c >= limit) { pc = " << hex(address, 3) << "; status = SRAotCycleLimit; goto out; }\n";
+            out << "        if (ie && (vector = io->interrupt(c, &check)) >= 0) { ret = " << ret << "; goto irq; }\n";
+            out << "        if (!ie || check > limit) check = limit;\n";
+            out << "    }\n";
+        } else {
+            out << "    if (c >= limit) { pc = " << hex(address, 3) << "; status = SRAotCycleLimit; goto out; }\n";
+        }
+    }
+
+    switch (i & OPCODE_MASK) {
+        case OPCODE_MOVE_IMM:
+            if (i & FLAG_EXTEND)
+                out << "    " << t << " = " << hex((unsigned short) (signed char) imm, 4) << ";\n";
+            else
+                out << "    " << t << " = (" << t << " & 0xff00) | " << hex(imm, 2) << ";\n";
+            break;
+
+        case OPCODE_LOAD:
+        case OPCODE_READ_IO: {
+            QString value = (i & OPCODE_MASK) == OPCODE_LOAD ? QString("data[%1]").arg(dataAddress) :
+                                                               QString("io->read(%1, c)").arg(dataAddress);
+            out << "    {\n        uint8_t value = " << value << ";\n";
+            if ((i & OPCODE_MASK) == OPCODE_READ_IO && m_interrupts)
+                out << "        check = 0;\n";
+            // The loaded value wins when the target is the address register
+            if (!postModify.isEmpty())
+                out << "    " << postModify;
+            if (i & FLAG_EXTEND)
+                out << "        " << t << " = (int8_t) value;\n    }\n";
+            else
+                out << "        " << t << " = (" << t << " & 0xff00) | value;\n    }\n";
+            break;
+        }
+
+        case OPCODE_STORE:
+            out << "    data[" << dataAddress << "] = (uint8_t) " << t << ";\n" << postModify;
+            break;
+
+        case OPCODE_WRITE_IO:
+            out << "    io->write(" << dataAddress << ", (uint8_t) " << t << ", c);\n" << postModify;
+            if (m_interrupts)
+                out << "    check = 0;\n";
+            break;
+
+        case OPCODE_ALUOP: {
+            int op = ALU_OP(i);
+            QString result;
+            switch (op) {
+                case ALU_OP_ADD: result = QString("(uint32_t) %1 + %2").arg(r, s); break;
+                case ALU_OP_SUB: result = QString("(uint32_t) %1 + (%2 ^ 0xffff) + 1").arg(r, s); break;
+                case ALU_OP_ADC: result = QString("(uint32_t) %1 + %2 + carry").arg(r, s); break;
+                case ALU_OP_SBC: result = QString("(uint32_t) %1 + (%2 ^ 0xffff) + carry").arg(r, s); break;
+                case ALU_OP_SHR: result = QString("(%1 & 0x8000) | %1 >> 1").arg(r); break;
+                case ALU_OP_SHL: result = QString("%1 << 1").arg(r); break;
+                case ALU_OP_SWAP: result = QString("%1 << 8 | %1 >> 8").arg(r); break;
+                case ALU_OP_NOT: result = QString("~%1").arg(r); break;
+                case ALU_OP_OR: result = QString("%1 | %2").arg(r, s); break;
+                case ALU_OP_AND: result = QString("%1 & %2").arg(r, s); break;
+                case ALU_OP_XOR: result = QString("%1 ^ %2").arg(r, s); break;
+                case ALU_OP_NOP: result = r; break;
+                case ALU_OP_DEC: result = QString("%1 - 1").arg(r); break;
+                case ALU_OP_INC: result = QString("%1 + 1").arg(r); break;
+                default: result = "0"; break;
+            }
+            bool writeBack = !(i & FLAG_NO_WRITEBACK);
+            bool storeResult = !m_resultDead.at(address);
+            bool storeCarry = ALU_OP_SETS_CARRY(op) && !m_carryDead.at(address);
+            if (storeCarry) {
+                out << "    {\n        uint32_t result = " << result << ";\n";
+                out << "        carry = result >> 16 & 1;\n";
+                if (storeResult)
+                    out << "        zn = result;\n";
+                if (writeBack)
+                    out << "        " << t << " = result;\n";
+                out << "    }\n";
+            } else if (writeBack) {
+                out << "    " << t << " = " << result << ";\n";
+                if (storeResult)
+                    out << "    zn = " << t << ";\n";
+            } else if (storeResult) {
+                out << "    zn = " << result << ";\n";
+            }
+            break;
+        }
+
+        case OPCODE_BRANCH_TO_SUBROUTINE:
+        case OPCODE_BRANCH:
+            // The return address gets pushed whether the branch is taken or not
+            if ((i & OPCODE_MASK) == OPCODE_BRANCH_TO_SUBROUTINE)
+                out << "    data[sp--] = " << hex(next & 0xff, 2) << ";\n";
+            out << "    c++;\n";
+            if (condition == "false")
+                return;
+            if (i & FLAG_REGISTER_JUMP_TARGET) {
+                QString jump = QString("pc = %1 | (%2 & 0xff); goto dispatch;").arg(hex(base, 3), r);
+                if (condition == "true")
+                    out << "    " << jump << "\n";
+                else
+                    out << "    if (" << condition << ") { " << jump << " }\n";
+            } else {
+                QString jump = "goto " + label(base | imm) + ";";
+                if (condition == "true")
+                    out << "    " << jump << "\n";
+                else
+                    out << "    if (" << condition << ") " << jump << "\n";
+            }
+            return;
+
+        case OPCODE_RETURN_FROM_SUBROUTINE:
+            out << "    sp++;\n";
+            if (i & (FLAG_RETI | FLAG_FAR_RETURN)) {
+                out << "    bankSp = (bankSp - 1) & 7;\n";
+                out << "    pc = s->bankStack[bankSp] << 8 | data[sp];\n";
+            } else {
+                out << "    pc = " << hex(base, 3) << " | data[sp];\n";
+            }
+            if (i & FLAG_RETI) {
+                out << "    zn = srAotResult(savedFlags);\n";
+                out << "    carry = (savedFlags & SRAotCarry) ? 1 : 0;\n";
+                out << "    ie = true;\n";
+                out << "    check = 0;\n";
+            }
+            out << "    c++;\n";
+            out << "    goto dispatch;\n";
+            return;
+
+        case OPCODE_FAR_BRANCH_TO_SUBROUTINE:
+            out << "    data[sp--] = " << hex(next & 0xff, 2) << ";\n";
+            out << "    s->bankStack[bankSp] = " << address / PROGRAM_BANK_SIZE << ";\n";
+            out << "    bankSp = (bankSp + 1) & 7;\n";
+            out << "    c++;\n";
+            out << "    goto " << label(FAR_BANK(i) * PROGRAM_BANK_SIZE + imm) << ";\n";
+            return;
+
+        case OPCODE_INTERRUPT_ENABLE:
+            out << "    ie = " << ((i & FLAG_INTERRUPT_ENABLE) ? "true" : "false") << ";\n";
+            if (i & FLAG_INTERRUPT_ENABLE)
+                out << "    check = 0;\n";
+            break;
+
+        case OPCODE_STACK_MOVE:
+            // Only the low byte of the register gets pushed or popped
+            if (i & FLAG_POP)
+                out << "    " << t << " = (" << t << " & 0xff00) | data[++sp];\n";
+            else
+                out << "    data[sp--] = (uint8_t) " << t << ";\n";
+            break;
+
+        case OPCODE_COPYDATA:
+            out << "    data[(uint8_t) " << t << "] = " << hex(imm, 2) << ";\n";
+            out << "    " << t << "++;\n";
+            break;
+
+        case OPCODE_HALT:
+            out << "    halted = true;\n";
+            out << "    c++;\n";
+            out << "    if (!ie) { pc = " << hex(address, 3) << "; status = SRAotStopped; goto out; }\n";
+            // Nothing happens while waiting until the next check
+            if (m_interrupts)
+                out << "    if (c < check) c = check;\n";
+            out << "    goto " << label(address) << ";\n";
+            return;
+
+        default:    // NOP and the unused opcodes
+            break;
+    }
+    out << "    c++;\n";
+}
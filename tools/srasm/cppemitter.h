@@ -0,0 +1,79 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef CPPEMITTER_H
+#define CPPEMITTER_H
+
+#include <QMap>
+#include <QString>
+#include <QTextStream>
+#include <QVector>
+
+// Ahead of time translation of a linked program to C++ for srasm --emit-cpp.
+// The program becomes a single function with a goto label at every basic
+// block leader, so the C++ compiler sees the whole control flow graph and
+// keeps the registers in host registers. Register indirect branches, returns
+// and interrupt vectors go through a dense switch over the leaders.
+//
+// Z and N are kept lazily as the last ALU result and only turned into flags
+// where BREQ/BRNE/BSREQ/BSRNE read them or the state is written back. Results
+// and carries that a later ALU op in the same block overwrites are never
+// stored. Cycles are counted like srsim does it, so a run matches srsim
+// exactly, but the cycle limit is only checked at block leaders.
+//
+// Interrupts are only checked between instructions in programs that contain
+// EI or RETI, and in them every instruction is a leader since an interrupt
+// can return to any of them. The leaders only compare the cycle count with
+// the next cycle the I/O said an interrupt can come at, which an I/O access,
+// EI or RETI reset, and a waiting HALT skips straight to it.
+class CppEmitter
+{
+public:
+    CppEmitter(const QVector<unsigned short>& program, const QMap<QString, int>& codeLabels);
+
+    void write(QTextStream& out, const QString& functionName) const;
+
+private:
+    void findLeaders();
+    void findDeadFlags();
+    void writeRuntime(QTextStream& out) const;
+    void writeInstruction(QTextStream& out, int address) const;
+    bool endsBlock(unsigned short instruction) const;
+    static QString label(int address);
+    static QString hex(int value, int digits);
+    static QString reg(int r);
+
+private:
+    QVector<unsigned short> m_program;      // used banks padded to 256 words
+    QVector<bool> m_banks;
+    QMap<int, QString> m_labels;            // address -> label name, for comments
+    QVector<bool> m_leader;
+    QVector<bool> m_resultDead;             // Z/N of the ALU op at the address are overwritten before use
+    QVector<bool> m_carryDead;
+    bool m_interrupts;
+    bool m_dispatch;                        // something jumps back to the dispatch switch
+};
+
+#endif // CPPEMITTER_H
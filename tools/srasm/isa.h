@@ -0,0 +1,100 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef ISA_H
+#define ISA_H
+
+// Instruction encoding stuff
+#define TARGET_REG 8
+#define SRC1_REG 6
+#define SRC2_REG 4
+#define FLAG_INDIRECT 0x0800
+#define FLAG_POST_INCREMENT 0x0001     // indirect LD, ST, IN and OUT step the address register after the access
+#define FLAG_POST_DECREMENT 0x0002
+#define POST_MODIFY_MASK 0x0003
+#define FLAG_REGISTER_JUMP_TARGET 0x0800
+#define FLAG_EXTEND 0x0400
+#define FLAG_POP 0x0800
+#define FLAG_NO_WRITEBACK 0x0800        // ALU op that only updates the flags (CMP, TST)
+#define FLAG_RETI 0x0800        // return from interrupt
+#define FLAG_FAR_RETURN 0x0400  // FRET, also pops the program memory bank
+#define FLAG_INTERRUPT_ENABLE 0x0001
+#define OPCODE_MOVE_IMM 0x1000
+#define OPCODE_LOAD 0x2000
+#define OPCODE_STORE 0x3000
+#define OPCODE_ALUOP 0x4000
+#define OPCODE_BRANCH 0x5000
+#define OPCODE_COPYDATA 0x6000
+#define OPCODE_BRANCH_TO_SUBROUTINE 0x7000
+#define OPCODE_RETURN_FROM_SUBROUTINE 0x8000
+#define OPCODE_STACK_MOVE 0x9000        // PUSH & POP
+#define OPCODE_READ_IO 0xA000   //  essentially LOAD and STORE with MSB set
+#define OPCODE_WRITE_IO 0xB000
+#define OPCODE_INTERRUPT_ENABLE 0xC000        // EI & DI
+#define OPCODE_FAR_BRANCH_TO_SUBROUTINE 0xD000        // FBSR
+#define OPCODE_HALT 0xf000
+#define OPCODE_NOP 0x0000
+
+// Decoding helpers
+#define OPCODE_MASK 0xf000
+#define REG_MASK 0x3
+#define BRANCH_CONDITION(i) (((i) >> 8) & 0x3)
+#define BRANCH_EQUAL 0
+#define BRANCH_NOT_EQUAL 1
+#define BRANCH_ALWAYS 2
+#define FAR_BANK_SHIFT 8
+#define FAR_BANK(i) (((i) >> FAR_BANK_SHIFT) & 0x7)
+#define ALU_OP(i) ((i) & 0xf)
+#define ALU_OP_ADD 0
+#define ALU_OP_SUB 1
+#define ALU_OP_SHR 2
+#define ALU_OP_SHL 3
+#define ALU_OP_ZERO 4
+#define ALU_OP_SWAP 5
+#define ALU_OP_NOT 6
+#define ALU_OP_OR 7
+#define ALU_OP_AND 8
+#define ALU_OP_XOR 9
+#define ALU_OP_NOP 10
+#define ALU_OP_DEC 11
+#define ALU_OP_INC 12
+#define ALU_OP_ADC 13
+#define ALU_OP_SBC 14
+// Carry is the carry out of the adder, for subtraction it's the inverted borrow
+#define ALU_OP_SETS_CARRY(op) ((op) == ALU_OP_ADD || (op) == ALU_OP_SUB || (op) == ALU_OP_ADC || (op) == ALU_OP_SBC)
+
+// Program memory is banked, the PC addresses 256 words within the current bank
+#define PROGRAM_BANK_SIZE 256
+#define PROGRAM_BANKS 8
+#define PROGRAM_SIZE (PROGRAM_BANK_SIZE * PROGRAM_BANKS)
+
+// Status register bits
+#define SR_ZERO 0x1
+#define SR_NEGATIVE 0x2
+#define SR_CARRY 0x4
+#define SR_HALTED 0x8
+#define SR_INTERRUPT_ENABLE 0x10
+
+#endif // ISA_H
@@ -25,56 +25,230 @@
 
 #include <QCoreApplication>
 #include <QFile>
+#include <QFileInfo>
 #include <QDebug>
 #include <QStringList>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QTextStream>
 
 #include "lexer.h"
 #include "nodes.h"
 #include "parser.h"
 #include "srprogram.h"
+#include "srlinker.h"
+#include "srimage.h"
+#include "timinganalyzer.h"
+#include "meminitfile.h"
+#include "cppemitter.h"
+#include "isa.h"
 
 int yyparse(Section*, Section*);
 extern QVariant* root;
 
-int main(int argc, char *argv[])
+static bool parseSource(const QString& filename, Section* codeSection, Section* dataSection)
 {
-    QCoreApplication a(argc, argv);
-    if (argc < 2)
-        qDebug() << "Usage: <sourcefile> [outputfile]";
-
-    QFile source(a.arguments().at(1));
+    QFile source(filename);
     if (!source.open(QFile::ReadOnly)) {
-        qDebug() << "Couldn't open source file" << a.arguments().at(1);
-        return 0;
+        qDebug() << "Couldn't open source file" << filename;
+        return false;
     }
 
     QByteArray data = source.readAll();
 
     YY_BUFFER_STATE bufferState = yy_scan_string(data.constData());
 
-    Section codeSection;
-    Section dataSection;
-
     // Parse the string.
-    yyparse(&codeSection, &dataSection);
+    yyparse(codeSection, dataSection);
 
     // flush the input stream.
     yy_delete_buffer(bufferState);
+    return true;
+}
 
-    SRProgram prg;
-    QByteArray bin = prg.assemble(&codeSection, &dataSection);
+// One label per line, "code $05 loop" or "data $10 buffer", sorted by address
+static bool writeMap(const QString& filename, const QMap<QString, int>& codeLabels, const QMap<QString, int>& dataLabels)
+{
+    QFile file(filename);
+    if (!file.open(QFile::WriteOnly)) {
+        qDebug() << "Can't open map file" << filename;
+        return false;
+    }
+
+    QTextStream out(&file);
+    for (int table = 0; table < 2; table++) {
+        const QMap<QString, int>& labels = table ? dataLabels : codeLabels;
+        QMultiMap<int, QString> byAddress;
+        for (QMap<QString, int>::const_iterator i = labels.constBegin(); i != labels.constEnd(); ++i)
+            byAddress.insert(i.value(), i.key());
+        for (QMultiMap<int, QString>::const_iterator i = byAddress.constBegin(); i != byAddress.constEnd(); ++i)
+            out << (table ? "data $" : "code $") << QString("%1").arg(i.key(), 2, 16, QChar('0')) << " " << i.value() << "\n";
+    }
+    return true;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
 
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    parser.addPositionalArgument("sourcefile", "Assembly source, or object files when linking");
+    parser.addPositionalArgument("outputfile", "Binary output, defaults to the source name with .bin extension "
+                                 "or .sri for an image", "[outputfile]");
+    QCommandLineOption compileOption("c", "Assemble to a relocatable object file (.o) instead of a binary");
+    QCommandLineOption linkOption(QStringList() << "l" << "link",
+                                  "Link the object files given as arguments into <binary>. Code that can't be "
+                                  "reached from the start of the first object through a label is removed", "binary");
+    QCommandLineOption timingOption("timing", "Print static cycle counts and worst case timing of the program");
+    QCommandLineOption clockOption("cpu-clock", "CPU clock in Hz used for timing, defaults to 6250000", "hz",
+                                   QString::number(TimingAnalyzer::DefaultCpuClock));
+    QCommandLineOption mapOption(QStringList() << "m" << "map", "Write the code and data label addresses to <file>", "file");
+    QCommandLineOption pgmInitOption("pgm-init", "Write the program memory initialization file for the ep1_pgmram "
+                                     "megafunction to <file>, Intel HEX for .hex and MIF otherwise", "file");
+    QCommandLineOption dataInitOption("data-init", "Write the initial data RAM contents for the ep1_dataram megafunction "
+                                      "to <file> and leave out the data initialization prologue. The binary then "
+                                      "doesn't initialize the data by itself", "file");
+    QCommandLineOption imageOption("image", "Write a sectioned program image instead of a flat binary. The image only "
+                                   "has the used program words and the data goes straight to the data RAM when "
+                                   "loaded, so there's no data initialization prologue");
+    QCommandLineOption cppOption("emit-cpp", "Translate the program to a C++ function in <file>. The function is named "
+                                 "after the file, sr_fibonacci() for fibonacci.cpp", "file");
+    parser.addOption(compileOption);
+    parser.addOption(linkOption);
+    parser.addOption(mapOption);
+    parser.addOption(timingOption);
+    parser.addOption(clockOption);
+    parser.addOption(pgmInitOption);
+    parser.addOption(dataInitOption);
+    parser.addOption(imageOption);
+    parser.addOption(cppOption);
+    parser.process(a);
+
+    QStringList args = parser.positionalArguments();
+    if (args.isEmpty())
+        parser.showHelp(1);
+
+    QByteArray bin;
+    QVector<unsigned short> program;
+    QMap<QString, int> codeLabels;
+    QMap<QString, int> dataLabels;
+    QByteArray dataImage;
+    SRImage image;
     QString outputFilename;
-    if (argc < 3)
-        outputFilename = a.arguments().at(1).split(".").first().append(".bin");
-      else
-        outputFilename = a.arguments().at(2);
+    bool dataInitPrologue = !parser.isSet(dataInitOption) && !parser.isSet(imageOption);
+
+    if (parser.isSet(linkOption)) {
+        SRLinker linker;
+        linker.setRemoveUnreferenced(true);
+        linker.setDataInitPrologue(dataInitPrologue);
+        foreach (QString filename, args) {
+            SRObject object;
+            if (!object.load(filename))
+                return 1;
+            linker.addObject(object);
+        }
+
+        bin = linker.link();
+        if (bin.isEmpty())
+            return 1;
+        qDebug() << "Removed" << linker.removedInstructions() << "unreferenced instructions";
+        program = linker.program();
+        codeLabels = linker.codeLabels();
+        dataLabels = linker.dataLabels();
+        dataImage = linker.dataImage();
+        image = linker.image();
+        outputFilename = parser.value(linkOption);
+    } else {
+        Section codeSection;
+        Section dataSection;
+        if (!parseSource(args.at(0), &codeSection, &dataSection))
+            return 0;
+
+        SRProgram prg;
+        if (parser.isSet(compileOption)) {
+            SRObject object = prg.compile(&codeSection, &dataSection, QFileInfo(args.at(0)).baseName());
+            if (args.length() < 2)
+                outputFilename = args.at(0).split(".").first().append(".o");
+              else
+                outputFilename = args.at(1);
+            if (!object.save(outputFilename))
+                return 1;
+            qDebug() << "Wrote object to" << outputFilename;
+            return 0;
+        }
+
+        bin = prg.assemble(&codeSection, &dataSection, dataInitPrologue);
+        program = prg.program();
+        codeLabels = prg.codeLabels();
+        dataLabels = prg.dataLabels();
+        dataImage = prg.dataImage();
+        image = prg.image();
+
+        if (args.length() < 2)
+            outputFilename = args.at(0).split(".").first().append(parser.isSet(imageOption) ? ".sri" : ".bin");
+          else
+            outputFilename = args.at(1);
+    }
+
+    if (parser.isSet(mapOption) && !bin.isEmpty())
+        writeMap(parser.value(mapOption), codeLabels, dataLabels);
+
+    if (parser.isSet(pgmInitOption) && !bin.isEmpty()) {
+        if (!writeMemInitFile(parser.value(pgmInitOption), program, 16, PROGRAM_SIZE))
+            return 1;
+        qDebug() << "Wrote program memory initialization to" << parser.value(pgmInitOption);
+    }
+
+    if (parser.isSet(dataInitOption) && !bin.isEmpty()) {
+        QVector<unsigned short> data;
+        foreach (char byte, dataImage)
+            data.append((unsigned char) byte);
+        if (!writeMemInitFile(parser.value(dataInitOption), data, 8, data.size()))
+            return 1;
+        qDebug() << "Wrote data memory initialization to" << parser.value(dataInitOption);
+    }
+
+    if (parser.isSet(cppOption) && !bin.isEmpty()) {
+        QString filename = parser.value(cppOption);
+        QFile file(filename);
+        if (!file.open(QFile::WriteOnly)) {
+            qDebug() << "Can't open C++ output file" << filename;
+            return 1;
+        }
+        QString name = "sr_" + QFileInfo(filename).baseName();
+        for (int i = 0; i < name.length(); i++) {
+            if (!name.at(i).isLetterOrNumber() && name.at(i) != '_')
+                name[i] = '_';
+        }
+        QTextStream out(&file);
+        CppEmitter emitter(program, codeLabels);
+        emitter.write(out, name);
+        qDebug() << "Wrote" << name << "to" << filename;
+    }
+
+    if (parser.isSet(timingOption) && !bin.isEmpty()) {
+        QElapsedTimer timer;
+        timer.start();
+        TimingAnalyzer analyzer(program, codeLabels);
+        analyzer.analyze();
+        qint64 elapsed = timer.nsecsElapsed();
+
+        QTextStream out(stdout);
+        analyzer.report(out, parser.value(clockOption).toInt());
+        out << "\nAnalyzed " << program.size() << " instructions in " << elapsed / 1000 << " us\n";
+    }
 
     QFile output(outputFilename);
     if (!output.open(QFile::WriteOnly)) {
         qDebug() << "Can't open outputfile" << outputFilename;
     }
 
-    qDebug() << "Wrote binary to" << outputFilename;
-    output.write(bin);
+    if (parser.isSet(imageOption)) {
+        qDebug() << "Wrote image to" << outputFilename;
+        output.write(image.toByteArray());
+    } else {
+        qDebug() << "Wrote binary to" << outputFilename;
+        output.write(bin);
+    }
 }
@@ -0,0 +1,95 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "meminitfile.h"
+#include <QDebug>
+#include <QFile>
+#include <QTextStream>
+
+// One word per record like Quartus writes them, the record address is the word address
+static void writeHex(QTextStream& out, const QVector<unsigned short>& words, int width)
+{
+    int bytes = (width + 7) / 8;
+    for (int i = 0; i < words.size(); i++) {
+        QByteArray record;
+        record.append((char) bytes);
+        record.append((char) (i >> 8));
+        record.append((char) i);
+        record.append((char) 0);     // data record
+        for (int b = bytes - 1; b >= 0; b--)
+            record.append((char) (words.at(i) >> b * 8));
+        unsigned char checksum = 0;
+        foreach (char c, record)
+            checksum += (unsigned char) c;
+        record.append((char) -checksum);
+        out << ":" << record.toHex().toUpper() << "\n";
+    }
+    out << ":00000001FF\n";
+}
+
+static void writeMif(QTextStream& out, const QVector<unsigned short>& words, int width)
+{
+    int addressDigits = QString::number(words.size() - 1, 16).length();
+    int dataDigits = (width + 3) / 4;
+    out << "-- Written by srasm\n";
+    out << "WIDTH=" << width << ";\n";
+    out << "DEPTH=" << words.size() << ";\n\n";
+    out << "ADDRESS_RADIX=HEX;\nDATA_RADIX=HEX;\n\n";
+    out << "CONTENT BEGIN\n";
+
+    // Trailing zeros go in as a single range
+    int used = words.size();
+    while (used > 0 && words.at(used - 1) == 0)
+        used--;
+    for (int i = 0; i < used; i++)
+        out << QString("\t%1 : %2;\n").arg(i, addressDigits, 16, QChar('0')).arg(words.at(i), dataDigits, 16, QChar('0')).toUpper();
+    if (used < words.size())
+        out << QString("\t[%1..%2] : %3;\n").arg(used, addressDigits, 16, QChar('0')).arg(words.size() - 1, addressDigits, 16, QChar('0'))
+               .arg(0, dataDigits, 16, QChar('0')).toUpper();
+    out << "END;\n";
+}
+
+bool writeMemInitFile(const QString &filename, const QVector<unsigned short> &contents, int width, int depth)
+{
+    if (contents.size() > depth) {
+        qDebug() << "Error:" << contents.size() << "words don't fit in" << depth << "for" << filename;
+        return false;
+    }
+
+    QFile file(filename);
+    if (!file.open(QFile::WriteOnly)) {
+        qDebug() << "Can't open" << filename;
+        return false;
+    }
+
+    QVector<unsigned short> words = contents;
+    words.resize(depth);
+    QTextStream out(&file);
+    if (filename.endsWith(".hex", Qt::CaseInsensitive))
+        writeHex(out, words, width);
+    else
+        writeMif(out, words, width);
+    return true;
+}
@@ -39,3 +39,5 @@ void LoadInstruction::visit(SRProgram *p) { p->handleNode(this); }
 void StoreInstruction::visit(SRProgram *p) { p->handleNode(this); }
 void ReturnInstruction::visit(SRProgram *p) { p->handleNode(this); }
 void StackMoveInstruction::visit(SRProgram *p) { p->handleNode(this); }
+void InterruptEnableInstruction::visit(SRProgram *p) { p->handleNode(this); }
+void BankDirective::visit(SRProgram *p) { p->handleNode(this); }
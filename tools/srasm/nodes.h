@@ -36,6 +36,7 @@ class SRProgram;
 
 class Node {
 public:
+    virtual ~Node() {}
     virtual void visit(SRProgram* p) = 0;
 };
 
@@ -46,7 +47,7 @@ public:
 
 class AluInstruction : public Node {
 public:
-    enum Op { Add, Sub, Zero, And, Or, Xor, Not, Swap, Nop, Dec, Inc };
+    enum Op { Add, Sub, Zero, And, Or, Xor, Not, Swap, Nop, Dec, Inc, Adc, Sbc, Cmp, Tst };
     void visit(SRProgram *p);
 
     Op op;
@@ -107,11 +108,28 @@ public:
     QString label;
     int jumpTargetRegister;
     bool subroutineCall;
+    bool far;       // FBSR, the linker fills in the bank
 };
 
 class ReturnInstruction : public Node {
 public:
+    ReturnInstruction(bool fromInterrupt = false, bool far = false) : fromInterrupt(fromInterrupt), far(far) {}
     void visit(SRProgram* p);
+    bool fromInterrupt;     // RETI, also enables interrupts and restores the flags
+    bool far;               // FRET, returns from a routine entered with FBSR
+};
+
+// Places the code that follows into a program memory bank
+class BankDirective : public Node {
+public:
+    void visit(SRProgram* p);
+    int bank;
+};
+
+class InterruptEnableInstruction : public Node {
+public:
+    void visit(SRProgram* p);
+    bool enable;
 };
 
 class StackMoveInstruction : public Node {
@@ -122,6 +140,9 @@ public:
     bool extendedReg;   // generate push/pop swap push/pop swap combo to push/pop the whole 16-bit reg
 };
 
+// Post-increment or decrement of the address register of indirect loads and stores
+enum PostModify { NoPostModify, PostIncrement, PostDecrement };
+
 class LoadInstruction : public Node {
 public:
     void visit(SRProgram *p);
@@ -130,6 +151,7 @@ public:
     bool signExtend;
     QString sourceLabel;    // source is ignored if sourceLabel is defined
     int source;     // doubles as register or address depending on indirect flag
+    PostModify postModify;      // indirect only
     int targetRegister;
 
 };
@@ -141,6 +163,7 @@ public:
     bool indirect;
     QString targetLabel;    // target is ignored if targetLabel is defined
     int target;     // doubles as register or address depending on indirect flag
+    PostModify postModify;      // indirect only
     int sourceRegister;
 };
 
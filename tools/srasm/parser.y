@@ -49,6 +49,7 @@ void addBranchInstruction(Section* section, BranchInstruction::Condition conditi
     n->condition = condition;
     n->jumpTargetRegister = jumpTargetRegister;
     n->subroutineCall = subroutine;
+    n->far = false;
     section->m_nodes.append(n);
 }
 
@@ -73,6 +74,8 @@ void addBranchInstruction(Section* section, BranchInstruction::Condition conditi
 %token <i> TOK_REGISTER
 %token TOK_LPAREN
 %token TOK_RPAREN
+%token TOK_RPAREN_INC
+%token TOK_RPAREN_DEC
 %token TOK_SOMETHING
 %token TOK_SECTION
 %token TOK_CODE
@@ -88,6 +91,10 @@ void addBranchInstruction(Section* section, BranchInstruction::Condition conditi
 %token TOK_ST
 %token TOK_ADD
 %token TOK_SUB
+%token TOK_ADC
+%token TOK_SBC
+%token TOK_CMP
+%token TOK_TST
 %token TOK_CLR
 %token TOK_SWAP
 %token TOK_NOT
@@ -104,6 +111,12 @@ void addBranchInstruction(Section* section, BranchInstruction::Condition conditi
 %token TOK_IN
 %token TOK_BSR
 %token TOK_RET
+%token TOK_RETI
+%token TOK_FBSR
+%token TOK_FRET
+%token TOK_BANK
+%token TOK_EI
+%token TOK_DI
 %token TOK_PUSH
 %token TOK_POP
 
@@ -112,6 +125,7 @@ void addBranchInstruction(Section* section, BranchInstruction::Condition conditi
 %type <str> label
 %type <data> db
 %type <i> rb
+%type <i> indirect_end
 
 %destructor {delete $$;} TOK_LABEL
 %destructor {delete $$;} TOK_LABEL_REF
@@ -121,9 +135,10 @@ void addBranchInstruction(Section* section, BranchInstruction::Condition conditi
 
 %%
 
-start : endls TOK_SECTION TOK_CODE code_statements TOK_END endls {
+// Blank lines are allowed before the code section with or without a data section
+start : opt_endls TOK_SECTION TOK_CODE code_statements TOK_END endls {
     }
-      | TOK_SECTION TOK_CODE code_statements TOK_SECTION TOK_DATA data_statements TOK_END endls {
+      | opt_endls TOK_SECTION TOK_CODE code_statements TOK_SECTION TOK_DATA data_statements TOK_END endls {
     }
 
 
@@ -143,6 +158,10 @@ code_statement : label {
               | swap
               | add
               | sub
+              | adc
+              | sbc
+              | cmp
+              | tst
               | and
               | or
               | xor
@@ -158,6 +177,8 @@ code_statement : label {
               | bsr
               | push
               | pop
+              | ei
+              | bank
 
 data_statements : data_statements data_statement
                 | data_statement
@@ -184,6 +205,9 @@ data_statement : label {
 endls : endls TOK_ENDL
       | TOK_ENDL
 
+opt_endls : endls
+          | /* empty */
+
 label : TOK_LABEL TOK_ENDL
 
 empty_line : TOK_ENDL
@@ -218,6 +242,38 @@ nop : TOK_RET TOK_ENDL  {
     codeSection->m_nodes.append(new ReturnInstruction);
 }
 
+nop : TOK_RETI TOK_ENDL  {
+    codeSection->m_nodes.append(new ReturnInstruction(true));
+}
+
+nop : TOK_FRET TOK_ENDL  {
+    codeSection->m_nodes.append(new ReturnInstruction(false, true));
+}
+
+// Code after "bank 1" goes to program memory bank 1. BSR across banks goes through a stub
+// the linker generates, FBSR calls a routine that returns with FRET directly.
+bank : TOK_BANK TOK_INTEGER TOK_ENDL {
+        BankDirective* n = new BankDirective;
+        n->bank = $2;
+        codeSection->m_nodes.append(n);
+    }
+
+ei : TOK_EI TOK_ENDL {
+        InterruptEnableInstruction* n = new InterruptEnableInstruction;
+        n->enable = true;
+        codeSection->m_nodes.append(n);
+    }
+   | TOK_DI TOK_ENDL {
+        InterruptEnableInstruction* n = new InterruptEnableInstruction;
+        n->enable = false;
+        codeSection->m_nodes.append(n);
+    }
+
+// (r1) leaves the address register alone, (r1)+ and (r1)- step it after the access
+indirect_end : TOK_RPAREN { $$ = NoPostModify; }
+             | TOK_RPAREN_INC { $$ = PostIncrement; }
+             | TOK_RPAREN_DEC { $$ = PostDecrement; }
+
 //  ld $123, r0
 ld : TOK_LD TOK_INTEGER TOK_COMMA TOK_REGISTER TOK_ENDL {
         LoadInstruction* n = new LoadInstruction();
@@ -238,11 +294,12 @@ ld : TOK_LD TOK_INTEGER TOK_COMMA TOK_REGISTER TOK_ENDL {
        n->io = false;
        codeSection->m_nodes.append(n);
     }
-// ld (r1), r0
-   | TOK_LD TOK_LPAREN TOK_REGISTER TOK_RPAREN TOK_COMMA TOK_REGISTER TOK_ENDL {
+// ld (r1), r0 or ld (r1)+, r0
+   | TOK_LD TOK_LPAREN TOK_REGISTER indirect_end TOK_COMMA TOK_REGISTER TOK_ENDL {
        LoadInstruction* n = new LoadInstruction();
        n->indirect = true;
        n->source = $3;
+       n->postModify = (PostModify) $4;
        n->targetRegister = $6;
        n->signExtend = $6 & 0x80000000;
        n->io = false;
@@ -258,10 +315,11 @@ in : TOK_IN TOK_INTEGER TOK_COMMA TOK_REGISTER TOK_ENDL {
         n->io = true;
         codeSection->m_nodes.append(n);
     }
-   | TOK_IN TOK_LPAREN TOK_REGISTER TOK_RPAREN TOK_COMMA TOK_REGISTER TOK_ENDL {
+   | TOK_IN TOK_LPAREN TOK_REGISTER indirect_end TOK_COMMA TOK_REGISTER TOK_ENDL {
        LoadInstruction* n = new LoadInstruction();
        n->indirect = true;
        n->source = $3;
+       n->postModify = (PostModify) $4;
        n->targetRegister = $6;
        n->signExtend = $6 & 0x80000000;
        n->io = true;
@@ -285,10 +343,11 @@ st : TOK_ST TOK_REGISTER TOK_COMMA TOK_INTEGER TOK_ENDL {
        n->io = false;
        codeSection->m_nodes.append(n);
 }
-   | TOK_ST TOK_REGISTER TOK_COMMA TOK_LPAREN TOK_REGISTER TOK_RPAREN TOK_ENDL {
+   | TOK_ST TOK_REGISTER TOK_COMMA TOK_LPAREN TOK_REGISTER indirect_end TOK_ENDL {
         StoreInstruction* n = new StoreInstruction();
         n->indirect = true;
         n->target = $5;
+        n->postModify = (PostModify) $6;
         n->sourceRegister = $2;
         n->io = false;
         codeSection->m_nodes.append(n);
@@ -302,10 +361,11 @@ out : TOK_OUT TOK_REGISTER TOK_COMMA TOK_INTEGER TOK_ENDL {
         n->io = true;
         codeSection->m_nodes.append(n);
     }
-   | TOK_OUT TOK_REGISTER TOK_COMMA TOK_LPAREN TOK_REGISTER TOK_RPAREN TOK_ENDL {
+   | TOK_OUT TOK_REGISTER TOK_COMMA TOK_LPAREN TOK_REGISTER indirect_end TOK_ENDL {
         StoreInstruction* n = new StoreInstruction();
         n->indirect = true;
         n->target = $5;
+        n->postModify = (PostModify) $6;
         n->sourceRegister = $2;
         n->io = true;
         codeSection->m_nodes.append(n);
@@ -319,6 +379,26 @@ sub : TOK_SUB TOK_REGISTER TOK_COMMA TOK_REGISTER TOK_COMMA TOK_REGISTER TOK_END
         addAluInstruction(codeSection, $6, $2, $4, AluInstruction::Sub);
     }
 
+adc : TOK_ADC TOK_REGISTER TOK_COMMA TOK_REGISTER TOK_COMMA TOK_REGISTER TOK_ENDL {
+        addAluInstruction(codeSection, $6, $2, $4, AluInstruction::Adc);
+    }
+
+sbc : TOK_SBC TOK_REGISTER TOK_COMMA TOK_REGISTER TOK_COMMA TOK_REGISTER TOK_ENDL {
+        addAluInstruction(codeSection, $6, $2, $4, AluInstruction::Sbc);
+    }
+
+// Compare and test only set the flags, the target register is don't care
+cmp : TOK_CMP TOK_REGISTER TOK_COMMA TOK_REGISTER TOK_ENDL {
+        addAluInstruction(codeSection, $2, $2, $4, AluInstruction::Cmp);
+    }
+
+tst : TOK_TST TOK_REGISTER TOK_COMMA TOK_REGISTER TOK_ENDL {
+        addAluInstruction(codeSection, $2, $2, $4, AluInstruction::Tst);
+    }
+    | TOK_TST TOK_REGISTER TOK_ENDL {
+        addAluInstruction(codeSection, $2, $2, $2, AluInstruction::Tst);
+    }
+
 and : TOK_AND TOK_REGISTER TOK_COMMA TOK_REGISTER TOK_COMMA TOK_REGISTER TOK_ENDL {
         addAluInstruction(codeSection, $6, $2, $4, AluInstruction::And);
     }
@@ -387,6 +467,15 @@ bsr : TOK_BSR TOK_LABEL_REF TOK_ENDL {
     | TOK_BSR TOK_REGISTER TOK_ENDL {
     addBranchInstruction(codeSection, BranchInstruction::Always, QString(), true, $2);
 }
+    | TOK_FBSR TOK_LABEL_REF TOK_ENDL {
+        BranchInstruction* n = new BranchInstruction;
+        n->label = *$2;
+        n->condition = BranchInstruction::Always;
+        n->jumpTargetRegister = -1;
+        n->subroutineCall = true;
+        n->far = true;
+        codeSection->m_nodes.append(n);
+    }
 
 push : TOK_PUSH TOK_REGISTER {
     StackMoveInstruction* n = new StackMoveInstruction();
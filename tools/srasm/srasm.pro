@@ -10,10 +10,23 @@ TEMPLATE = app
 QMAKE_CXXFLAGS = -std=c++0x
 
 HEADERS += nodes.h \
-    srprogram.h
+    srprogram.h \
+    isa.h \
+    timinganalyzer.h \
+    srobject.h \
+    srlinker.h \
+    meminitfile.h \
+    cppemitter.h \
+    srimage.h
 SOURCES += main.cpp \
     nodes.cpp \
-    srprogram.cpp
+    srprogram.cpp \
+    timinganalyzer.cpp \
+    srobject.cpp \
+    srlinker.cpp \
+    meminitfile.cpp \
+    cppemitter.cpp \
+    srimage.cpp
 
 # Flex and bison stuff shamelessly ripped from http://hipersayanx.blogspot.com/2013/03/using-flex-and-bison-with-qt.html
 LIBS += -lfl -ly
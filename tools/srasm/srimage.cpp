@@ -0,0 +1,137 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "srimage.h"
+#include "isa.h"
+#include <QDataStream>
+#include <QDebug>
+
+static const quint32 ImageMagic = 0x5352494d;      // "SRIM"
+static const quint16 ImageVersion = 1;
+
+SRImage::SRImage() :
+    m_entry(0)
+{
+}
+
+bool SRImage::isImage(const QByteArray &file)
+{
+    return file.startsWith("SRIM");
+}
+
+bool SRImage::parse(const QByteArray &file)
+{
+    QDataStream in(file);
+    quint32 magic;
+    quint16 version, entry, count;
+    in >> magic >> version;
+    if (magic != ImageMagic || version != ImageVersion) {
+        qDebug() << "Not a version" << ImageVersion << "program image";
+        return false;
+    }
+    in >> entry >> count;
+    m_entry = entry;
+
+    m_sections.clear();
+    for (int i = 0; i < count && in.status() == QDataStream::Ok; i++) {
+        quint8 type;
+        quint16 address;
+        Section s;
+        in >> type >> address >> s.bytes;
+        s.type = (SectionType) type;
+        s.address = address;
+
+        bool valid;
+        if (s.type == ProgramSection)
+            valid = s.bytes.length() % 2 == 0 && (s.address % PROGRAM_BANK_SIZE) + s.bytes.length() / 2 <= PROGRAM_BANK_SIZE
+                    && s.address < PROGRAM_SIZE;
+        else
+            valid = s.type == DataSection && s.address + s.bytes.length() <= 256;
+        if (!valid) {
+            qDebug() << "Invalid section" << i << "in the program image";
+            return false;
+        }
+        m_sections.append(s);
+    }
+
+    if (in.status() != QDataStream::Ok) {
+        qDebug() << "Truncated program image";
+        return false;
+    }
+    return true;
+}
+
+QByteArray SRImage::toByteArray() const
+{
+    QByteArray file;
+    QDataStream out(&file, QIODevice::WriteOnly);
+    out << ImageMagic << ImageVersion << (quint16) m_entry << (quint16) m_sections.length();
+    foreach (const Section& s, m_sections)
+        out << (quint8) s.type << (quint16) s.address << s.bytes;
+    return file;
+}
+
+void SRImage::addProgram(int address, const QVector<unsigned short> &words)
+{
+    int i = 0;
+    while (i < words.size()) {
+        Section s;
+        s.type = ProgramSection;
+        s.address = address + i;
+        int end = qMin(words.size(), i + PROGRAM_BANK_SIZE - s.address % PROGRAM_BANK_SIZE);
+        for (; i < end; i++) {
+            s.bytes.append((char) (words.at(i) >> 8));
+            s.bytes.append((char) words.at(i));
+        }
+        m_sections.append(s);
+    }
+}
+
+void SRImage::addData(int address, const QByteArray &bytes)
+{
+    Section s;
+    s.type = DataSection;
+    s.address = address;
+    s.bytes = bytes;
+    m_sections.append(s);
+}
+
+QVector<unsigned short> SRImage::program() const
+{
+    int size = 0;
+    foreach (const Section& s, m_sections) {
+        if (s.type == ProgramSection)
+            size = qMax(size, s.address + s.bytes.length() / 2);
+    }
+
+    QVector<unsigned short> words(size, 0);
+    foreach (const Section& s, m_sections) {
+        if (s.type != ProgramSection)
+            continue;
+        for (int i = 0; i < s.bytes.length() / 2; i++)
+            words[s.address + i] = (unsigned char) s.bytes.at(i * 2) << 8 | (unsigned char) s.bytes.at(i * 2 + 1);
+    }
+    return words;
+}
@@ -0,0 +1,78 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef SRIMAGE_H
+#define SRIMAGE_H
+
+#include <QList>
+#include <QVector>
+#include <QString>
+#include <QByteArray>
+
+// Sectioned program image. Unlike the flat binary, which holds the program memory
+// banks back to back and initializes the data RAM with a COPYDATA per byte, the image
+// only has the program words each bank uses and the initialized data as segments that
+// the loader writes to the data RAM directly, so data tables cost neither program
+// words nor startup cycles.
+//
+// The file is a QDataStream: "SRIM", version and entry point (bank * 256 + address),
+// followed by the section count and the sections, each a type, a start address and
+// the contents. Program sections hold big-endian words and stay within a bank.
+class SRImage
+{
+public:
+    SRImage();
+
+    enum SectionType { ProgramSection = 1, DataSection = 2 };
+
+    struct Section {
+        SectionType type;
+        int address;        // bank * 256 + address for program sections, data RAM address for data
+        QByteArray bytes;
+    };
+
+    // True if the file starts with the image magic rather than being a flat binary
+    static bool isImage(const QByteArray& file);
+
+    bool parse(const QByteArray& file);
+    QByteArray toByteArray() const;
+
+    void setEntry(int address) { m_entry = address; }
+    int entry() const { return m_entry; }
+
+    // Splits the words at bank boundaries
+    void addProgram(int address, const QVector<unsigned short>& words);
+    void addData(int address, const QByteArray& bytes);
+
+    QList<Section> sections() const { return m_sections; }
+    // The program sections as a flat program memory image, unused words are 0
+    QVector<unsigned short> program() const;
+
+private:
+    int m_entry;
+    QList<Section> m_sections;
+};
+
+#endif // SRIMAGE_H
@@ -0,0 +1,447 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "srlinker.h"
+#include "isa.h"
+#include <QDebug>
+
+const int SRLinker::DefaultMaxProgramSize;
+
+SRLinker::SRLinker() :
+    m_removeUnreferenced(false),
+    m_dataInitPrologue(true),
+    m_maxProgramSize(DefaultMaxProgramSize),
+    m_removedInstructions(0)
+{
+}
+
+void SRLinker::addObject(const SRObject &object)
+{
+    m_objects.append(object);
+}
+
+QByteArray SRLinker::link()
+{
+    m_program.clear();
+    m_bankSizes.clear();
+    m_codeLabels.clear();
+    m_dataLabels.clear();
+    m_removedInstructions = 0;
+
+    if (!collectGlobals())
+        return QByteArray();
+
+    // Data sections are concatenated in object order
+    m_dataBase.clear();
+    int dataSize = 0;
+    foreach (const SRObject& object, m_objects) {
+        m_dataBase.append(dataSize);
+        dataSize += object.dataSize;
+    }
+    if (dataSize > 255) {
+        qDebug() << "Error: data section over allocation," << dataSize << "bytes";
+        return QByteArray();
+    }
+
+    buildChunks();
+    if (!markLiveChunks())
+        return QByteArray();
+
+    // Generate instructions to copy data sections to ram. All regs are 0 after reset
+    // so the pointer register only needs to be loaded when there's a gap between segments.
+    m_dataImage.fill(0, 256);
+    m_dataSegments.clear();
+    int dataPtr = 0;
+    for (int m = 0; m < m_objects.length(); m++) {
+        foreach (SRObject::DataSegment seg, m_objects.at(m).data) {
+            if (seg.first.isEmpty())
+                continue;
+            int offset = m_dataBase.at(m) + seg.second;
+            m_dataImage.replace(offset, seg.first.length(), seg.first);
+            if (!m_dataSegments.isEmpty() && m_dataSegments.last().second + m_dataSegments.last().first.length() == offset)
+                m_dataSegments.last().first.append(seg.first);
+            else
+                m_dataSegments.append(qMakePair(seg.first, offset));
+            if (!m_dataInitPrologue)
+                continue;
+            if (offset != dataPtr)
+                m_program.append(OPCODE_MOVE_IMM | offset);
+            for (int i = 0; i < seg.first.length(); i++)
+                m_program.append(OPCODE_COPYDATA | FLAG_INDIRECT | (unsigned char) seg.first.at(i));
+            dataPtr = offset + seg.first.length();
+        }
+    }
+
+    if (m_chunks.isEmpty() || m_chunks.first().bank != 0) {
+        qDebug() << "Error: execution starts from bank 0, the first object can't start with a bank directive";
+        m_program.clear();
+        return QByteArray();
+    }
+
+    QVector<int> bankSizes(PROGRAM_BANKS, 0);
+    bankSizes[0] = m_program.length();
+    for (int c = 0; c < m_chunks.length(); c++) {
+        Chunk& chunk = m_chunks[c];
+        chunk.address = bankSizes.at(chunk.bank);
+        if (chunk.live)
+            bankSizes[chunk.bank] += chunk.end - chunk.start;
+        else
+            m_removedInstructions += chunk.end - chunk.start;
+
+        if (chunk.live && c + 1 < m_chunks.length() && m_chunks.at(c + 1).module == chunk.module
+                && m_chunks.at(c + 1).bank != chunk.bank && fallsThrough(chunk))
+            qDebug() << "Warning: code at the end of bank" << chunk.bank << "in" << m_objects.at(chunk.module).name
+                     << "falls through to bank" << m_chunks.at(c + 1).bank;
+    }
+
+    if (!placeFarStubs(bankSizes)) {
+        m_program.clear();
+        return QByteArray();
+    }
+
+    // Check that all the code and data fits in the program memory
+    int banks = 1;
+    for (int b = 0; b < PROGRAM_BANKS; b++) {
+        if (bankSizes.at(b) > m_maxProgramSize) {
+            if (b == 0) {
+                qDebug() << "Error: can't fit instructions and data in" << m_maxProgramSize << "words";
+                qDebug() << "Instruction count:" << bankSizes.at(0) - m_program.length() << "Data length:" << m_program.length();
+            } else {
+                qDebug() << "Error: can't fit the instructions of bank" << b << "in" << m_maxProgramSize << "words";
+            }
+            m_program.clear();
+            return QByteArray();
+        }
+        if (bankSizes.at(b))
+            banks = b + 1;
+    }
+
+    m_bankSizes = bankSizes;
+
+    // Banks are padded to full size except the last one
+    m_program.resize(banks > 1 ? (banks - 1) * PROGRAM_BANK_SIZE + bankSizes.at(banks - 1) : bankSizes.at(0));
+    foreach (const Chunk& chunk, m_chunks) {
+        if (!chunk.live)
+            continue;
+        int address = chunk.bank * PROGRAM_BANK_SIZE + chunk.address;
+        for (int i = chunk.start; i < chunk.end; i++)
+            m_program[address++] = m_objects.at(chunk.module).instructions.at(i);
+    }
+
+    // Patch the 8-bit address fields, FBSR gets the bank too
+    for (int m = 0; m < m_objects.length(); m++) {
+        foreach (SRObject::Relocation r, m_objects.at(m).relocations) {
+            const Chunk& chunk = m_chunks.at(chunkAt(m, r.instruction));
+            if (!chunk.live)
+                continue;
+            Symbol symbol;
+            resolve(m, r, &symbol);
+            int target = symbolAddress(symbol);
+            unsigned short& instruction = m_program[chunk.bank * PROGRAM_BANK_SIZE + chunk.address + r.instruction - chunk.start];
+            if (symbol.kind == SRObject::CodeSymbol && (instruction & OPCODE_MASK) == OPCODE_BRANCH_TO_SUBROUTINE
+                    && m_farStubs.contains(qMakePair(symbol.module, symbol.address)) && symbolBank(symbol) != chunk.bank)
+                instruction = OPCODE_FAR_BRANCH_TO_SUBROUTINE | m_farStubs.value(qMakePair(symbol.module, symbol.address));
+            else if ((instruction & OPCODE_MASK) == OPCODE_FAR_BRANCH_TO_SUBROUTINE)
+                instruction |= target;
+            else
+                instruction |= target & 0xff;
+        }
+    }
+
+    // __far_<label>: bsr <label>; fret
+    for (QMap<QPair<int, int>, int>::const_iterator i = m_farStubs.constBegin(); i != m_farStubs.constEnd(); ++i) {
+        Symbol routine;
+        routine.kind = SRObject::CodeSymbol;
+        routine.module = i.key().first;
+        routine.address = i.key().second;
+        m_program[i.value()] = OPCODE_BRANCH_TO_SUBROUTINE | (BRANCH_ALWAYS << 8) | (symbolAddress(routine) & 0xff);
+        m_program[i.value() + 1] = OPCODE_RETURN_FROM_SUBROUTINE | FLAG_FAR_RETURN;
+        m_codeLabels.insert("__far_" + m_farStubNames.value(i.value()), i.value());
+    }
+
+    for (int m = 0; m < m_objects.length(); m++) {
+        const QMap<QString, int>& labels = m_objects.at(m).codeLabels;
+        for (QMap<QString, int>::const_iterator i = labels.constBegin(); i != labels.constEnd(); ++i) {
+            const Chunk& chunk = m_chunks.at(chunkAt(m, i.value()));
+            if (chunk.live || chunk.start == chunk.end)
+                m_codeLabels.insert(qualifiedName(m, i.key()), chunk.bank * PROGRAM_BANK_SIZE + chunk.address + i.value() - chunk.start);
+        }
+        const QMap<QString, int>& data = m_objects.at(m).dataLabels;
+        for (QMap<QString, int>::const_iterator i = data.constBegin(); i != data.constEnd(); ++i)
+            m_dataLabels.insert(qualifiedName(m, i.key()), m_dataBase.at(m) + i.value());
+    }
+
+    QByteArray bin;
+    bin.fill(0, qMax(m_program.length(), DefaultMaxProgramSize) * 2);
+    for (int i = 0; i < m_program.length(); i++) {
+        bin[i * 2] = (char) (m_program.at(i) >> 8);
+        bin[i * 2 + 1] = (char) m_program.at(i);
+    }
+    return bin;
+}
+
+SRImage SRLinker::image() const
+{
+    SRImage image;
+    for (int b = 0; b < m_bankSizes.size(); b++) {
+        if (m_bankSizes.at(b))
+            image.addProgram(b * PROGRAM_BANK_SIZE, m_program.mid(b * PROGRAM_BANK_SIZE, m_bankSizes.at(b)));
+    }
+    foreach (const SRObject::DataSegment& seg, m_dataSegments)
+        image.addData(seg.second, seg.first);
+    return image;
+}
+
+bool SRLinker::collectGlobals()
+{
+    m_globalCode.clear();
+    m_globalData.clear();
+
+    bool ok = true;
+    for (int m = 0; m < m_objects.length(); m++) {
+        const SRObject& object = m_objects.at(m);
+        for (int table = 0; table < 2; table++) {
+            const QMap<QString, int>& labels = table ? object.dataLabels : object.codeLabels;
+            QMap<QString, Symbol>& globals = table ? m_globalData : m_globalCode;
+            for (QMap<QString, int>::const_iterator i = labels.constBegin(); i != labels.constEnd(); ++i) {
+                if (SRObject::isLocalSymbol(i.key()))
+                    continue;
+                if (globals.contains(i.key())) {
+                    qDebug() << "Error: label" << i.key() << "defined in both" << m_objects.at(globals.value(i.key()).module).name
+                             << "and" << object.name;
+                    ok = false;
+                    continue;
+                }
+                Symbol s;
+                s.kind = table ? SRObject::DataSymbol : SRObject::CodeSymbol;
+                s.module = m;
+                s.address = i.value();
+                globals.insert(i.key(), s);
+            }
+        }
+    }
+    return ok;
+}
+
+bool SRLinker::findSymbol(int module, const QString &name, SRObject::SymbolKind kind, Symbol *symbol) const
+{
+    const QMap<QString, int>& labels = kind == SRObject::DataSymbol ? m_objects.at(module).dataLabels
+                                                                     : m_objects.at(module).codeLabels;
+    if (SRObject::isLocalSymbol(name)) {
+        if (!labels.contains(name))
+            return false;
+        symbol->kind = kind;
+        symbol->module = module;
+        symbol->address = labels.value(name);
+        return true;
+    }
+
+    const QMap<QString, Symbol>& globals = kind == SRObject::DataSymbol ? m_globalData : m_globalCode;
+    if (!globals.contains(name))
+        return false;
+    *symbol = globals.value(name);
+    return true;
+}
+
+bool SRLinker::resolve(int module, const SRObject::Relocation &relocation, Symbol *symbol) const
+{
+    // Data labels take precedence over code labels for MOV
+    if (relocation.kind != SRObject::CodeSymbol && findSymbol(module, relocation.symbol, SRObject::DataSymbol, symbol))
+        return true;
+    if (relocation.kind != SRObject::DataSymbol && findSymbol(module, relocation.symbol, SRObject::CodeSymbol, symbol))
+        return true;
+    return false;
+}
+
+void SRLinker::buildChunks()
+{
+    m_chunks.clear();
+    m_chunkStarts.clear();
+
+    for (int m = 0; m < m_objects.length(); m++) {
+        const SRObject& object = m_objects.at(m);
+        QMap<int, int> starts;
+        starts.insert(0, 0);
+        foreach (int address, object.codeLabels)
+            starts.insert(address, 0);
+        foreach (int address, object.banks.keys())
+            starts.insert(address, 0);
+
+        QList<int> addresses = starts.keys();
+        for (int i = 0; i < addresses.length(); i++) {
+            Chunk chunk;
+            chunk.module = m;
+            chunk.start = addresses.at(i);
+            chunk.end = i + 1 < addresses.length() ? addresses.at(i + 1) : object.instructions.length();
+            // the bank of the last directive at or before the chunk, bank 0 if there's none
+            QMap<int, int>::const_iterator bank = object.banks.upperBound(chunk.start);
+            chunk.bank = bank == object.banks.constBegin() ? 0 : (--bank).value();
+            chunk.live = !m_removeUnreferenced;
+            chunk.address = 0;
+            starts.insert(chunk.start, m_chunks.length());
+            m_chunks.append(chunk);
+        }
+        m_chunkStarts.append(starts);
+
+        for (int r = 0; r < object.relocations.length(); r++)
+            m_chunks[chunkAt(m, object.relocations.at(r).instruction)].relocations.append(r);
+    }
+}
+
+bool SRLinker::markLiveChunks()
+{
+    QList<int> work;
+    if (!m_removeUnreferenced) {
+        for (int c = 0; c < m_chunks.length(); c++)
+            work.append(c);
+    } else if (!m_chunks.isEmpty()) {
+        // Execution starts from the beginning of the first object
+        m_chunks[0].live = true;
+        work.append(0);
+    }
+
+    bool ok = true;
+    while (!work.isEmpty()) {
+        int c = work.takeLast();
+        const Chunk& chunk = m_chunks.at(c);
+        const SRObject& object = m_objects.at(chunk.module);
+
+        QList<int> referenced;
+        foreach (int index, chunk.relocations) {
+            const SRObject::Relocation& r = object.relocations.at(index);
+            Symbol symbol;
+            if (!resolve(chunk.module, r, &symbol)) {
+                qDebug() << "Error: undefined" << (r.kind == SRObject::CodeSymbol ? "code label" :
+                                                   r.kind == SRObject::DataSymbol ? "data label" : "label")
+                         << r.symbol << "referenced in" << object.name;
+                ok = false;
+                continue;
+            }
+            if (symbol.kind == SRObject::CodeSymbol)
+                referenced.append(chunkAt(symbol.module, symbol.address));
+        }
+        if (fallsThrough(chunk) && c + 1 < m_chunks.length())
+            referenced.append(c + 1);
+
+        foreach (int r, referenced) {
+            if (!m_chunks.at(r).live) {
+                m_chunks[r].live = true;
+                work.append(r);
+            }
+        }
+    }
+    return ok;
+}
+
+bool SRLinker::fallsThrough(const Chunk &chunk) const
+{
+    if (chunk.start == chunk.end)
+        return true;
+
+    unsigned short last = m_objects.at(chunk.module).instructions.at(chunk.end - 1);
+    switch (last & OPCODE_MASK) {
+        case OPCODE_BRANCH:
+            return BRANCH_CONDITION(last) != BRANCH_ALWAYS;
+        case OPCODE_RETURN_FROM_SUBROUTINE:
+            return false;
+        case OPCODE_HALT:
+            return true;    // an interrupt resumes after HALT
+        default:
+            return true;
+    }
+}
+
+// Allocates a stub at the end of the routine's bank for every routine called with
+// BSR from another bank. Branches can't cross banks.
+bool SRLinker::placeFarStubs(QVector<int>& bankSizes)
+{
+    m_farStubs.clear();
+    m_farStubNames.clear();
+
+    bool ok = true;
+    foreach (const Chunk& chunk, m_chunks) {
+        if (!chunk.live)
+            continue;
+        const SRObject& object = m_objects.at(chunk.module);
+        foreach (int index, chunk.relocations) {
+            const SRObject::Relocation& r = object.relocations.at(index);
+            unsigned short instruction = object.instructions.at(r.instruction);
+            int opcode = instruction & OPCODE_MASK;
+            if (opcode != OPCODE_BRANCH && opcode != OPCODE_BRANCH_TO_SUBROUTINE)
+                continue;
+
+            Symbol symbol;
+            resolve(chunk.module, r, &symbol);
+            int bank = symbolBank(symbol);
+            if (bank == chunk.bank)
+                continue;
+
+            if (opcode == OPCODE_BRANCH || BRANCH_CONDITION(instruction) != BRANCH_ALWAYS) {
+                qDebug() << "Error:" << (opcode == OPCODE_BRANCH ? "branch" : "conditional call") << "to" << r.symbol
+                         << "in bank" << bank << "from bank" << chunk.bank << "in" << object.name;
+                ok = false;
+                continue;
+            }
+
+            QPair<int, int> routine = qMakePair(symbol.module, symbol.address);
+            if (m_farStubs.contains(routine))
+                continue;
+            int address = bank * PROGRAM_BANK_SIZE + bankSizes.at(bank);
+            bankSizes[bank] += 2;
+            m_farStubs.insert(routine, address);
+            m_farStubNames.insert(address, qualifiedName(symbol.module, r.symbol));
+        }
+    }
+    return ok;
+}
+
+int SRLinker::chunkAt(int module, int address) const
+{
+    QMap<int, int>::const_iterator i = m_chunkStarts.at(module).upperBound(address);
+    --i;
+    return i.value();
+}
+
+int SRLinker::symbolAddress(const Symbol &symbol) const
+{
+    if (symbol.kind == SRObject::DataSymbol)
+        return m_dataBase.at(symbol.module) + symbol.address;
+
+    const Chunk& chunk = m_chunks.at(chunkAt(symbol.module, symbol.address));
+    return chunk.bank * PROGRAM_BANK_SIZE + chunk.address + symbol.address - chunk.start;
+}
+
+int SRLinker::symbolBank(const Symbol &symbol) const
+{
+    return m_chunks.at(chunkAt(symbol.module, symbol.address)).bank;
+}
+
+QString SRLinker::qualifiedName(int module, const QString &label) const
+{
+    // Local labels may clash between modules
+    if (SRObject::isLocalSymbol(label) && m_objects.length() > 1)
+        return m_objects.at(module).name + ":" + label;
+    return label;
+}
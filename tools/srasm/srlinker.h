@@ -0,0 +1,131 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef SRLINKER_H
+#define SRLINKER_H
+
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+
+#include "srobject.h"
+#include "srimage.h"
+
+// Merges SRObjects into a program image. Data sections are laid out back to back
+// in the order the objects were added and the data initialization prologue is
+// generated in front of the code, unless the data RAM gets initialized from
+// dataImage() instead. Code is split into chunks at every code label
+// and, when unreferenced code removal is enabled, only chunks reachable from the
+// start of the first object either by a label reference or by falling through
+// from the preceding chunk are kept.
+//
+// Chunks are placed in the program memory bank of their "bank" directive and
+// the image holds the banks back to back, 256 words each. A BSR to a routine
+// in another bank is turned into an FBSR to a "__far_<label>" stub in the
+// routine's bank that calls it with BSR and returns with FRET, so the same
+// routine can be called from its own bank and from others.
+class SRLinker
+{
+public:
+    SRLinker();
+
+    static const int DefaultMaxProgramSize = 256;
+
+    void addObject(const SRObject& object);
+    void setRemoveUnreferenced(bool remove) { m_removeUnreferenced = remove; }
+    // Without the prologue the data sections are only in dataImage()
+    void setDataInitPrologue(bool generate) { m_dataInitPrologue = generate; }
+    // Words per bank. Only meant for benchmarking the assembler with programs that don't fit the program memory
+    void setMaxProgramSize(int words) { m_maxProgramSize = words; }
+
+    // Returns an empty array if linking fails
+    QByteArray link();
+
+    // Valid after link(). Code label addresses are bank * 256 + address like in the program.
+    QVector<unsigned short> program() const { return m_program; }
+    QMap<QString, int> codeLabels() const { return m_codeLabels; }
+    QMap<QString, int> dataLabels() const { return m_dataLabels; }
+    // Initial data RAM contents, 256 bytes
+    QByteArray dataImage() const { return m_dataImage; }
+    // The used words of each bank and the initialized data segments, execution starts from bank 0 address 0
+    SRImage image() const;
+    int removedInstructions() const { return m_removedInstructions; }
+
+private:
+    struct Symbol {
+        SRObject::SymbolKind kind;
+        int module;
+        int address;    // relative to the module's code or data
+    };
+
+    struct Chunk {
+        int module;
+        int start;
+        int end;
+        int bank;
+        bool live;
+        int address;    // within the bank
+        QList<int> relocations;     // indices to the module's relocation table
+    };
+
+    bool collectGlobals();
+    bool findSymbol(int module, const QString& name, SRObject::SymbolKind kind, Symbol* symbol) const;
+    bool resolve(int module, const SRObject::Relocation& relocation, Symbol* symbol) const;
+    void buildChunks();
+    bool markLiveChunks();
+    bool fallsThrough(const Chunk& chunk) const;
+    bool placeFarStubs(QVector<int>& bankSizes);
+    int chunkAt(int module, int address) const;
+    // Code addresses are bank * 256 + address
+    int symbolAddress(const Symbol& symbol) const;
+    int symbolBank(const Symbol& symbol) const;
+    QString qualifiedName(int module, const QString& label) const;
+
+private:
+    QList<SRObject> m_objects;
+    bool m_removeUnreferenced;
+    bool m_dataInitPrologue;
+    int m_maxProgramSize;
+
+    QMap<QString, Symbol> m_globalCode;
+    QMap<QString, Symbol> m_globalData;
+    QList<int> m_dataBase;
+    QList<Chunk> m_chunks;
+    QList<QMap<int, int> > m_chunkStarts;   // per module, chunk start address -> chunk index
+    QMap<QPair<int, int>, int> m_farStubs;  // module and address of the routine -> stub address
+    QMap<int, QString> m_farStubNames;      // stub address -> routine label
+
+    QVector<unsigned short> m_program;
+    QMap<QString, int> m_codeLabels;
+    QMap<QString, int> m_dataLabels;
+    QByteArray m_dataImage;
+    QList<SRObject::DataSegment> m_dataSegments;    // absolute addresses, adjacent segments merged
+    QVector<int> m_bankSizes;
+    int m_removedInstructions;
+};
+
+#endif // SRLINKER_H
@@ -0,0 +1,122 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "srobject.h"
+#include <QFile>
+#include <QDataStream>
+#include <QDebug>
+
+static const quint32 ObjectMagic = 0x53524f42;     // "SROB"
+static const quint16 ObjectVersion = 2;
+
+SRObject::SRObject() :
+    dataSize(0)
+{
+}
+
+bool SRObject::save(const QString &filename) const
+{
+    QFile file(filename);
+    if (!file.open(QFile::WriteOnly)) {
+        qDebug() << "Can't open object file" << filename;
+        return false;
+    }
+
+    QDataStream out(&file);
+    out << ObjectMagic << ObjectVersion << name;
+    out << (quint16) instructions.length();
+    foreach (unsigned short instruction, instructions)
+        out << (quint16) instruction;
+    out << (qint32) dataSize << (quint16) data.length();
+    foreach (DataSegment segment, data)
+        out << segment.first << (qint32) segment.second;
+    out << codeLabels << dataLabels;
+    out << (quint16) relocations.length();
+    foreach (Relocation r, relocations)
+        out << (qint32) r.instruction << r.symbol << (quint8) r.kind;
+    out << banks;
+
+    return out.status() == QDataStream::Ok;
+}
+
+bool SRObject::load(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QFile::ReadOnly)) {
+        qDebug() << "Can't open object file" << filename;
+        return false;
+    }
+
+    QDataStream in(&file);
+    quint32 magic;
+    quint16 version;
+    in >> magic >> version;
+    if (magic != ObjectMagic || version != ObjectVersion) {
+        qDebug() << filename << "is not a srasm object file";
+        return false;
+    }
+    in >> name;
+
+    quint16 count;
+    in >> count;
+    instructions.clear();
+    for (int i = 0; i < count; i++) {
+        quint16 instruction;
+        in >> instruction;
+        instructions.append(instruction);
+    }
+
+    qint32 size;
+    in >> size >> count;
+    dataSize = size;
+    data.clear();
+    for (int i = 0; i < count; i++) {
+        DataSegment segment;
+        qint32 offset;
+        in >> segment.first >> offset;
+        segment.second = offset;
+        data.append(segment);
+    }
+    in >> codeLabels >> dataLabels;
+
+    in >> count;
+    relocations.clear();
+    for (int i = 0; i < count; i++) {
+        Relocation r;
+        qint32 instruction;
+        quint8 kind;
+        in >> instruction >> r.symbol >> kind;
+        r.instruction = instruction;
+        r.kind = (SymbolKind) kind;
+        relocations.append(r);
+    }
+    in >> banks;
+
+    if (in.status() != QDataStream::Ok) {
+        qDebug() << "Truncated object file" << filename;
+        return false;
+    }
+    return true;
+}
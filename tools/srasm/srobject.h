@@ -0,0 +1,70 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef SROBJECT_H
+#define SROBJECT_H
+
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QString>
+#include <QByteArray>
+
+// Relocatable output of assembling a single source file. Code addresses are
+// relative to the start of the module's code and data addresses relative to the
+// start of the module's data, every label reference in the code is left as a
+// relocation for SRLinker to patch. Labels starting with an underscore are local
+// to the module and can't be referenced from other modules.
+class SRObject
+{
+public:
+    SRObject();
+
+    enum SymbolKind { AnySymbol, CodeSymbol, DataSymbol };
+
+    struct Relocation {
+        int instruction;
+        QString symbol;
+        SymbolKind kind;    // MOV accepts both code and data labels
+    };
+
+    typedef QPair<QByteArray, int> DataSegment;
+
+    bool save(const QString& filename) const;
+    bool load(const QString& filename);
+
+    static bool isLocalSymbol(const QString& symbol) { return symbol.startsWith("_"); }
+
+    QString name;
+    QList<unsigned short> instructions;
+    QList<DataSegment> data;
+    int dataSize;
+    QMap<QString, int> codeLabels;
+    QMap<QString, int> dataLabels;
+    QList<Relocation> relocations;
+    QMap<int, int> banks;       // instruction -> program memory bank of the code starting from it
+};
+
+#endif // SROBJECT_H
@@ -24,36 +24,16 @@
 */
 
 #include "srprogram.h"
+#include "srlinker.h"
 #include "nodes.h"
+#include "isa.h"
 #include <assert.h>
 
-// Instruction encoding stuff
-#define TARGET_REG 8
-#define SRC1_REG 6
-#define SRC2_REG 4
-#define FLAG_INDIRECT 0x0800
-#define FLAG_REGISTER_JUMP_TARGET 0x0800
-#define FLAG_EXTEND 0x0400
-#define FLAG_POP 0x0800
-#define OPCODE_MOVE_IMM 0x1000
-#define OPCODE_LOAD 0x2000
-#define OPCODE_STORE 0x3000
-#define OPCODE_ALUOP 0x4000
-#define OPCODE_BRANCH 0x5000
-#define OPCODE_COPYDATA 0x6000
-#define OPCODE_BRANCH_TO_SUBROUTINE 0x7000
-#define OPCODE_RETURN_FROM_SUBROUTINE 0x8000
-#define OPCODE_STACK_MOVE 0x9000        // PUSH & POP
-#define OPCODE_READ_IO 0xA000   //  essentially LOAD and STORE with MSB set
-#define OPCODE_WRITE_IO 0xB000
-#define OPCODE_HALT 0xf000
-#define OPCODE_NOP 0x0000
-
 SRProgram::SRProgram()
 {
 }
 
-QByteArray SRProgram::assemble(Section *codeSection, Section *dataSection)
+SRObject SRProgram::compile(Section *codeSection, Section *dataSection, const QString &name)
 {
     m_dataAllocHead = 0;
     DataSegment firstSeg;
@@ -75,80 +55,50 @@ QByteArray SRProgram::assemble(Section *codeSection, Section *dataSection)
         qDebug() << "  " << QString::number(m_instructions.at(i), 16);
     }
 
-    int dataCopyInstructionCount = 0;
-    foreach(DataSegment s, m_data) {
-        // +1 is for loading the segment offset to the pointer register used by COPYDATA
-        dataCopyInstructionCount += s.first.length() + 1;
-    }
-
-    // All regs are 0 after reset so we don't need to set the pointer for the first segment
-    if (dataCopyInstructionCount > 0)
-        dataCopyInstructionCount--;
-
-    // Check that all the code and data fits in 256 instructions
-    if (dataCopyInstructionCount + m_instructions.length() > 256) {
-        qDebug() << "Error: can't fit instructions and data in 256 bytes";
-        qDebug() << "Instruction count:" << m_instructions.length() << "Data length:" << dataCopyInstructionCount;
-        return QByteArray();
-    }
-
-    bool isFirstSeg = true;
-    QByteArray bin;
-    bin.fill(0, 512);
-
-    int dataPtr = 0;
-    // Generate instructions to copy data sections to ram
-    foreach (DataSegment seg, m_data) {
-        // Generate the instruction to load the segment offset to the pointer register
-        if (!isFirstSeg) {
-            bin[dataPtr++] = (OPCODE_MOVE_IMM) >> 8;
-            bin[dataPtr++] = seg.second;
-        }
-
-        for (int i = 0; i < seg.first.length(); i++) {
-            bin[dataPtr + i * 2] = (OPCODE_COPYDATA | FLAG_INDIRECT) >> 8;
-            bin[dataPtr + i * 2 + 1] = seg.first.at(i);
-        }
-        dataPtr += seg.first.length() * 2;
-        isFirstSeg = false;
-    }
-
-    fixCodeLabelReferences(dataPtr / 2);
-
-    foreach(unsigned short instruction, m_instructions) {
-        bin[dataPtr++] = (char) (instruction >> 8);
-        bin[dataPtr++] = (char) (instruction);
-    }
-
-    return bin;
+    SRObject object;
+    object.name = name;
+    object.instructions = m_instructions;
+    object.data = m_data;
+    object.dataSize = m_dataAllocHead;
+    object.codeLabels = m_codeLabels;
+    object.dataLabels = m_dataLabels;
+    object.relocations = m_relocations;
+    object.banks = m_banks;
+    return object;
 }
 
-int SRProgram::lookupDataLabel(QString label)
+QByteArray SRProgram::assemble(Section *codeSection, Section *dataSection, bool dataInitPrologue)
 {
-    int value = m_dataLabels.value(label, -1);
-    if (value < 0) {
-        qDebug() << "Error: unknown data label" << label;
-        qFatal("Terminating assembly");
-    }
-    return value;
+    SRLinker linker;
+    linker.setDataInitPrologue(dataInitPrologue);
+    linker.addObject(compile(codeSection, dataSection, QString()));
+
+    QByteArray bin = linker.link();
+    m_program = linker.program();
+    m_programLabels = linker.codeLabels();
+    m_dataImage = linker.dataImage();
+    m_image = linker.image();
+    return bin;
 }
 
-bool SRProgram::dataLabelExists(QString label)
+void SRProgram::addRelocation(QString label, SRObject::SymbolKind kind)
 {
-    return (m_dataLabels.value(label, -1) != -1);
+    SRObject::Relocation r;
+    r.instruction = m_instructions.length();
+    r.symbol = label;
+    r.kind = kind;
+    m_relocations.append(r);
 }
 
-void SRProgram::fixCodeLabelReferences(int offset)
+static unsigned short postModifyFlags(PostModify postModify)
 {
-    foreach(CodeLabelRef ref, m_codeLabelRefs) {
-        int address = m_codeLabels.value(ref.second, -1);
-        if (address < 0) {
-            qDebug() << "Couldn't find code label" << ref.second;
-            qFatal("");
-        }
-        unsigned short instruction = m_instructions.at(ref.first);
-        instruction |= (address + offset) & 0xff;
-        m_instructions.replace(ref.first, instruction);
+    switch (postModify) {
+        case PostIncrement:
+            return FLAG_POST_INCREMENT;
+        case PostDecrement:
+            return FLAG_POST_DECREMENT;
+        default:
+            return 0;
     }
 }
 
@@ -157,10 +107,7 @@ void SRProgram::handleNode(MoveImmInstruction *n)
     //qDebug() << Q_FUNC_INFO << "target reg" << n->targetRegister << "immediate:" << n->immediate << "sign extend:" << n->signExtend;
     unsigned short instruction = OPCODE_MOVE_IMM;
     if (n->label.length() > 0)
-        if (dataLabelExists(n->label))
-            instruction |= lookupDataLabel(n->label) & 0xff;
-        else     // code label, add ref
-            m_codeLabelRefs.append(QPair<int, QString>(m_instructions.length(), n->label));
+        addRelocation(n->label, SRObject::AnySymbol);     // either a code or a data label
     else
         instruction |= n->immediate;
     if (n->signExtend)
@@ -179,9 +126,21 @@ void SRProgram::handleNode(NopInstruction* /* n */)
     m_instructions.append(OPCODE_NOP);
 }
 
-void SRProgram::handleNode(ReturnInstruction* /* n */)
+void SRProgram::handleNode(ReturnInstruction* n)
+{
+    unsigned short i = OPCODE_RETURN_FROM_SUBROUTINE;
+    if (n->fromInterrupt)
+        i |= FLAG_RETI;
+    if (n->far)
+        i |= FLAG_FAR_RETURN;
+    m_instructions.append(i);
+}
+
+void SRProgram::handleNode(BankDirective *n)
 {
-    m_instructions.append(OPCODE_RETURN_FROM_SUBROUTINE);
+    if (n->bank < 0 || n->bank >= PROGRAM_BANKS)
+        qFatal("Error: there are only %d program memory banks", PROGRAM_BANKS);
+    m_banks.insert(m_instructions.length(), n->bank);
 }
 
 void SRProgram::handleNode(StackMoveInstruction *n)
@@ -217,6 +176,14 @@ void SRProgram::handleNode(HaltInstruction* /* n */)
     m_instructions.append(OPCODE_HALT);
 }
 
+void SRProgram::handleNode(InterruptEnableInstruction *n)
+{
+    unsigned short i = OPCODE_INTERRUPT_ENABLE;
+    if (n->enable)
+        i |= FLAG_INTERRUPT_ENABLE;
+    m_instructions.append(i);
+}
+
 void SRProgram::handleNode(AluInstruction *n)
 {
     unsigned short i = OPCODE_ALUOP;
@@ -246,12 +213,26 @@ void SRProgram::handleNode(AluInstruction *n)
             i |= 11; break;
         case AluInstruction::Inc:
             i |= 12; break;
+        case AluInstruction::Adc:
+            i |= 13; break;
+        case AluInstruction::Sbc:
+            i |= 14; break;
+        case AluInstruction::Cmp:
+            i |= 1 | FLAG_NO_WRITEBACK; break;
+        case AluInstruction::Tst:
+            i |= 8 | FLAG_NO_WRITEBACK; break;
     }
     m_instructions.append(i);
 }
 
 void SRProgram::handleNode(BranchInstruction* n)
 {
+    if (n->far) {
+        addRelocation(n->label, SRObject::CodeSymbol);
+        m_instructions.append(OPCODE_FAR_BRANCH_TO_SUBROUTINE);
+        return;
+    }
+
     unsigned short i = n->subroutineCall ? OPCODE_BRANCH_TO_SUBROUTINE : OPCODE_BRANCH;
     switch (n->condition) {
         case BranchInstruction::Equal:
@@ -262,7 +243,7 @@ void SRProgram::handleNode(BranchInstruction* n)
             i |= 0x0200; break;
     }
     if (n->label.length() > 0)
-        m_codeLabelRefs.append(QPair<int, QString>(m_instructions.length(), n->label));
+        addRelocation(n->label, SRObject::CodeSymbol);
     else {
         i |= FLAG_REGISTER_JUMP_TARGET;
         i |= n->jumpTargetRegister << SRC1_REG;
@@ -280,9 +261,10 @@ void SRProgram::handleNode(LoadInstruction *n)
     if (n->indirect) {
         i |= FLAG_INDIRECT;
         i |= n->source << SRC1_REG;
+        i |= postModifyFlags(n->postModify);
     } else {
         if (n->sourceLabel.length() > 0)
-            i |= lookupDataLabel(n->sourceLabel);
+            addRelocation(n->sourceLabel, SRObject::DataSymbol);
         else
             i |= n->source;     // immediate address
     }
@@ -298,9 +280,10 @@ void SRProgram::handleNode(StoreInstruction *n)
     if (n->indirect) {
         i |= FLAG_INDIRECT;
         i |= n->target << SRC1_REG;
+        i |= postModifyFlags(n->postModify);
     } else {
         if (n->targetLabel.length() > 0)
-            i |= lookupDataLabel(n->targetLabel);
+            addRelocation(n->targetLabel, SRObject::DataSymbol);
         else
             i |= n->target;     // immediate address
     }
@@ -29,6 +29,10 @@
 #include <QMap>
 #include <QString>
 #include <QPair>
+#include <QVector>
+
+#include "srobject.h"
+#include "srimage.h"
 
 class CodeLabel;
 class DataLabel;
@@ -45,16 +49,29 @@ class StoreInstruction;
 class LoadInstruction;
 class ReturnInstruction;
 class StackMoveInstruction;
+class InterruptEnableInstruction;
+class BankDirective;
 
 class SRProgram
 {
 public:
     SRProgram();
 
-    typedef QPair<int, QString> CodeLabelRef;
-    typedef QPair<QByteArray, int> DataSegment;
+    typedef SRObject::DataSegment DataSegment;
+
+    // Assembles the sections into a relocatable object, all label references are left for the linker
+    SRObject compile(Section* codeSection, Section* dataSection, const QString& name);
+
+    // Assembles and links a standalone program, see SRLinker::setDataInitPrologue()
+    QByteArray assemble(Section* codeSection, Section* dataSection, bool dataInitPrologue = true);
 
-    QByteArray assemble(Section* codeSection, Section* dataSection);
+    // Valid after assemble(). The program includes the data initialization prologue
+    // and code label addresses are relocated accordingly.
+    QVector<unsigned short> program() const { return m_program; }
+    QMap<QString, int> codeLabels() const { return m_programLabels; }
+    QMap<QString, int> dataLabels() const { return m_dataLabels; }
+    QByteArray dataImage() const { return m_dataImage; }
+    SRImage image() const { return m_image; }
 
     void handleNode(CodeLabel*);
     void handleNode(DataLabel*);
@@ -70,21 +87,26 @@ public:
     void handleNode(StoreInstruction*);
     void handleNode(ReturnInstruction*);
     void handleNode(StackMoveInstruction*);
+    void handleNode(InterruptEnableInstruction*);
+    void handleNode(BankDirective*);
 
 private:
-    void fixCodeLabelReferences(int offset);
-    int lookupDataLabel(QString label);
-    bool dataLabelExists(QString label);
+    void addRelocation(QString label, SRObject::SymbolKind kind);
     int dataAllocHead();
 
 private:
     QMap<QString, int> m_codeLabels;
     QMap<QString, int> m_dataLabels;
-    QList<CodeLabelRef> m_codeLabelRefs;
+    QList<SRObject::Relocation> m_relocations;
+    QMap<int, int> m_banks;
 
     QList<DataSegment> m_data;
     int m_dataAllocHead;
     QList<unsigned short> m_instructions;
+    QVector<unsigned short> m_program;
+    QMap<QString, int> m_programLabels;
+    QByteArray m_dataImage;
+    SRImage m_image;
 };
 
 #endif // SRPROGRAM_H
@@ -0,0 +1,209 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+// Runs a program translated with srasm --emit-cpp and the same program in
+// srsim's interpreter for the same number of cycles and compares the final
+// state and every I/O write with the cycle it happened at. With a repetition
+// count both are then timed for the full cycle limit. Built by aotcheck.sh
+// with AOT_FILE set to the translated file and AOT_FUNC to its function.
+
+#include "srsimulator.h"
+#include "interruptcontroller.h"
+
+#include <QByteArray>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QVector>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include AOT_FILE
+
+struct IoWrite
+{
+    quint64 cycle;
+    int address;
+    int value;
+
+    bool operator==(const IoWrite& other) const
+    {
+        return cycle == other.cycle && address == other.address && value == other.value;
+    }
+};
+
+class ReferenceSimulator : public SRSimulator
+{
+public:
+    ReferenceSimulator(bool log) : m_log(log) {}
+
+    QVector<IoWrite> m_writes;
+
+protected:
+    void ioWrite(int address, unsigned char value)
+    {
+        if (m_log) {
+            IoWrite w = { cycles(), address, value };
+            m_writes.append(w);
+        }
+        SRSimulator::ioWrite(address, value);
+    }
+
+private:
+    bool m_log;
+};
+
+// The interrupt controller and LCD ready timing wired up like srsim does it
+class AotIo : public SRAotIo
+{
+public:
+    AotIo(bool log) : m_log(log) {}
+
+    QVector<IoWrite> m_writes;
+
+    uint8_t read(int address, uint64_t cycle)
+    {
+        m_ic.tick(cycle);
+        if ((address & 0xf0) == InterruptController::BaseAddress)
+            return m_ic.read(address & 0xf);
+        return 0;
+    }
+
+    void write(int address, uint8_t value, uint64_t cycle)
+    {
+        if (m_log) {
+            IoWrite w = { cycle, address, value };
+            m_writes.append(w);
+        }
+        m_ic.tick(cycle);
+        if ((address & 0xf0) == InterruptController::BaseAddress)
+            m_ic.write(address & 0xf, value, cycle + 1);
+        else if (address == InterruptController::LcdCommandAddress || address == InterruptController::LcdDataAddress)
+            m_ic.lcdWritten(address, value, cycle + 1);
+    }
+
+    int interrupt(uint64_t cycle, uint64_t* next)
+    {
+        m_ic.tick(cycle);
+        if (m_ic.irq())
+            return m_ic.vector();
+        *next = m_ic.nextEvent();
+        return -1;
+    }
+
+private:
+    InterruptController m_ic;
+    bool m_log;
+};
+
+static void initState(SRAotState* state)
+{
+    memset(state, 0, sizeof(*state));
+    state->sp = 0xff;
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 3) {
+        printf("usage: %s program.bin max_cycles [repetitions]\n", argv[0]);
+        return 2;
+    }
+
+    QFile file(argv[1]);
+    if (!file.open(QIODevice::ReadOnly)) {
+        printf("Can't open %s\n", argv[1]);
+        return 2;
+    }
+    QByteArray program = file.readAll();
+    quint64 maxCycles = strtoull(argv[2], 0, 0);
+    int repetitions = argc > 3 ? atoi(argv[3]) : 0;
+
+    SRAotState state;
+    initState(&state);
+    AotIo io(true);
+    SRAotStatus status = AOT_FUNC(&state, &io, maxCycles);
+
+    // The translated code only stops at leaders, so the interpreter runs to the same cycle
+    ReferenceSimulator sim(true);
+    sim.loadProgram(program);
+    sim.run(state.cycles);
+
+    bool match = sim.cycles() == state.cycles && sim.pc() == state.pc && sim.sp() == state.sp && sim.sr() == state.sr;
+    for (int r = 0; r < 4; r++)
+        match &= sim.reg(r) == state.regs[r];
+    for (int a = 0; a < 256; a++)
+        match &= sim.dataByte(a) == state.data[a];
+    match &= sim.m_writes == io.m_writes;
+
+    printf("%s: status %d, %llu cycles, pc %03x, sr %02x, r0-r3 %04x %04x %04x %04x, %d I/O writes\n",
+           match ? "match" : "MISMATCH", status, (unsigned long long) state.cycles, state.pc, state.sr,
+           state.regs[0], state.regs[1], state.regs[2], state.regs[3], io.m_writes.size());
+    if (!match) {
+        printf("srsim: %llu cycles, pc %03x, sp %02x, sr %02x, r0-r3 %04x %04x %04x %04x, %d I/O writes\n",
+               (unsigned long long) sim.cycles(), sim.pc(), sim.sp(), sim.sr(),
+               sim.reg(0), sim.reg(1), sim.reg(2), sim.reg(3), sim.m_writes.size());
+        for (int i = 0; i < io.m_writes.size() && i < sim.m_writes.size(); i++) {
+            const IoWrite& a = io.m_writes.at(i);
+            const IoWrite& b = sim.m_writes.at(i);
+            if (!(a == b)) {
+                printf("I/O write %d: srsim $%02x = %02x at %llu, translated $%02x = %02x at %llu\n", i,
+                       b.address, b.value, (unsigned long long) b.cycle, a.address, a.value, (unsigned long long) a.cycle);
+                break;
+            }
+        }
+        for (int a = 0; a < 256; a++) {
+            if (sim.dataByte(a) != state.data[a]) {
+                printf("data $%02x: srsim %02x, translated %02x\n", a, sim.dataByte(a), state.data[a]);
+                break;
+            }
+        }
+        return 1;
+    }
+
+    if (repetitions > 0) {
+        qint64 interpreted = 0;
+        qint64 translated = 0;
+        quint64 cycles = 0;
+        QElapsedTimer timer;
+        for (int i = 0; i < repetitions; i++) {
+            ReferenceSimulator s(false);
+            s.loadProgram(program);
+            timer.start();
+            s.run(maxCycles);
+            interpreted += timer.nsecsElapsed();
+
+            initState(&state);
+            AotIo quietIo(false);
+            timer.start();
+            AOT_FUNC(&state, &quietIo, maxCycles);
+            translated += timer.nsecsElapsed();
+            cycles += state.cycles;
+        }
+        printf("srsim %.1f Mcycles/s, translated %.1f Mcycles/s, %.1f times faster\n",
+               cycles * 1e3 / interpreted, cycles * 1e3 / translated, (double) interpreted / translated);
+    }
+    return 0;
+}
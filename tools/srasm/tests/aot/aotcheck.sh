@@ -0,0 +1,65 @@
+#!/bin/sh
+#
+# Translates programs with srasm --emit-cpp, checks that each one ends in the
+# same state with the same I/O writes as srsim after the cycle limit and
+# times both. Exits with 1 if any of them differ. Only the interrupt
+# controller and the LCD ready timing are modelled for the translated code,
+# so programs that read srsim's performance counters will differ.
+#
+# usage: aotcheck.sh [-c max_cycles] [-r repetitions] program.asm...
+#
+# SRASM and CXX can be set in the environment if the tools aren't in PATH,
+# QT_CFLAGS and QT_LIBS if Qt 5 isn't known to pkg-config.
+
+set -e
+
+aot_dir=$(cd "$(dirname "$0")" && pwd)
+tools_dir="$aot_dir/../../.."
+work_dir="$aot_dir/work"
+srasm=${SRASM:-srasm}
+cxx=${CXX:-g++}
+qt_cflags=${QT_CFLAGS:-$(pkg-config --cflags Qt5Core) -fPIC}
+qt_libs=${QT_LIBS:-$(pkg-config --libs Qt5Core)}
+
+cycles=20000000
+repetitions=3
+
+while getopts "c:r:" opt; do
+    case $opt in
+        c) cycles=$OPTARG ;;
+        r) repetitions=$OPTARG ;;
+        *) echo "usage: $0 [-c max_cycles] [-r repetitions] program.asm..."; exit 2 ;;
+    esac
+done
+shift $((OPTIND - 1))
+
+if [ $# -eq 0 ]; then
+    echo "usage: $0 [-c max_cycles] [-r repetitions] program.asm..."
+    exit 2
+fi
+
+mkdir -p "$work_dir"
+
+# Everything in srsim but its main()
+sources=""
+for f in "$tools_dir"/srsim/*.cpp; do
+    [ "$(basename "$f")" = main.cpp ] || sources="$sources $f"
+done
+sources="$sources $tools_dir/srasm/srimage.cpp"
+
+failed=0
+for program in "$@"; do
+    name=$(basename "$program" .asm)
+    echo "$name:"
+    if ! "$srasm" --emit-cpp "$work_dir/$name.cpp" "$program" "$work_dir/$name.bin" > /dev/null 2>&1; then
+        echo "doesn't assemble"
+        failed=1
+        continue
+    fi
+    $cxx -O2 $qt_cflags -I"$tools_dir/srsim" -I"$tools_dir/srasm" \
+        -DAOT_FILE="\"$work_dir/$name.cpp\"" -DAOT_FUNC="sr_$name" \
+        -o "$work_dir/$name" "$aot_dir/aotcheck.cpp" $sources $qt_libs
+    "$work_dir/$name" "$work_dir/$name.bin" "$cycles" "$repetitions" || failed=1
+done
+
+exit $failed
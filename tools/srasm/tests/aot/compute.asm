@@ -0,0 +1,29 @@
+SECTION CODE
+    // Compute loop for aotcheck.sh, runs until the cycle limit
+main:
+    mov     0, r3
+outer:
+    mov     0, r0
+    mov     0, r1
+inner:
+    add     r1, r0, r1
+    bsr     mix
+    st      r1, $10
+    ld      $10, r2
+    xor     r1, r2, r1
+    dec     r0
+    brne    inner
+    dec     r3
+    brne    outer
+    bra     main
+
+mix:
+    swap    r1
+    not     r1
+    sub     r1, r0, r2
+    tst     r2
+    breq    skip
+    inc     r1
+skip:
+    ret
+END
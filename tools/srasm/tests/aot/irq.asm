@@ -0,0 +1,36 @@
+SECTION CODE
+    // Interrupt driven: the timer handler counts ticks and the main loop does
+    // a bit of work after every tick and sleeps until the next one. Runs until
+    // the cycle limit.
+    mov     tick, r0
+    out     r0, $32         // vector
+    mov     200, r0
+    out     r0, $33         // reload = 200
+    mov     0, r0
+    out     r0, $34         // starts the timer
+    mov     $01, r0
+    out     r0, $30         // enable the timer interrupt
+    mov     0, r2
+    ei
+loop:
+    mov     16, r1
+work:
+    ld      (r2)+, r3
+    add     r0, r3, r0
+    dec     r1
+    brne    work
+    st      r0, $f0
+    halt                    // sleeps until the next tick
+    bra     loop
+
+tick:
+    push    r0
+    ld      $f1, r0
+    inc     r0
+    st      r0, $f1
+    out     r0, $00
+    mov     $01, r0
+    out     r0, $31         // acknowledge
+    pop     r0
+    reti
+END
@@ -0,0 +1,16 @@
+SECTION CODE
+    // Polls the timer's pending bit with interrupts disabled, runs until the cycle limit
+    mov     37, r0
+    out     r0, $33         // reload = 37
+    mov     0, r0
+    out     r0, $34         // starts the timer
+    mov     0, r1
+wait:
+    inc     r1
+    in      $31, r0
+    tst     r0
+    breq    wait
+    out     r0, $31         // acknowledge
+    out     r1, $10
+    bra     wait
+END
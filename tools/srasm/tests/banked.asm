@@ -0,0 +1,18 @@
+
+SECTION CODE
+    // A counted loop in bank 1 called through a far stub. srasm --timing
+    // bounds it like in bank 0: 10 iterations of 2 cycles, work takes 22
+    // cycles worst case and the program 26.
+    bsr     work
+done:
+    halt
+    bra     done
+
+bank 1
+work:
+    mov     10, r0
+loop:
+    dec     r0
+    brne    loop
+    ret
+END
@@ -1,4 +1,6 @@
 SECTION CODE
+    // 20 terms big-endian at $02-$29, 227 cycles in srsim with (r)+ and 267
+    // with a separate inc after each store
 
     mov     0, r0       // n-2
     mov     1, r1       // n-1
@@ -13,11 +15,9 @@ loop:
     mov     r2, r1
     ld      $ff, r2      // recall mem pointer
     swap    r1
-    st      r1, (r2)     // write upper byte result
-    inc     r2
+    st      r1, (r2)+    // write upper byte result
     swap    r1
-    st      r1, (r2)     // write lower byte result
-    inc     r2
+    st      r1, (r2)+    // write lower byte result
     dec     r3
     brne    loop
     halt
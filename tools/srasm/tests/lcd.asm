@@ -33,11 +33,9 @@ l6:
     st      r1, str_ptr
 write_loop:
     ld      str_ptr, r1
-    ld      (r1), r0
-    inc     r1
+    ld      (r1)+, r0
     st      r1, str_ptr     // r1 gets globbered
-    mov     0, r3
-    add     r3, r0, r0      // yeah need to implement that tst instruction
+    tst     r0
     breq    write_complete
     mov     write_ret, r3
     bra     write_lcd_data
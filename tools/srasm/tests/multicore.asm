@@ -0,0 +1,103 @@
+SECTION CODE
+    // Splits 16 work units between the cores of a multi-core top level, try
+    // srsim --cores 1, 2 or 4. Unit u (1-16) adds u to the result 64 times,
+    // core c does units c+1, c+1+cores and so on. Every core shows the low
+    // digit of its result on its own 7-segment digit, taking semaphore 0 for
+    // the display, and posts the result to its mailbox a byte at a time.
+    // Core 0 adds them up and writes the total ($2200) to $00-$01 and the
+    // cycle count snapshot to $02-$05, LSB first.
+    in      $66, r0         // number of cores
+    st      r0, $f0
+    mov     $60, r1e
+    add     r0, r1, r0
+    st      r0, $f1         // past the last mailbox
+    in      $65, r2         // core number, units to skip before the first one
+    mov     0, r1e          // result
+    mov     1, r0e          // unit
+next:
+    tst     r2
+    brne    skip
+    ld      $f0, r2         // the next unit of this core is cores units away
+    mov     64, r3e
+work:
+    add     r1, r0, r1
+    dec     r3
+    brne    work
+skip:
+    dec     r2
+    inc     r0
+    mov     17, r3e
+    cmp     r0, r3
+    brne    next
+
+lock:
+    in      $68, r2         // 0 when this core got the semaphore
+    tst     r2
+    brne    lock
+    mov     $03, r2
+    out     r2, $05         // display on, hex digits
+    in      $65, r0
+    out     r1, (r0)        // digit of this core
+    out     r2, $68         // frees the semaphore
+
+    mov     1, r3e          // full flag of this core's mailbox
+    tst     r0
+    breq     collect
+mask:
+    add     r3, r3, r3
+    dec     r0
+    brne    mask
+    in      $65, r0
+    mov     $60, r2e
+    add     r0, r2, r2
+    out     r1, (r2)        // low byte
+taken:
+    in      $64, r0         // wait until core 0 took it
+    tst     r0, r3
+    brne    taken
+    swap    r1
+    out     r1, (r2)        // high byte
+    halt
+
+collect:
+    mov     $61, r2e        // mailbox of core 1
+    mov     2, r3e          // and its full flag
+next_core:
+    ld      $f1, r0e
+    cmp     r2, r0
+    breq     done
+    bsr     receive         // low byte
+    swap    r0
+    bsr     receive         // high byte
+    swap    r0
+    add     r1, r0, r1
+    inc     r2
+    add     r3, r3, r3
+    bra     next_core
+
+done:
+    swap    r1
+    st      r1, $01
+    swap    r1
+    st      r1, $00
+    mov     $01, r0
+    out     r0, $40         // snapshot
+    mov     $40, r1
+    mov     2, r2
+    mov     4, r3
+copy:
+    in      (r1)+, r0
+    st      r0, (r2)+
+    dec     r3
+    brne    copy
+    halt
+
+    // Waits for the mailbox in r2 to fill up, r3 has its full flag. Reads it
+    // to the low byte of r0 and keeps the high byte.
+receive:
+    in      $64, r0
+    tst     r0, r3
+    breq     receive
+    in      (r2), r0
+    ret
+END
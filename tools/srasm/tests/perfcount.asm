@@ -0,0 +1,24 @@
+SECTION CODE
+    // Measures a loop with the performance counters and copies the snapshot
+    // to data memory at $00-$17, four bytes per counter starting with the cycles.
+    // Expect 203 cycles and instructions, the clearing OUT, both MOVs and the
+    // loop, 99 taken branches and no memory accesses or halted cycles.
+    mov     $03, r0
+    out     r0, $40         // snapshot and clear
+    mov     100, r1
+loop:
+    dec     r1
+    brne    loop
+    mov     $01, r0
+    out     r0, $40         // snapshot, the counters keep running
+    mov     $40, r1
+    mov     0, r2
+    mov     24, r3
+copy:
+    in      (r1)+, r0
+    st      r0, (r2)+
+    dec     r3
+    brne    copy
+    halt
+
+END
@@ -0,0 +1,31 @@
+
+SECTION CODE
+    // 1000 cycle timer interrupt counting on the first 7-segment display
+    mov     $03, r0
+    out     r0, $05         // display on, hex digits
+    mov     timer_irq, r0
+    out     r0, $32         // vector
+    mov     $e8, r0
+    out     r0, $33         // reload = 1000
+    mov     $03, r0
+    out     r0, $34         // starts the timer
+    mov     $01, r0
+    out     r0, $30         // enable the timer interrupt
+    mov     0, r1
+    ei
+
+wait:
+    halt                    // sleeps until the next interrupt
+    mov     16, r2
+    cmp     r1, r2
+    brne    wait
+    di
+    halt
+
+timer_irq:
+    inc     r1
+    out     r1, $00
+    mov     $01, r0
+    out     r0, $31         // acknowledge
+    reti
+END
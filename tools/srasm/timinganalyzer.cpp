@@ -0,0 +1,822 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "timinganalyzer.h"
+#include "isa.h"
+
+const int TimingAnalyzer::DefaultCpuClock;
+const quint64 TimingAnalyzer::Unbounded;
+
+static const int AllRegisters = 0xf;
+
+static quint64 addCycles(quint64 a, quint64 b)
+{
+    if (a == TimingAnalyzer::Unbounded || b == TimingAnalyzer::Unbounded)
+        return TimingAnalyzer::Unbounded;
+    return a + b;
+}
+
+static quint64 mulCycles(quint64 a, quint64 b)
+{
+    if (a == TimingAnalyzer::Unbounded || b == TimingAnalyzer::Unbounded)
+        return TimingAnalyzer::Unbounded;
+    if (a != 0 && b > (TimingAnalyzer::Unbounded - 1) / a)
+        return TimingAnalyzer::Unbounded;
+    return a * b;
+}
+
+TimingAnalyzer::TimingAnalyzer(const QVector<unsigned short>& program, const QMap<QString, int>& codeLabels) :
+    m_program(program)
+{
+    for (QMap<QString, int>::const_iterator i = codeLabels.constBegin(); i != codeLabels.constEnd(); ++i) {
+        if (!m_labels.contains(i.value()))
+            m_labels.insert(i.value(), i.key());
+    }
+}
+
+void TimingAnalyzer::analyze()
+{
+    buildBlocks();
+    if (m_blocks.isEmpty())
+        return;
+
+    // Every call target is analyzed as a subroutine of its own, the reset vector being the outermost one
+    addFunction(0);
+    foreach (const Block& b, m_blocks) {
+        if (b.callee < 0)
+            continue;
+        if (b.callee >= m_program.size()) {
+            m_warnings << QString("call to %1 is outside the program").arg(name(b.callee));
+            continue;
+        }
+        addFunction(b.callee);
+        if (b.linkRegister >= 0)
+            m_functions[b.callee].linkRegisters.insert(b.linkRegister);
+    }
+
+    QList<int> entries = m_functions.keys();
+    foreach (int entry, entries)
+        buildFunction(m_functions[entry]);
+
+    // Trip counts look into the register usage of called subroutines so all of them have to be built first
+    foreach (int entry, entries)
+        findLoops(m_functions[entry]);
+
+    foreach (int entry, entries) {
+        Function& f = m_functions[entry];
+        functionCycles(entry);
+        for (int i = 0; i < f.loops.length(); i++)
+            regionCycles(f, i);
+    }
+}
+
+quint64 TimingAnalyzer::worstCaseCycles() const
+{
+    if (!m_functions.contains(0))
+        return 0;
+    return m_functions.value(0).cycles;
+}
+
+void TimingAnalyzer::buildBlocks()
+{
+    int n = m_program.size();
+    if (n == 0)
+        return;
+
+    QVector<bool> leader(n + 1, false);
+    leader[0] = true;
+    for (int i = 0; i < n; i++) {
+        unsigned short w = m_program.at(i);
+        switch (w & OPCODE_MASK) {
+            case OPCODE_BRANCH:
+            case OPCODE_BRANCH_TO_SUBROUTINE:
+                if (!(w & FLAG_REGISTER_JUMP_TARGET) && branchTarget(i, w) < n)
+                    leader[branchTarget(i, w)] = true;
+                leader[i + 1] = true;
+                break;
+            case OPCODE_FAR_BRANCH_TO_SUBROUTINE:
+                if (branchTarget(i, w) < n)
+                    leader[branchTarget(i, w)] = true;
+                leader[i + 1] = true;
+                break;
+            case OPCODE_RETURN_FROM_SUBROUTINE:
+            case OPCODE_HALT:
+                leader[i + 1] = true;
+                break;
+        }
+    }
+
+    m_blockAt.fill(-1, n);
+    for (int i = 0; i < n; ) {
+        Block b;
+        b.start = i++;
+        while (i < n && !leader[i])
+            i++;
+        b.end = i;
+        b.callee = -1;
+        b.linkRegister = -1;
+        b.indirectRegister = -1;
+        b.indirectCall = false;
+        b.returns = false;
+        b.halts = false;
+        for (int a = b.start; a < b.end; a++)
+            m_blockAt[a] = m_blocks.length();
+        m_blocks.append(b);
+    }
+
+    for (int i = 0; i < m_blocks.length(); i++) {
+        Block& b = m_blocks[i];
+        unsigned short w = m_program.at(b.end - 1);
+        int target = branchTarget(b.end - 1, w);
+        bool direct = !(w & FLAG_REGISTER_JUMP_TARGET);
+        int condition = BRANCH_CONDITION(w);
+        bool fallsThrough = true;
+
+        switch (w & OPCODE_MASK) {
+            case OPCODE_BRANCH:
+                if (condition > BRANCH_ALWAYS)
+                    break;      // undefined condition, never taken
+                if (!direct) {
+                    b.indirectRegister = (w >> SRC1_REG) & REG_MASK;
+                    fallsThrough = condition != BRANCH_ALWAYS;
+                } else if (condition == BRANCH_ALWAYS && (b.linkRegister = ghettoCallLinkRegister(b)) >= 0) {
+                    b.callee = target;
+                } else {
+                    if (target < n)
+                        b.successors.append(m_blockAt.at(target));
+                    else
+                        m_warnings << QString("branch at %1 leaves the program").arg(name(b.end - 1));
+                    fallsThrough = condition != BRANCH_ALWAYS;
+                }
+                break;
+
+            case OPCODE_BRANCH_TO_SUBROUTINE:
+                if (condition > BRANCH_ALWAYS)
+                    break;
+                if (direct)
+                    b.callee = target;
+                else
+                    b.indirectCall = true;
+                break;
+
+            case OPCODE_FAR_BRANCH_TO_SUBROUTINE:
+                b.callee = target;
+                break;
+
+            case OPCODE_RETURN_FROM_SUBROUTINE:
+                b.returns = true;
+                fallsThrough = false;
+                break;
+
+            case OPCODE_HALT:
+                b.halts = true;
+                fallsThrough = false;
+                break;
+        }
+
+        if (fallsThrough && b.end < n && !b.successors.contains(m_blockAt.at(b.end)))
+            b.successors.append(m_blockAt.at(b.end));
+    }
+}
+
+// Branch targets are addresses within the bank of the branch, FBSR carries its own bank.
+int TimingAnalyzer::branchTarget(int address, unsigned short w)
+{
+    if ((w & OPCODE_MASK) == OPCODE_FAR_BRANCH_TO_SUBROUTINE)
+        return FAR_BANK(w) * PROGRAM_BANK_SIZE + (w & 0xff);
+    return (address & ~(PROGRAM_BANK_SIZE - 1)) | (w & 0xff);
+}
+
+// Recognizes the "mov return_label, rX; bra subroutine" calling convention, returns the
+// link register or -1 if the branch at the end of the block isn't a call.
+int TimingAnalyzer::ghettoCallLinkRegister(const Block& b) const
+{
+    int branch = b.end - 1;
+    for (int i = branch - 1; i >= b.start; i--) {
+        unsigned short w = m_program.at(i);
+        if ((w & OPCODE_MASK) != OPCODE_MOVE_IMM || (w & 0xff) != ((branch + 1) & 0xff))
+            continue;
+
+        int reg = (w >> TARGET_REG) & REG_MASK;
+        bool clobbered = false;
+        for (int j = i + 1; j < branch; j++)
+            clobbered |= registersWritten(j) & (1 << reg);
+        if (!clobbered)
+            return reg;
+    }
+    return -1;
+}
+
+void TimingAnalyzer::addFunction(int entryAddress)
+{
+    if (m_functions.contains(entryAddress))
+        return;
+
+    Function f;
+    f.entry = m_blockAt.at(entryAddress);
+    f.cycles = 0;
+    f.done = false;
+    f.inProgress = false;
+    m_functions.insert(entryAddress, f);
+}
+
+void TimingAnalyzer::buildFunction(Function& f)
+{
+    QList<int> pending;
+    pending.append(f.entry);
+    f.blockSet.insert(f.entry);
+    while (!pending.isEmpty()) {
+        int b = pending.takeFirst();
+        f.blocks.append(b);
+        foreach (int s, m_blocks.at(b).successors) {
+            f.predecessors[s].append(b);
+            if (!f.blockSet.contains(s)) {
+                f.blockSet.insert(s);
+                pending.append(s);
+            }
+        }
+    }
+    qSort(f.blocks.begin(), f.blocks.end());
+
+    foreach (int b, f.blocks) {
+        const Block& block = m_blocks.at(b);
+        if (block.indirectRegister >= 0 && !f.linkRegisters.contains(block.indirectRegister))
+            f.warnings << QString("unresolved branch to r%1 at %2 is treated as a return")
+                          .arg(block.indirectRegister).arg(name(block.end - 1));
+        if (block.indirectCall)
+            f.warnings << QString("subroutine call through a register at %1").arg(name(block.end - 1));
+
+        unsigned short last = m_program.at(block.end - 1) & OPCODE_MASK;
+        if (block.end == m_program.size() && last != OPCODE_HALT && last != OPCODE_RETURN_FROM_SUBROUTINE
+                && last != OPCODE_BRANCH)
+            f.warnings << "execution runs past the end of the program";
+    }
+}
+
+void TimingAnalyzer::findLoops(Function& f)
+{
+    // Dominators with the Cooper-Harvey-Kennedy algorithm on the reverse postorder
+    QList<int> postorder;
+    QSet<int> seen;
+    QList<QPair<int, int> > stack;
+    stack.append(qMakePair(f.entry, 0));
+    seen.insert(f.entry);
+    while (!stack.isEmpty()) {
+        QPair<int, int>& top = stack.last();
+        const QList<int>& successors = m_blocks.at(top.first).successors;
+        if (top.second < successors.length()) {
+            int s = successors.at(top.second++);
+            if (!seen.contains(s)) {
+                seen.insert(s);
+                stack.append(qMakePair(s, 0));
+            }
+        } else {
+            postorder.append(top.first);
+            stack.removeLast();
+        }
+    }
+
+    QHash<int, int> order;
+    for (int i = 0; i < postorder.length(); i++)
+        order.insert(postorder.at(i), i);
+
+    QHash<int, int> idom;
+    idom.insert(f.entry, f.entry);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        for (int i = postorder.length() - 2; i >= 0; i--) {
+            int b = postorder.at(i);
+            int newIdom = -1;
+            foreach (int p, f.predecessors.value(b)) {
+                if (!idom.contains(p))
+                    continue;
+                if (newIdom < 0) {
+                    newIdom = p;
+                    continue;
+                }
+                int x = p;
+                int y = newIdom;
+                while (x != y) {
+                    while (order.value(x) < order.value(y))
+                        x = idom.value(x);
+                    while (order.value(y) < order.value(x))
+                        y = idom.value(y);
+                }
+                newIdom = x;
+            }
+            if (newIdom >= 0 && idom.value(b, -1) != newIdom) {
+                idom.insert(b, newIdom);
+                changed = true;
+            }
+        }
+    }
+
+    // Natural loops, loops sharing a header are merged
+    QMap<int, Loop> loops;
+    foreach (int b, f.blocks) {
+        foreach (int s, m_blocks.at(b).successors) {
+            int d = b;
+            while (d != s && d != f.entry)
+                d = idom.value(d);
+            if (d != s)
+                continue;       // not a back edge
+
+            if (!loops.contains(s)) {
+                Loop l;
+                l.header = s;
+                l.blocks.insert(s);
+                l.parent = -1;
+                l.tripCount = 0;
+                l.iterationCycles = 0;
+                l.totalCycles = 0;
+                l.done = false;
+                loops.insert(s, l);
+            }
+            Loop& l = loops[s];
+            l.latches.append(b);
+            QList<int> pending;
+            if (!l.blocks.contains(b)) {
+                l.blocks.insert(b);
+                pending.append(b);
+            }
+            while (!pending.isEmpty()) {
+                int x = pending.takeLast();
+                foreach (int p, f.predecessors.value(x)) {
+                    if (!l.blocks.contains(p)) {
+                        l.blocks.insert(p);
+                        pending.append(p);
+                    }
+                }
+            }
+        }
+    }
+    f.loops = loops.values();
+
+    for (int i = 0; i < f.loops.length(); i++) {
+        Loop& l = f.loops[i];
+        for (int j = 0; j < f.loops.length(); j++) {
+            const Loop& o = f.loops.at(j);
+            if (j == i || o.blocks.size() <= l.blocks.size() || !o.blocks.contains(l.blocks))
+                continue;
+            if (l.parent < 0 || o.blocks.size() < f.loops.at(l.parent).blocks.size())
+                l.parent = j;
+        }
+        foreach (int b, l.blocks) {
+            int current = f.innermostLoop.value(b, -1);
+            if (current < 0 || f.loops.at(current).blocks.size() > l.blocks.size())
+                f.innermostLoop.insert(b, i);
+        }
+    }
+
+    for (int i = 0; i < f.loops.length(); i++)
+        findTripCount(f, f.loops[i]);
+}
+
+void TimingAnalyzer::findTripCount(Function& f, Loop& l)
+{
+    if (l.latches.length() != 1) {
+        l.note = "more than one back edge";
+        return;
+    }
+
+    const Block& latch = m_blocks.at(l.latches.first());
+    unsigned short branch = m_program.at(latch.end - 1);
+    if ((branch & OPCODE_MASK) != OPCODE_BRANCH || (branch & FLAG_REGISTER_JUMP_TARGET)
+            || BRANCH_CONDITION(branch) != BRANCH_NOT_EQUAL
+            || branchTarget(latch.end - 1, branch) != m_blocks.at(l.header).start) {
+        l.note = "not closed by a BRNE";
+        return;
+    }
+
+    // The zero flag is only updated by ALU operations
+    int flagSetter = -1;
+    for (int a = latch.end - 2; a >= latch.start && flagSetter < 0; a--) {
+        if ((m_program.at(a) & OPCODE_MASK) == OPCODE_ALUOP)
+            flagSetter = a;
+    }
+    if (flagSetter < 0) {
+        l.note = "loop condition isn't computed in the loop latch";
+        return;
+    }
+
+    unsigned short w = m_program.at(flagSetter);
+    if (w & FLAG_NO_WRITEBACK) {
+        l.note = "loop condition is a compare";
+        return;
+    }
+    int counter = (w >> TARGET_REG) & REG_MASK;
+    int src1 = (w >> SRC1_REG) & REG_MASK;
+    int src2 = (w >> SRC2_REG) & REG_MASK;
+    int stepRegister = -1;
+    bool negateStep = false;
+    unsigned short step = 0;
+    bool counterUpdate = false;
+    switch (ALU_OP(w)) {
+        case ALU_OP_DEC:
+            counterUpdate = src1 == counter;
+            step = 0xffff;
+            break;
+        case ALU_OP_INC:
+            counterUpdate = src1 == counter;
+            step = 1;
+            break;
+        case ALU_OP_ADD:
+            counterUpdate = (src1 == counter) != (src2 == counter);
+            stepRegister = src1 == counter ? src2 : src1;
+            break;
+        case ALU_OP_SUB:
+            counterUpdate = src1 == counter && src2 != counter;
+            stepRegister = src2;
+            negateStep = true;
+            break;
+    }
+    if (!counterUpdate) {
+        l.note = "loop condition isn't a counter update";
+        return;
+    }
+
+    int calleeWrites = calleeRegistersWritten(l.blocks);
+    if (calleeWrites < 0) {
+        l.note = "loop calls a subroutine through a register";
+        return;
+    }
+    if (writeCount(l.blocks, counter) != 1 || (calleeWrites & (1 << counter))) {
+        l.note = QString("r%1 is modified elsewhere in the loop").arg(counter);
+        return;
+    }
+
+    QStringList assumptions;
+    bool assumed = false;
+    if (stepRegister >= 0) {
+        if (writeCount(l.blocks, stepRegister) != 0 || (calleeWrites & (1 << stepRegister))) {
+            l.note = QString("step r%1 isn't loop invariant").arg(stepRegister);
+            return;
+        }
+        if (!entryValue(f, l, stepRegister, step, assumed)) {
+            l.note = QString("step r%1 isn't a constant").arg(stepRegister);
+            return;
+        }
+        if (assumed)
+            assumptions << QString("r%1").arg(stepRegister);
+        if (negateStep)
+            step = -step;
+    }
+
+    unsigned short value;
+    assumed = false;
+    if (!entryValue(f, l, counter, value, assumed)) {
+        l.note = QString("initial value of r%1 isn't a constant").arg(counter);
+        return;
+    }
+    if (assumed)
+        assumptions << QString("r%1").arg(counter);
+
+    for (quint64 n = 1; n <= 0x10000; n++) {
+        value += step;
+        if (value == 0) {
+            l.tripCount = n;
+            break;
+        }
+    }
+    if (l.tripCount == 0)
+        l.note = QString("r%1 never reaches zero").arg(counter);
+    else if (!assumptions.isEmpty())
+        l.note = QString("assumes the high byte of %1 is zero").arg(assumptions.join(" and "));
+}
+
+// Value of a register when the loop is entered, as long as it's set with MOV on the way in
+bool TimingAnalyzer::entryValue(Function& f, const Loop& l, int reg, unsigned short& value, bool& assumed)
+{
+    QList<int> entering;
+    foreach (int p, f.predecessors.value(l.header)) {
+        if (!l.blocks.contains(p))
+            entering.append(p);
+    }
+    if (entering.length() != 1)
+        return false;
+
+    int b = entering.first();
+    QSet<int> visited;
+    while (!visited.contains(b)) {
+        visited.insert(b);
+        const Block& block = m_blocks.at(b);
+
+        // A call at the end of the block is the last thing that can touch the register
+        if (block.indirectCall)
+            return false;
+        if (block.callee >= 0) {
+            QSet<int> calleeVisited;
+            if (functionRegistersWritten(block.callee, calleeVisited) & (1 << reg))
+                return false;
+        }
+
+        for (int a = block.end - 1; a >= block.start; a--) {
+            if (!(registersWritten(a) & (1 << reg)))
+                continue;
+            unsigned short w = m_program.at(a);
+            if ((w & OPCODE_MASK) != OPCODE_MOVE_IMM)
+                return false;
+            value = w & 0xff;
+            if (w & FLAG_EXTEND) {
+                if (value & 0x80)
+                    value |= 0xff00;
+            } else {
+                assumed = true;     // MOV without extension leaves the high byte alone
+            }
+            return true;
+        }
+
+        QList<int> predecessors = f.predecessors.value(b);
+        if (b == f.entry) {
+            // All registers are cleared on reset
+            if (m_blocks.at(b).start == 0 && predecessors.isEmpty()) {
+                value = 0;
+                return true;
+            }
+            return false;
+        }
+        if (predecessors.length() != 1)
+            return false;
+        b = predecessors.first();
+    }
+    return false;
+}
+
+int TimingAnalyzer::registersWritten(int address) const
+{
+    unsigned short w = m_program.at(address);
+    int target = 1 << ((w >> TARGET_REG) & REG_MASK);
+    // Post-incremented or decremented address register of an indirect access
+    int pointer = ((w & FLAG_INDIRECT) && (w & POST_MODIFY_MASK) && (w & POST_MODIFY_MASK) != POST_MODIFY_MASK)
+            ? 1 << ((w >> SRC1_REG) & REG_MASK) : 0;
+    switch (w & OPCODE_MASK) {
+        case OPCODE_ALUOP:
+            return (w & FLAG_NO_WRITEBACK) ? 0 : target;
+        case OPCODE_MOVE_IMM:
+        case OPCODE_COPYDATA:
+            return target;
+        case OPCODE_LOAD:
+        case OPCODE_READ_IO:
+            return target | pointer;
+        case OPCODE_STORE:
+        case OPCODE_WRITE_IO:
+            return pointer;
+        case OPCODE_STACK_MOVE:
+            return (w & FLAG_POP) ? target : 0;
+    }
+    return 0;
+}
+
+int TimingAnalyzer::writeCount(const QSet<int>& blocks, int reg) const
+{
+    int count = 0;
+    foreach (int b, blocks) {
+        for (int a = m_blocks.at(b).start; a < m_blocks.at(b).end; a++) {
+            if (registersWritten(a) & (1 << reg))
+                count++;
+        }
+    }
+    return count;
+}
+
+// Registers possibly modified by subroutines called from the blocks, -1 if that can't be known
+int TimingAnalyzer::calleeRegistersWritten(const QSet<int>& blocks)
+{
+    int mask = 0;
+    foreach (int b, blocks) {
+        const Block& block = m_blocks.at(b);
+        if (block.indirectCall)
+            return -1;
+        if (block.callee >= 0) {
+            QSet<int> visited;
+            mask |= functionRegistersWritten(block.callee, visited);
+        }
+    }
+    return mask;
+}
+
+int TimingAnalyzer::functionRegistersWritten(int entryAddress, QSet<int>& visited)
+{
+    if (!m_functions.contains(entryAddress))
+        return AllRegisters;
+    if (visited.contains(entryAddress))
+        return 0;
+    visited.insert(entryAddress);
+
+    const Function& f = m_functions[entryAddress];
+    int mask = 0;
+    foreach (int b, f.blocks) {
+        const Block& block = m_blocks.at(b);
+        for (int a = block.start; a < block.end; a++)
+            mask |= registersWritten(a);
+        if (block.indirectCall)
+            mask |= AllRegisters;
+        else if (block.callee >= 0)
+            mask |= functionRegistersWritten(block.callee, visited);
+    }
+    return mask;
+}
+
+quint64 TimingAnalyzer::functionCycles(int entryAddress)
+{
+    if (!m_functions.contains(entryAddress))
+        return Unbounded;
+
+    Function& f = m_functions[entryAddress];
+    if (f.done)
+        return f.cycles;
+    if (f.inProgress) {
+        f.warnings << "recursive call";
+        return Unbounded;
+    }
+
+    f.inProgress = true;
+    f.cycles = regionCycles(f, -1);
+    f.inProgress = false;
+    f.done = true;
+    return f.cycles;
+}
+
+quint64 TimingAnalyzer::blockCycles(Function& /* f */, int block)
+{
+    const Block& b = m_blocks.at(block);
+    quint64 cycles = b.end - b.start;
+    if (b.indirectCall)
+        return Unbounded;
+    if (b.callee >= 0)
+        cycles = addCycles(cycles, functionCycles(b.callee));
+    return cycles;
+}
+
+// Worst case cycles through a whole function (loop < 0) or through all iterations of a loop
+quint64 TimingAnalyzer::regionCycles(Function& f, int loop)
+{
+    QHash<int, quint64> memo;
+    QSet<int> visiting;
+    if (loop < 0)
+        return longestPath(f, -1, regionNode(f, -1, f.entry), memo, visiting);
+
+    Loop& l = f.loops[loop];
+    if (!l.done) {
+        l.done = true;
+        l.iterationCycles = longestPath(f, loop, l.header, memo, visiting);
+        l.totalCycles = l.tripCount ? mulCycles(l.tripCount, f.loops[loop].iterationCycles) : Unbounded;
+    }
+    return f.loops.at(loop).totalCycles;
+}
+
+quint64 TimingAnalyzer::longestPath(Function& f, int loop, int node, QHash<int, quint64>& memo, QSet<int>& visiting)
+{
+    if (memo.contains(node))
+        return memo.value(node);
+    if (visiting.contains(node)) {
+        f.warnings << "irreducible control flow";
+        return Unbounded;
+    }
+    visiting.insert(node);
+
+    quint64 cycles = node >= 0 ? blockCycles(f, node) : regionCycles(f, -node - 1);
+    bool terminates;
+    QList<int> successors = nodeSuccessors(f, loop, node, terminates);
+    quint64 longest = 0;
+    foreach (int s, successors)
+        longest = qMax(longest, longestPath(f, loop, s, memo, visiting));
+
+    visiting.remove(node);
+    cycles = addCycles(cycles, longest);
+    memo.insert(node, cycles);
+    return cycles;
+}
+
+// Nodes of a region are its blocks, except that loops nested directly inside the region
+// are collapsed to a single node (-index - 1)
+int TimingAnalyzer::regionNode(Function& f, int loop, int block) const
+{
+    int child = f.innermostLoop.value(block, -1);
+    if (child == loop)
+        return block;
+    while (child >= 0 && f.loops.at(child).parent != loop)
+        child = f.loops.at(child).parent;
+    return child < 0 ? block : -child - 1;
+}
+
+QList<int> TimingAnalyzer::nodeSuccessors(Function& f, int loop, int node, bool& terminates) const
+{
+    QList<int> blocks;
+    if (node >= 0)
+        blocks.append(node);
+    else
+        blocks = f.loops.at(-node - 1).blocks.toList();
+
+    QList<int> result;
+    terminates = false;
+    foreach (int b, blocks) {
+        const Block& block = m_blocks.at(b);
+        if (block.successors.isEmpty() || block.indirectRegister >= 0)
+            terminates = true;
+        foreach (int s, block.successors) {
+            if (node < 0 && f.loops.at(-node - 1).blocks.contains(s))
+                continue;
+            if (loop >= 0 && (s == f.loops.at(loop).header || !f.loops.at(loop).blocks.contains(s))) {
+                terminates = true;      // back edge or loop exit ends the iteration
+                continue;
+            }
+            int n = regionNode(f, loop, s);
+            if (n != node && !result.contains(n))
+                result.append(n);
+        }
+    }
+    return result;
+}
+
+QString TimingAnalyzer::name(int address) const
+{
+    return m_labels.value(address, QString("$%1").arg(address, 2, 16, QChar('0')));
+}
+
+QString TimingAnalyzer::formatCycles(quint64 cycles, int cpuClock)
+{
+    if (cycles == Unbounded)
+        return "unbounded";
+
+    double seconds = (double) cycles / cpuClock;
+    QString time;
+    if (seconds < 1e-6)
+        time = QString("%1 ns").arg(seconds * 1e9, 0, 'f', 0);
+    else if (seconds < 1e-3)
+        time = QString("%1 us").arg(seconds * 1e6, 0, 'f', 2);
+    else if (seconds < 1)
+        time = QString("%1 ms").arg(seconds * 1e3, 0, 'f', 2);
+    else
+        time = QString("%1 s").arg(seconds, 0, 'f', 2);
+    return QString("%1 cycles (%2)").arg(cycles).arg(time);
+}
+
+void TimingAnalyzer::report(QTextStream& out, int cpuClock) const
+{
+    out << "Timing analysis at " << QString::number(cpuClock / 1e6, 'f', 3) << " MHz, "
+        << QString::number(1e9 / cpuClock, 'f', 0) << " ns per cycle\n";
+    foreach (const QString& w, m_warnings)
+        out << "warning: " << w << "\n";
+
+    for (QMap<int, Function>::const_iterator i = m_functions.constBegin(); i != m_functions.constEnd(); ++i) {
+        const Function& f = i.value();
+        out << "\n" << (i.key() == 0 ? "reset " : "subroutine ") << name(i.key())
+            << ": worst case " << formatCycles(f.cycles, cpuClock) << "\n";
+
+        out << "  " << QString("block").leftJustified(12) << QString("label").leftJustified(24)
+            << QString("cycles").rightJustified(8) << QString("max count").rightJustified(12) << "  calls\n";
+        foreach (int b, f.blocks) {
+            const Block& block = m_blocks.at(b);
+            quint64 count = 1;
+            for (int l = f.innermostLoop.value(b, -1); l >= 0; l = f.loops.at(l).parent)
+                count = mulCycles(count, f.loops.at(l).tripCount ? f.loops.at(l).tripCount : Unbounded);
+
+            QString range = QString("$%1-$%2").arg(block.start, 2, 16, QChar('0')).arg(block.end - 1, 2, 16, QChar('0'));
+            out << "  " << range.leftJustified(12) << m_labels.value(block.start).leftJustified(24)
+                << QString::number(block.end - block.start).rightJustified(8)
+                << (count == Unbounded ? QString("unbounded") : QString::number(count)).rightJustified(12);
+            if (block.callee >= 0)
+                out << "  " << name(block.callee);
+            out << "\n";
+        }
+
+        foreach (const Loop& l, f.loops) {
+            out << "  loop " << name(m_blocks.at(l.header).start) << ": ";
+            if (l.tripCount)
+                out << l.tripCount << " iterations of " << l.iterationCycles << " cycles, "
+                    << formatCycles(l.totalCycles, cpuClock);
+            else
+                out << "unknown trip count, " << formatCycles(l.iterationCycles, cpuClock) << " per iteration";
+            if (!l.note.isEmpty())
+                out << " (" << l.note << ")";
+            out << "\n";
+        }
+
+        foreach (const QString& w, f.warnings)
+            out << "  warning: " << w << "\n";
+    }
+}
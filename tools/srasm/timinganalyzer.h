@@ -0,0 +1,140 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TIMINGANALYZER_H
+#define TIMINGANALYZER_H
+
+#include <QVector>
+#include <QList>
+#include <QMap>
+#include <QSet>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+
+// Static cycle counter for assembled programs. Every instruction executes in exactly one
+// CPU cycle, so the worst case running time of a routine is the length of the longest
+// path through its control flow graph once loops are multiplied by their trip counts.
+//
+// Subroutines are recognized both from BSR/RET and from the register return convention
+// used in the test programs:
+//
+//     mov     return_label, r3
+//     bra     subroutine
+// return_label:
+//     ...
+// subroutine:
+//     ...
+//     bra     r3
+//
+// Loop trip counts are found for loops closed by a single BRNE whose zero flag comes from
+// an INC/DEC/ADD/SUB on a counter register that is initialized with MOV before the loop.
+class TimingAnalyzer
+{
+public:
+    static const int DefaultCpuClock = 6250000;     // 50MHz board clock divided by 8 in the debugger
+    static const quint64 Unbounded = ~0ULL;
+
+    TimingAnalyzer(const QVector<unsigned short>& program, const QMap<QString, int>& codeLabels);
+
+    void analyze();
+    void report(QTextStream& out, int cpuClock = DefaultCpuClock) const;
+
+    // Worst case cycles from reset until the program halts, Unbounded if it never does
+    quint64 worstCaseCycles() const;
+
+private:
+    struct Block {
+        int start;
+        int end;                    // one past the last instruction
+        QList<int> successors;      // block indices, subroutine calls are stepped over
+        int callee;                 // entry address of the subroutine called at the end of the block or -1
+        int linkRegister;           // register holding the return address of a register convention call
+        int indirectRegister;       // register of a register indirect branch ending the block or -1
+        bool indirectCall;
+        bool returns;
+        bool halts;
+    };
+
+    struct Loop {
+        int header;
+        QSet<int> blocks;
+        QList<int> latches;
+        int parent;
+        quint64 tripCount;          // 0 when unknown
+        QString note;
+        quint64 iterationCycles;
+        quint64 totalCycles;
+        bool done;
+    };
+
+    struct Function {
+        int entry;                  // block index
+        QSet<int> linkRegisters;
+        QList<int> blocks;
+        QSet<int> blockSet;
+        QHash<int, QList<int> > predecessors;
+        QHash<int, int> innermostLoop;
+        QList<Loop> loops;
+        QStringList warnings;
+        quint64 cycles;
+        bool done;
+        bool inProgress;
+    };
+
+    void buildBlocks();
+    static int branchTarget(int address, unsigned short w);
+    int ghettoCallLinkRegister(const Block& b) const;
+    void addFunction(int entryAddress);
+    void buildFunction(Function& f);
+    void findLoops(Function& f);
+    void findTripCount(Function& f, Loop& l);
+    bool entryValue(Function& f, const Loop& l, int reg, unsigned short& value, bool& assumed);
+    int registersWritten(int address) const;
+    int writeCount(const QSet<int>& blocks, int reg) const;
+    int calleeRegistersWritten(const QSet<int>& blocks);
+    int functionRegistersWritten(int entryAddress, QSet<int>& visited);
+
+    quint64 functionCycles(int entryAddress);
+    quint64 blockCycles(Function& f, int block);
+    quint64 regionCycles(Function& f, int loop);
+    quint64 longestPath(Function& f, int loop, int node, QHash<int, quint64>& memo, QSet<int>& visiting);
+    int regionNode(Function& f, int loop, int block) const;
+    QList<int> nodeSuccessors(Function& f, int loop, int node, bool& terminates) const;
+
+    QString name(int address) const;
+    static QString formatCycles(quint64 cycles, int cpuClock);
+
+private:
+    QVector<unsigned short> m_program;
+    QMap<int, QString> m_labels;
+    QList<Block> m_blocks;
+    QVector<int> m_blockAt;
+    QMap<int, Function> m_functions;     // keyed by entry address
+    QStringList m_warnings;
+};
+
+#endif // TIMINGANALYZER_H
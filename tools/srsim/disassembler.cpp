@@ -0,0 +1,167 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "disassembler.h"
+#include "isa.h"
+
+Disassembler::Disassembler()
+{
+}
+
+Disassembler::Disassembler(const QMap<int, QString> &codeLabels, const QMap<int, QString> &dataLabels) :
+    m_codeLabels(codeLabels),
+    m_dataLabels(dataLabels)
+{
+}
+
+QString Disassembler::hex(int value, int digits)
+{
+    return QString("$%1").arg(value, digits, 16, QChar('0'));
+}
+
+QString Disassembler::reg(int r, bool extend)
+{
+    return QString("r%1%2").arg(r & REG_MASK).arg(extend ? "e" : "");
+}
+
+// (r), (r)+ or (r)- of an indirect access
+QString Disassembler::pointer(unsigned short i)
+{
+    QString s = "(" + reg(i >> SRC1_REG) + ")";
+    switch (i & POST_MODIFY_MASK) {
+        case FLAG_POST_INCREMENT: return s + "+";
+        case FLAG_POST_DECREMENT: return s + "-";
+        default: return s;
+    }
+}
+
+QString Disassembler::codeAddress(int address) const
+{
+    return m_codeLabels.value(address, hex(address, address > 0xff ? 3 : 2));
+}
+
+QString Disassembler::dataAddress(int address) const
+{
+    return m_dataLabels.value(address, hex(address));
+}
+
+QString Disassembler::disassemble(unsigned short i, int address) const
+{
+    int t = i >> TARGET_REG;
+    int r = i >> SRC1_REG;
+    int s = i >> SRC2_REG;
+    int imm = i & 0xff;
+    bool extend = i & FLAG_EXTEND;
+    bool indirect = i & FLAG_INDIRECT;
+
+    switch (i & OPCODE_MASK) {
+        case OPCODE_NOP:
+            return "nop";
+
+        case OPCODE_MOVE_IMM:
+            return QString("mov     %1, %2").arg(hex(imm)).arg(reg(t, extend));
+
+        case OPCODE_LOAD:
+            return QString("ld      %1, %2").arg(indirect ? pointer(i) : dataAddress(imm)).arg(reg(t, extend));
+
+        case OPCODE_READ_IO:
+            return QString("in      %1, %2").arg(indirect ? pointer(i) : hex(imm)).arg(reg(t, extend));
+
+        case OPCODE_STORE:
+            return QString("st      %1, %2").arg(reg(t)).arg(indirect ? pointer(i) : dataAddress(imm));
+
+        case OPCODE_WRITE_IO:
+            return QString("out     %1, %2").arg(reg(t)).arg(indirect ? pointer(i) : hex(imm));
+
+        case OPCODE_ALUOP: {
+            static const char* names[] = { "add", "sub", "shr", "shl", "clr", "swap", "not", "or",
+                                           "and", "xor", "mov", "dec", "inc", "adc", "sbc" };
+            int op = ALU_OP(i);
+            if (op > ALU_OP_SBC)
+                return QString(".dw     %1").arg(hex(i, 4));
+            if (i & FLAG_NO_WRITEBACK) {
+                if (op == ALU_OP_SUB)
+                    return QString("cmp     %1, %2").arg(reg(r)).arg(reg(s));
+                if (op == ALU_OP_AND)
+                    return (r & REG_MASK) == (s & REG_MASK) ? "tst     " + reg(r) : QString("tst     %1, %2").arg(reg(r)).arg(reg(s));
+                // the other ops can't be written in srasm without the write-back
+                return QString(".dw     %1").arg(hex(i, 4));
+            }
+            QString name = QString(names[op]).leftJustified(8);
+            switch (op) {
+                case ALU_OP_ADD:
+                case ALU_OP_SUB:
+                case ALU_OP_ADC:
+                case ALU_OP_SBC:
+                case ALU_OP_OR:
+                case ALU_OP_AND:
+                case ALU_OP_XOR:
+                    return name + QString("%1, %2, %3").arg(reg(r)).arg(reg(s)).arg(reg(t));
+                case ALU_OP_ZERO:
+                    return name + reg(t);
+                case ALU_OP_DEC:
+                case ALU_OP_INC:
+                    if ((r & REG_MASK) == (t & REG_MASK))
+                        return name + reg(t);
+                    // fall through
+                default:
+                    return name + QString("%1, %2").arg(reg(r)).arg(reg(t));
+            }
+        }
+
+        case OPCODE_BRANCH:
+        case OPCODE_BRANCH_TO_SUBROUTINE: {
+            bool subroutine = (i & OPCODE_MASK) == OPCODE_BRANCH_TO_SUBROUTINE;
+            static const char* branches[] = { "breq", "brne", "bra", "brnv" };
+            static const char* calls[] = { "bsreq", "bsrne", "bsr", "bsrnv" };
+            QString name = QString(subroutine ? calls[BRANCH_CONDITION(i)] : branches[BRANCH_CONDITION(i)]).leftJustified(8);
+            return name + ((i & FLAG_REGISTER_JUMP_TARGET) ? reg(r) : codeAddress((address & ~0xff) | imm));
+        }
+
+        case OPCODE_FAR_BRANCH_TO_SUBROUTINE:
+            return "fbsr    " + codeAddress(FAR_BANK(i) * PROGRAM_BANK_SIZE + imm);
+
+        case OPCODE_RETURN_FROM_SUBROUTINE:
+            if (i & FLAG_RETI)
+                return "reti";
+            return (i & FLAG_FAR_RETURN) ? "fret" : "ret";
+
+        case OPCODE_INTERRUPT_ENABLE:
+            return (i & FLAG_INTERRUPT_ENABLE) ? "ei" : "di";
+
+        case OPCODE_STACK_MOVE:
+            return QString((i & FLAG_POP) ? "pop     " : "push    ") + reg(t);
+
+        case OPCODE_COPYDATA:
+            // Only generated by srasm for the data initialization prologue
+            return QString("cpy     %1, (%2)+").arg(hex(imm)).arg(reg(t));
+
+        case OPCODE_HALT:
+            return "halt";
+
+        default:
+            return QString(".dw     %1").arg(hex(i, 4));
+    }
+}
@@ -0,0 +1,55 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef DISASSEMBLER_H
+#define DISASSEMBLER_H
+
+#include <QMap>
+#include <QString>
+
+// Turns instruction words back into srasm syntax. Branch targets and memory
+// addresses are replaced with labels when they're known.
+class Disassembler
+{
+public:
+    Disassembler();
+    Disassembler(const QMap<int, QString>& codeLabels, const QMap<int, QString>& dataLabels);
+
+    // Branch targets are resolved in the bank of the program memory address
+    QString disassemble(unsigned short instruction, int address = 0) const;
+
+private:
+    QString codeAddress(int address) const;
+    QString dataAddress(int address) const;
+    static QString reg(int r, bool extend = false);
+    static QString pointer(unsigned short instruction);
+    static QString hex(int value, int digits = 2);
+
+private:
+    QMap<int, QString> m_codeLabels;
+    QMap<int, QString> m_dataLabels;
+};
+
+#endif // DISASSEMBLER_H
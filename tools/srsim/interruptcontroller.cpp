@@ -0,0 +1,129 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "interruptcontroller.h"
+
+const int InterruptController::BaseAddress;
+const int InterruptController::LcdCommandAddress;
+const int InterruptController::LcdDataAddress;
+const int InterruptController::LcdLongDelay;
+const int InterruptController::LcdShortDelay;
+const int InterruptController::DefaultClockDivider;
+const quint64 InterruptController::Never;
+
+InterruptController::InterruptController()
+{
+    setClockDivider(DefaultClockDivider);
+    reset();
+}
+
+void InterruptController::setClockDivider(int divider)
+{
+    // The interrupt is taken on the first CPU clock after the delay in clk_50 cycles
+    m_lcdLongDelay = (LcdLongDelay * DefaultClockDivider + divider - 1) / divider;
+    m_lcdShortDelay = (LcdShortDelay * DefaultClockDivider + divider - 1) / divider;
+}
+
+void InterruptController::reset()
+{
+    m_enable = 0;
+    m_pending = 0;
+    m_vector = 0;
+    m_reload = 0;
+    m_hostData = 0;
+    m_timerDeadline = Never;
+    m_lcdDeadline = Never;
+    update(0);
+}
+
+unsigned char InterruptController::read(int reg) const
+{
+    switch (reg) {
+        case Enable: return m_enable;
+        case Pending: return m_pending;
+        case Vector: return m_vector;
+        case ReloadLow: return m_reload & 0xff;
+        case ReloadHigh: return m_reload >> 8;
+        case HostData: return m_hostData;
+        default: return 0;
+    }
+}
+
+void InterruptController::write(int reg, unsigned char value, quint64 cycle)
+{
+    switch (reg) {
+        case Enable:
+            m_enable = value & 0x7;
+            break;
+        case Pending:
+            // A source firing in the same cycle wins, update() runs after this
+            m_pending &= ~value;
+            break;
+        case Vector:
+            m_vector = value;
+            break;
+        case ReloadLow:
+            m_reload = (m_reload & 0xff00) | value;
+            break;
+        case ReloadHigh:
+            m_reload = value << 8 | (m_reload & 0xff);
+            m_timerDeadline = m_reload ? cycle + m_reload : Never;
+            break;
+    }
+    update(0);
+}
+
+void InterruptController::lcdWritten(int address, unsigned char value, quint64 cycle)
+{
+    // Clear display and return home take long. The RTL counts the delay in
+    // clk_50 cycles and the edge detection makes the interrupt pending one
+    // cycle before the delay runs out, so it's taken exactly after it.
+    bool slow = address == LcdCommandAddress && value >= 1 && value <= 3;
+    m_lcdDeadline = cycle + (slow ? m_lcdLongDelay : m_lcdShortDelay) - 1;
+    update(0);
+}
+
+void InterruptController::update(quint64 cycle)
+{
+    if (cycle >= m_timerDeadline) {
+        m_pending |= Timer;
+        // reloads with whatever is in the reload register now, 0 stops the timer. A caller
+        // that doesn't tick every cycle, like code from srasm --emit-cpp, stays in phase.
+        m_timerDeadline = m_reload ? cycle + m_reload - (cycle - m_timerDeadline) % m_reload : Never;
+    }
+    if (cycle >= m_lcdDeadline) {
+        m_pending |= LcdReady;
+        m_lcdDeadline = Never;
+    }
+    while (!m_hostBytes.isEmpty() && cycle >= m_hostBytes.firstKey()) {
+        m_pending |= Host;
+        m_hostData = m_hostBytes.first();
+        m_hostBytes.erase(m_hostBytes.begin());
+    }
+
+    m_nextEvent = qMin(m_timerDeadline, m_lcdDeadline);
+    if (!m_hostBytes.isEmpty())
+        m_nextEvent = qMin(m_nextEvent, m_hostBytes.firstKey());
+}
@@ -0,0 +1,91 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef INTERRUPTCONTROLLER_H
+#define INTERRUPTCONTROLLER_H
+
+#include <QMap>
+
+// Model of core/vhdl/interrupt_controller.vhdl together with the ready output
+// of the LCD controller. Everything is kept as the cycle at which a source
+// fires, so tick() is a single compare until something happens. The LCD
+// delay is counted in clk_50 cycles like the RTL does it, so its length in CPU
+// cycles depends on the debugger's clock divider.
+class InterruptController
+{
+public:
+    static const int BaseAddress = 0x30;
+    static const int LcdCommandAddress = 0x20;
+    static const int LcdDataAddress = 0x21;
+    // CPU cycles the HD44780 needs for clear/home and for everything else at the default divider
+    static const int LcdLongDelay = 10240;
+    static const int LcdShortDelay = 256;
+    static const int DefaultClockDivider = 8;
+
+    enum Register { Enable, Pending, Vector, ReloadLow, ReloadHigh, HostData };
+    enum Source { Timer = 0x1, LcdReady = 0x2, Host = 0x4 };
+
+    InterruptController();
+
+    // Clears the registers, queued host bytes and the clock divider are kept
+    void reset();
+    // clk_50 cycles per CPU cycle, set with debugger command 07
+    void setClockDivider(int divider);
+
+    // The cycle is the cycle count after the instruction that does the access
+    unsigned char read(int reg) const;
+    void write(int reg, unsigned char value, quint64 cycle);
+    void lcdWritten(int address, unsigned char value, quint64 cycle);
+
+    // Byte sent by the host with debugger command 06, pending after <cycle> cycles
+    void queueHostByte(quint64 cycle, unsigned char value) { m_hostBytes.insert(cycle, value); update(0); }
+
+    bool irq() const { return m_pending & m_enable; }
+    int vector() const { return m_vector; }
+
+    // Called after every cycle, or before an access to catch up with the cycles in between
+    inline void tick(quint64 cycle) { if (cycle >= m_nextEvent) update(cycle); }
+    // First cycle irq() can change at without an access in between
+    quint64 nextEvent() const { return m_nextEvent; }
+
+private:
+    void update(quint64 cycle);
+
+    static const quint64 Never = ~0ULL;
+
+    int m_enable;
+    int m_pending;
+    int m_vector;
+    int m_reload;
+    int m_hostData;
+    int m_lcdLongDelay;
+    int m_lcdShortDelay;
+    quint64 m_timerDeadline;
+    quint64 m_lcdDeadline;
+    quint64 m_nextEvent;
+    QMultiMap<quint64, unsigned char> m_hostBytes;
+};
+
+#endif // INTERRUPTCONTROLLER_H
@@ -0,0 +1,81 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "labelmap.h"
+#include <QFile>
+#include <QStringList>
+#include <QDebug>
+
+bool LabelMap::load(const QString &filename)
+{
+    QFile file(filename);
+    if (!file.open(QFile::ReadOnly)) {
+        qDebug() << "Can't open map file" << filename;
+        return false;
+    }
+
+    m_codeLabels.clear();
+    m_dataLabels.clear();
+    int lineNumber = 0;
+    while (!file.atEnd()) {
+        QString line = QString::fromLatin1(file.readLine()).trimmed();
+        lineNumber++;
+        if (line.isEmpty())
+            continue;
+
+        QStringList fields = line.split(" ", QString::SkipEmptyParts);
+        bool ok = fields.length() == 3 && fields.at(1).startsWith("$");
+        int address = ok ? fields.at(1).mid(1).toInt(&ok, 16) : 0;
+        if (!ok || (fields.at(0) != "code" && fields.at(0) != "data")) {
+            qDebug() << "Malformed line" << lineNumber << "in" << filename;
+            return false;
+        }
+        if (fields.at(0) == "code")
+            m_codeLabels.insert(fields.at(2), address);
+        else
+            m_dataLabels.insert(fields.at(2), address);
+    }
+    return true;
+}
+
+QMap<int, QString> LabelMap::codeAddresses() const
+{
+    return invert(m_codeLabels);
+}
+
+QMap<int, QString> LabelMap::dataAddresses() const
+{
+    return invert(m_dataLabels);
+}
+
+QMap<int, QString> LabelMap::invert(const QMap<QString, int> &labels)
+{
+    QMap<int, QString> addresses;
+    for (QMap<QString, int>::const_iterator i = labels.constBegin(); i != labels.constEnd(); ++i) {
+        if (!addresses.contains(i.value()))
+            addresses.insert(i.value(), i.key());
+    }
+    return addresses;
+}
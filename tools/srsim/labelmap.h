@@ -0,0 +1,53 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef LABELMAP_H
+#define LABELMAP_H
+
+#include <QMap>
+#include <QString>
+
+// Label addresses written by srasm --map
+class LabelMap
+{
+public:
+    bool load(const QString& filename);
+
+    QMap<QString, int> codeLabels() const { return m_codeLabels; }
+    QMap<QString, int> dataLabels() const { return m_dataLabels; }
+
+    // Address -> label, the alphabetically first label wins if there are several at the same address
+    QMap<int, QString> codeAddresses() const;
+    QMap<int, QString> dataAddresses() const;
+
+private:
+    static QMap<int, QString> invert(const QMap<QString, int>& labels);
+
+private:
+    QMap<QString, int> m_codeLabels;
+    QMap<QString, int> m_dataLabels;
+};
+
+#endif // LABELMAP_H
@@ -0,0 +1,72 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "mailbox.h"
+#include <string.h>
+
+const int Mailbox::BaseAddress;
+
+Mailbox::Mailbox(int cores) :
+    m_cores(cores)
+{
+    reset();
+}
+
+void Mailbox::reset()
+{
+    memset(m_mailbox, 0, sizeof(m_mailbox));
+    m_full = 0;
+    m_semaphores = 0;
+}
+
+unsigned char Mailbox::read(int reg, int core)
+{
+    if (reg & Semaphore) {
+        int bit = 1 << (reg & 7);
+        bool taken = m_semaphores & bit;
+        m_semaphores |= bit;
+        return taken ? 1 : 0;
+    }
+    if (reg < Mailboxes) {
+        m_full &= ~(1 << reg);
+        return m_mailbox[reg];
+    }
+    switch (reg) {
+        case Full: return m_full;
+        case CoreNumber: return core;
+        case CoreCount: return m_cores;
+        default: return 0;
+    }
+}
+
+void Mailbox::write(int reg, unsigned char value)
+{
+    if (reg & Semaphore) {
+        m_semaphores &= ~(1 << (reg & 7));
+    } else if (reg < Mailboxes) {
+        m_mailbox[reg] = value;
+        m_full |= 1 << reg;
+    }
+}
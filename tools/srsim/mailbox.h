@@ -0,0 +1,56 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MAILBOX_H
+#define MAILBOX_H
+
+// Model of core/vhdl/mailbox_device.vhdl, the mailboxes and semaphores the
+// cores of a multi-core configuration share at $60-$6f.
+class Mailbox
+{
+public:
+    static const int BaseAddress = 0x60;
+    static const int Mailboxes = 4;
+    static const int Semaphores = 8;
+
+    enum Register { Full = 4, CoreNumber = 5, CoreCount = 6, Semaphore = 8 };
+
+    explicit Mailbox(int cores = 1);
+
+    void reset();
+
+    // Reads have side effects: a mailbox read clears its full flag and a
+    // semaphore read takes the semaphore
+    unsigned char read(int reg, int core);
+    void write(int reg, unsigned char value);
+
+private:
+    int m_cores;
+    unsigned char m_mailbox[Mailboxes];
+    int m_full;
+    int m_semaphores;
+};
+
+#endif // MAILBOX_H
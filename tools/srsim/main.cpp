@@ -0,0 +1,412 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QDebug>
+#include <QTextStream>
+#include <stdio.h>
+
+#include "srsimulator.h"
+#include "multicore.h"
+#include "labelmap.h"
+#include "profiler.h"
+#include "statetrace.h"
+#include "tracebuffer.h"
+#include "tracefile.h"
+#include "srimage.h"
+#include "disassembler.h"
+#include "reversedebugger.h"
+
+static bool writeReport(const QString& filename, Profiler& profiler, void (Profiler::*writer)(QTextStream&) const)
+{
+    if (filename == "-") {
+        QTextStream out(stdout);
+        (profiler.*writer)(out);
+        return true;
+    }
+
+    QFile file(filename);
+    if (!file.open(QFile::WriteOnly)) {
+        qDebug() << "Can't open" << filename;
+        return false;
+    }
+    QTextStream out(&file);
+    (profiler.*writer)(out);
+    return true;
+}
+
+// $hex, a number or a label
+static bool parseAddress(const QString& text, const QMap<QString, int>& labels, int* address)
+{
+    bool ok = false;
+    *address = text.startsWith("$") ? text.mid(1).toInt(&ok, 16) : text.toInt(&ok, 0);
+    if (!ok && labels.contains(text)) {
+        *address = labels.value(text);
+        ok = true;
+    }
+    return ok;
+}
+
+static void printPosition(const SRSimulator& sim, const Disassembler& disassembler)
+{
+    printf("%-10llu $%03X  %-28s R0: %04X R1: %04X R2: %04X R3: %04X SP: %02X SR: %02X%s\n", sim.cycles(), sim.pc(),
+           qPrintable(disassembler.disassemble(sim.ir(), sim.pc())), sim.reg(0), sim.reg(1), sim.reg(2), sim.reg(3),
+           sim.sp(), sim.sr(), sim.halted() ? "  halted" : "");
+}
+
+// Commands in the style of risccom, with b for back: s/bs [n] steps, r/br runs
+// to the next or previous breakpoint, b <address> toggles a breakpoint, g <cycle>
+// goes to a cycle, lw [io] <address> finds the last write to an address, dm
+// dumps the data memory and q quits
+static void debugConsole(ReverseDebugger& debugger, SRSimulator& sim, const LabelMap& labels, quint64 maxCycles)
+{
+    Disassembler disassembler(labels.codeAddresses(), labels.dataAddresses());
+    QTextStream in(stdin);
+    printPosition(sim, disassembler);
+    forever {
+        printf("> ");
+        fflush(stdout);
+        QString line = in.readLine();
+        if (line.isNull())
+            break;
+        QStringList args = line.simplified().split(" ");
+        QString command = args.first();
+        bool ok = true;
+        quint64 count = args.length() == 2 ? args.at(1).toULongLong(&ok, 0) : 1;
+
+        if (command.isEmpty()) {
+            continue;
+        } else if (command == "q") {
+            break;
+        } else if (command == "s" && ok && args.length() <= 2) {
+            debugger.forward(count, false);
+        } else if (command == "bs" && ok && args.length() <= 2) {
+            debugger.seek(sim.cycles() - qMin(count, sim.cycles()));
+        } else if (command == "r" && args.length() == 1) {
+            if (!debugger.forward(maxCycles))
+                printf("%s\n", sim.stopped() ? "Halted" : "No breakpoint hit");
+        } else if (command == "br" && args.length() == 1) {
+            if (!debugger.reverseContinue())
+                printf("No breakpoint hit before cycle %llu\n", sim.cycles());
+        } else if (command == "g" && args.length() == 2 && ok) {
+            debugger.seek(args.at(1).toULongLong(&ok, 0));
+        } else if (command == "b" && args.length() == 1) {
+            foreach (int address, debugger.breakpoints())
+                printf("$%03X  %s\n", address, qPrintable(labels.codeAddresses().value(address)));
+            continue;
+        } else if (command == "b" && args.length() == 2) {
+            int address;
+            if (!parseAddress(args.at(1), labels.codeLabels(), &address) || address < 0 || address >= PROGRAM_SIZE) {
+                printf("Invalid address %s\n", qPrintable(args.at(1)));
+                continue;
+            }
+            debugger.setBreakpoint(address, !debugger.breakpoint(address));
+            printf("Breakpoint at $%03X %s\n", address, debugger.breakpoint(address) ? "set" : "cleared");
+            continue;
+        } else if (command == "lw" && (args.length() == 2 || (args.length() == 3 && args.at(1) == "io"))) {
+            bool io = args.length() == 3;
+            int address;
+            if (!parseAddress(args.last(), io ? QMap<QString, int>() : labels.dataLabels(), &address)
+                    || address < 0 || address > 255) {
+                printf("Invalid address %s\n", qPrintable(args.last()));
+                continue;
+            }
+            ReverseDebugger::Write write;
+            if (debugger.lastWrite(address, io, &write))
+                printf("%-10llu $%03X  %-28s wrote $%02X\n", write.cycle, write.pc,
+                       qPrintable(disassembler.disassemble(sim.programWord(write.pc), write.pc)), write.value);
+            else
+                printf("No write to %s$%02X before cycle %llu\n", io ? "I/O " : "", address, sim.cycles());
+            continue;
+        } else if (command == "dm" && args.length() == 1) {
+            for (int row = 0; row < 256; row += 16) {
+                printf("$%02X:", row);
+                for (int a = row; a < row + 16; a++)
+                    printf(" %02X", sim.dataByte(a));
+                printf("\n");
+            }
+            continue;
+        } else {
+            printf("Commands: s [n], bs [n], r, br, g <cycle>, b [address], lw [io] <address>, dm, q\n");
+            continue;
+        }
+        printPosition(sim, disassembler);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Instruction set simulator for shitty-RISC");
+    parser.addHelpOption();
+    parser.addPositionalArgument("binary", "Program binary or image written by srasm");
+    QCommandLineOption mapOption(QStringList() << "m" << "map", "Label map written by srasm --map", "file");
+    QCommandLineOption cyclesOption(QStringList() << "c" << "max-cycles", "Stop after <n> cycles unless the CPU halts first", "n", "10000000");
+    QCommandLineOption profileOption(QStringList() << "p" << "profile", "Print the hot spot report");
+    QCommandLineOption topOption("top", "Number of entries in the hot spot report", "n", "20");
+    QCommandLineOption listingOption("listing", "Write an annotated listing with execution counts to <file>, - for stdout", "file");
+    QCommandLineOption foldedOption("folded", "Write folded call stacks for flame graph tools to <file>, - for stdout", "file");
+    QCommandLineOption traceOption("trace", "Write a state trace in the format of core/sim/shitty_risc_tb.vhdl to <file>", "file");
+    QCommandLineOption compareOption("compare", "Compare the run against a state trace written by the RTL testbench and "
+                                     "report the first divergence", "file");
+    QCommandLineOption sampleOption("sample", "Trace the CPU state every <n> cycles, memory writes are always traced. "
+                                    "Taken from the trace header when comparing", "n", "1");
+    QCommandLineOption serialOption("serial", "Bytes sent by the host with debugger command 06, raising the host "
+                                    "interrupt after <cycle> cycles", "cycle:byte[,cycle:byte...]");
+    QCommandLineOption dividerOption("clock-divider", "clk_50 cycles per CPU cycle set with debugger command 07, "
+                                     "affects the LCD ready interrupt timing", "n",
+                                     QString::number(InterruptController::DefaultClockDivider));
+    QCommandLineOption traceBufferOption("trace-buffer", "Record the last instructions like the debugger's trace buffer "
+                                         "and write the decoded dump to <file>, - for stdout", "file");
+    QCommandLineOption traceWritesOption("trace-writes", "Record the data and I/O writes in the trace buffer instead of the IR");
+    QCommandLineOption traceStopOption("trace-stop", "Stop recording after the instruction at <address>, "
+                                       "a code label or bank * 256 + PC", "address");
+    QCommandLineOption traceFileOption("trace-file", "Write every executed instruction with its register changes and "
+                                       "writes to a compressed binary trace for srtrace", "file");
+    QCommandLineOption coresOption("cores", "Simulate the multi-core top level with <n> cores sharing the I/O bus, "
+                                   "the other options apply to core 0", "n", "1");
+    parser.addOption(mapOption);
+    parser.addOption(cyclesOption);
+    parser.addOption(profileOption);
+    parser.addOption(topOption);
+    parser.addOption(listingOption);
+    parser.addOption(foldedOption);
+    parser.addOption(traceOption);
+    parser.addOption(compareOption);
+    parser.addOption(sampleOption);
+    parser.addOption(serialOption);
+    parser.addOption(dividerOption);
+    parser.addOption(traceBufferOption);
+    parser.addOption(traceWritesOption);
+    parser.addOption(traceStopOption);
+    parser.addOption(traceFileOption);
+    QCommandLineOption debugOption("debug", "Step through the program interactively, backwards too. The run "
+                                   "and trace options don't apply");
+    QCommandLineOption checkpointsOption("checkpoints", "Checkpoints kept for reverse execution with --debug, "
+                                         "a few hundred bytes each", "n",
+                                         QString::number(ReverseDebugger::DefaultMaxCheckpoints));
+    parser.addOption(coresOption);
+    parser.addOption(debugOption);
+    parser.addOption(checkpointsOption);
+    parser.process(a);
+
+    QStringList args = parser.positionalArguments();
+    if (args.isEmpty())
+        parser.showHelp(1);
+
+    QFile binary(args.at(0));
+    if (!binary.open(QFile::ReadOnly)) {
+        qDebug() << "Can't open" << args.at(0);
+        return 1;
+    }
+
+    LabelMap labels;
+    if (parser.isSet(mapOption) && !labels.load(parser.value(mapOption)))
+        return 1;
+
+    int cores = parser.value(coresOption).toInt();
+    if (cores < 1 || cores > MultiCore::MaxCores) {
+        qDebug() << "The number of cores has to be between 1 and" << MultiCore::MaxCores;
+        return 1;
+    }
+    MultiCore machine(cores);
+    QByteArray file = binary.readAll();
+    if (SRImage::isImage(file)) {
+        SRImage image;
+        if (!image.parse(file))
+            return 1;
+        machine.loadImage(image);
+    } else {
+        machine.loadProgram(file);
+    }
+    SRSimulator& sim = *machine.core(0);
+
+    int divider = parser.value(dividerOption).toInt();
+    // 1 is the pipelined core's
+    if (divider < 1 || divider > 8) {
+        qDebug() << "The clock divider has to be between 1 and 8";
+        return 1;
+    }
+    sim.interruptController()->setClockDivider(divider);
+
+    if (parser.isSet(serialOption)) {
+        foreach (QString byte, parser.value(serialOption).split(",")) {
+            QStringList fields = byte.split(":");
+            bool cycleOk = false, valueOk = false;
+            quint64 cycle = fields.first().toULongLong(&cycleOk);
+            int value = fields.last().toInt(&valueOk, 0);
+            if (fields.length() != 2 || !cycleOk || !valueOk || value < 0 || value > 255) {
+                qDebug() << "Invalid serial byte" << byte;
+                return 1;
+            }
+            sim.interruptController()->queueHostByte(cycle, value);
+        }
+    }
+
+    if (parser.isSet(debugOption)) {
+        ReverseDebugger debugger(&machine, parser.value(checkpointsOption).toInt());
+        debugConsole(debugger, sim, labels, parser.value(cyclesOption).toULongLong());
+        return 0;
+    }
+
+    bool profiling = parser.isSet(profileOption) || parser.isSet(listingOption) || parser.isSet(foldedOption);
+    Profiler profiler;
+    if (profiling) {
+        QVector<unsigned short> program;
+        for (int i = 0; i < PROGRAM_SIZE; i++)
+            program.append(sim.programWord(i));
+        profiler.setProgram(program, labels.codeAddresses(), labels.dataAddresses());
+        sim.setProfiler(&profiler);
+    }
+
+    TraceBuffer traceBuffer;
+    if (parser.isSet(traceBufferOption)) {
+        int trigger = -1;
+        if (parser.isSet(traceStopOption)) {
+            QString address = parser.value(traceStopOption);
+            bool ok = parseAddress(address, labels.codeLabels(), &trigger);
+            if (!ok || trigger < 0 || trigger >= PROGRAM_SIZE) {
+                qDebug() << "Invalid trace stop address" << address;
+                return 1;
+            }
+        }
+        traceBuffer.start(parser.isSet(traceWritesOption), trigger);
+        sim.setTraceBuffer(&traceBuffer);
+    }
+
+    TraceFileWriter binaryTrace;
+    if (parser.isSet(traceFileOption)) {
+        TraceFile::State state;
+        for (int r = 0; r < 4; r++)
+            state.regs[r] = sim.reg(r);
+        state.sp = sim.sp();
+        state.sr = sim.sr();
+        if (!binaryTrace.open(parser.value(traceFileOption), state, sim.cycles())) {
+            qDebug() << "Can't open" << parser.value(traceFileOption);
+            return 1;
+        }
+        sim.setTraceFile(&binaryTrace);
+    }
+
+    bool tracing = parser.isSet(traceOption) || parser.isSet(compareOption);
+    StateTrace trace(&sim, parser.value(sampleOption).toInt());
+    QFile traceFile(parser.value(traceOption));
+    QFile referenceFile(parser.value(compareOption));
+    if (parser.isSet(traceOption)) {
+        if (!traceFile.open(QFile::WriteOnly)) {
+            qDebug() << "Can't open" << traceFile.fileName();
+            return 1;
+        }
+        trace.setOutput(&traceFile);
+    }
+    if (parser.isSet(compareOption)) {
+        if (!referenceFile.open(QFile::ReadOnly)) {
+            qDebug() << "Can't open" << referenceFile.fileName();
+            return 1;
+        }
+        trace.setReference(&referenceFile, referenceFile.fileName());
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    quint64 maxCycles = parser.value(cyclesOption).toULongLong();
+    quint64 cycles;
+    if (tracing) {
+        sim.setTrace(&trace);
+        trace.begin();
+        while (!machine.stopped() && sim.cycles() < maxCycles && !trace.diverged())
+            machine.step();
+        trace.end();
+        cycles = sim.cycles();
+    } else {
+        cycles = machine.run(maxCycles);
+    }
+    qint64 elapsed = timer.nsecsElapsed();
+    if (parser.isSet(traceFileOption) && !binaryTrace.close()) {
+        qDebug() << "Writing" << parser.value(traceFileOption) << "failed";
+        return 1;
+    }
+
+    printf("%s after %llu cycles, %.1f M cycles/s\n", machine.stopped() ? "Halted" : "Stopped", cycles,
+           elapsed ? cycles * 1e3 / elapsed : 0.0);
+    printf("----------------------------------------------\n");
+    printf("R0: 0x%04X  R1: 0x%04X  R2: 0x%04X  R3: 0x%04X\n", sim.reg(0), sim.reg(1), sim.reg(2), sim.reg(3));
+    printf("PC: 0x%02X    SR: -%c%c%c%c%c  IR: 0x%04X  SP: 0x%02X  BANK: %d\n", sim.pc() & 0xff,
+           sim.sr() & SR_INTERRUPT_ENABLE ? 'I' : '-', sim.sr() & SR_HALTED ? 'H' : '-', sim.sr() & SR_CARRY ? 'C' : '-',
+           sim.sr() & SR_NEGATIVE ? 'N' : '-', sim.sr() & SR_ZERO ? 'Z' : '-', sim.ir(), sim.sp(), sim.bank());
+    quint32 counters[PerfCounters::CounterCount];
+    for (int i = 0; i < PerfCounters::CounterCount; i++)
+        counters[i] = sim.perfCounters().value(i);
+    printf("%s\n", qPrintable(PerfCounters::format(counters)));
+    for (int i = 1; i < machine.cores(); i++) {
+        const SRSimulator* core = machine.core(i);
+        printf("Core %d  R0: 0x%04X  R1: 0x%04X  R2: 0x%04X  R3: 0x%04X  PC: 0x%02X  BANK: %d%s\n", i,
+               core->reg(0), core->reg(1), core->reg(2), core->reg(3), core->pc() & 0xff, core->bank(),
+               core->stopped() ? "  halted" : "");
+    }
+    printf("----------------------------------------------\n");
+    fflush(stdout);
+
+    if (parser.isSet(profileOption)) {
+        QTextStream out(stdout);
+        profiler.report(out, parser.value(topOption).toInt());
+    }
+    if (parser.isSet(compareOption)) {
+        QTextStream out(stdout);
+        trace.report(out, Disassembler(labels.codeAddresses(), labels.dataAddresses()));
+        if (trace.diverged())
+            return 1;
+    }
+    if (parser.isSet(listingOption) && !writeReport(parser.value(listingOption), profiler, &Profiler::listing))
+        return 1;
+    if (parser.isSet(foldedOption) && !writeReport(parser.value(foldedOption), profiler, &Profiler::foldedStacks))
+        return 1;
+    if (parser.isSet(traceBufferOption)) {
+        // Goes through the same dump format and decoder risccom uses with the hardware
+        QVector<unsigned short> program;
+        for (int i = 0; i < PROGRAM_SIZE; i++)
+            program.append(sim.programWord(i));
+        Disassembler disassembler(labels.codeAddresses(), labels.dataAddresses());
+        if (parser.value(traceBufferOption) == "-") {
+            QTextStream out(stdout);
+            TraceBuffer::decode(traceBuffer.dump(), out, disassembler, program);
+        } else {
+            QFile file(parser.value(traceBufferOption));
+            if (!file.open(QFile::WriteOnly)) {
+                qDebug() << "Can't open" << file.fileName();
+                return 1;
+            }
+            QTextStream out(&file);
+            TraceBuffer::decode(traceBuffer.dump(), out, disassembler, program);
+        }
+    }
+
+    return 0;
+}
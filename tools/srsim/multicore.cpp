@@ -0,0 +1,172 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "multicore.h"
+
+class MultiCore::Core : public SRSimulator
+{
+public:
+    Core(MultiCore* machine, int number) : m_machine(machine), m_number(number) {}
+
+    // Core 0's own devices for the other cores
+    unsigned char deviceRead(int address) { return SRSimulator::ioRead(address); }
+    void deviceWrite(int address, unsigned char value) { SRSimulator::ioWrite(address, value); }
+
+protected:
+    unsigned char ioRead(int address)
+    {
+        if ((address & 0xf0) == Mailbox::BaseAddress)
+            return m_machine->m_mailbox.read(address & 0xf, m_number);
+        return m_machine->m_cores.first()->deviceRead(address);
+    }
+
+    void ioWrite(int address, unsigned char value)
+    {
+        if ((address & 0xf0) == Mailbox::BaseAddress)
+            m_machine->m_mailbox.write(address & 0xf, value);
+        else
+            m_machine->m_cores.first()->deviceWrite(address, value);
+    }
+
+private:
+    MultiCore* m_machine;
+    int m_number;
+};
+
+const int MultiCore::MaxCores;
+
+MultiCore::MultiCore(int cores) :
+    m_mailbox(cores),
+    m_lastGrant(cores - 1)
+{
+    for (int i = 0; i < cores; i++)
+        m_cores.append(new Core(this, i));
+}
+
+MultiCore::~MultiCore()
+{
+    qDeleteAll(m_cores);
+}
+
+SRSimulator* MultiCore::core(int n)
+{
+    return m_cores.at(n);
+}
+
+const SRSimulator* MultiCore::core(int n) const
+{
+    return m_cores.at(n);
+}
+
+quint64 MultiCore::cycles() const
+{
+    return m_cores.first()->cycles();
+}
+
+void MultiCore::reset()
+{
+    foreach (Core* core, m_cores)
+        core->reset();
+    m_mailbox.reset();
+    m_lastGrant = m_cores.size() - 1;
+}
+
+void MultiCore::loadProgram(const QByteArray &bin)
+{
+    foreach (Core* core, m_cores)
+        core->loadProgram(bin);
+}
+
+void MultiCore::loadImage(const SRImage &image)
+{
+    foreach (Core* core, m_cores)
+        core->loadImage(image);
+}
+
+void MultiCore::saveState(State *state) const
+{
+    state->cores.resize(m_cores.size());
+    for (int i = 0; i < m_cores.size(); i++)
+        m_cores.at(i)->saveState(&state->cores[i]);
+    state->mailbox = m_mailbox;
+    state->lastGrant = m_lastGrant;
+}
+
+void MultiCore::restoreState(const State &state)
+{
+    for (int i = 0; i < m_cores.size(); i++)
+        m_cores.at(i)->restoreState(state.cores.at(i));
+    m_mailbox = state.mailbox;
+    m_lastGrant = state.lastGrant;
+}
+
+void MultiCore::step()
+{
+    int cores = m_cores.size();
+    if (cores == 1) {
+        m_cores.first()->step();
+        return;
+    }
+
+    // Like io_arbiter.vhdl, the search starts after the core that had the bus last
+    int requests = 0;
+    for (int i = 0; i < cores; i++) {
+        if (m_cores.at(i)->ioPending())
+            requests |= 1 << i;
+    }
+    int grant = -1;
+    for (int i = 1; i <= cores && grant < 0; i++) {
+        int candidate = (m_lastGrant + i) % cores;
+        if (requests & 1 << candidate)
+            grant = candidate;
+    }
+    if (grant >= 0)
+        m_lastGrant = grant;
+
+    // Core 0 goes last so the others access its devices before its cycle count moves on
+    for (int i = cores - 1; i >= 0; i--) {
+        if ((requests & 1 << i) && i != grant)
+            m_cores.at(i)->stall();
+        else
+            m_cores.at(i)->step();
+    }
+}
+
+quint64 MultiCore::run(quint64 maxCycles)
+{
+    quint64 start = cycles();
+    while (!stopped() && cycles() - start < maxCycles)
+        step();
+    return cycles() - start;
+}
+
+bool MultiCore::stopped() const
+{
+    foreach (const Core* core, m_cores) {
+        if (!core->stopped())
+            return false;
+    }
+    return true;
+}
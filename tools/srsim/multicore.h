@@ -0,0 +1,84 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef MULTICORE_H
+#define MULTICORE_H
+
+#include <QVector>
+#include <QByteArray>
+
+#include "srsimulator.h"
+#include "mailbox.h"
+
+// The cores generic of shitty_risc_top_ep1: up to four cores running the same
+// image out of their own memories and sharing the I/O bus. A core doing IN or
+// OUT waits until the round robin arbiter grants it the bus. The devices other
+// than the mailboxes are core 0's, it's also the only one that gets interrupts.
+//
+// A write by another core to the interrupt controller is seen by core 0's
+// interrupt check in the same cycle, a cycle earlier than on the hardware.
+class MultiCore
+{
+public:
+    static const int MaxCores = 4;
+
+    explicit MultiCore(int cores);
+    ~MultiCore();
+
+    struct State {
+        QVector<SRSimulator::State> cores;
+        Mailbox mailbox;
+        int lastGrant;
+    };
+
+    int cores() const { return m_cores.size(); }
+    SRSimulator* core(int n);
+    const SRSimulator* core(int n) const;
+
+    void reset();
+    // Every core boots the same image
+    void loadProgram(const QByteArray& bin);
+    void loadImage(const SRImage& image);
+
+    void saveState(State* state) const;
+    void restoreState(const State& state);
+
+    // One cycle of every core
+    void step();
+    // Runs until all cores stop or maxCycles have been executed, returns the number of executed cycles
+    quint64 run(quint64 maxCycles);
+
+    bool stopped() const;
+    quint64 cycles() const;
+
+private:
+    class Core;
+
+    QVector<Core*> m_cores;
+    Mailbox m_mailbox;
+    int m_lastGrant;
+};
+
+#endif // MULTICORE_H
@@ -0,0 +1,64 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "perfcounters.h"
+#include <string.h>
+
+const int PerfCounters::BaseAddress;
+const int PerfCounters::AddressMask;
+
+PerfCounters::PerfCounters()
+{
+    reset();
+}
+
+void PerfCounters::reset()
+{
+    memset(m_counters, 0, sizeof(m_counters));
+    memset(m_snapshot, 0, sizeof(m_snapshot));
+}
+
+unsigned char PerfCounters::read(int reg) const
+{
+    int counter = reg / 4;
+    if (counter >= CounterCount)
+        return 0;
+    return m_snapshot[counter] >> (reg % 4) * 8;
+}
+
+void PerfCounters::write(unsigned char value)
+{
+    if (value & Snapshot)
+        memcpy(m_snapshot, m_counters, sizeof(m_snapshot));
+    if (value & Clear)
+        memset(m_counters, 0, sizeof(m_counters));
+}
+
+QString PerfCounters::format(const quint32 *counters)
+{
+    return QString("CYCLES: %1  INSTR: %2  BRANCHES: %3  READS: %4  WRITES: %5  HALTED: %6")
+            .arg(counters[Cycles]).arg(counters[Instructions]).arg(counters[TakenBranches])
+            .arg(counters[MemoryReads]).arg(counters[MemoryWrites]).arg(counters[HaltedCycles]);
+}
@@ -0,0 +1,64 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <QString>
+
+// Model of core/vhdl/perf_counters.vhdl, 32-bit counters that wrap around like
+// the hardware ones. Every cycle is either a retired instruction, an interrupt
+// entry or one that a HALT spent waiting.
+class PerfCounters
+{
+public:
+    // $40-$5f, the counters read as four byte snapshots at $40-$57 with the LSB first
+    static const int BaseAddress = 0x40;
+    static const int AddressMask = 0xe0;
+
+    enum Counter { Cycles, Instructions, TakenBranches, MemoryReads, MemoryWrites, HaltedCycles, CounterCount };
+    // Bits of a write to any of the addresses
+    enum Control { Snapshot = 0x1, Clear = 0x2 };
+
+    PerfCounters();
+
+    void reset();
+
+    unsigned char read(int reg) const;
+    // A clear takes effect before the events of the writing OUT get counted
+    void write(unsigned char value);
+
+    inline void count(Counter counter) { m_counters[counter]++; }
+    quint32 value(int counter) const { return m_counters[counter]; }
+
+    // One line summary printed by srsim and risccom below the CPU state
+    static QString format(const quint32* counters);
+
+private:
+    quint32 m_counters[CounterCount];
+    quint32 m_snapshot[CounterCount];
+};
+
+#endif // PERFCOUNTERS_H
@@ -0,0 +1,230 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "profiler.h"
+#include <QList>
+#include <QPair>
+#include <QSet>
+#include <QStringList>
+#include <string.h>
+
+const int Profiler::MaxDepth;
+
+Profiler::Profiler() :
+    m_total(0),
+    m_node(0)
+{
+    memset(m_kind, Plain, sizeof(m_kind));
+    memset(m_counts, 0, sizeof(m_counts));
+    memset(m_calls, 0, sizeof(m_calls));
+    for (int i = 0; i < PROGRAM_SIZE; i++)
+        m_enclosingLabel[i] = -1;
+
+    Node root;
+    root.parent = -1;
+    root.function = 0;
+    root.cycles = 0;
+    m_nodes.append(root);
+}
+
+void Profiler::setProgram(const QVector<unsigned short> &program, const QMap<int, QString> &codeLabels,
+                          const QMap<int, QString> &dataLabels)
+{
+    m_program = program;
+    m_program.resize(PROGRAM_SIZE);
+    m_labels = codeLabels;
+    m_disassembler = Disassembler(codeLabels, dataLabels);
+
+    int label = -1;
+    for (int pc = 0; pc < PROGRAM_SIZE; pc++) {
+        if (m_labels.contains(pc))
+            label = pc;
+        m_enclosingLabel[pc] = label;
+
+        unsigned short i = m_program.at(pc);
+        switch (i & OPCODE_MASK) {
+            case OPCODE_BRANCH_TO_SUBROUTINE:
+                m_kind[pc] = Call;
+                break;
+            case OPCODE_FAR_BRANCH_TO_SUBROUTINE:
+                m_kind[pc] = FarCall;
+                break;
+            case OPCODE_RETURN_FROM_SUBROUTINE:
+                m_kind[pc] = Return;
+                break;
+            case OPCODE_BRANCH:
+                if (i & FLAG_REGISTER_JUMP_TARGET) {
+                    // Only treated as a return if the target matches a frame on the shadow stack
+                    m_kind[pc] = Return;
+                } else if ((pc & 0xff) > 0 && BRANCH_CONDITION(i) == BRANCH_ALWAYS) {
+                    // mov ret_label, rN; bra sub; ret_label:
+                    unsigned short previous = m_program.at(pc - 1);
+                    if ((previous & OPCODE_MASK) == OPCODE_MOVE_IMM && (previous & 0xff) == (pc & 0xff) + 1)
+                        m_kind[pc] = GhettoCall;
+                    else
+                        m_kind[pc] = Plain;
+                } else {
+                    m_kind[pc] = Plain;
+                }
+                break;
+            default:
+                m_kind[pc] = Plain;
+                break;
+        }
+    }
+}
+
+void Profiler::call(int function, int returnAddress)
+{
+    m_calls[function]++;
+    if (m_stack.size() >= MaxDepth)
+        return;     // runaway recursion, keep attributing to the current stack
+
+    Frame frame;
+    frame.returnAddress = returnAddress;
+    frame.callerNode = m_node;
+    m_stack.append(frame);
+
+    int key = m_node * PROGRAM_SIZE + function;
+    QHash<int, int>::const_iterator child = m_children.constFind(key);
+    if (child != m_children.constEnd()) {
+        m_node = child.value();
+    } else {
+        Node node;
+        node.parent = m_node;
+        node.function = function;
+        node.cycles = 0;
+        m_node = m_nodes.size();
+        m_nodes.append(node);
+        m_children.insert(key, m_node);
+    }
+}
+
+void Profiler::interrupted(int vector, int returnAddress)
+{
+    call(vector, returnAddress);
+    m_nodes[m_node].cycles++;
+    m_total++;
+}
+
+void Profiler::ret(int address)
+{
+    // Unwind to the innermost frame returning to the address, a register jump
+    // that doesn't match any frame is just a jump
+    for (int i = m_stack.size() - 1; i >= 0; i--) {
+        if (m_stack.at(i).returnAddress == address) {
+            m_node = m_stack.at(i).callerNode;
+            m_stack.resize(i);
+            return;
+        }
+    }
+}
+
+QString Profiler::functionName(int address) const
+{
+    if (address == 0 && !m_labels.contains(0))
+        return "reset";
+    return m_labels.value(address, QString("$%1").arg(address, 2, 16, QChar('0')));
+}
+
+void Profiler::report(QTextStream &out, int top) const
+{
+    out << "Profile of " << m_total << " cycles\n";
+    if (m_total == 0)
+        return;
+
+    QMap<int, quint64> byLabel;
+    for (int pc = 0; pc < PROGRAM_SIZE; pc++)
+        if (m_counts[pc])
+            byLabel[m_enclosingLabel[pc]] += m_counts[pc];
+
+    QList<QPair<quint64, int> > hot;
+    for (QMap<int, quint64>::const_iterator i = byLabel.constBegin(); i != byLabel.constEnd(); ++i)
+        hot.append(qMakePair(i.value(), i.key()));
+    qSort(hot.begin(), hot.end(), qGreater<QPair<quint64, int> >());
+
+    out << "\nHot spots by label\n";
+    out << QString("cycles").rightJustified(14) << QString("%").rightJustified(8) << "  label\n";
+    for (int i = 0; i < hot.length() && i < top; i++)
+        out << QString::number(hot.at(i).first).rightJustified(14)
+            << QString::number(100.0 * hot.at(i).first / m_total, 'f', 2).rightJustified(8)
+            << "  " << (hot.at(i).second < 0 ? QString("(init)") : m_labels.value(hot.at(i).second)) << "\n";
+
+    // Inclusive cycles, a function appearing several times in a recursive stack is counted once
+    QMap<int, quint64> inclusive;
+    for (int n = 0; n < m_nodes.size(); n++) {
+        QSet<int> seen;
+        for (int p = n; p >= 0; p = m_nodes.at(p).parent) {
+            if (!seen.contains(m_nodes.at(p).function)) {
+                seen.insert(m_nodes.at(p).function);
+                inclusive[m_nodes.at(p).function] += m_nodes.at(n).cycles;
+            }
+        }
+    }
+
+    QList<QPair<quint64, int> > functions;
+    for (QMap<int, quint64>::const_iterator i = inclusive.constBegin(); i != inclusive.constEnd(); ++i)
+        functions.append(qMakePair(i.value(), i.key()));
+    qSort(functions.begin(), functions.end(), qGreater<QPair<quint64, int> >());
+
+    out << "\nFunctions by inclusive cycles\n";
+    out << QString("cycles").rightJustified(14) << QString("%").rightJustified(8) << QString("calls").rightJustified(12) << "  function\n";
+    for (int i = 0; i < functions.length() && i < top; i++) {
+        int f = functions.at(i).second;
+        out << QString::number(functions.at(i).first).rightJustified(14)
+            << QString::number(100.0 * functions.at(i).first / m_total, 'f', 2).rightJustified(8)
+            << (f == 0 ? QString("-") : QString::number(m_calls[f])).rightJustified(12)
+            << "  " << functionName(f) << "\n";
+    }
+}
+
+void Profiler::listing(QTextStream &out) const
+{
+    int end = PROGRAM_SIZE;
+    while (end > 0 && m_program.at(end - 1) == 0 && m_counts[end - 1] == 0)
+        end--;
+
+    for (int pc = 0; pc < end; pc++) {
+        if (m_labels.contains(pc))
+            out << QString(36, ' ') << m_labels.value(pc) << ":\n";
+        QString count = m_counts[pc] ? QString::number(m_counts[pc]) : QString("-");
+        QString percent = m_total ? QString::number(100.0 * m_counts[pc] / m_total, 'f', 2) : QString("0.00");
+        out << count.rightJustified(12) << percent.rightJustified(8)
+            << QString("  $%1  %2").arg(pc, end > 256 ? 3 : 2, 16, QChar('0')).arg(m_program.at(pc), 4, 16, QChar('0'))
+            << "    " << m_disassembler.disassemble(m_program.at(pc), pc) << "\n";
+    }
+}
+
+void Profiler::foldedStacks(QTextStream &out) const
+{
+    for (int n = 0; n < m_nodes.size(); n++) {
+        if (m_nodes.at(n).cycles == 0)
+            continue;
+        QStringList frames;
+        for (int p = n; p >= 0; p = m_nodes.at(p).parent)
+            frames.prepend(functionName(m_nodes.at(p).function));
+        out << frames.join(";") << " " << m_nodes.at(n).cycles << "\n";
+    }
+}
@@ -0,0 +1,127 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QVector>
+#include <QTextStream>
+
+#include "isa.h"
+#include "disassembler.h"
+
+// Counts executions of every program address and keeps a shadow call stack by
+// following BSR/RET and the "mov ret_label, rN; bra sub; ret_label:" ... "bra rN"
+// subroutine convention. Call stacks are interned in a tree so that the per
+// instruction cost is two counter increments and a table lookup.
+class Profiler
+{
+public:
+    Profiler();
+
+    // Program includes the data initialization prologue, labels are the ones from srasm --map
+    void setProgram(const QVector<unsigned short>& program, const QMap<int, QString>& codeLabels,
+                    const QMap<int, QString>& dataLabels);
+
+    // Addresses are program memory addresses, bank * 256 + PC
+    inline void executed(int pc, unsigned short instruction, int next);
+    // Interrupt entry, the cycle goes to the handler
+    void interrupted(int vector, int returnAddress);
+
+    quint64 totalCycles() const { return m_total; }
+
+    // Cycles by enclosing label and inclusive cycles by function
+    void report(QTextStream& out, int top) const;
+    // Program listing with the execution count of every instruction
+    void listing(QTextStream& out) const;
+    // One "func1;func2;func3 cycles" line per call stack, the format flamegraph.pl and friends take
+    void foldedStacks(QTextStream& out) const;
+
+private:
+    enum Kind { Plain, Call, FarCall, GhettoCall, Return };
+
+    struct Frame {
+        int returnAddress;
+        int callerNode;
+    };
+
+    struct Node {
+        int parent;
+        int function;
+        quint64 cycles;
+    };
+
+    void call(int function, int returnAddress);
+    void ret(int address);
+    QString functionName(int address) const;
+
+    static const int MaxDepth = 256;
+
+    QVector<unsigned short> m_program;
+    QMap<int, QString> m_labels;
+    Disassembler m_disassembler;
+    unsigned char m_kind[PROGRAM_SIZE];
+    int m_enclosingLabel[PROGRAM_SIZE];
+    quint64 m_counts[PROGRAM_SIZE];
+    quint64 m_calls[PROGRAM_SIZE];
+    quint64 m_total;
+
+    QVector<Frame> m_stack;
+    QVector<Node> m_nodes;
+    QHash<int, int> m_children;     // parent node * PROGRAM_SIZE + function -> node
+    int m_node;
+};
+
+inline void Profiler::executed(int pc, unsigned short instruction, int next)
+{
+    int returnAddress = (pc & ~0xff) | ((pc + 1) & 0xff);
+    m_counts[pc]++;
+    m_nodes[m_node].cycles++;
+    m_total++;
+
+    switch (m_kind[pc]) {
+        case Plain:
+            break;
+        case Call:
+            // A conditional BSR that isn't taken doesn't enter the subroutine
+            if (BRANCH_CONDITION(instruction) == BRANCH_ALWAYS || next != returnAddress)
+                call(next, returnAddress);
+            break;
+        case FarCall:
+            call(next, returnAddress);
+            break;
+        case GhettoCall:
+            call(next, returnAddress);
+            break;
+        case Return:
+            ret(next);
+            break;
+    }
+}
+
+#endif // PROFILER_H
@@ -0,0 +1,216 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "reversedebugger.h"
+#include <string.h>
+
+const int ReverseDebugger::DefaultMaxCheckpoints;
+const int ReverseDebugger::InitialInterval;
+
+ReverseDebugger::ReverseDebugger(MultiCore *machine, int maxCheckpoints) :
+    m_machine(machine),
+    m_core(machine->core(0)),
+    m_maxCheckpoints(qMax(maxCheckpoints, 2)),
+    m_interval(InitialInterval),
+    m_frontier(machine->cycles()),
+    m_watchAddress(-1),
+    m_watchIo(false),
+    m_watchEnd(0),
+    m_watchFound(false)
+{
+    m_core->setDebugger(this);
+    takeCheckpoint();
+}
+
+ReverseDebugger::~ReverseDebugger()
+{
+    m_core->setDebugger(0);
+}
+
+void ReverseDebugger::setBreakpoint(int address, bool set)
+{
+    if (set)
+        m_breakpoints.insert(address);
+    else
+        m_breakpoints.remove(address);
+}
+
+QList<int> ReverseDebugger::breakpoints() const
+{
+    QList<int> list = m_breakpoints.toList();
+    qSort(list);
+    return list;
+}
+
+bool ReverseDebugger::atBreakpoint() const
+{
+    return !m_core->halted() && m_breakpoints.contains(m_core->pc());
+}
+
+bool ReverseDebugger::forward(quint64 maxCycles, bool breakpoints)
+{
+    for (quint64 i = 0; i < maxCycles; i++) {
+        if (i > 0 && m_machine->stopped())
+            break;
+        step();
+        if (breakpoints && atBreakpoint())
+            return true;
+    }
+    return false;
+}
+
+void ReverseDebugger::seek(quint64 cycle)
+{
+    const Checkpoint& checkpoint = m_checkpoints.at(checkpointAt(cycle));
+    if (cycles() > cycle || cycles() < checkpoint.cycle)
+        m_machine->restoreState(checkpoint.state);
+    while (cycles() < cycle)
+        step();
+}
+
+bool ReverseDebugger::reverseContinue()
+{
+    quint64 end = cycles();
+    if (end == 0 || m_breakpoints.isEmpty())
+        return false;
+
+    // Replays an interval at a time going back until one has a hit
+    for (int c = checkpointAt(end - 1); c >= 0; c--) {
+        const Checkpoint& checkpoint = m_checkpoints.at(c);
+        quint64 stop = qMin(checkpointEnd(c), end);
+        m_machine->restoreState(checkpoint.state);
+        quint64 hit = end;
+        while (cycles() < stop) {
+            if (atBreakpoint())
+                hit = cycles();
+            step();
+        }
+        if (hit != end) {
+            seek(hit);
+            return true;
+        }
+    }
+    seek(end);
+    return false;
+}
+
+bool ReverseDebugger::lastWrite(int address, bool io, Write *write)
+{
+    quint64 end = cycles();
+    int word = (address & 0xff) / 32;
+    quint32 bit = 1u << (address & 31);
+
+    m_watchAddress = address & 0xff;
+    m_watchIo = io;
+    m_watchEnd = end;
+    m_watchFound = false;
+    for (int c = checkpointAt(end); c >= 0 && !m_watchFound; c--) {
+        const Checkpoint& checkpoint = m_checkpoints.at(c);
+        if (checkpoint.cycle >= end || !((io ? checkpoint.ioWrites : checkpoint.dataWrites)[word] & bit))
+            continue;
+        m_machine->restoreState(checkpoint.state);
+        quint64 stop = qMin(checkpointEnd(c), end);
+        while (cycles() < stop)
+            step();
+    }
+    m_watchAddress = -1;
+
+    seek(end);
+    if (m_watchFound)
+        *write = m_watchWrite;
+    return m_watchFound;
+}
+
+// One machine cycle, recording the writes and taking checkpoints past the frontier
+void ReverseDebugger::step()
+{
+    m_machine->step();
+    if (cycles() <= m_frontier)
+        return;
+    m_frontier = cycles();
+    if (m_frontier - m_checkpoints.last().cycle >= m_interval)
+        takeCheckpoint();
+}
+
+void ReverseDebugger::written(int address, unsigned char value, bool io)
+{
+    // Called during the instruction, the cycle count hasn't moved yet
+    if (cycles() >= m_frontier) {
+        Checkpoint& checkpoint = m_checkpoints.last();
+        (io ? checkpoint.ioWrites : checkpoint.dataWrites)[address / 32] |= 1u << (address & 31);
+    }
+    if (address == m_watchAddress && io == m_watchIo && cycles() < m_watchEnd) {
+        m_watchFound = true;
+        m_watchWrite.cycle = cycles();
+        m_watchWrite.pc = m_core->pc();
+        m_watchWrite.value = value;
+    }
+}
+
+void ReverseDebugger::takeCheckpoint()
+{
+    Checkpoint checkpoint;
+    m_machine->saveState(&checkpoint.state);
+    checkpoint.cycle = cycles();
+    memset(checkpoint.dataWrites, 0, sizeof(checkpoint.dataWrites));
+    memset(checkpoint.ioWrites, 0, sizeof(checkpoint.ioWrites));
+    m_checkpoints.append(checkpoint);
+    if (m_checkpoints.size() <= m_maxCheckpoints)
+        return;
+
+    // Every other one goes, the intervals it ended are merged into the preceding ones
+    QVector<Checkpoint> kept;
+    for (int i = 0; i < m_checkpoints.size(); i += 2) {
+        Checkpoint c = m_checkpoints.at(i);
+        if (i + 1 < m_checkpoints.size()) {
+            for (int w = 0; w < 8; w++) {
+                c.dataWrites[w] |= m_checkpoints.at(i + 1).dataWrites[w];
+                c.ioWrites[w] |= m_checkpoints.at(i + 1).ioWrites[w];
+            }
+        }
+        kept.append(c);
+    }
+    m_checkpoints = kept;
+    m_interval *= 2;
+}
+
+int ReverseDebugger::checkpointAt(quint64 cycle) const
+{
+    int low = 0;
+    int high = m_checkpoints.size() - 1;
+    while (low < high) {
+        int middle = (low + high + 1) / 2;
+        if (m_checkpoints.at(middle).cycle <= cycle)
+            low = middle;
+        else
+            high = middle - 1;
+    }
+    return low;
+}
+
+quint64 ReverseDebugger::checkpointEnd(int checkpoint) const
+{
+    return checkpoint + 1 < m_checkpoints.size() ? m_checkpoints.at(checkpoint + 1).cycle : m_frontier;
+}
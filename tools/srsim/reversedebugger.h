@@ -0,0 +1,120 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef REVERSEDEBUGGER_H
+#define REVERSEDEBUGGER_H
+
+#include <QSet>
+#include <QList>
+#include <QVector>
+
+#include "multicore.h"
+
+// Reverse execution for srsim --debug. The whole machine is checkpointed every
+// interval cycles together with bitmaps of the data and I/O addresses core 0
+// wrote until the next checkpoint. Going back restores the nearest checkpoint
+// and runs forward from there, which gives the same history since nothing
+// outside the machine feeds it. The bitmaps limit the search for the last write
+// to an address to the intervals that wrote it.
+//
+// When the checkpoint limit is reached every other checkpoint is dropped and
+// the interval doubled, so the memory use stays fixed and a step back costs at
+// most an interval of re-execution however long the run is. Breakpoints and the
+// write history are core 0's.
+class ReverseDebugger
+{
+public:
+    static const int DefaultMaxCheckpoints = 1024;
+    static const int InitialInterval = 1024;
+
+    struct Write {
+        quint64 cycle;      // before the instruction that did it
+        int pc;
+        unsigned char value;
+    };
+
+    ReverseDebugger(MultiCore* machine, int maxCheckpoints = DefaultMaxCheckpoints);
+    ~ReverseDebugger();
+
+    quint64 cycles() const { return m_core->cycles(); }
+    // The furthest cycle run so far
+    quint64 frontier() const { return m_frontier; }
+    quint64 interval() const { return m_interval; }
+    int checkpoints() const { return m_checkpoints.size(); }
+
+    void setBreakpoint(int address, bool set);
+    bool breakpoint(int address) const { return m_breakpoints.contains(address); }
+    QList<int> breakpoints() const;
+    // Core 0 is about to execute an instruction with a breakpoint, a HALT only counts when it's reached
+    bool atBreakpoint() const;
+
+    // Runs forward until a breakpoint, the machine stops or maxCycles have been
+    // executed. Returns true when it stopped at a breakpoint.
+    bool forward(quint64 maxCycles, bool breakpoints = true);
+    // Moves to the state after <cycle> cycles, before or after the current one
+    void seek(quint64 cycle);
+    // Moves back to the last breakpoint hit before the current cycle, false if there's none
+    bool reverseContinue();
+    // The last write by core 0 to the data or I/O address before the current cycle
+    bool lastWrite(int address, bool io, Write* write);
+
+    // Called by core 0
+    void dataWritten(int address, unsigned char value) { written(address, value, false); }
+    void ioWritten(int address, unsigned char value) { written(address, value, true); }
+
+private:
+    struct Checkpoint {
+        MultiCore::State state;
+        quint64 cycle;
+        // written between this checkpoint and the next one, or the frontier for the last one
+        quint32 dataWrites[8];
+        quint32 ioWrites[8];
+    };
+
+    void step();
+    void written(int address, unsigned char value, bool io);
+    void takeCheckpoint();
+    // Index of the last checkpoint at or before the cycle
+    int checkpointAt(quint64 cycle) const;
+    quint64 checkpointEnd(int checkpoint) const;
+
+private:
+    MultiCore* m_machine;
+    SRSimulator* m_core;
+    int m_maxCheckpoints;
+    quint64 m_interval;
+    quint64 m_frontier;
+    QVector<Checkpoint> m_checkpoints;
+    QSet<int> m_breakpoints;
+
+    // Write search, the last matching write before m_watchEnd
+    int m_watchAddress;     // -1 when not searching
+    bool m_watchIo;
+    quint64 m_watchEnd;
+    bool m_watchFound;
+    Write m_watchWrite;
+};
+
+#endif // REVERSEDEBUGGER_H
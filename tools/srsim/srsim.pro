@@ -0,0 +1,43 @@
+QT       += core
+QT       -= gui
+
+TARGET = srsim
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+QMAKE_CXXFLAGS = -std=c++0x
+
+INCLUDEPATH += ../srasm
+
+SOURCES += main.cpp \
+    srsimulator.cpp \
+    disassembler.cpp \
+    labelmap.cpp \
+    profiler.cpp \
+    statetrace.cpp \
+    interruptcontroller.cpp \
+    tracebuffer.cpp \
+    perfcounters.cpp \
+    mailbox.cpp \
+    multicore.cpp \
+    tracefile.cpp \
+    reversedebugger.cpp \
+    ../srasm/srimage.cpp
+
+HEADERS += \
+    srsimulator.h \
+    disassembler.h \
+    labelmap.h \
+    profiler.h \
+    statetrace.h \
+    interruptcontroller.h \
+    tracebuffer.h \
+    perfcounters.h \
+    mailbox.h \
+    multicore.h \
+    tracefile.h \
+    reversedebugger.h \
+    ../srasm/srimage.h \
+    ../srasm/isa.h
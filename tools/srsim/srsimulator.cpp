@@ -0,0 +1,419 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "srsimulator.h"
+#include "profiler.h"
+#include "statetrace.h"
+#include "tracebuffer.h"
+#include "tracefile.h"
+#include "reversedebugger.h"
+#include "srimage.h"
+#include <string.h>
+
+SRSimulator::SRSimulator() :
+    m_profiler(0),
+    m_trace(0),
+    m_traceBuffer(0),
+    m_traceFile(0),
+    m_debugger(0)
+{
+    memset(m_program, 0, sizeof(m_program));
+    memset(m_data, 0, sizeof(m_data));
+    memset(m_bankStack, 0, sizeof(m_bankStack));
+    reset();
+}
+
+SRSimulator::~SRSimulator()
+{
+}
+
+void SRSimulator::reset()
+{
+    memset(m_regs, 0, sizeof(m_regs));
+    m_pc = 0;
+    m_bank = 0;
+    m_bankSp = 0;
+    m_sp = 0xff;
+    m_sr = 0;
+    m_savedFlags = 0;
+    m_cycles = 0;
+    m_interrupts.reset();
+    m_perfCounters.reset();
+}
+
+void SRSimulator::saveState(State *state) const
+{
+    memcpy(state->data, m_data, sizeof(m_data));
+    memcpy(state->regs, m_regs, sizeof(m_regs));
+    state->pc = m_pc;
+    state->bank = m_bank;
+    memcpy(state->bankStack, m_bankStack, sizeof(m_bankStack));
+    state->bankSp = m_bankSp;
+    state->sp = m_sp;
+    state->sr = m_sr;
+    state->savedFlags = m_savedFlags;
+    state->cycles = m_cycles;
+    state->interrupts = m_interrupts;
+    state->perfCounters = m_perfCounters;
+}
+
+void SRSimulator::restoreState(const State &state)
+{
+    memcpy(m_data, state.data, sizeof(m_data));
+    memcpy(m_regs, state.regs, sizeof(m_regs));
+    m_pc = state.pc;
+    m_bank = state.bank;
+    memcpy(m_bankStack, state.bankStack, sizeof(m_bankStack));
+    m_bankSp = state.bankSp;
+    m_sp = state.sp;
+    m_sr = state.sr;
+    m_savedFlags = state.savedFlags;
+    m_cycles = state.cycles;
+    m_interrupts = state.interrupts;
+    m_perfCounters = state.perfCounters;
+}
+
+void SRSimulator::loadProgram(const QByteArray &bin)
+{
+    for (int i = 0; i < PROGRAM_SIZE; i++) {
+        if (i * 2 + 1 < bin.length())
+            m_program[i] = (unsigned char) bin.at(i * 2) << 8 | (unsigned char) bin.at(i * 2 + 1);
+        else
+            m_program[i] = 0;
+    }
+}
+
+void SRSimulator::loadImage(const SRImage &image)
+{
+    QVector<unsigned short> program = image.program();
+    for (int i = 0; i < PROGRAM_SIZE; i++)
+        m_program[i] = i < program.size() ? program.at(i) : 0;
+
+    foreach (const SRImage::Section& s, image.sections()) {
+        if (s.type == SRImage::DataSection)
+            memcpy(m_data + s.address, s.bytes.constData(), s.bytes.length());
+    }
+    m_bank = image.entry() >> 8;
+    m_pc = image.entry() & 0xff;
+}
+
+unsigned char SRSimulator::ioRead(int address)
+{
+    if ((address & 0xf0) == InterruptController::BaseAddress)
+        return m_interrupts.read(address & 0xf);
+    if ((address & PerfCounters::AddressMask) == PerfCounters::BaseAddress)
+        return m_perfCounters.read(address & ~PerfCounters::AddressMask);
+    return 0;
+}
+
+void SRSimulator::ioWrite(int address, unsigned char value)
+{
+    if ((address & 0xf0) == InterruptController::BaseAddress)
+        m_interrupts.write(address & 0xf, value, m_cycles + 1);
+    else if (address == InterruptController::LcdCommandAddress || address == InterruptController::LcdDataAddress)
+        m_interrupts.lcdWritten(address, value, m_cycles + 1);
+    else if ((address & PerfCounters::AddressMask) == PerfCounters::BaseAddress)
+        m_perfCounters.write(value);
+}
+
+// Steps the address register of an indirect (r)+ or (r)- access
+void SRSimulator::postModify(unsigned short i, int r)
+{
+    if (!(i & FLAG_INDIRECT))
+        return;
+    switch (i & POST_MODIFY_MASK) {
+        case FLAG_POST_INCREMENT: m_regs[r]++; break;
+        case FLAG_POST_DECREMENT: m_regs[r]--; break;
+        default: break;
+    }
+}
+
+void SRSimulator::pushBank()
+{
+    m_bankStack[m_bankSp] = m_bank;
+    m_bankSp = (m_bankSp + 1) & 7;
+}
+
+void SRSimulator::writeData(int address, unsigned char value)
+{
+    m_data[address] = value;
+    m_perfCounters.count(PerfCounters::MemoryWrites);
+    if (m_trace)
+        m_trace->dataWritten(address, value);
+    if (m_traceBuffer)
+        m_traceBuffer->dataWritten(address, value);
+    if (m_traceFile)
+        m_traceFile->dataWritten(address, value);
+    if (m_debugger)
+        m_debugger->dataWritten(address, value);
+}
+
+quint64 SRSimulator::run(quint64 maxCycles)
+{
+    quint64 start = m_cycles;
+    while (!stopped() && m_cycles - start < maxCycles)
+        step();
+    return m_cycles - start;
+}
+
+bool SRSimulator::ioPending() const
+{
+    if ((m_sr & SR_INTERRUPT_ENABLE) && m_interrupts.irq())
+        return false;
+    unsigned short opcode = m_program[m_bank << 8 | m_pc] & OPCODE_MASK;
+    return opcode == OPCODE_READ_IO || opcode == OPCODE_WRITE_IO;
+}
+
+void SRSimulator::stall()
+{
+    m_cycles++;
+    m_perfCounters.count(PerfCounters::Cycles);
+    m_perfCounters.count(PerfCounters::HaltedCycles);
+    m_interrupts.tick(m_cycles);
+}
+
+// Takes the cycle of the instruction it replaces. Pushes the return address
+// like BSR, which is the instruction after HALT when the CPU was waiting.
+void SRSimulator::interrupt()
+{
+    int pc = m_pc;
+    int bank = m_bank;
+    int returnAddress = halted() ? (pc + 1) & 0xff : pc;
+    writeData(m_sp, returnAddress);
+    m_sp = (m_sp - 1) & 0xff;
+    m_savedFlags = m_sr & (SR_CARRY | SR_NEGATIVE | SR_ZERO);
+    m_sr &= ~(SR_HALTED | SR_INTERRUPT_ENABLE);
+    // Handlers live in bank 0
+    pushBank();
+    int returnBank = m_bank;
+    m_bank = 0;
+    m_pc = m_interrupts.vector();
+
+    m_cycles++;
+    m_perfCounters.count(PerfCounters::Cycles);
+    m_interrupts.tick(m_cycles);
+    if (m_profiler)
+        m_profiler->interrupted(m_pc, returnBank << 8 | returnAddress);
+    if (m_trace)
+        m_trace->executed();
+    if (m_traceBuffer)
+        m_traceBuffer->executed(bank << 8 | pc, m_program[bank << 8 | pc], true);
+    if (m_traceFile)
+        m_traceFile->executed(m_cycles, bank << 8 | pc, m_program[bank << 8 | pc], true, m_regs, m_sp, m_sr);
+}
+
+void SRSimulator::step()
+{
+    if ((m_sr & SR_INTERRUPT_ENABLE) && m_interrupts.irq()) {
+        interrupt();
+        return;
+    }
+
+    int pc = m_pc;
+    int bank = m_bank;
+    unsigned short i = m_program[bank << 8 | pc];
+    int next = (pc + 1) & 0xff;
+    bool wasHalted = halted();
+
+    int t = (i >> TARGET_REG) & REG_MASK;
+    int r = (i >> SRC1_REG) & REG_MASK;
+    int s = (i >> SRC2_REG) & REG_MASK;
+    unsigned char imm = i & 0xff;
+    int address = (i & FLAG_INDIRECT) ? m_regs[r] & 0xff : imm;
+    int carry = (m_sr & SR_CARRY) ? 1 : 0;
+    bool zero = m_sr & SR_ZERO;
+
+    switch (i & OPCODE_MASK) {
+        case OPCODE_MOVE_IMM:
+            if (i & FLAG_EXTEND)
+                m_regs[t] = (signed char) imm;
+            else
+                m_regs[t] = (m_regs[t] & 0xff00) | imm;
+            break;
+
+        case OPCODE_LOAD:
+        case OPCODE_READ_IO: {
+            unsigned char value;
+            if ((i & OPCODE_MASK) == OPCODE_LOAD) {
+                value = m_data[address];
+                m_perfCounters.count(PerfCounters::MemoryReads);
+            } else {
+                value = ioRead(address);
+            }
+            unsigned short result = (i & FLAG_EXTEND) ? (signed char) value : (m_regs[t] & 0xff00) | value;
+            // The loaded value wins when the target is the address register
+            postModify(i, r);
+            m_regs[t] = result;
+            break;
+        }
+
+        case OPCODE_STORE:
+            writeData(address, m_regs[t] & 0xff);
+            postModify(i, r);
+            break;
+
+        case OPCODE_WRITE_IO:
+            if (m_trace)
+                m_trace->ioWritten(address, m_regs[t] & 0xff);
+            if (m_traceBuffer)
+                m_traceBuffer->ioWritten(address, m_regs[t] & 0xff);
+            if (m_traceFile)
+                m_traceFile->ioWritten(address, m_regs[t] & 0xff);
+            if (m_debugger)
+                m_debugger->ioWritten(address, m_regs[t] & 0xff);
+            ioWrite(address, m_regs[t] & 0xff);
+            postModify(i, r);
+            break;
+
+        case OPCODE_ALUOP: {
+            unsigned int a = m_regs[r];
+            unsigned int b = m_regs[s];
+            unsigned int result;
+            switch (ALU_OP(i)) {
+                // Subtraction adds the complement, leaving the inverted borrow in bit 16
+                case ALU_OP_ADD: result = a + b; break;
+                case ALU_OP_SUB: result = a + (b ^ 0xffff) + 1; break;
+                case ALU_OP_ADC: result = a + b + carry; break;
+                case ALU_OP_SBC: result = a + (b ^ 0xffff) + carry; break;
+                case ALU_OP_SHR: result = (a & 0x8000) | a >> 1; break;
+                case ALU_OP_SHL: result = a << 1; break;
+                case ALU_OP_SWAP: result = a << 8 | a >> 8; break;
+                case ALU_OP_NOT: result = ~a; break;
+                case ALU_OP_OR: result = a | b; break;
+                case ALU_OP_AND: result = a & b; break;
+                case ALU_OP_XOR: result = a ^ b; break;
+                case ALU_OP_NOP: result = a; break;
+                case ALU_OP_DEC: result = a - 1; break;
+                case ALU_OP_INC: result = a + 1; break;
+                default: result = 0; break;     // ALU_OP_ZERO and the unused op
+            }
+            if (ALU_OP_SETS_CARRY(ALU_OP(i))) {
+                m_sr &= ~SR_CARRY;
+                if (result & 0x10000)
+                    m_sr |= SR_CARRY;
+            }
+            result &= 0xffff;
+            // CMP and TST only update the flags
+            if (!(i & FLAG_NO_WRITEBACK))
+                m_regs[t] = result;
+            m_sr &= ~(SR_ZERO | SR_NEGATIVE);
+            if (result == 0)
+                m_sr |= SR_ZERO;
+            if (result & 0x8000)
+                m_sr |= SR_NEGATIVE;
+            break;
+        }
+
+        case OPCODE_BRANCH_TO_SUBROUTINE:
+            // The return address gets pushed whether the branch is taken or not
+            writeData(m_sp, next);
+            m_sp = (m_sp - 1) & 0xff;
+            // fall through
+        case OPCODE_BRANCH: {
+            int target = (i & FLAG_REGISTER_JUMP_TARGET) ? m_regs[r] & 0xff : imm;
+            bool taken;
+            switch (BRANCH_CONDITION(i)) {
+                case BRANCH_EQUAL: taken = zero; break;
+                case BRANCH_NOT_EQUAL: taken = !zero; break;
+                case BRANCH_ALWAYS: taken = true; break;
+                default: taken = false; break;
+            }
+            if (taken) {
+                next = target;
+                m_perfCounters.count(PerfCounters::TakenBranches);
+            }
+            break;
+        }
+
+        case OPCODE_RETURN_FROM_SUBROUTINE:
+            m_sp = (m_sp + 1) & 0xff;
+            next = m_data[m_sp];
+            m_perfCounters.count(PerfCounters::MemoryReads);
+            m_perfCounters.count(PerfCounters::TakenBranches);
+            if (i & (FLAG_RETI | FLAG_FAR_RETURN)) {
+                m_bankSp = (m_bankSp - 1) & 7;
+                m_bank = m_bankStack[m_bankSp];
+            }
+            if (i & FLAG_RETI)
+                m_sr = (m_sr & ~(SR_CARRY | SR_NEGATIVE | SR_ZERO)) | m_savedFlags | SR_INTERRUPT_ENABLE;
+            break;
+
+        case OPCODE_FAR_BRANCH_TO_SUBROUTINE:
+            writeData(m_sp, next);
+            m_sp = (m_sp - 1) & 0xff;
+            pushBank();
+            m_bank = FAR_BANK(i);
+            next = imm;
+            m_perfCounters.count(PerfCounters::TakenBranches);
+            break;
+
+        case OPCODE_INTERRUPT_ENABLE:
+            if (i & FLAG_INTERRUPT_ENABLE)
+                m_sr |= SR_INTERRUPT_ENABLE;
+            else
+                m_sr &= ~SR_INTERRUPT_ENABLE;
+            break;
+
+        case OPCODE_STACK_MOVE:
+            // Only the low byte of the register gets pushed or popped
+            if (i & FLAG_POP) {
+                m_sp = (m_sp + 1) & 0xff;
+                m_regs[t] = (m_regs[t] & 0xff00) | m_data[m_sp];
+                m_perfCounters.count(PerfCounters::MemoryReads);
+            } else {
+                writeData(m_sp, m_regs[t] & 0xff);
+                m_sp = (m_sp - 1) & 0xff;
+            }
+            break;
+
+        case OPCODE_COPYDATA:
+            writeData(m_regs[t] & 0xff, imm);
+            m_regs[t]++;
+            break;
+
+        case OPCODE_HALT:
+            next = pc;
+            m_sr |= SR_HALTED;
+            break;
+
+        default:    // NOP and the unused opcodes
+            break;
+    }
+
+    m_pc = next;
+    m_cycles++;
+    m_perfCounters.count(PerfCounters::Cycles);
+    m_perfCounters.count(wasHalted ? PerfCounters::HaltedCycles : PerfCounters::Instructions);
+    m_interrupts.tick(m_cycles);
+    if (m_profiler)
+        m_profiler->executed(bank << 8 | pc, i, m_bank << 8 | next);
+    if (m_trace)
+        m_trace->executed();
+    // The hardware doesn't record a HALT again while the core waits on it
+    if (m_traceBuffer && !wasHalted)
+        m_traceBuffer->executed(bank << 8 | pc, i, false);
+    if (m_traceFile && !wasHalted)
+        m_traceFile->executed(m_cycles, bank << 8 | pc, i, false, m_regs, m_sp, m_sr);
+}
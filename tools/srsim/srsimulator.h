@@ -0,0 +1,146 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef SRSIMULATOR_H
+#define SRSIMULATOR_H
+
+#include <QByteArray>
+
+#include "isa.h"
+#include "interruptcontroller.h"
+#include "perfcounters.h"
+
+class Profiler;
+class StateTrace;
+class TraceBuffer;
+class TraceFileWriter;
+class ReverseDebugger;
+class SRImage;
+
+// Instruction level model of the shitty_risc core. Every instruction takes one
+// cycle. Follows what the VHDL does rather than what the README says, e.g. a
+// conditional BSR pushes the return address even if the branch isn't taken.
+class SRSimulator
+{
+public:
+    SRSimulator();
+    virtual ~SRSimulator();
+
+    // Everything but the program memory and the hooks, for the reverse debugger's checkpoints
+    struct State {
+        unsigned char data[256];
+        unsigned short regs[4];
+        int pc;
+        int bank;
+        int bankStack[8];
+        int bankSp;
+        int sp;
+        int sr;
+        int savedFlags;
+        quint64 cycles;
+        InterruptController interrupts;
+        PerfCounters perfCounters;
+    };
+
+    // Resets the CPU state, memory contents are preserved like on the FPGA
+    void reset();
+    // Takes a binary written by srasm, big endian 16-bit words, banks back to back
+    void loadProgram(const QByteArray& bin);
+    // Takes a sectioned image, writes its data segments to the data RAM and starts from its entry point
+    void loadImage(const SRImage& image);
+
+    void saveState(State* state) const;
+    void restoreState(const State& state);
+
+    void step();
+    // Runs until the CPU stops or maxCycles have been executed, returns the number of executed cycles
+    quint64 run(quint64 maxCycles);
+    // True when the next step does IN or OUT and has to wait for the shared I/O bus
+    // of a multi-core configuration, an interrupt entry doesn't use the bus
+    bool ioPending() const;
+    // Spends a cycle waiting for the I/O bus, the performance counters see it as halted
+    void stall();
+
+    bool halted() const { return m_sr & SR_HALTED; }
+    // HALT with interrupts enabled waits for an interrupt, with them disabled it's the end of the program
+    bool stopped() const { return (m_sr & (SR_HALTED | SR_INTERRUPT_ENABLE)) == SR_HALTED; }
+    quint64 cycles() const { return m_cycles; }
+    // Program memory address of the next instruction, bank * 256 + PC
+    int pc() const { return m_bank << 8 | m_pc; }
+    int bank() const { return m_bank; }
+    int sp() const { return m_sp; }
+    int sr() const { return m_sr; }
+    unsigned short reg(int r) const { return m_regs[r]; }
+    unsigned short ir() const { return m_program[pc()]; }
+    unsigned short programWord(int address) const { return m_program[address & (PROGRAM_SIZE - 1)]; }
+    unsigned char dataByte(int address) const { return m_data[address & 0xff]; }
+    InterruptController* interruptController() { return &m_interrupts; }
+    const PerfCounters& perfCounters() const { return m_perfCounters; }
+
+    // The profiler gets called after every executed instruction
+    void setProfiler(Profiler* profiler) { m_profiler = profiler; }
+    // The trace gets every memory and I/O write and is called after every executed instruction
+    void setTrace(StateTrace* trace) { m_trace = trace; }
+    // Records the executed instructions like the debugger's trace buffer
+    void setTraceBuffer(TraceBuffer* traceBuffer) { m_traceBuffer = traceBuffer; }
+    // Streams every executed instruction with its register changes and writes to a binary trace file
+    void setTraceFile(TraceFileWriter* traceFile) { m_traceFile = traceFile; }
+    // Gets the memory and I/O writes for its write history
+    void setDebugger(ReverseDebugger* debugger) { m_debugger = debugger; }
+
+protected:
+    // The interrupt controller and the performance counters are the only readable
+    // devices on the EP1 top level, other I/O reads return zero
+    virtual unsigned char ioRead(int address);
+    virtual void ioWrite(int address, unsigned char value);
+
+private:
+    inline void writeData(int address, unsigned char value);
+    void pushBank();
+    inline void postModify(unsigned short instruction, int r);
+    void interrupt();
+
+private:
+    unsigned short m_program[PROGRAM_SIZE];
+    unsigned char m_data[256];
+    unsigned short m_regs[4];
+    int m_pc;
+    int m_bank;
+    int m_bankStack[8];     // pushed by FBSR and interrupt entry, wraps around like the hardware one
+    int m_bankSp;
+    int m_sp;
+    int m_sr;
+    int m_savedFlags;       // C, N and Z saved on interrupt entry for RETI
+    quint64 m_cycles;
+    Profiler* m_profiler;
+    StateTrace* m_trace;
+    TraceBuffer* m_traceBuffer;
+    TraceFileWriter* m_traceFile;
+    ReverseDebugger* m_debugger;
+    InterruptController m_interrupts;
+    PerfCounters m_perfCounters;
+};
+
+#endif // SRSIMULATOR_H
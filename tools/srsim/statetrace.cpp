@@ -0,0 +1,204 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "statetrace.h"
+#include "srsimulator.h"
+#include "disassembler.h"
+
+StateTrace::StateTrace(const SRSimulator *sim, int sampleInterval) :
+    m_sim(sim),
+    m_sampleInterval(qMax(1, sampleInterval)),
+    m_writing(false),
+    m_comparing(false),
+    m_sampledCycle(0),
+    m_referenceLine(0),
+    m_compared(0),
+    m_diverged(false)
+{
+}
+
+void StateTrace::setOutput(QIODevice *output)
+{
+    m_output.setDevice(output);
+    m_writing = true;
+    m_output << "# sample " << m_sampleInterval << "\n";
+}
+
+void StateTrace::setReference(QIODevice *reference, const QString &name)
+{
+    m_reference.setDevice(reference);
+    m_referenceName = name;
+    m_comparing = true;
+
+    // The header has to be read before the first state gets sampled
+    while (!m_reference.atEnd() && m_pending.isEmpty()) {
+        QString line = m_reference.readLine().simplified();
+        m_referenceLine++;
+        QStringList header = line.split(" ", QString::SkipEmptyParts);
+        if (header.length() == 3 && header.at(0) == "#" && header.at(1) == "sample")
+            m_sampleInterval = qMax(1, header.at(2).toInt());
+        else if (!line.startsWith("#"))
+            m_pending = line;
+    }
+}
+
+void StateTrace::begin()
+{
+    sampleState();
+}
+
+void StateTrace::end()
+{
+    if (m_diverged)
+        return;
+    if (m_sampledCycle != m_sim->cycles())
+        sampleState();
+
+    // The RTL ran further than the simulator
+    if (m_comparing && !m_diverged) {
+        QString line = nextReferenceLine();
+        if (!line.isEmpty()) {
+            m_expected = line;
+            m_actual = "end of trace";
+            m_diverged = true;
+        }
+    }
+}
+
+void StateTrace::executed()
+{
+    if (!m_diverged && m_sim->cycles() % m_sampleInterval == 0)
+        sampleState();
+}
+
+void StateTrace::writeEvent(char kind, int address, unsigned char value)
+{
+    // Writes happen during the instruction, i.e. before the cycle counter is incremented
+    event(QString(QChar(kind)) + " " + QString::number(m_sim->cycles() + 1) + " " + hex(address, 2) + " " + hex(value, 2));
+}
+
+void StateTrace::sampleState()
+{
+    QString line = "S " + QString::number(m_sim->cycles()) + " " + hex(m_sim->pc(), 3) + " " + hex(m_sim->sp(), 2) + " "
+            + hex(m_sim->sr(), 2) + " " + hex(m_sim->ir(), 4);
+    for (int r = 0; r < 4; r++)
+        line += " " + hex(m_sim->reg(r), 4);
+    m_sampledCycle = m_sim->cycles();
+    event(line);
+}
+
+void StateTrace::event(const QString &line)
+{
+    if (m_writing)
+        m_output << line << "\n";
+
+    if (!m_comparing)
+        return;
+
+    QString reference = nextReferenceLine();
+    if (reference.isEmpty())
+        reference = "end of trace";
+    if (!matches(reference, line)) {
+        m_expected = reference;
+        m_actual = line;
+        m_diverged = true;
+        return;
+    }
+    m_compared++;
+    if (line.startsWith("S"))
+        m_lastState = line;
+}
+
+// Next non-empty line that isn't a comment, empty at the end of the trace
+QString StateTrace::nextReferenceLine()
+{
+    if (!m_pending.isEmpty()) {
+        QString line = m_pending;
+        m_pending.clear();
+        return line;
+    }
+
+    while (!m_reference.atEnd()) {
+        QString line = m_reference.readLine().simplified();
+        m_referenceLine++;
+        if (!line.isEmpty() && !line.startsWith("#"))
+            return line;
+    }
+    return QString();
+}
+
+// Fields are compared numerically so that the case and width of the hex digits
+// don't matter. Undefined bits show up as 'x' in the RTL trace and never match.
+bool StateTrace::matches(const QString &reference, const QString &line)
+{
+    QStringList expected = reference.split(" ", QString::SkipEmptyParts);
+    QStringList actual = line.split(" ", QString::SkipEmptyParts);
+    if (expected.length() != actual.length() || expected.at(0) != actual.at(0))
+        return false;
+
+    for (int i = 1; i < expected.length(); i++) {
+        bool ok;
+        qulonglong value = expected.at(i).toULongLong(&ok, i == 1 ? 10 : 16);
+        if (!ok || value != actual.at(i).toULongLong(0, i == 1 ? 10 : 16))
+            return false;
+    }
+    return true;
+}
+
+QString StateTrace::hex(int value, int digits)
+{
+    return QString("%1").arg(value, digits, 16, QChar('0'));
+}
+
+void StateTrace::report(QTextStream &out, const Disassembler &disassembler) const
+{
+    if (!m_diverged) {
+        out << "Matched " << m_compared << " events of " << m_referenceName << "\n";
+        return;
+    }
+
+    static const char* const fields[] = { "kind", "cycle", "pc", "sp", "sr", "ir", "r0", "r1", "r2", "r3" };
+
+    out << "Diverged at line " << m_referenceLine << " of " << m_referenceName << " after " << m_compared << " matching events\n";
+    out << "  rtl:   " << m_expected << "\n";
+    out << "  srsim: " << m_actual << "\n";
+
+    QStringList expected = m_expected.split(" ", QString::SkipEmptyParts);
+    QStringList actual = m_actual.split(" ", QString::SkipEmptyParts);
+    if (expected.length() == actual.length() && expected.length() == 10 && expected.at(0) == "S") {
+        for (int i = 1; i < expected.length(); i++) {
+            bool ok;
+            if (expected.at(i).toULongLong(&ok, 16) != actual.at(i).toULongLong(0, 16) || !ok)
+                out << "  " << fields[i] << ": rtl " << expected.at(i) << " srsim " << actual.at(i) << "\n";
+        }
+    }
+
+    if (!m_lastState.isEmpty()) {
+        QStringList state = m_lastState.split(" ", QString::SkipEmptyParts);
+        out << "Last matching state: " << m_lastState << "\n";
+        out << "  next instruction at $" << state.at(2) << ": "
+            << disassembler.disassemble(state.at(5).toUShort(0, 16), state.at(2).toInt(0, 16)) << "\n";
+    }
+}
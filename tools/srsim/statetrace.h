@@ -0,0 +1,93 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef STATETRACE_H
+#define STATETRACE_H
+
+#include <QIODevice>
+#include <QString>
+#include <QStringList>
+#include <QTextStream>
+
+class SRSimulator;
+class Disassembler;
+
+// Cycle level state trace for co-simulation against the RTL, in the format
+// core/sim/shitty_risc_tb.vhdl writes. One event per line:
+//   S <cycle> <pc> <sp> <sr> <ir> <r0> <r1> <r2> <r3>  state after <cycle> instructions
+//   W <cycle> <address> <value>                         data memory write
+//   O <cycle> <address> <value>                         I/O write
+// The cycle is decimal, everything else hex. The pc is bank * 256 + PC. The state is sampled every
+// sampleInterval cycles and when the run ends, writes are always traced.
+// The trace is either written out or compared against a reference trace as
+// the simulation runs, stopping at the first divergence.
+class StateTrace
+{
+public:
+    StateTrace(const SRSimulator* sim, int sampleInterval);
+
+    void setOutput(QIODevice* output);
+    // Takes the sample interval from the "# sample <n>" header if there is one
+    void setReference(QIODevice* reference, const QString& name);
+
+    void begin();
+    void end();
+
+    void dataWritten(int address, unsigned char value) { if (m_diverged) return; writeEvent('W', address, value); }
+    void ioWritten(int address, unsigned char value) { if (m_diverged) return; writeEvent('O', address, value); }
+    void executed();
+
+    bool diverged() const { return m_diverged; }
+    quint64 comparedEvents() const { return m_compared; }
+    // First divergence with the last matching state and the instruction executed after it
+    void report(QTextStream& out, const Disassembler& disassembler) const;
+
+private:
+    void writeEvent(char kind, int address, unsigned char value);
+    void sampleState();
+    void event(const QString& line);
+    QString nextReferenceLine();
+    static bool matches(const QString& reference, const QString& line);
+    static QString hex(int value, int digits);
+
+private:
+    const SRSimulator* m_sim;
+    int m_sampleInterval;
+    QTextStream m_output;
+    bool m_writing;
+    QTextStream m_reference;
+    QString m_referenceName;
+    QString m_pending;
+    bool m_comparing;
+    quint64 m_sampledCycle;
+    int m_referenceLine;
+    quint64 m_compared;
+    bool m_diverged;
+    QString m_expected;
+    QString m_actual;
+    QString m_lastState;
+};
+
+#endif // STATETRACE_H
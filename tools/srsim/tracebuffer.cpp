@@ -0,0 +1,144 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tracebuffer.h"
+#include "disassembler.h"
+
+static void appendWord(QByteArray& d, quint32 word)
+{
+    for (int i = 0; i < 4; i++)
+        d.append((char) (word >> i * 8));
+}
+
+static quint32 takeWord(const QByteArray& d, int offset)
+{
+    quint32 word = 0;
+    for (int i = 0; i < 4; i++)
+        word |= (quint32) (unsigned char) d.at(offset + i) << i * 8;
+    return word;
+}
+
+TraceBuffer::TraceBuffer() :
+    m_entries(Depth),
+    m_head(0),
+    m_wrapped(false),
+    m_recording(false),
+    m_recordWrites(false),
+    m_triggered(false),
+    m_trigger(-1),
+    m_pending(0)
+{
+}
+
+void TraceBuffer::start(bool recordWrites, int trigger)
+{
+    m_head = 0;
+    m_wrapped = false;
+    m_recording = true;
+    m_recordWrites = recordWrites;
+    m_triggered = false;
+    m_trigger = trigger;
+    m_pending = 0;
+}
+
+void TraceBuffer::executed(int pc, unsigned short ir, bool interrupt)
+{
+    quint32 writes = m_pending;
+    m_pending = 0;
+    if (!m_recording)
+        return;
+
+    quint32 entry = writes & (DataWrite | IoWrite);
+    if (interrupt)
+        entry |= InterruptEntry;
+    entry |= (pc & 0x7ff) << 16;
+    entry |= m_recordWrites ? writes & 0xffff : ir;
+    m_entries[m_head] = entry;
+    m_head = (m_head + 1) % Depth;
+    if (m_head == 0)
+        m_wrapped = true;
+
+    if (pc == m_trigger) {
+        m_recording = false;
+        m_triggered = true;
+    }
+}
+
+QByteArray TraceBuffer::dump() const
+{
+    int count = m_wrapped ? Depth : m_head;
+    int flags = (m_recordWrites ? WritesRecorded : 0) | (m_triggered ? Triggered : 0) | (m_wrapped ? Wrapped : 0);
+
+    QByteArray d;
+    appendWord(d, DepthBits << 24 | flags << 16 | count);
+    int oldest = m_wrapped ? m_head : 0;
+    for (int i = 0; i < count; i++)
+        appendWord(d, m_entries[(oldest + i) % Depth]);
+    return d;
+}
+
+bool TraceBuffer::decode(const QByteArray &dump, QTextStream &out, const Disassembler &disassembler,
+                         const QVector<unsigned short> &program)
+{
+    if (dump.length() < 4)
+        return false;
+    quint32 header = takeWord(dump, 0);
+    int count = header & 0xffff;
+    int flags = header >> 16 & 0xff;
+    if (dump.length() < 4 + count * 4)
+        return false;
+
+    out << "# " << count << " of " << (1 << (header >> 24)) << " entries";
+    if (flags & Triggered)
+        out << ", stopped by the trigger";
+    out << "\n";
+
+    for (int i = 0; i < count; i++) {
+        quint32 entry = takeWord(dump, 4 + i * 4);
+        int pc = entry >> 16 & 0x7ff;
+        int write = entry & 0xffff;
+
+        // The newest entry is 0, older ones count down from it
+        out << QString("%1  %2:%3  ").arg(i - count + 1, 6).arg(pc >> 8).arg(pc & 0xff, 2, 16, QChar('0'));
+        if (!(flags & WritesRecorded))
+            out << QString("%1  ").arg(entry & 0xffff, 4, 16, QChar('0')) << disassembler.disassemble(entry & 0xffff, pc);
+        else if (pc < program.size())
+            out << QString("%1  ").arg(program.at(pc), 4, 16, QChar('0')) << disassembler.disassemble(program.at(pc), pc);
+        else
+            out << "????";
+
+        if (entry & InterruptEntry)
+            out << "  ; interrupt entry";
+        if ((flags & WritesRecorded) && (entry & (DataWrite | IoWrite)))
+            out << QString("  ; %1 $%2 = $%3").arg(entry & DataWrite ? "W" : "O")
+                   .arg(write >> 8, 2, 16, QChar('0')).arg(write & 0xff, 2, 16, QChar('0'));
+        else if (entry & DataWrite)
+            out << "  ; W";
+        else if (entry & IoWrite)
+            out << "  ; O";
+        out << "\n";
+    }
+    return true;
+}
@@ -0,0 +1,83 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TRACEBUFFER_H
+#define TRACEBUFFER_H
+
+#include <QByteArray>
+#include <QTextStream>
+#include <QVector>
+
+class Disassembler;
+
+// Model of the debugger's execution trace buffer (core/vhdl/trace_buffer.vhdl)
+// and the decoder for its dump, shared by srsim and risccom. The buffer keeps
+// an entry for each of the last Depth executed instructions:
+//   bit 31     interrupt entry, it replaced the recorded instruction
+//   bit 30     data memory write
+//   bit 29     I/O write
+//   bits 26-16 bank * 256 + PC
+//   bits 15-0  IR, or the write address and value when recording writes
+// A dump is a header word with the entry count in bits 15-0, the DumpFlags in
+// bits 23-16 and log2 of the depth in bits 31-24, followed by the entries
+// oldest first. All words are little endian like on the serial line.
+class TraceBuffer
+{
+public:
+    enum { DepthBits = 9, Depth = 1 << DepthBits };
+    enum EntryFlag { InterruptEntry = 0x80000000, DataWrite = 0x40000000, IoWrite = 0x20000000 };
+    enum DumpFlag { WritesRecorded = 0x1, Triggered = 0x2, Wrapped = 0x4 };
+
+    TraceBuffer();
+
+    // Clears the buffer and starts recording like debugger command 08 does. A
+    // trigger (bank * 256 + PC) stops the recording after that instruction.
+    void start(bool recordWrites, int trigger = -1);
+    void stop() { m_recording = false; }
+    bool recording() const { return m_recording; }
+
+    void dataWritten(int address, unsigned char value) { m_pending |= DataWrite | address << 8 | value; }
+    void ioWritten(int address, unsigned char value) { m_pending |= IoWrite | address << 8 | value; }
+    void executed(int pc, unsigned short ir, bool interrupt);
+
+    QByteArray dump() const;
+
+    // Writes the dump as an instruction trace, one line per entry. When only the
+    // writes were recorded the instructions are taken from program if it's given.
+    static bool decode(const QByteArray& dump, QTextStream& out, const Disassembler& disassembler,
+                       const QVector<unsigned short>& program = QVector<unsigned short>());
+
+private:
+    QVector<quint32> m_entries;
+    int m_head;
+    bool m_wrapped;
+    bool m_recording;
+    bool m_recordWrites;
+    bool m_triggered;
+    int m_trigger;
+    quint32 m_pending;      // write flags, address and value of the executing instruction
+};
+
+#endif // TRACEBUFFER_H
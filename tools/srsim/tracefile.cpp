@@ -0,0 +1,431 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include "tracefile.h"
+#include <QtEndian>
+#include <string.h>
+
+static const char Magic[8] = { 'S', 'R', 'T', 'R', 'A', 'C', 'E', 0 };
+static const char IndexMagic[4] = { 'S', 'R', 'T', 'I' };
+
+const int TraceFile::ChunkRecords;
+const int TraceFile::IndexEntrySize;
+
+TraceFile::TraceFile() :
+    m_map(0),
+    m_size(0)
+{
+}
+
+TraceFile::~TraceFile()
+{
+    if (m_map)
+        m_file.unmap(m_map);
+}
+
+QByteArray TraceFile::header()
+{
+    QByteArray header(Magic, sizeof(Magic));
+    uchar fields[8];
+    qToLittleEndian<quint32>(Version, fields);
+    qToLittleEndian<quint32>(ChunkRecords, fields + 4);
+    header.append((const char*) fields, sizeof(fields));
+    return header;
+}
+
+void TraceFile::appendIndexEntry(QByteArray &index, const Chunk &chunk)
+{
+    uchar entry[IndexEntrySize];
+    uchar* p = entry;
+    qToLittleEndian<quint64>(chunk.offset, p); p += 8;
+    qToLittleEndian<quint64>(chunk.firstRecord, p); p += 8;
+    qToLittleEndian<quint64>(chunk.firstCycle, p); p += 8;
+    qToLittleEndian<quint64>(chunk.lastCycle, p); p += 8;
+    qToLittleEndian<quint32>(chunk.records, p); p += 4;
+    qToLittleEndian<quint32>(chunk.writes, p); p += 4;
+    for (int r = 0; r < 4; r++) {
+        qToLittleEndian<quint16>(chunk.start.regs[r], p);
+        p += 2;
+    }
+    *p++ = chunk.start.sp;
+    *p++ = chunk.start.sr;
+    for (int c = 0; c < ColumnCount; c++) {
+        qToLittleEndian<quint32>(chunk.columnSizes[c], p);
+        p += 4;
+    }
+    memcpy(p, chunk.pcs, sizeof(chunk.pcs)); p += sizeof(chunk.pcs);
+    memcpy(p, chunk.dataWrites, sizeof(chunk.dataWrites)); p += sizeof(chunk.dataWrites);
+    memcpy(p, chunk.ioWrites, sizeof(chunk.ioWrites));
+    index.append((const char*) entry, IndexEntrySize);
+}
+
+TraceFile::Chunk TraceFile::indexEntry(const uchar *p)
+{
+    Chunk chunk;
+    chunk.offset = qFromLittleEndian<quint64>(p); p += 8;
+    chunk.firstRecord = qFromLittleEndian<quint64>(p); p += 8;
+    chunk.firstCycle = qFromLittleEndian<quint64>(p); p += 8;
+    chunk.lastCycle = qFromLittleEndian<quint64>(p); p += 8;
+    chunk.records = qFromLittleEndian<quint32>(p); p += 4;
+    chunk.writes = qFromLittleEndian<quint32>(p); p += 4;
+    for (int r = 0; r < 4; r++) {
+        chunk.start.regs[r] = qFromLittleEndian<quint16>(p);
+        p += 2;
+    }
+    chunk.start.sp = *p++;
+    chunk.start.sr = *p++;
+    for (int c = 0; c < ColumnCount; c++) {
+        chunk.columnSizes[c] = qFromLittleEndian<quint32>(p);
+        p += 4;
+    }
+    memcpy(chunk.pcs, p, sizeof(chunk.pcs)); p += sizeof(chunk.pcs);
+    memcpy(chunk.dataWrites, p, sizeof(chunk.dataWrites)); p += sizeof(chunk.dataWrites);
+    memcpy(chunk.ioWrites, p, sizeof(chunk.ioWrites));
+    return chunk;
+}
+
+bool TraceFile::open(const QString &filename)
+{
+    m_file.setFileName(filename);
+    if (!m_file.open(QFile::ReadOnly)) {
+        m_error = QString("Can't open %1").arg(filename);
+        return false;
+    }
+    m_size = m_file.size();
+    m_map = m_size >= HeaderSize + FooterSize ? m_file.map(0, m_size) : 0;
+    if (!m_map || memcmp(m_map, Magic, sizeof(Magic))) {
+        m_error = QString("%1 isn't a trace file").arg(filename);
+        return false;
+    }
+    if (qFromLittleEndian<quint32>(m_map + 8) != Version ||
+            qFromLittleEndian<quint32>(m_map + 12) != ChunkRecords) {
+        m_error = QString("%1 is from an incompatible version of srsim").arg(filename);
+        return false;
+    }
+
+    // An unfinished trace has no index
+    const uchar* footer = m_map + m_size - FooterSize;
+    quint64 indexOffset = qFromLittleEndian<quint64>(footer);
+    quint32 chunks = qFromLittleEndian<quint32>(footer + 8);
+    if (memcmp(footer + 12, IndexMagic, sizeof(IndexMagic)) ||
+            indexOffset + (quint64) chunks * IndexEntrySize + FooterSize != (quint64) m_size) {
+        m_error = QString("%1 has no index, srsim didn't finish writing it").arg(filename);
+        return false;
+    }
+    m_chunks.clear();
+    for (quint32 i = 0; i < chunks; i++)
+        m_chunks.append(indexEntry(m_map + indexOffset + i * IndexEntrySize));
+    return true;
+}
+
+quint64 TraceFile::records() const
+{
+    if (m_chunks.isEmpty())
+        return 0;
+    return m_chunks.last().firstRecord + m_chunks.last().records;
+}
+
+bool TraceFile::decode(int n, QVector<Record> *records, QVector<Write> *writes, bool instructions) const
+{
+    const Chunk& chunk = m_chunks.at(n);
+    QByteArray columns[ColumnCount];
+    const uchar* p = m_map + chunk.offset;
+    for (int c = 0; c < ColumnCount; c++) {
+        if (p + chunk.columnSizes[c] > m_map + m_size)
+            return false;
+        bool skip = (!instructions && (c == Pcs || c == Irs)) || (!writes && c >= WriteRecords);
+        if (!skip)
+            columns[c] = qUncompress(p, chunk.columnSizes[c]);
+        p += chunk.columnSizes[c];
+    }
+    if (columns[Flags].size() != (int) chunk.records || columns[Changed].size() != (int) chunk.records)
+        return false;
+    if (instructions && (columns[Pcs].size() != (int) chunk.records * 2 || columns[Irs].size() != (int) chunk.records * 2))
+        return false;
+    if (writes && (columns[WriteRecords].size() != (int) chunk.writes * 2 ||
+                   columns[WriteAddresses].size() != (int) chunk.writes * 2 || columns[WriteValues].size() != (int) chunk.writes))
+        return false;
+
+    const uchar* cycles = (const uchar*) columns[Cycles].constData();
+    const uchar* cyclesEnd = cycles + columns[Cycles].size();
+    const uchar* pcs = (const uchar*) columns[Pcs].constData();
+    const uchar* irs = (const uchar*) columns[Irs].constData();
+    const uchar* flags = (const uchar*) columns[Flags].constData();
+    const uchar* changed = (const uchar*) columns[Changed].constData();
+    const uchar* values = (const uchar*) columns[Values].constData();
+    const uchar* valuesEnd = values + columns[Values].size();
+
+    records->resize(chunk.records);
+    State state = chunk.start;
+    quint64 cycle = chunk.firstCycle;
+    for (quint32 i = 0; i < chunk.records; i++) {
+        // The first record's delta is from the end of the previous chunk, the index has its cycle
+        quint64 delta = 0;
+        int shift = 0;
+        do {
+            if (cycles == cyclesEnd)
+                return false;
+            delta |= (quint64) (*cycles & 0x7f) << shift;
+            shift += 7;
+        } while (*cycles++ & 0x80);
+        if (i > 0)
+            cycle += delta;
+
+        for (int r = 0; r < 5; r++) {
+            if (!(changed[i] & 1 << r))
+                continue;
+            if (values + 2 > valuesEnd)
+                return false;
+            if (r < 4)
+                state.regs[r] = qFromLittleEndian<quint16>(values);
+            else
+                state.sp = qFromLittleEndian<quint16>(values);
+            values += 2;
+        }
+        state.sr = flags[i] & ~InterruptEntry;
+
+        Record& record = (*records)[i];
+        record.cycle = cycle;
+        record.pc = instructions ? qFromLittleEndian<quint16>(pcs + i * 2) : 0;
+        record.ir = instructions ? qFromLittleEndian<quint16>(irs + i * 2) : 0;
+        record.interrupt = flags[i] & InterruptEntry;
+        record.state = state;
+    }
+
+    if (writes) {
+        const uchar* writeRecords = (const uchar*) columns[WriteRecords].constData();
+        const uchar* writeAddresses = (const uchar*) columns[WriteAddresses].constData();
+        const uchar* writeValues = (const uchar*) columns[WriteValues].constData();
+        writes->resize(chunk.writes);
+        for (quint32 i = 0; i < chunk.writes; i++) {
+            quint32 record = qFromLittleEndian<quint16>(writeRecords + i * 2);
+            int address = qFromLittleEndian<quint16>(writeAddresses + i * 2);
+            if (record >= chunk.records)
+                return false;
+            Write& write = (*writes)[i];
+            write.cycle = records->at(record).cycle;
+            write.io = address & IoWrite;
+            write.address = address & 0xff;
+            write.value = writeValues[i];
+        }
+    }
+    return true;
+}
+
+class TraceFileWriter::Compressor : public QThread
+{
+public:
+    static const int MaxQueued = 4;
+
+    Compressor(QFile* file) : m_file(file), m_offset(TraceFile::HeaderSize), m_failed(false) {}
+
+    // Blocks while the queue is full, a null chunk ends the thread
+    void enqueue(Pending* pending)
+    {
+        QMutexLocker locker(&m_mutex);
+        while (m_queue.size() >= MaxQueued)
+            m_changed.wait(&m_mutex);
+        m_queue.append(pending);
+        m_changed.wakeAll();
+    }
+
+    quint64 offset() const { return m_offset; }
+    bool failed() const { return m_failed; }
+    const QByteArray& index() const { return m_index; }
+    int chunks() const { return m_index.size() / TraceFile::IndexEntrySize; }
+
+protected:
+    void run()
+    {
+        forever {
+            Pending* pending;
+            {
+                QMutexLocker locker(&m_mutex);
+                while (m_queue.isEmpty())
+                    m_changed.wait(&m_mutex);
+                pending = m_queue.takeFirst();
+                m_changed.wakeAll();
+            }
+            if (!pending)
+                break;
+
+            // The fastest zlib level, the columns are repetitive enough for it
+            pending->chunk.offset = m_offset;
+            for (int c = 0; c < TraceFile::ColumnCount; c++) {
+                QByteArray compressed = qCompress(pending->columns[c], 1);
+                pending->chunk.columnSizes[c] = compressed.size();
+                if (m_file->write(compressed) != compressed.size())
+                    m_failed = true;
+                m_offset += compressed.size();
+            }
+            TraceFile::appendIndexEntry(m_index, pending->chunk);
+            delete pending;
+        }
+    }
+
+private:
+    QFile* m_file;
+    quint64 m_offset;
+    bool m_failed;
+    QByteArray m_index;
+    QMutex m_mutex;
+    QWaitCondition m_changed;
+    QList<Pending*> m_queue;
+};
+
+TraceFileWriter::TraceFileWriter() :
+    m_compressor(0),
+    m_pending(0),
+    m_cycle(0),
+    m_records(0)
+{
+}
+
+TraceFileWriter::~TraceFileWriter()
+{
+    close();
+}
+
+bool TraceFileWriter::open(const QString &filename, const TraceFile::State &state, quint64 cycle)
+{
+    m_file.setFileName(filename);
+    if (!m_file.open(QFile::WriteOnly) || m_file.write(TraceFile::header()) != TraceFile::HeaderSize)
+        return false;
+    m_state = state;
+    m_cycle = cycle;
+    m_records = 0;
+    m_compressor = new Compressor(&m_file);
+    m_compressor->start();
+    newChunk();
+    return true;
+}
+
+bool TraceFileWriter::close()
+{
+    if (!m_compressor)
+        return true;
+    if (m_pending->chunk.records > 0)
+        flushChunk();
+    delete m_pending;
+    m_pending = 0;
+    m_compressor->enqueue(0);
+    m_compressor->wait();
+
+    uchar footer[TraceFile::FooterSize];
+    qToLittleEndian<quint64>(m_compressor->offset(), footer);
+    qToLittleEndian<quint32>(m_compressor->chunks(), footer + 8);
+    memcpy(footer + 12, IndexMagic, sizeof(IndexMagic));
+    bool ok = !m_compressor->failed() && m_file.write(m_compressor->index()) == m_compressor->index().size() &&
+            m_file.write((const char*) footer, sizeof(footer)) == sizeof(footer);
+    m_file.close();
+    delete m_compressor;
+    m_compressor = 0;
+    return ok;
+}
+
+// The columns are allocated for a full chunk up front so that adding a record
+// is only stores. A record does at most one write.
+void TraceFileWriter::newChunk()
+{
+    static const int BytesPerRecord[TraceFile::ColumnCount] = { 10, 2, 2, 1, 1, 10, 2, 2, 1 };
+    m_pending = new Pending;
+    memset(&m_pending->chunk, 0, sizeof(m_pending->chunk));
+    m_pending->chunk.firstRecord = m_records;
+    for (int c = 0; c < TraceFile::ColumnCount; c++) {
+        m_pending->columns[c].resize(TraceFile::ChunkRecords * BytesPerRecord[c]);
+        m_column[c] = (uchar*) m_pending->columns[c].data();
+    }
+}
+
+void TraceFileWriter::flushChunk()
+{
+    for (int c = 0; c < TraceFile::ColumnCount; c++)
+        m_pending->columns[c].resize(m_column[c] - (const uchar*) m_pending->columns[c].constData());
+    m_compressor->enqueue(m_pending);
+    m_pending = 0;
+}
+
+void TraceFileWriter::append16(TraceFile::Column column, int value)
+{
+    qToLittleEndian<quint16>(value, m_column[column]);
+    m_column[column] += 2;
+}
+
+void TraceFileWriter::written(int address, unsigned char value)
+{
+    // Belongs to the record executed() gets next
+    TraceFile::Chunk& chunk = m_pending->chunk;
+    append16(TraceFile::WriteRecords, chunk.records);
+    append16(TraceFile::WriteAddresses, address);
+    *m_column[TraceFile::WriteValues]++ = value;
+    TraceFile::set((address & TraceFile::IoWrite) ? chunk.ioWrites : chunk.dataWrites, address & 0xff);
+    chunk.writes++;
+}
+
+void TraceFileWriter::executed(quint64 cycle, int pc, unsigned short ir, bool interrupt,
+                               const unsigned short *regs, int sp, int sr)
+{
+    TraceFile::Chunk& chunk = m_pending->chunk;
+    if (chunk.records == 0) {
+        chunk.firstCycle = cycle;
+        chunk.start = m_state;
+    }
+
+    quint64 delta = cycle - m_cycle;
+    while (delta >= 0x80) {
+        *m_column[TraceFile::Cycles]++ = delta | 0x80;
+        delta >>= 7;
+    }
+    *m_column[TraceFile::Cycles]++ = delta;
+    append16(TraceFile::Pcs, pc);
+    append16(TraceFile::Irs, ir);
+    *m_column[TraceFile::Flags]++ = sr | (interrupt ? TraceFile::InterruptEntry : 0);
+
+    int changed = 0;
+    for (int r = 0; r < 4; r++) {
+        if (regs[r] != m_state.regs[r]) {
+            changed |= 1 << r;
+            append16(TraceFile::Values, regs[r]);
+            m_state.regs[r] = regs[r];
+        }
+    }
+    if (sp != m_state.sp) {
+        changed |= TraceFile::SpChanged;
+        append16(TraceFile::Values, sp);
+        m_state.sp = sp;
+    }
+    m_state.sr = sr;
+    *m_column[TraceFile::Changed]++ = changed;
+
+    TraceFile::set(chunk.pcs, pc & (PROGRAM_SIZE - 1));
+    chunk.lastCycle = cycle;
+    chunk.records++;
+    m_cycle = cycle;
+    m_records++;
+    if (chunk.records == TraceFile::ChunkRecords) {
+        flushChunk();
+        newChunk();
+    }
+}
@@ -0,0 +1,185 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#ifndef TRACEFILE_H
+#define TRACEFILE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+#include "isa.h"
+
+// Binary execution trace for long runs, written by srsim --trace-file and
+// queried with tools/srtrace. There's a record for every executed instruction
+// and interrupt entry, a HALT that waits is recorded once like the trace buffer
+// does it. The records are stored in chunks of ChunkRecords with each field in
+// a column of its own, compressed separately:
+//   Cycles          cycles since the previous record, LEB128
+//   Pcs, Irs        bank * 256 + PC and the instruction, 16-bit
+//   Flags           SR after the record, InterruptEntry for an interrupt entry
+//   Changed         mask of the registers the record changed, bits 0-3 and SpChanged
+//   Values          new values of the changed registers, 16-bit
+//   WriteRecords    record of each memory and I/O write within the chunk, 16-bit
+//   WriteAddresses  address, IoWrite set for I/O, 16-bit
+//   WriteValues     8-bit
+// Everything is little endian. The file has a header in front and the index
+// of the chunks at the end. The index entries have the state at the start of
+// the chunk and bitmaps of the PCs executed and the addresses written in it, a
+// query only decompresses the chunks that can match.
+class TraceFile
+{
+public:
+    static const int ChunkRecords = 65536;
+    static const int Version = 1;
+
+    enum Column { Cycles, Pcs, Irs, Flags, Changed, Values, WriteRecords, WriteAddresses, WriteValues, ColumnCount };
+    enum { InterruptEntry = 0x80, SpChanged = 0x10, IoWrite = 0x100 };
+
+    struct State {
+        quint16 regs[4];
+        quint8 sp;
+        quint8 sr;
+    };
+
+    // The cycle count and state after the record
+    struct Record {
+        quint64 cycle;
+        int pc;
+        quint16 ir;
+        bool interrupt;
+        State state;
+    };
+
+    struct Write {
+        quint64 cycle;
+        bool io;
+        int address;
+        quint8 value;
+    };
+
+    struct Chunk {
+        quint64 offset;
+        quint64 firstRecord;
+        quint64 firstCycle;
+        quint64 lastCycle;
+        quint32 records;
+        quint32 writes;
+        State start;
+        quint32 columnSizes[ColumnCount];
+        uchar pcs[PROGRAM_SIZE / 8];
+        uchar dataWrites[32];
+        uchar ioWrites[32];
+    };
+
+    TraceFile();
+    ~TraceFile();
+
+    // Maps the file, the chunks are decompressed on demand
+    bool open(const QString& filename);
+    QString errorString() const { return m_error; }
+
+    int chunkCount() const { return m_chunks.size(); }
+    const Chunk& chunk(int n) const { return m_chunks.at(n); }
+    quint64 records() const;
+    qint64 fileSize() const { return m_size; }
+
+    bool executes(int chunk, int pc) const { return test(m_chunks.at(chunk).pcs, pc & (PROGRAM_SIZE - 1)); }
+    bool writes(int chunk, bool io, int address) const
+    {
+        return test(io ? m_chunks.at(chunk).ioWrites : m_chunks.at(chunk).dataWrites, address & 0xff);
+    }
+
+    // Without instructions the pc and ir of the records are left zero, which
+    // saves decompressing two columns when only the state is needed
+    bool decode(int chunk, QVector<Record>* records, QVector<Write>* writes, bool instructions = true) const;
+
+    // For the writer
+    static const int HeaderSize = 16;
+    static const int FooterSize = 16;
+    static const int IndexEntrySize = 4 * 8 + 2 * 4 + 10 + ColumnCount * 4 + PROGRAM_SIZE / 8 + 64;
+    static QByteArray header();
+    static void appendIndexEntry(QByteArray& index, const Chunk& chunk);
+    static void set(uchar* bitmap, int bit) { bitmap[bit >> 3] |= 1 << (bit & 7); }
+
+private:
+    static bool test(const uchar* bitmap, int bit) { return bitmap[bit >> 3] & 1 << (bit & 7); }
+    static Chunk indexEntry(const uchar* p);
+
+private:
+    QFile m_file;
+    uchar* m_map;
+    qint64 m_size;
+    QList<Chunk> m_chunks;
+    QString m_error;
+};
+
+// Fills the columns of a chunk as the simulator runs and hands full chunks to
+// a thread that compresses and writes them, the simulator only waits when that
+// falls MaxQueued chunks behind.
+class TraceFileWriter
+{
+public:
+    TraceFileWriter();
+    ~TraceFileWriter();
+
+    // The state and cycle count the trace starts from
+    bool open(const QString& filename, const TraceFile::State& state, quint64 cycle);
+    // Writes the last chunk and the index
+    bool close();
+
+    inline void dataWritten(int address, unsigned char value) { written(address, value); }
+    inline void ioWritten(int address, unsigned char value) { written(address | TraceFile::IoWrite, value); }
+    void executed(quint64 cycle, int pc, unsigned short ir, bool interrupt, const unsigned short* regs, int sp, int sr);
+
+private:
+    struct Pending {
+        TraceFile::Chunk chunk;
+        QByteArray columns[TraceFile::ColumnCount];
+    };
+    class Compressor;
+
+    void written(int address, unsigned char value);
+    void newChunk();
+    void flushChunk();
+    inline void append16(TraceFile::Column column, int value);
+
+private:
+    QFile m_file;
+    Compressor* m_compressor;
+    Pending* m_pending;
+    // Where the next byte of each column of the pending chunk goes
+    uchar* m_column[TraceFile::ColumnCount];
+    TraceFile::State m_state;
+    quint64 m_cycle;
+    quint64 m_records;
+};
+
+#endif // TRACEFILE_H
@@ -0,0 +1,209 @@
+/*
+   Copyright (c) 2014, Juha Turunen
+   All rights reserved.
+
+   Redistribution and use in source and binary forms, with or without
+   modification, are permitted provided that the following conditions are met:
+
+   1. Redistributions of source code must retain the above copyright notice, this
+      list of conditions and the following disclaimer.
+   2. Redistributions in binary form must reproduce the above copyright notice,
+      this list of conditions and the following disclaimer in the documentation
+      and/or other materials provided with the distribution.
+
+   THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+   ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+   WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+   DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+   ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+   (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+   LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+   ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+   (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+   SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QElapsedTimer>
+#include <stdio.h>
+
+#include "tracefile.h"
+#include "labelmap.h"
+#include "disassembler.h"
+
+// $hex, 0x hex, decimal or a label
+static bool parseAddress(const QString& text, const QMap<QString, int>& labels, int limit, int* address)
+{
+    bool ok = false;
+    int value = text.startsWith("$") ? text.mid(1).toInt(&ok, 16) : text.toInt(&ok, 0);
+    if (!ok && labels.contains(text)) {
+        value = labels.value(text);
+        ok = true;
+    }
+    if (!ok || value < 0 || value >= limit) {
+        qDebug() << "Invalid address" << text;
+        return false;
+    }
+    *address = value;
+    return true;
+}
+
+static void printRecord(const TraceFile::Record& record, const Disassembler& disassembler)
+{
+    const TraceFile::State& s = record.state;
+    printf("%12llu  %03x  %04x  %-24s R0=%04x R1=%04x R2=%04x R3=%04x SP=%02x SR=%02x\n",
+           (unsigned long long) record.cycle, record.pc, record.ir,
+           record.interrupt ? "<interrupt>" : qPrintable(disassembler.disassemble(record.ir, record.pc)),
+           s.regs[0], s.regs[1], s.regs[2], s.regs[3], s.sp, s.sr);
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Queries the binary execution traces written by srsim --trace-file");
+    parser.addHelpOption();
+    parser.addPositionalArgument("trace", "Trace file written by srsim --trace-file");
+    QCommandLineOption mapOption(QStringList() << "m" << "map", "Label map written by srasm --map", "file");
+    QCommandLineOption writesOption("writes", "Every write to data memory <address>", "address");
+    QCommandLineOption ioWritesOption("io-writes", "Every write to I/O <address>", "address");
+    QCommandLineOption pcOption("pc", "The first time the instruction at <address> executes, "
+                                "a code label or bank * 256 + PC", "address");
+    QCommandLineOption allOption("all", "Every time the --pc instruction executes instead of the first");
+    QCommandLineOption regOption("reg", "Value of <register> (r0-r3, sp or sr) over time, printed when it changes", "register");
+    QCommandLineOption listOption("list", "Every executed instruction with the state after it");
+    QCommandLineOption fromOption("from", "Ignore records before <cycle>", "cycle", "0");
+    QCommandLineOption toOption("to", "Ignore records after <cycle>", "cycle");
+    parser.addOption(mapOption);
+    parser.addOption(writesOption);
+    parser.addOption(ioWritesOption);
+    parser.addOption(pcOption);
+    parser.addOption(allOption);
+    parser.addOption(regOption);
+    parser.addOption(listOption);
+    parser.addOption(fromOption);
+    parser.addOption(toOption);
+    parser.process(a);
+
+    QStringList args = parser.positionalArguments();
+    if (args.isEmpty())
+        parser.showHelp(1);
+
+    LabelMap labels;
+    if (parser.isSet(mapOption) && !labels.load(parser.value(mapOption)))
+        return 1;
+    Disassembler disassembler(labels.codeAddresses(), labels.dataAddresses());
+
+    TraceFile trace;
+    if (!trace.open(args.at(0))) {
+        qDebug() << qPrintable(trace.errorString());
+        return 1;
+    }
+
+    quint64 from = parser.value(fromOption).toULongLong();
+    quint64 to = parser.isSet(toOption) ? parser.value(toOption).toULongLong() : ~0ULL;
+
+    int writeAddress = -1;
+    bool io = parser.isSet(ioWritesOption);
+    if (parser.isSet(writesOption) && !parseAddress(parser.value(writesOption), labels.dataLabels(), 256, &writeAddress))
+        return 1;
+    if (io && !parseAddress(parser.value(ioWritesOption), QMap<QString, int>(), 256, &writeAddress))
+        return 1;
+    int pc = -1;
+    if (parser.isSet(pcOption) && !parseAddress(parser.value(pcOption), labels.codeLabels(), PROGRAM_SIZE, &pc))
+        return 1;
+    int reg = -1;
+    if (parser.isSet(regOption)) {
+        reg = (QStringList() << "r0" << "r1" << "r2" << "r3" << "sp" << "sr").indexOf(parser.value(regOption).toLower());
+        if (reg < 0) {
+            qDebug() << "Invalid register" << parser.value(regOption);
+            return 1;
+        }
+    }
+
+    if (writeAddress < 0 && pc < 0 && reg < 0 && !parser.isSet(listOption)) {
+        quint64 cycles = trace.chunkCount() ? trace.chunk(trace.chunkCount() - 1).lastCycle : 0;
+        quint64 writes = 0;
+        for (int i = 0; i < trace.chunkCount(); i++)
+            writes += trace.chunk(i).writes;
+        printf("%llu records, %llu writes over %llu cycles in %d chunks\n", (unsigned long long) trace.records(),
+               (unsigned long long) writes, (unsigned long long) cycles, trace.chunkCount());
+        printf("%lld bytes, %.2f bytes per record\n", trace.fileSize(),
+               trace.records() ? (double) trace.fileSize() / trace.records() : 0.0);
+        return 0;
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+    QVector<TraceFile::Record> records;
+    QVector<TraceFile::Write> writes;
+    int lastValue = -1;
+    int decoded = 0;
+    quint64 matches = 0;
+    bool done = false;
+    for (int c = 0; c < trace.chunkCount() && !done; c++) {
+        const TraceFile::Chunk& chunk = trace.chunk(c);
+        if (chunk.lastCycle < from)
+            continue;
+        if (chunk.firstCycle > to)
+            break;
+        // The index tells which chunks can't match
+        if (writeAddress >= 0 && !trace.writes(c, io, writeAddress))
+            continue;
+        if (pc >= 0 && !trace.executes(c, pc))
+            continue;
+
+        if (!trace.decode(c, &records, writeAddress >= 0 ? &writes : 0, reg < 0)) {
+            qDebug() << "Chunk" << c << "is corrupt";
+            return 1;
+        }
+        decoded++;
+
+        if (writeAddress >= 0) {
+            foreach (const TraceFile::Write& write, writes) {
+                if (write.io == io && write.address == writeAddress && write.cycle >= from && write.cycle <= to) {
+                    printf("%12llu  %s $%02x = $%02x\n", (unsigned long long) write.cycle, io ? "out" : "st ",
+                           write.address, write.value);
+                    matches++;
+                }
+            }
+            continue;
+        }
+
+        foreach (const TraceFile::Record& record, records) {
+            if (record.cycle < from)
+                continue;
+            if (record.cycle > to) {
+                done = true;
+                break;
+            }
+            if (pc >= 0) {
+                if (record.pc != pc || record.interrupt)
+                    continue;
+                printRecord(record, disassembler);
+                matches++;
+                if (!parser.isSet(allOption)) {
+                    done = true;
+                    break;
+                }
+            } else if (reg >= 0) {
+                int value = reg < 4 ? record.state.regs[reg] : reg == 4 ? record.state.sp : record.state.sr;
+                if (value != lastValue) {
+                    printf("%12llu  %04x\n", (unsigned long long) record.cycle, value);
+                    lastValue = value;
+                    matches++;
+                }
+            } else {
+                printRecord(record, disassembler);
+                matches++;
+            }
+        }
+    }
+    fflush(stdout);
+    fprintf(stderr, "%llu matches, decompressed %d of %d chunks in %.3f s\n", (unsigned long long) matches,
+            decoded, trace.chunkCount(), timer.nsecsElapsed() / 1e9);
+    return 0;
+}
@@ -0,0 +1,23 @@
+QT       += core
+QT       -= gui
+
+TARGET = srtrace
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+QMAKE_CXXFLAGS = -std=c++0x
+
+INCLUDEPATH += ../srsim ../srasm
+
+SOURCES += main.cpp \
+    ../srsim/tracefile.cpp \
+    ../srsim/labelmap.cpp \
+    ../srsim/disassembler.cpp
+
+HEADERS += \
+    ../srsim/tracefile.h \
+    ../srsim/labelmap.h \
+    ../srsim/disassembler.h \
+    ../srasm/isa.h